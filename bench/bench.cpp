@@ -0,0 +1,509 @@
+#include "common/allocator.hpp"
+#include "common/profiler.hpp"
+#include "physics/solver.hpp"
+#include "physics/simd_solver.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Headless throughput benchmark of the AoS (environment) and SoA (simd::f32_solver) engines.
+ * Every run builds a fresh engine from a seeded scenario, steps it `warmup` frames untimed and
+ * `frames` frames timed, and is repeated `repeats` times. One record is printed per
+ * (engine, scenario, particle count, thread count) as CSV (default) or JSON. The AoS particles
+ * live in a pool_allocator whose chunks are backed by `pages`. The SoA engine runs once per
+ * grid `precision`; each record has the bytes per slot its collision kernel streams and the
+ * RMS position error one frame adds against f32, from the same warmed-up state. Both engines
+ * run once per `broadphase`, and `world` overrides the side of the world the count implies.
+ *
+ *   bench --engine=both --scenario=all --counts=1000,4000,12000 --threads=1,8 --format=json
+ *   bench --engine=soa --precision=f32,fixed16
+ *   bench --scenario=sparse --world=100000 --broadphase=grid,hash
+ *   bench --scenario=all --broadphase=grid,sap
+ */
+namespace collision_engine::bench {
+
+enum class scenario { pile, gas, polydisperse, clustered, mixed, sparse };
+
+struct spawn {
+    float32_t x, y, px, py, r;
+};
+
+struct options {
+    std::vector<std::string>    engines     = {"aos", "soa"};
+    std::vector<scenario>       scenarios   = {scenario::pile, scenario::gas, scenario::polydisperse, scenario::clustered, scenario::mixed, scenario::sparse};
+    std::vector<uint32_t>       counts      = {1000, 4000, 12000};
+    std::vector<uint32_t>       threads     = {};   // 1 and every hardware thread by default
+    uint32_t                    frames      = 120;
+    uint32_t                    warmup      = 30;
+    uint32_t                    repeats     = 3;
+    uint32_t                    seed        = 42;
+    std::string                 format      = "csv";
+    std::string                 label       = "";   // e.g. a commit hash, copied into every record
+    page_backing                pages       = page_backing::standard;
+    std::vector<simd::precision> precisions = {simd::precision::f32};
+    std::vector<broadphase>     broadphases = {broadphase::uniform_grid};
+    uint32_t                    world       = 0;    // side of the world, 0 sizes it from the count
+};
+
+struct result {
+    std::string engine;
+    scenario    scene;
+    uint32_t    particles;
+    uint32_t    threads;
+    uint32_t    world;
+    broadphase  bp;
+    std::string precision;      // effective grid precision of the SoA engine, "-" for AoS
+    uint32_t    slot_bytes;     // per-slot state the SoA collision kernel streams, 0 for AoS
+    double      error_px;       // RMS position error of one frame against f32
+    double      substeps_per_sec;
+    double      substeps_per_sec_stddev;
+    double      ns_per_particle_substep;
+    double      ns_per_particle_substep_stddev;
+    double      frame_ms_mean;
+    double      frame_ms_stddev;
+    double      frame_ms_max;
+    double      frame_ms_p50;
+    double      frame_ms_p99;
+    double      frame_ms_p999;
+};
+
+constexpr float32_t dt          = 1.f / 60.f;
+constexpr float32_t radius      = 2.f;  // fits the smallest cells of the AoS engine (4px at 512px)
+constexpr float32_t spacing     = 4.2f; // lattice pitch of the packed scenarios
+constexpr float32_t margin      = 4.f;
+
+const char* name(simd::precision p) {
+    return p == simd::precision::fixed16 ? "fixed16" : "f32";
+}
+
+const char* name(broadphase b) {
+    return b == broadphase::spatial_hash ? "hash" : b == broadphase::sweep_and_prune ? "sap" : "grid";
+}
+
+const char* name(scenario s) {
+    switch (s) {
+        case scenario::pile:            return "pile";
+        case scenario::gas:             return "gas";
+        case scenario::polydisperse:    return "polydisperse";
+        case scenario::clustered:       return "clustered";
+        case scenario::mixed:           return "mixed";
+        case scenario::sparse:          return "sparse";
+    }
+    return "";
+}
+
+/**
+ * @return side of the square world both engines are given for n particles, the packed
+ *         lattice fills about half of it
+ */
+uint32_t world_side(uint32_t n) {
+    const uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(2.f * n) * spacing + 2 * margin));
+    return std::max(512u, side);
+}
+
+/**
+ * Seeded initial conditions in a square world of side `world`:
+ *  - pile:         a packed lattice filling the world from the floor up, at rest
+ *  - gas:          uniformly scattered particles with random velocities
+ *  - polydisperse: the pile with radii drawn from [radius / 2, radius]
+ *  - clustered:    eight gaussian blobs with random velocities
+ *  - mixed:        the gas with every 100th particle a boulder of 8 times the radius
+ *  - sparse:       eight packed square blocks at rest, scattered over the world; with a
+ *                  large --world most of it is empty
+ */
+std::vector<spawn> make_scenario(scenario s, uint32_t n, uint32_t world, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float32_t> unit(0.f, 1.f);
+    std::vector<spawn> spawns;
+    spawns.reserve(n);
+
+    const float32_t lo = margin + radius;
+    const float32_t hi = world - margin - radius;
+    const auto clamp = [&](float32_t v) { return std::clamp(v, lo, hi); };
+
+    switch (s) {
+        case scenario::pile:
+        case scenario::polydisperse: {
+            const uint32_t per_row = static_cast<uint32_t>((hi - lo) / spacing) + 1;
+            for (uint32_t i = 0; i < n; i++) {
+                const float32_t x = lo + spacing * (i % per_row) + 0.1f * unit(rng);
+                const float32_t y = hi - spacing * (i / per_row);
+                const float32_t r = s == scenario::pile ? radius : radius * (0.5f + 0.5f * unit(rng));
+                spawns.push_back({x, y, x, y, r});
+            }
+            break;
+        }
+        case scenario::gas:
+        case scenario::mixed: {
+            for (uint32_t i = 0; i < n; i++) {
+                const float32_t r = s == scenario::mixed && i % 100 == 0 ? 8 * radius : radius;
+                const float32_t x = lo - radius + r + (hi - lo + 2 * (radius - r)) * unit(rng);
+                const float32_t y = lo - radius + r + (hi - lo + 2 * (radius - r)) * unit(rng);
+                spawns.push_back({x, y, x - (unit(rng) - 0.5f), y - (unit(rng) - 0.5f), r});
+            }
+            break;
+        }
+        case scenario::clustered: {
+            constexpr uint32_t n_clusters = 8;
+            std::vector<std::pair<float32_t, float32_t>> centres;
+            for (uint32_t c = 0; c < n_clusters; c++) {
+                centres.push_back({lo + (hi - lo) * unit(rng), lo + (hi - lo) * unit(rng)});
+            }
+            std::normal_distribution<float32_t> spread(0.f, world / 16.f);
+            for (uint32_t i = 0; i < n; i++) {
+                const auto [cx, cy] = centres[i % n_clusters];
+                const float32_t x = clamp(cx + spread(rng));
+                const float32_t y = clamp(cy + spread(rng));
+                spawns.push_back({x, y, x - 0.5f * (unit(rng) - 0.5f), y - 0.5f * (unit(rng) - 0.5f), radius});
+            }
+            break;
+        }
+        case scenario::sparse: {
+            constexpr uint32_t n_clusters = 8;
+            const uint32_t per_cluster = (n + n_clusters - 1) / n_clusters;
+            const uint32_t per_row = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float32_t>(per_cluster))));
+            const float32_t side = spacing * per_row;
+            std::vector<std::pair<float32_t, float32_t>> corners;
+            for (uint32_t c = 0; c < n_clusters; c++) {
+                corners.push_back({lo + std::max(0.f, hi - lo - side) * unit(rng), lo + std::max(0.f, hi - lo - side) * unit(rng)});
+            }
+            for (uint32_t i = 0; i < n; i++) {
+                const auto [cx, cy] = corners[i % n_clusters];
+                const uint32_t k = i / n_clusters;
+                const float32_t x = clamp(cx + spacing * (k % per_row) + 0.1f * unit(rng));
+                const float32_t y = clamp(cy + spacing * (k / per_row));
+                spawns.push_back({x, y, x, y, radius});
+            }
+            break;
+        }
+    }
+    return spawns;
+}
+
+double mean(const std::vector<double>& v) {
+    double sum = 0;
+    for (double x : v) { sum += x; }
+    return v.empty() ? 0 : sum / v.size();
+}
+
+double stddev(const std::vector<double>& v) {
+    if (v.size() < 2) {
+        return 0;
+    }
+    const double m = mean(v);
+    double sq = 0;
+    for (double x : v) { sq += (x - m) * (x - m); }
+    return std::sqrt(sq / (v.size() - 1));
+}
+
+/**
+ * Steps `engine` for the warmup and timed frames, appending the timed frame durations (ns)
+ */
+template <typename StepFunction>
+void time_frames(const options& opt, StepFunction&& step, std::vector<double>& frame_ns) {
+    for (uint32_t f = 0; f < opt.warmup; f++) {
+        step();
+    }
+    for (uint32_t f = 0; f < opt.frames; f++) {
+        const auto start = std::chrono::steady_clock::now();
+        step();
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        frame_ns.push_back(std::chrono::duration<double, std::nano>(elapsed).count());
+    }
+}
+
+/**
+ * Steps two SoA engines through the warmup frames on f32, then one frame with one of them on
+ * precision p
+ *
+ * @return RMS distance between their particles
+ */
+double precision_error(const options& opt, const std::vector<spawn>& spawns, uint32_t world, uint32_t threads, broadphase bp, simd::precision p) {
+    if (p == simd::precision::f32) {
+        return 0;
+    }
+    simd::f32_solver reference(dt, world, world, simd::isa::active(), threads, bp);
+    simd::f32_solver reduced(dt, world, world, simd::isa::active(), threads, bp);
+    for (const spawn& sp : spawns) {
+        reference.add_particle(simd::particle<float32_t>(sp.x, sp.y, sp.px, sp.py, sp.r));
+        reduced.add_particle(simd::particle<float32_t>(sp.x, sp.y, sp.px, sp.py, sp.r));
+    }
+    for (uint32_t f = 0; f < opt.warmup; f++) {
+        reference.step();
+        reduced.step();
+    }
+    reduced.set_precision(p);
+    reference.step();
+    reduced.step();
+    reference.stop();
+    reduced.stop();
+
+    double sq = 0;
+    for (uint32_t i = 0; i < spawns.size(); i++) {
+        const double dx = reference.pc().xs[i] - reduced.pc().xs[i];
+        const double dy = reference.pc().ys[i] - reduced.pc().ys[i];
+        sq += dx * dx + dy * dy;
+    }
+    return spawns.empty() ? 0 : std::sqrt(sq / spawns.size());
+}
+
+/**
+ * Runs one (engine, scenario, count, threads, broadphase, precision) configuration `repeats` times
+ */
+result run(const options& opt, const std::string& engine, scenario s, uint32_t n, uint32_t threads, broadphase bp, simd::precision precision) {
+    using W = vec2<uint32_t>;
+    using VT = vec2<float32_t>;
+    using PT = particle<VT>;
+
+    const bool aos = engine == "aos";
+    const uint32_t world = opt.world ? opt.world : world_side(n);
+    const uint32_t sub_steps = aos ? environment<VT, W>::sub_steps() : simd::f32_solver::sub_steps();
+
+    std::vector<double> frame_ns, substeps_per_sec, ns_per_particle;
+    std::string effective = "-";
+    uint32_t slot_bytes = 0;
+    for (uint32_t rep = 0; rep < opt.repeats; rep++) {
+        const std::vector<spawn> spawns = make_scenario(s, n, world, opt.seed);
+        const size_t first_frame = frame_ns.size();
+
+        if (aos) {
+            environment<VT, W> env(W{world, world}, threads, bp);
+            pool_allocator pool(sizeof(PT), alignof(PT), 1u << 16, opt.pages);
+            for (uint32_t i = 0; i < n; i++) {
+                PT* p = new (pool.allocate(sizeof(PT), alignof(PT))) PT();
+                p->position = VT(spawns[i].x, spawns[i].y);
+                p->prev_position = VT(spawns[i].px, spawns[i].py);
+                p->radius = spawns[i].r;
+                env.add_particle(p);
+            }
+            time_frames(opt, [&]() { env.step(dt); }, frame_ns);
+            env.stop();
+        } else {
+            simd::f32_solver solver(dt, world, world, simd::isa::active(), threads, bp);
+            solver.set_precision(precision);
+            for (const spawn& sp : spawns) {
+                solver.add_particle(simd::particle<float32_t>(sp.x, sp.y, sp.px, sp.py, sp.r));
+            }
+            time_frames(opt, [&]() { solver.step(); }, frame_ns);
+            effective = name(solver.precision());
+            slot_bytes = solver.grid().slot_bytes();
+            solver.stop();
+        }
+
+        double total_ns = 0;
+        for (size_t f = first_frame; f < frame_ns.size(); f++) { total_ns += frame_ns[f]; }
+        const double substeps = static_cast<double>(opt.frames) * sub_steps;
+        substeps_per_sec.push_back(substeps / (total_ns * 1e-9));
+        ns_per_particle.push_back(total_ns / (substeps * n));
+    }
+
+    double frame_max = 0;
+    frame_histogram histogram;
+    for (double ns : frame_ns) {
+        frame_max = std::max(frame_max, ns);
+        histogram.record(static_cast<uint64_t>(ns));
+    }
+    std::vector<double> frame_ms(frame_ns.size());
+    std::transform(frame_ns.begin(), frame_ns.end(), frame_ms.begin(), [](double ns) { return ns * 1e-6; });
+
+    const double error = aos ? 0 : precision_error(opt, make_scenario(s, n, world, opt.seed), world, threads, bp, precision);
+
+    return result{
+        engine, s, n, threads, world, bp, effective, slot_bytes, error,
+        mean(substeps_per_sec), stddev(substeps_per_sec),
+        mean(ns_per_particle), stddev(ns_per_particle),
+        mean(frame_ms), stddev(frame_ms), frame_max * 1e-6,
+        histogram.percentile(50) * 1e-6, histogram.percentile(99) * 1e-6, histogram.percentile(99.9) * 1e-6,
+    };
+}
+
+void print_csv_header() {
+    std::cout<<"label,engine,isa,scenario,particles,threads,world,broadphase,precision,slot_bytes,error_px,frames,repeats,"
+             <<"substeps_per_sec,substeps_per_sec_stddev,ns_per_particle_substep,ns_per_particle_substep_stddev,"
+             <<"frame_ms_mean,frame_ms_stddev,frame_ms_max,frame_ms_p50,frame_ms_p99,frame_ms_p999"<<std::endl;
+}
+
+void print_csv(const options& opt, const result& r) {
+    std::cout<<opt.label<<","<<r.engine<<","<<(r.engine == "soa" ? simd::isa::name(simd::isa::active()) : "-")<<","
+             <<name(r.scene)<<","<<r.particles<<","<<r.threads<<","<<r.world<<","<<name(r.bp)<<","
+             <<r.precision<<","<<r.slot_bytes<<","<<r.error_px<<","<<opt.frames<<","<<opt.repeats<<","
+             <<r.substeps_per_sec<<","<<r.substeps_per_sec_stddev<<","
+             <<r.ns_per_particle_substep<<","<<r.ns_per_particle_substep_stddev<<","
+             <<r.frame_ms_mean<<","<<r.frame_ms_stddev<<","<<r.frame_ms_max<<","
+             <<r.frame_ms_p50<<","<<r.frame_ms_p99<<","<<r.frame_ms_p999<<std::endl;
+}
+
+void print_json(const options& opt, const result& r, bool first) {
+    std::cout<<(first ? "  " : ",\n  ")
+             <<"{\"label\": \""<<opt.label<<"\", \"engine\": \""<<r.engine<<"\", "
+             <<"\"isa\": \""<<(r.engine == "soa" ? simd::isa::name(simd::isa::active()) : "-")<<"\", "
+             <<"\"scenario\": \""<<name(r.scene)<<"\", \"particles\": "<<r.particles<<", "
+             <<"\"threads\": "<<r.threads<<", \"world\": "<<r.world<<", \"broadphase\": \""<<name(r.bp)<<"\", "
+             <<"\"precision\": \""<<r.precision<<"\", \"slot_bytes\": "<<r.slot_bytes<<", \"error_px\": "<<r.error_px<<", "
+             <<"\"frames\": "<<opt.frames<<", \"repeats\": "<<opt.repeats<<", "
+             <<"\"substeps_per_sec\": "<<r.substeps_per_sec<<", \"substeps_per_sec_stddev\": "<<r.substeps_per_sec_stddev<<", "
+             <<"\"ns_per_particle_substep\": "<<r.ns_per_particle_substep<<", "
+             <<"\"ns_per_particle_substep_stddev\": "<<r.ns_per_particle_substep_stddev<<", "
+             <<"\"frame_ms_mean\": "<<r.frame_ms_mean<<", \"frame_ms_stddev\": "<<r.frame_ms_stddev<<", "
+             <<"\"frame_ms_max\": "<<r.frame_ms_max<<", \"frame_ms_p50\": "<<r.frame_ms_p50<<", "
+             <<"\"frame_ms_p99\": "<<r.frame_ms_p99<<", \"frame_ms_p999\": "<<r.frame_ms_p999<<"}";
+}
+
+std::vector<std::string> split(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    for (std::string item; std::getline(ss, item, ',');) {
+        if (!item.empty()) { items.push_back(item); }
+    }
+    return items;
+}
+
+std::vector<uint32_t> split_counts(const std::string& list) {
+    std::vector<uint32_t> values;
+    for (const std::string& item : split(list)) {
+        values.push_back(static_cast<uint32_t>(std::stoul(item)));
+    }
+    return values;
+}
+
+bool parse(int argc, char** argv, options& opt) {
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const size_t eq = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || eq == std::string::npos) {
+            std::cerr<<"unknown argument "<<arg<<std::endl;
+            return false;
+        }
+        const std::string key = arg.substr(2, eq - 2);
+        const std::string value = arg.substr(eq + 1);
+
+        if (key == "engine") {
+            opt.engines = value == "both" ? std::vector<std::string>{"aos", "soa"} : split(value);
+        } else if (key == "scenario") {
+            if (value == "all") {
+                continue;
+            }
+            opt.scenarios.clear();
+            for (const std::string& item : split(value)) {
+                bool known = false;
+                for (scenario s : {scenario::pile, scenario::gas, scenario::polydisperse, scenario::clustered, scenario::mixed, scenario::sparse}) {
+                    if (item == name(s)) { opt.scenarios.push_back(s); known = true; }
+                }
+                if (!known) {
+                    std::cerr<<"unknown scenario "<<item<<std::endl;
+                    return false;
+                }
+            }
+        } else if (key == "counts") {
+            opt.counts = split_counts(value);
+        } else if (key == "threads") {
+            opt.threads = split_counts(value);
+        } else if (key == "frames") {
+            opt.frames = std::stoul(value);
+        } else if (key == "warmup") {
+            opt.warmup = std::stoul(value);
+        } else if (key == "repeats") {
+            opt.repeats = std::max(1ul, std::stoul(value));
+        } else if (key == "seed") {
+            opt.seed = std::stoul(value);
+        } else if (key == "format") {
+            opt.format = value;
+        } else if (key == "label") {
+            opt.label = value;
+        } else if (key == "pages") {
+            if (value == "standard") { opt.pages = page_backing::standard; }
+            else if (value == "transparent") { opt.pages = page_backing::transparent; }
+            else if (value == "huge") { opt.pages = page_backing::huge; }
+            else {
+                std::cerr<<"unknown page backing "<<value<<std::endl;
+                return false;
+            }
+        } else if (key == "precision") {
+            opt.precisions.clear();
+            for (const std::string& item : split(value)) {
+                if (item == "f32") { opt.precisions.push_back(simd::precision::f32); }
+                else if (item == "fixed16") { opt.precisions.push_back(simd::precision::fixed16); }
+                else {
+                    std::cerr<<"unknown precision "<<item<<std::endl;
+                    return false;
+                }
+            }
+        } else if (key == "broadphase") {
+            opt.broadphases.clear();
+            for (const std::string& item : split(value)) {
+                if (item == "grid") { opt.broadphases.push_back(broadphase::uniform_grid); }
+                else if (item == "hash") { opt.broadphases.push_back(broadphase::spatial_hash); }
+                else if (item == "sap") { opt.broadphases.push_back(broadphase::sweep_and_prune); }
+                else {
+                    std::cerr<<"unknown broadphase "<<item<<std::endl;
+                    return false;
+                }
+            }
+        } else if (key == "world") {
+            opt.world = std::stoul(value);
+        } else {
+            std::cerr<<"unknown option --"<<key<<std::endl;
+            return false;
+        }
+    }
+    for (const std::string& e : opt.engines) {
+        if (e != "aos" && e != "soa") {
+            std::cerr<<"unknown engine "<<e<<std::endl;
+            return false;
+        }
+    }
+    if (opt.format != "csv" && opt.format != "json") {
+        std::cerr<<"unknown format "<<opt.format<<std::endl;
+        return false;
+    }
+    if (opt.threads.empty()) {
+        opt.threads = {1};
+        if (thread_pool::hardware_threads() > 1) { opt.threads.push_back(thread_pool::hardware_threads()); }
+    }
+    return true;
+}
+
+} // namespace collision_engine::bench
+
+int main(int argc, char** argv) {
+    using namespace collision_engine;
+    using namespace collision_engine::bench;
+
+    options opt;
+    if (!parse(argc, argv, opt)) {
+        std::cerr<<"usage: bench [--engine=aos,soa|both] [--scenario=pile,gas,polydisperse,clustered,mixed,sparse|all] "
+                 <<"[--counts=1000,4000] [--threads=1,8] [--frames=120] [--warmup=30] [--repeats=3] "
+                 <<"[--seed=42] [--format=csv|json] [--label=...] [--pages=standard|transparent|huge] "
+                 <<"[--precision=f32,fixed16] [--broadphase=grid,hash,sap] [--world=100000]"<<std::endl;
+        return 1;
+    }
+
+    bool first = true;
+    if (opt.format == "csv") { print_csv_header(); } else { std::cout<<"[\n"; }
+    for (const std::string& engine : opt.engines) {
+        for (scenario s : opt.scenarios) {
+            for (uint32_t n : opt.counts) {
+                for (uint32_t threads : opt.threads) {
+                    for (broadphase bp : opt.broadphases) {
+                        // the AoS engine has no reduced precision storage
+                        for (size_t p = 0; p < (engine == "soa" ? opt.precisions.size() : 1); p++) {
+                            const result r = run(opt, engine, s, n, threads, bp, engine == "soa" ? opt.precisions[p] : simd::precision::f32);
+                            if (opt.format == "csv") { print_csv(opt, r); } else { print_json(opt, r, first); }
+                            first = false;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    if (opt.format == "json") { std::cout<<"\n]"<<std::endl; }
+    return 0;
+}
@@ -1,6 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
 
 namespace collision_engine {
 
@@ -26,7 +34,7 @@ public:
         return static_cast<AllocatorImpl*>(this)->deallocate_impl(ptr, size);
     }
     /**
-     * Wipes current buffer clean, provides a newly allocated buffer with size _allocated_buffer_size
+     * Releases every allocation at once, keeping the memory for the next ones
      */
     void reset() {
         return static_cast<AllocatorImpl*>(this)->reset_impl();
@@ -46,34 +54,52 @@ protected:
 
 class linear_allocator : public allocator<linear_allocator> {
 public: 
+    /**
+     * @param buffer_size bytes of the buffer, which starts on a cache line
+     */
     explicit linear_allocator(std::size_t buffer_size) : allocator<linear_allocator>(buffer_size) {
-        _buffer_start_ptr = std::malloc(_allocated_buffer_size);
+        if (posix_memalign(&_buffer_start_ptr, 64, std::max<std::size_t>(_allocated_buffer_size, 1)) != 0) {
+            throw std::bad_alloc();
+        }
         _buffer_offset_ptr = _buffer_start_ptr;
     }
 
     ~linear_allocator() { std::free(_buffer_start_ptr); }
 
+    /**
+     * @return nullptr when the rest of the buffer does not fit the allocation
+     */
     void* allocate_impl(std::size_t allocation_size, std::size_t alignment) {
         std::size_t remaining_size = _allocated_buffer_size - _used_amount;
-        // pointer to first aligned position in memory (to `alignment`) 
-        void* aligned_ptr = std::align(alignment, allocation_size, _buffer_offset_ptr, remaining_size); 
+        void* offset_ptr = _buffer_offset_ptr;
+        // pointer to first aligned position in memory (to `alignment`), offset_ptr is moved to it
+        void* aligned_ptr = std::align(alignment, allocation_size, offset_ptr, remaining_size);
 
         if (aligned_ptr != nullptr) {
-            // calculate cost of alignment to update _used_amount
-            std::size_t alignment_size = static_cast<char*>(aligned_ptr) - static_cast<char*>(_buffer_offset_ptr);
-            _used_amount += alignment_size + allocation_size;
             _buffer_offset_ptr = static_cast<void*>(static_cast<char*>(aligned_ptr) + allocation_size);
+            _used_amount = static_cast<char*>(_buffer_offset_ptr) - static_cast<char*>(_buffer_start_ptr);
         }
 
         return aligned_ptr;
     }
-    void deallocate_impl(void* ptr, std::size_t) = delete;
+
+    /**
+     * Gives back the most recent allocation; any other is only reclaimed by reset()
+     */
+    void deallocate_impl(void* ptr, std::size_t size) {
+        if (static_cast<char*>(ptr) + size == _buffer_offset_ptr) {
+            _buffer_offset_ptr = ptr;
+            _used_amount = static_cast<char*>(ptr) - static_cast<char*>(_buffer_start_ptr);
+        }
+    }
+
     void reset_impl() {
-        std::free(_buffer_start_ptr);
-        _buffer_start_ptr = std::malloc(_allocated_buffer_size);
+        _buffer_offset_ptr = _buffer_start_ptr;
         _used_amount = 0;
     }
 
+    std::size_t used() const noexcept { return _used_amount; }
+
     // no copy, no move
     linear_allocator(const allocator& other) = delete;
     linear_allocator& operator=(const allocator& other) = delete; 
@@ -85,6 +111,209 @@ private:
     void* _buffer_start_ptr{nullptr};
 };
 
+/**
+ * Memory the chunks of a pool_allocator are mapped from
+ */
+enum class page_backing : uint8_t {
+    standard,       // regular pages
+    transparent,    // chunks aligned to huge pages and advised to the kernel's transparent huge pages
+    huge,           // the reserved huge page pool (MAP_HUGETLB), transparent when it is empty
+};
+
+/**
+ * @brief Fixed-size blocks carved from chunks that are mapped as needed and never moved,
+ * so pointers into the pool stay valid while it grows. Freed blocks are threaded onto an
+ * intrusive free list (the link lives in the block itself) and handed out again first.
+ *
+ * Allocations larger than a block take a run of adjacent blocks of one chunk, e.g. to
+ * restore a snapshot into contiguous storage. Chunks are whole pages, huge pages when
+ * asked for, so iterating a million particles walks a few hundred TLB entries instead of
+ * hundreds of thousands; a chunk that cannot get huge pages silently uses regular ones.
+ */
+class pool_allocator : public allocator<pool_allocator> {
+public:
+    static constexpr std::size_t huge_page_size = std::size_t(2) << 20;
+
+private:
+    struct free_block { free_block* next; };
+
+    struct chunk {
+        std::byte*      data;
+        std::size_t     bytes;
+        page_backing    backing;    // what the chunk actually got
+    };
+
+    const std::size_t   _block_stride;      // bytes per block, a multiple of the block alignment
+    const std::size_t   _block_alignment;
+    const page_backing  _backing;
+    std::size_t         _chunk_bytes;
+    std::size_t         _blocks_per_chunk;
+    std::vector<chunk>  _chunks;
+    std::size_t         _current    = 0;    // chunk blocks are bumped from, chunks past it are unused
+    std::size_t         _cursor     = 0;    // first unused block of the current chunk
+    free_block*         _free       = nullptr;
+    std::size_t         _free_count = 0;
+
+    static std::size_t round_up(std::size_t n, std::size_t multiple) noexcept { return (n + multiple - 1) / multiple * multiple; }
+
+    /**
+     * @return `bytes` mapped at a multiple of `alignment`, the excess of a larger mapping
+     *         unmapped again; nullptr when the mapping fails
+     */
+    static std::byte* map_aligned(std::size_t bytes, std::size_t alignment) noexcept {
+        void* p = ::mmap(nullptr, bytes + alignment, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            return nullptr;
+        }
+        std::byte* base = static_cast<std::byte*>(p);
+        std::byte* aligned = reinterpret_cast<std::byte*>(round_up(reinterpret_cast<uintptr_t>(base), alignment));
+        if (aligned > base) {
+            ::munmap(base, aligned - base);
+        }
+        if (base + alignment > aligned) {
+            ::munmap(aligned + bytes, base + alignment - aligned);
+        }
+        return aligned;
+    }
+
+    chunk map_chunk() const {
+        chunk c{nullptr, _chunk_bytes, page_backing::standard};
+#if defined(__linux__)
+        if (_backing == page_backing::huge) {
+            void* p = ::mmap(nullptr, _chunk_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED) {
+                c.data = static_cast<std::byte*>(p);
+                c.backing = page_backing::huge;
+                return c;
+            }
+        }
+        if (_backing != page_backing::standard) {
+            c.data = map_aligned(_chunk_bytes, huge_page_size);
+            if (c.data && ::madvise(c.data, _chunk_bytes, MADV_HUGEPAGE) == 0) {
+                c.backing = page_backing::transparent;
+            }
+        }
+#endif
+        if (!c.data) {
+            void* p = ::mmap(nullptr, _chunk_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            c.data = static_cast<std::byte*>(p);
+        }
+        return c;
+    }
+
+    void push_free(std::byte* block) noexcept {
+        _free = new (block) free_block{_free};
+        _free_count++;
+    }
+
+public:
+    /**
+     * @param block_size bytes of each block, e.g. sizeof(particle<VT>)
+     * @param block_alignment of every block, a power of 2 up to the page size
+     * @param blocks_per_chunk blocks each chunk holds at least; chunks are rounded up to
+     *                         whole pages (huge ones unless backing is standard)
+     */
+    pool_allocator(std::size_t block_size, std::size_t block_alignment, std::size_t blocks_per_chunk, page_backing backing = page_backing::standard)
+        :   allocator<pool_allocator>(0),
+            _block_stride(round_up(std::max(block_size, sizeof(free_block)), std::max(block_alignment, alignof(free_block)))),
+            _block_alignment(std::max(block_alignment, alignof(free_block))),
+            _backing(backing) {
+        const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        if ((_block_alignment & (_block_alignment - 1)) != 0 || _block_alignment > page || blocks_per_chunk == 0) {
+            throw std::invalid_argument("pool_allocator: alignment must be a power of 2 up to the page size");
+        }
+        _chunk_bytes = round_up(_block_stride * blocks_per_chunk, backing == page_backing::standard ? page : huge_page_size);
+        _blocks_per_chunk = _chunk_bytes / _block_stride;
+    }
+
+    ~pool_allocator() {
+        for (const chunk& c : _chunks) {
+            ::munmap(c.data, c.bytes);
+        }
+    }
+
+    /**
+     * @return a block, or a run of adjacent blocks for sizes above one; nullptr when the
+     *         alignment exceeds the blocks' or the run exceeds a chunk
+     */
+    void* allocate_impl(std::size_t size, std::size_t alignment) {
+        if (alignment > _block_alignment || size > _chunk_bytes) {
+            return nullptr;
+        }
+        const std::size_t blocks = std::max<std::size_t>(1, (size + _block_stride - 1) / _block_stride);
+        _used_amount += blocks * _block_stride;
+        if (blocks == 1 && _free) {
+            free_block* block = _free;
+            _free = block->next;
+            _free_count--;
+            return block;
+        }
+        if (_chunks.empty() || _cursor + blocks > _blocks_per_chunk) {
+            if (!_chunks.empty()) { // the rest of the chunk goes to single blocks
+                for (; _cursor < _blocks_per_chunk; _cursor++) {
+                    push_free(_chunks[_current].data + _cursor * _block_stride);
+                }
+                _current++;
+            }
+            if (_current == _chunks.size()) {
+                _chunks.push_back(map_chunk());
+                _allocated_buffer_size += _chunk_bytes;
+            }
+            _cursor = 0;
+        }
+        std::byte* run = _chunks[_current].data + _cursor * _block_stride;
+        _cursor += blocks;
+        return run;
+    }
+
+    /**
+     * Threads the blocks of an allocation of `size` bytes onto the free list
+     */
+    void deallocate_impl(void* ptr, std::size_t size) {
+        const std::size_t blocks = std::max<std::size_t>(1, (size + _block_stride - 1) / _block_stride);
+        for (std::size_t b = blocks; b-- > 0;) { // the first block is handed out first again
+            push_free(static_cast<std::byte*>(ptr) + b * _block_stride);
+        }
+        _used_amount -= blocks * _block_stride;
+    }
+
+    /**
+     * Frees every block at once; the chunks stay mapped and are refilled in order
+     */
+    void reset_impl() noexcept {
+        _current = 0;
+        _cursor = 0;
+        _free = nullptr;
+        _free_count = 0;
+        _used_amount = 0;
+    }
+
+    std::size_t block_stride() const noexcept { return _block_stride; }
+    std::size_t blocks_per_chunk() const noexcept { return _blocks_per_chunk; }
+    std::size_t chunk_count() const noexcept { return _chunks.size(); }
+    std::size_t free_blocks() const noexcept { return _free_count; }
+    std::size_t used() const noexcept { return _used_amount; }
+    std::size_t capacity() const noexcept { return _allocated_buffer_size; }
+
+    /**
+     * @return chunks mapped with the given backing, which may fall short of the one asked for
+     */
+    std::size_t chunks_backed_by(page_backing backing) const noexcept {
+        std::size_t n = 0;
+        for (const chunk& c : _chunks) {
+            n += c.backing == backing;
+        }
+        return n;
+    }
+
+    // no copy, no move
+    pool_allocator(const pool_allocator& other) = delete;
+    pool_allocator& operator=(const pool_allocator& other) = delete;
+};
+
 template <typename T, std::size_t Alignment>
 struct aligned_allocator {
     using value_type = T;
@@ -99,9 +328,15 @@ struct aligned_allocator {
     template <typename U>
     aligned_allocator(const aligned_allocator<U, Alignment>&) noexcept {}
 
+    /**
+     * Allocates storage for n objects, rounded up to a whole multiple of `Alignment` bytes
+     * plus one trailing block, so that a full-width SIMD load starting at any element
+     * stays inside the allocation.
+     */
     T* allocate(std::size_t n) {
         void* ptr = nullptr;
-        if (posix_memalign(&ptr, Alignment, n * sizeof(T)) != 0) {
+        const std::size_t padded_size = ((n * sizeof(T) + Alignment - 1) & ~(Alignment - 1)) + Alignment;
+        if (posix_memalign(&ptr, Alignment, padded_size) != 0) {
             throw std::bad_alloc();
         }
         return reinterpret_cast<T*>(ptr);
@@ -116,6 +351,12 @@ struct aligned_allocator {
     bool operator!=(const aligned_allocator<U, Alignment>&) const noexcept { return false; }
 };
 
+/**
+ * Cache-line aligned, tail-padded vector used for SIMD-visible particle data
+ */
+template <typename T>
+using simd_vector = std::vector<T, aligned_allocator<T, 64>>;
+
 } // namespace collision engine 
 
 
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+namespace collision_engine {
+
+/**
+ * 8 bit per channel colour, laid out R, G, B, A in memory like the framebuffers that store it
+ */
+struct rgba {
+    uint8_t r = 0, g = 0, b = 0, a = 255;
+
+    /**
+     * @return the four channels as one pixel word, in memory order
+     */
+    uint32_t packed() const noexcept {
+        return static_cast<uint32_t>(r) | static_cast<uint32_t>(g) << 8 | static_cast<uint32_t>(b) << 16 | static_cast<uint32_t>(a) << 24;
+    }
+};
+
+inline rgba hsv_to_rgba(float hue, float saturation, float value) {
+    int h = static_cast<int>(hue / 60) % 6;
+    float f = (hue / 60) - h;
+    float p = value * (1 - saturation);
+    float q = value * (1 - f * saturation);
+    float t = value * (1 - (1 - f) * saturation);
+
+    const auto c = [](float x) { return static_cast<uint8_t>(x * 255); };
+    switch (h) {
+        case 0: return rgba{c(value), c(t), c(p)};
+        case 1: return rgba{c(q), c(value), c(p)};
+        case 2: return rgba{c(p), c(value), c(t)};
+        case 3: return rgba{c(p), c(q), c(value)};
+        case 4: return rgba{c(t), c(p), c(value)};
+        default: return rgba{c(value), c(p), c(q)};
+    }
+}
+
+} // namespace collision_engine
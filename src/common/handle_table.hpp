@@ -0,0 +1,180 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace collision_engine {
+
+/**
+ * @brief Stable handles to elements kept densely packed in index order, while elements
+ * are permuted and removed with swap-and-pop.
+ *
+ * A handle packs a slot (its low slot_bits) and the slot's generation (the bits above).
+ * Slots index the table and stay with their element for its whole life, so consumers key
+ * per-particle state (renderer vertices, recorded trajectories) by slot; a removed
+ * element's slot is reused by a later add() with its generation bumped, which turns every
+ * outstanding handle to the removed element stale. Generations wrap after 2^(32 - slot_bits)
+ * reuses of one slot.
+ */
+class handle_table {
+public:
+    static constexpr uint32_t slot_bits         = 24;
+    static constexpr uint32_t slot_mask         = (1u << slot_bits) - 1;
+    static constexpr uint32_t generation_mask   = ~0u >> slot_bits;
+    static constexpr uint32_t invalid           = ~0u;  // index of a free slot or a stale handle
+
+private:
+    std::vector<uint32_t>   _slot_of;       // slot of the element at each index
+    std::vector<uint32_t>   _index_of;      // index of each slot's element, invalid when free
+    std::vector<uint32_t>   _generation;    // of each slot, bumped when its element is removed
+    std::vector<uint32_t>   _free;          // free slots, the most recently freed reused first
+
+    // remove() scratch
+    std::vector<uint8_t>                        _doomed;    // per index, all zero between calls
+    std::vector<uint32_t>                       _holes;
+    std::vector<std::pair<uint32_t, uint32_t>>  _moves;
+
+    uint32_t make(uint32_t slot) const noexcept { return slot | (_generation[slot] << slot_bits); }
+
+public:
+    static uint32_t slot(uint32_t handle) noexcept { return handle & slot_mask; }
+    static uint32_t generation(uint32_t handle) noexcept { return handle >> slot_bits; }
+
+    /**
+     * Appends an element at index size()
+     *
+     * @return its handle, reusing the most recently freed slot if any
+     */
+    uint32_t add() {
+        uint32_t s;
+        if (_free.empty()) {
+            s = _index_of.size();
+            _index_of.push_back(0);
+            _generation.push_back(0);
+        } else {
+            s = _free.back();
+            _free.pop_back();
+        }
+        _index_of[s] = _slot_of.size();
+        _slot_of.push_back(s);
+        return make(s);
+    }
+
+    uint32_t handle_of(uint32_t index) const noexcept { return make(_slot_of[index]); }
+    uint32_t slot_of(uint32_t index) const noexcept { return _slot_of[index]; }
+
+    /**
+     * @return index of the handle's element, invalid when it was removed
+     */
+    uint32_t index_of(uint32_t handle) const noexcept {
+        const uint32_t s = slot(handle);
+        return s < _index_of.size() && _generation[s] == generation(handle) ? _index_of[s] : invalid;
+    }
+
+    /**
+     * @return index of the slot's element, invalid when the slot is free
+     */
+    uint32_t index_of_slot(uint32_t slot) const noexcept { return _index_of[slot]; }
+
+    bool contains(uint32_t handle) const noexcept { return index_of(handle) != invalid; }
+
+    size_t size() const noexcept { return _slot_of.size(); }
+
+    /**
+     * @return slots in use or free, every slot_of() is below it
+     */
+    size_t slot_count() const noexcept { return _index_of.size(); }
+
+    const std::vector<uint32_t>& slots() const noexcept { return _slot_of; }
+    const std::vector<uint32_t>& free_slots() const noexcept { return _free; }
+
+    /**
+     * Starts over with n elements at generation 0
+     *
+     * @param slots slot of each index (distinct values), identity when null; the slots
+     *              below the largest one that no index uses are free
+     */
+    void reset(size_t n, const uint32_t* slots = nullptr) {
+        _slot_of.resize(n);
+        size_t count = n;
+        for (size_t i = 0; i < n; i++) {
+            _slot_of[i] = slots ? slots[i] : i;
+            count = std::max<size_t>(count, _slot_of[i] + 1);
+        }
+        _index_of.assign(count, invalid);
+        _generation.assign(count, 0);
+        for (size_t i = 0; i < n; i++) {
+            _index_of[_slot_of[i]] = i;
+        }
+        _free.clear();
+        for (uint32_t s = count; s-- > 0;) {
+            if (_index_of[s] == invalid) {
+                _free.push_back(s);
+            }
+        }
+    }
+
+    /**
+     * Follows a permutation of the elements: index i now holds the element previously at
+     * order[i]
+     */
+    void permute(const std::vector<uint32_t>& order) {
+        _holes.resize(_slot_of.size());
+        for (size_t i = 0; i < _slot_of.size(); i++) {
+            _holes[i] = _slot_of[order[i]];
+            _index_of[_holes[i]] = i;
+        }
+        _slot_of.swap(_holes);
+    }
+
+    /**
+     * Removes the elements of the given handles in one pass, skipping stale and repeated
+     * ones: every hole left below the new size() is filled by a surviving element from
+     * past it. The caller applies the returned (from, to) index moves to its own arrays,
+     * in any order, and truncates them to size().
+     */
+    const std::vector<std::pair<uint32_t, uint32_t>>& remove(const uint32_t* handles, size_t count) {
+        const uint32_t n = _slot_of.size();
+        _doomed.resize(n, 0);
+        _holes.clear();
+        _moves.clear();
+        for (size_t k = 0; k < count; k++) {
+            const uint32_t idx = index_of(handles[k]);
+            if (idx == invalid || _doomed[idx]) {
+                continue;
+            }
+            const uint32_t s = slot(handles[k]);
+            _doomed[idx] = 1;
+            _holes.push_back(idx);
+            _index_of[s] = invalid;
+            _generation[s] = (_generation[s] + 1) & generation_mask;
+            _free.push_back(s);
+        }
+
+        // the survivors in [m, n) are exactly as many as the holes in [0, m)
+        const uint32_t m = n - _holes.size();
+        uint32_t tail = m;
+        for (uint32_t hole : _holes) {
+            if (hole >= m) {
+                continue;
+            }
+            while (_doomed[tail]) {
+                tail++;
+            }
+            _moves.emplace_back(tail, hole);
+            _slot_of[hole] = _slot_of[tail];
+            _index_of[_slot_of[hole]] = hole;
+            tail++;
+        }
+        for (uint32_t hole : _holes) {
+            _doomed[hole] = 0;
+        }
+        _slot_of.resize(m);
+        return _moves;
+    }
+};
+
+} // namespace collision_engine
@@ -0,0 +1,406 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Instrumentation is compiled in only when CE_PROFILE is defined (cmake -DCOLLISION_ENGINE_PROFILE=ON),
+ * otherwise every macro below expands to nothing and the hot paths are left untouched.
+ *
+ *   CE_PROFILE_SCOPE("collide");          times the enclosing scope on the calling thread
+ *   CE_PROFILE_COUNT(pair_tests, n);      adds n to a profiler::counter of the calling thread
+ *   CE_PROFILE_MAX(max_cell_occupancy, n) raises a profiler::counter of the calling thread to n
+ *   CE_PROFILE_THREAD("worker");          names the calling thread in the trace
+ *   CE_PROFILE_FRAME();                   closes the current frame
+ *
+ * Scope names must be string literals (or otherwise outlive the profiler).
+ */
+#define CE_PROFILE_CONCAT_IMPL(a, b) a##b
+#define CE_PROFILE_CONCAT(a, b) CE_PROFILE_CONCAT_IMPL(a, b)
+
+#if defined(CE_PROFILE)
+#define CE_PROFILE_SCOPE(name) ::collision_engine::profile_scope CE_PROFILE_CONCAT(_ce_profile_scope_, __LINE__)(name)
+#define CE_PROFILE_COUNT(c, n) ::collision_engine::profiler::instance().add(::collision_engine::profiler::counter::c, n)
+#define CE_PROFILE_MAX(c, n) ::collision_engine::profiler::instance().raise(::collision_engine::profiler::counter::c, n)
+#define CE_PROFILE_THREAD(name) ::collision_engine::profiler::instance().set_thread_name(name)
+#define CE_PROFILE_FRAME() ::collision_engine::profiler::instance().end_frame()
+#else
+#define CE_PROFILE_SCOPE(name) ((void)0)
+#define CE_PROFILE_COUNT(c, n) ((void)0)
+#define CE_PROFILE_MAX(c, n) ((void)0)
+#define CE_PROFILE_THREAD(name) ((void)0)
+#define CE_PROFILE_FRAME() ((void)0)
+#endif
+
+namespace collision_engine {
+
+#if defined(CE_PROFILE)
+inline constexpr bool profiling = true;
+#else
+inline constexpr bool profiling = false;  // lets hot loops drop their counting with `if constexpr`
+#endif
+
+/**
+ * @brief Log-linear (HDR-style) histogram of durations in nanoseconds. Values below 32ns get
+ * a bucket each, above that every power of two is split into 32 buckets, so a percentile is
+ * reported within ~3% of the recorded value at any magnitude with a fixed 15KB footprint.
+ */
+class frame_histogram {
+private:
+    static constexpr uint32_t   _sub_bits       = 5;
+    static constexpr uint32_t   _sub_count      = 1u << _sub_bits;
+    static constexpr uint32_t   _bucket_count   = (64 - _sub_bits) * _sub_count + _sub_count;
+
+    std::array<uint64_t, _bucket_count> _buckets = {};
+    uint64_t    _count  = 0;
+    uint64_t    _max    = 0;
+    double      _sum    = 0;
+
+    static uint32_t bucket_of(uint64_t ns) noexcept {
+        if (ns < _sub_count) {
+            return static_cast<uint32_t>(ns);
+        }
+        const uint32_t exponent = 63 - __builtin_clzll(ns) - _sub_bits;
+        return (exponent + 1) * _sub_count + static_cast<uint32_t>((ns >> exponent) - _sub_count);
+    }
+
+    static uint64_t bucket_max(uint32_t bucket) noexcept {
+        if (bucket < _sub_count) {
+            return bucket;
+        }
+        const uint32_t exponent = bucket / _sub_count - 1;
+        const uint64_t mantissa = bucket % _sub_count + _sub_count;
+        return ((mantissa + 1) << exponent) - 1;
+    }
+
+public:
+    void record(uint64_t ns) noexcept {
+        _buckets[bucket_of(ns)]++;
+        _count++;
+        _max = std::max(_max, ns);
+        _sum += ns;
+    }
+
+    /**
+     * @param p percentile in [0, 100]
+     * @return upper bound of the bucket holding the p-th percentile (0 when empty)
+     */
+    uint64_t percentile(double p) const noexcept {
+        if (_count == 0) {
+            return 0;
+        }
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p / 100.0 * _count + 0.5));
+        uint64_t seen = 0;
+        for (uint32_t b = 0; b < _bucket_count; b++) {
+            seen += _buckets[b];
+            if (seen >= rank) {
+                return std::min(bucket_max(b), _max);
+            }
+        }
+        return _max;
+    }
+
+    uint64_t count() const noexcept { return _count; }
+    uint64_t max() const noexcept { return _max; }
+    double mean() const noexcept { return _count ? _sum / _count : 0; }
+
+    void reset() noexcept {
+        _buckets.fill(0);
+        _count = 0;
+        _max = 0;
+        _sum = 0;
+    }
+};
+
+/**
+ * @brief Process-wide recorder behind the CE_PROFILE_* macros. Every thread writes scoped
+ * timings and counters into its own buffer; end_frame() folds them into per-phase totals of
+ * the frame, the frame-time histogram and, while tracing, a Chrome trace_event timeline.
+ */
+class profiler {
+public:
+    enum class counter : uint32_t {
+        pair_tests,         // particle pairs whose distance was computed
+        contacts,           // pairs found overlapping
+        max_cell_occupancy, // most particles in one cell
+        count
+    };
+    static constexpr uint32_t counter_count = static_cast<uint32_t>(counter::count);
+
+    struct phase {
+        const char* name;
+        double      ms;     // summed over every thread, so concurrent phases add up
+        uint32_t    calls;
+    };
+
+private:
+    struct event {
+        const char* name;
+        uint64_t    start_ns;
+        uint64_t    duration_ns;
+    };
+
+    struct thread_buffer {
+        std::mutex                                      mut;
+        uint32_t                                        tid;
+        std::string                                     name;
+        std::vector<event>                              events;
+        std::array<std::atomic_uint64_t, counter_count> counters = {};
+    };
+
+    struct trace_event {
+        event       e;
+        uint32_t    tid;
+    };
+
+    struct counter_sample {
+        uint64_t                                ts_ns;
+        std::array<uint64_t, counter_count>     values;
+    };
+
+    static constexpr size_t _max_thread_events = 1 << 16;  // per thread and frame, the rest is dropped
+
+    const std::chrono::steady_clock::time_point _epoch = std::chrono::steady_clock::now();
+
+    mutable std::mutex                          _mut;       // guards the registry and everything below
+    std::vector<std::unique_ptr<thread_buffer>> _buffers;
+    frame_histogram                             _frames;
+    uint64_t                                    _last_frame_end = 0;
+    std::vector<phase>                          _phases;
+    std::array<uint64_t, counter_count>         _frame_counters = {};
+    bool                                        _tracing = false;
+    size_t                                      _trace_limit = 1 << 22;
+    std::vector<trace_event>                    _trace;
+    std::vector<counter_sample>                 _counter_trace;
+
+    thread_buffer& local() {
+        thread_local thread_buffer* buffer = nullptr;
+        if (!buffer) {
+            std::lock_guard<std::mutex> lock(_mut);
+            _buffers.push_back(std::make_unique<thread_buffer>());
+            buffer = _buffers.back().get();
+            buffer->tid = static_cast<uint32_t>(_buffers.size() - 1);
+            buffer->name = "thread " + std::to_string(buffer->tid);
+        }
+        return *buffer;
+    }
+
+    static const char* counter_name(uint32_t c) noexcept {
+        switch (static_cast<counter>(c)) {
+            case counter::pair_tests:           return "pair_tests";
+            case counter::contacts:             return "contacts";
+            case counter::max_cell_occupancy:   return "max_cell_occupancy";
+            default:                            return "";
+        }
+    }
+
+    profiler() = default;
+
+public:
+    profiler(const profiler&) = delete;
+    profiler& operator=(const profiler&) = delete;
+
+    static profiler& instance() {
+        static profiler p;
+        return p;
+    }
+
+    uint64_t now_ns() const noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _epoch).count();
+    }
+
+    void record(const char* name, uint64_t start_ns, uint64_t duration_ns) {
+        thread_buffer& b = local();
+        std::lock_guard<std::mutex> lock(b.mut); // only contended while end_frame() drains it
+        if (b.events.size() < _max_thread_events) {
+            b.events.push_back({name, start_ns, duration_ns});
+        }
+    }
+
+    void add(counter c, uint64_t n) noexcept {
+        local().counters[static_cast<uint32_t>(c)].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    void raise(counter c, uint64_t n) noexcept {
+        std::atomic_uint64_t& value = local().counters[static_cast<uint32_t>(c)];
+        if (n > value.load(std::memory_order_relaxed)) {
+            value.store(n, std::memory_order_relaxed); // only the owning thread writes it
+        }
+    }
+
+    void set_thread_name(const std::string& name) {
+        thread_buffer& b = local();
+        std::lock_guard<std::mutex> lock(b.mut);
+        b.name = name;
+    }
+
+    /**
+     * Closes the current frame: records the time since the previous call in the frame
+     * histogram, totals the phases and counters of every thread and, while tracing, moves
+     * the frame's events into the trace. Must not overlap the scopes of the frame it closes.
+     */
+    void end_frame() {
+        const uint64_t now = now_ns();
+        std::lock_guard<std::mutex> lock(_mut);
+        if (_last_frame_end != 0) {
+            _frames.record(now - _last_frame_end);
+        }
+        _last_frame_end = now;
+
+        _phases.clear();
+        _frame_counters.fill(0);
+        for (auto& b : _buffers) {
+            std::lock_guard<std::mutex> buffer_lock(b->mut);
+            for (const event& e : b->events) {
+                auto it = std::find_if(_phases.begin(), _phases.end(), [&](const phase& p) { return p.name == e.name; });
+                if (it == _phases.end()) {
+                    _phases.push_back({e.name, 0, 0});
+                    it = _phases.end() - 1;
+                }
+                it->ms += e.duration_ns * 1e-6;
+                it->calls++;
+                if (_tracing && _trace.size() < _trace_limit) {
+                    _trace.push_back({e, b->tid});
+                }
+            }
+            b->events.clear();
+            for (uint32_t c = 0; c < counter_count; c++) {
+                const uint64_t v = b->counters[c].exchange(0, std::memory_order_relaxed);
+                _frame_counters[c] = static_cast<counter>(c) == counter::max_cell_occupancy
+                    ? std::max(_frame_counters[c], v) : _frame_counters[c] + v;
+            }
+        }
+        if (_tracing && _counter_trace.size() < _trace_limit) {
+            _counter_trace.push_back({now, _frame_counters});
+        }
+    }
+
+    /**
+     * @param enabled keep every event (up to `limit`) for write_chrome_trace
+     */
+    void set_tracing(bool enabled, size_t limit = 1 << 22) {
+        std::lock_guard<std::mutex> lock(_mut);
+        _tracing = enabled;
+        _trace_limit = limit;
+    }
+
+    /**
+     * Writes the recorded timeline as Chrome trace_event JSON (chrome://tracing, Perfetto):
+     * one complete ("X") event per scope, a counter ("C") track per frame and the thread names
+     */
+    void write_chrome_trace(std::ostream& os) const {
+        std::lock_guard<std::mutex> lock(_mut);
+        os<<std::fixed<<std::setprecision(3);
+        os<<"{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+        bool first = true;
+        const auto sep = [&]() { os<<(first ? "" : ",\n"); first = false; };
+        for (const auto& b : _buffers) {
+            sep();
+            os<<"{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": "<<b->tid
+              <<", \"args\": {\"name\": \""<<b->name<<"\"}}";
+        }
+        for (const trace_event& t : _trace) {
+            sep();
+            os<<"{\"name\": \""<<t.e.name<<"\", \"ph\": \"X\", \"pid\": 0, \"tid\": "<<t.tid
+              <<", \"ts\": "<<t.e.start_ns * 1e-3<<", \"dur\": "<<t.e.duration_ns * 1e-3<<"}";
+        }
+        for (const counter_sample& s : _counter_trace) {
+            sep();
+            os<<"{\"name\": \"counters\", \"ph\": \"C\", \"pid\": 0, \"tid\": 0, \"ts\": "<<s.ts_ns * 1e-3<<", \"args\": {";
+            for (uint32_t c = 0; c < counter_count; c++) {
+                os<<(c ? ", " : "")<<"\""<<counter_name(c)<<"\": "<<s.values[c];
+            }
+            os<<"}}";
+        }
+        os<<"\n]}\n";
+    }
+
+    bool write_chrome_trace(const std::string& path) const {
+        std::ofstream file(path);
+        write_chrome_trace(file);
+        return static_cast<bool>(file);
+    }
+
+    /**
+     * @return phases of the last closed frame, in order of first appearance
+     */
+    std::vector<phase> phases() const {
+        std::lock_guard<std::mutex> lock(_mut);
+        return _phases;
+    }
+
+    uint64_t value(counter c) const {
+        std::lock_guard<std::mutex> lock(_mut);
+        return _frame_counters[static_cast<uint32_t>(c)];
+    }
+
+    frame_histogram frames() const {
+        std::lock_guard<std::mutex> lock(_mut);
+        return _frames;
+    }
+
+    /**
+     * @return multi-line overlay text: frame-time percentiles, last frame's counters and phases
+     */
+    std::string summary() const {
+        std::lock_guard<std::mutex> lock(_mut);
+        std::ostringstream os;
+        os<<std::fixed<<std::setprecision(2);
+        os<<"frame p50 "<<_frames.percentile(50) * 1e-6<<"ms  p99 "<<_frames.percentile(99) * 1e-6
+          <<"ms  p99.9 "<<_frames.percentile(99.9) * 1e-6<<"ms\n";
+        for (uint32_t c = 0; c < counter_count; c++) {
+            os<<counter_name(c)<<": "<<_frame_counters[c]<<"\n";
+        }
+        for (const phase& p : _phases) {
+            os<<p.name<<": "<<p.ms<<"ms ("<<p.calls<<")\n";
+        }
+        return os.str();
+    }
+
+    /**
+     * Drops the histogram, the trace and the current frame's events and counters
+     */
+    void reset() {
+        std::lock_guard<std::mutex> lock(_mut);
+        for (auto& b : _buffers) {
+            std::lock_guard<std::mutex> buffer_lock(b->mut);
+            b->events.clear();
+            for (auto& c : b->counters) { c.store(0, std::memory_order_relaxed); }
+        }
+        _frames.reset();
+        _last_frame_end = 0;
+        _phases.clear();
+        _frame_counters.fill(0);
+        _trace.clear();
+        _counter_trace.clear();
+    }
+};
+
+/**
+ * @brief RAII timer behind CE_PROFILE_SCOPE
+ */
+class profile_scope {
+private:
+    const char*     _name;
+    const uint64_t  _start;
+
+public:
+    explicit profile_scope(const char* name) noexcept : _name(name), _start(profiler::instance().now_ns()) {}
+    ~profile_scope() {
+        profiler& p = profiler::instance();
+        p.record(_name, _start, p.now_ns() - _start);
+    }
+};
+
+} // namespace collision_engine
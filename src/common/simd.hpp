@@ -0,0 +1,634 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <initializer_list>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CE_SIMD_NEON 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CE_SIMD_X86 1
+#endif
+
+#if !defined(CE_SIMD_NEON)
+// arm_neon.h provides these in the global namespace; mirror them everywhere else
+using float32_t = float;
+using float64_t = double;
+#endif
+
+#define CE_SIMD_STR(x) #x
+
+/**
+ * Compile the enclosed functions for `features` regardless of the global -m flags,
+ * so one binary carries every x86 backend and picks one at runtime.
+ */
+#if defined(__clang__)
+#define CE_SIMD_TARGET_PUSH(features) \
+    _Pragma(CE_SIMD_STR(clang attribute push(__attribute__((target(features))), apply_to = function)))
+#define CE_SIMD_TARGET_POP() _Pragma("clang attribute pop")
+#else
+#define CE_SIMD_TARGET_PUSH(features) _Pragma("GCC push_options") _Pragma(CE_SIMD_STR(GCC target(features)))
+#define CE_SIMD_TARGET_POP() _Pragma("GCC pop_options")
+#endif
+
+/**
+ * Thin SIMD abstraction used by the hot kernels.
+ *
+ * Every instruction set is described by a struct in `simd::isa` exposing a register type
+ * `f32`, an integer register `u32`, a lane mask `mask`, its lane count `width` and a small set
+ * of static operations. `load_n`/`store_n` access only the first n lanes and never touch the
+ * memory behind them, so they are safe next to ranges owned by other threads. Reduced-precision
+ * data widens to f32 in registers: `low_i16`/`high_i16` unpack two 16-bit integers per u32
+ * lane, `pack_i16` packs them back rounded to nearest and saturated, `add_i16`/`sub_i16` wrap
+ * around each half, and `gather_n` looks up a table through 8-bit indices (reading a full
+ * register of indices, of which lanes past n are ignored). Kernels are written once against these operations and run at
+ * whatever width the selected backend provides (1 for scalar, 4 for NEON/SSE, 8 for AVX2,
+ * 16 for AVX-512).
+ *
+ * On x86 every backend is compiled into the binary and `dispatch` picks one at runtime.
+ */
+namespace collision_engine::simd::isa {
+
+struct scalar {
+    static constexpr uint32_t width = 1;
+
+    using f32   = float32_t;
+    using u32   = uint32_t;
+    using mask  = bool;
+
+    static f32  load(const float32_t* p) noexcept           { return *p; }
+    static u32  load(const uint32_t* p) noexcept            { return *p; }
+    static f32  load_n(const float32_t* p, size_t n) noexcept   { return n > 0 ? *p : 0.f; }
+    static u32  load_n(const uint32_t* p, size_t n) noexcept    { return n > 0 ? *p : 0u; }
+    static void store(float32_t* p, f32 v) noexcept         { *p = v; }
+    static void store_n(float32_t* p, f32 v, size_t n) noexcept { if (n > 0) *p = v; }
+    static void store(uint32_t* p, u32 v) noexcept          { *p = v; }
+    static void store_n(uint32_t* p, u32 v, size_t n) noexcept  { if (n > 0) *p = v; }
+    static f32  set1(float32_t v) noexcept                  { return v; }
+    static u32  set1(uint32_t v) noexcept                   { return v; }
+
+    static f32  low_i16(u32 v) noexcept                     { return static_cast<int16_t>(v & 0xFFFF); }
+    static f32  high_i16(u32 v) noexcept                    { return static_cast<int16_t>(v >> 16); }
+    static u32  pack_i16(f32 low, f32 high) noexcept {
+        const auto narrow = [](f32 v) { return static_cast<uint16_t>(std::lrint(std::fmin(std::fmax(v, -32768.f), 32767.f))); };
+        return narrow(low) | static_cast<uint32_t>(narrow(high)) << 16;
+    }
+    static u32  add_i16(u32 a, u32 b) noexcept              { return ((a + b) & 0xFFFF) | ((a & 0xFFFF0000) + (b & 0xFFFF0000)); }
+    static u32  sub_i16(u32 a, u32 b) noexcept              { return ((a - b) & 0xFFFF) | ((a & 0xFFFF0000) - (b & 0xFFFF0000)); }
+    static f32  gather_n(const float32_t* table, const uint8_t* idx, size_t n) noexcept { return n > 0 ? table[*idx] : 0.f; }
+
+    static f32  add(f32 a, f32 b) noexcept                  { return a + b; }
+    static f32  sub(f32 a, f32 b) noexcept                  { return a - b; }
+    static f32  mul(f32 a, f32 b) noexcept                  { return a * b; }
+    static f32  fma(f32 a, f32 b, f32 c) noexcept           { return a * b + c; }
+    static f32  fnma(f32 a, f32 b, f32 c) noexcept          { return c - a * b; }
+    static f32  rsqrt(f32 a) noexcept                       { return 1.f / std::sqrt(a); }
+    static f32  recip(f32 a) noexcept                       { return 1.f / a; }
+
+    static mask lt(f32 a, f32 b) noexcept                   { return a < b; }
+    static mask gt(f32 a, f32 b) noexcept                   { return a > b; }
+    static mask eq(u32 a, u32 b) noexcept                   { return a == b; }
+    static mask mask_and(mask a, mask b) noexcept           { return a && b; }
+    static mask mask_not(mask a) noexcept                   { return !a; }
+    static mask first_n(size_t n) noexcept                  { return n > 0; }
+    static f32  select(mask m, f32 a, f32 b) noexcept       { return m ? a : b; }
+
+    static float32_t hadd(f32 a) noexcept                   { return a; }
+    static uint32_t  count(mask m) noexcept                 { return m; }
+};
+
+namespace detail {
+template <typename F>
+__attribute__((flatten)) void run_scalar(F& f) { f.template operator()<scalar>(); }
+} // namespace detail
+
+#if defined(CE_SIMD_NEON)
+struct neon {
+    static constexpr uint32_t width = 4;
+
+    using f32   = float32x4_t;
+    using u32   = uint32x4_t;
+    using mask  = uint32x4_t;
+
+    static f32  load(const float32_t* p) noexcept           { return vld1q_f32(p); }
+    static u32  load(const uint32_t* p) noexcept            { return vld1q_u32(p); }
+    static f32  load_n(const float32_t* p, size_t n) noexcept {
+        if (n >= width) return vld1q_f32(p);
+        float32_t tmp[4] = {0, 0, 0, 0};
+        std::memcpy(tmp, p, n * sizeof(float32_t));
+        return vld1q_f32(tmp);
+    }
+    static u32  load_n(const uint32_t* p, size_t n) noexcept {
+        if (n >= width) return vld1q_u32(p);
+        uint32_t tmp[4] = {0, 0, 0, 0};
+        std::memcpy(tmp, p, n * sizeof(uint32_t));
+        return vld1q_u32(tmp);
+    }
+    static void store(float32_t* p, f32 v) noexcept         { vst1q_f32(p, v); }
+    static void store_n(float32_t* p, f32 v, size_t n) noexcept {
+        if (n >= width) { vst1q_f32(p, v); return; }
+        float32_t tmp[4];
+        vst1q_f32(tmp, v);
+        std::memcpy(p, tmp, n * sizeof(float32_t));
+    }
+    static void store(uint32_t* p, u32 v) noexcept          { vst1q_u32(p, v); }
+    static void store_n(uint32_t* p, u32 v, size_t n) noexcept {
+        if (n >= width) { vst1q_u32(p, v); return; }
+        uint32_t tmp[4];
+        vst1q_u32(tmp, v);
+        std::memcpy(p, tmp, n * sizeof(uint32_t));
+    }
+    static f32  set1(float32_t v) noexcept                  { return vdupq_n_f32(v); }
+    static u32  set1(uint32_t v) noexcept                   { return vdupq_n_u32(v); }
+
+    static f32  low_i16(u32 v) noexcept                     { return vcvtq_f32_s32(vshrq_n_s32(vshlq_n_s32(vreinterpretq_s32_u32(v), 16), 16)); }
+    static f32  high_i16(u32 v) noexcept                    { return vcvtq_f32_s32(vshrq_n_s32(vreinterpretq_s32_u32(v), 16)); }
+    static u32  pack_i16(f32 low, f32 high) noexcept {
+        const int32x4_t lo = vdupq_n_s32(-32768), hi = vdupq_n_s32(32767);
+        const int32x4_t a = vminq_s32(vmaxq_s32(vcvtnq_s32_f32(low), lo), hi);
+        const int32x4_t b = vminq_s32(vmaxq_s32(vcvtnq_s32_f32(high), lo), hi);
+        return vorrq_u32(vandq_u32(vreinterpretq_u32_s32(a), vdupq_n_u32(0xFFFF)), vshlq_n_u32(vreinterpretq_u32_s32(b), 16));
+    }
+    static u32  add_i16(u32 a, u32 b) noexcept { return vreinterpretq_u32_u16(vaddq_u16(vreinterpretq_u16_u32(a), vreinterpretq_u16_u32(b))); }
+    static u32  sub_i16(u32 a, u32 b) noexcept { return vreinterpretq_u32_u16(vsubq_u16(vreinterpretq_u16_u32(a), vreinterpretq_u16_u32(b))); }
+    static f32  gather_n(const float32_t* table, const uint8_t* idx, size_t n) noexcept {
+        float32_t tmp[4] = {0, 0, 0, 0};
+        for (size_t i = 0; i < n && i < width; i++) tmp[i] = table[idx[i]];
+        return vld1q_f32(tmp);
+    }
+
+    static f32  add(f32 a, f32 b) noexcept                  { return vaddq_f32(a, b); }
+    static f32  sub(f32 a, f32 b) noexcept                  { return vsubq_f32(a, b); }
+    static f32  mul(f32 a, f32 b) noexcept                  { return vmulq_f32(a, b); }
+    static f32  fma(f32 a, f32 b, f32 c) noexcept           { return vfmaq_f32(c, a, b); }
+    static f32  fnma(f32 a, f32 b, f32 c) noexcept          { return vfmsq_f32(c, a, b); }
+
+    static f32 rsqrt(f32 a) noexcept {
+        f32 r = vrsqrteq_f32(a);
+        return vmulq_f32(vrsqrtsq_f32(vmulq_f32(a, r), r), r); // one Newton-Raphson step
+    }
+    static f32 recip(f32 a) noexcept {
+        f32 r = vrecpeq_f32(a);
+        return vmulq_f32(vrecpsq_f32(a, r), r);
+    }
+
+    static mask lt(f32 a, f32 b) noexcept                   { return vcltq_f32(a, b); }
+    static mask gt(f32 a, f32 b) noexcept                   { return vcgtq_f32(a, b); }
+    static mask eq(u32 a, u32 b) noexcept                   { return vceqq_u32(a, b); }
+    static mask mask_and(mask a, mask b) noexcept           { return vandq_u32(a, b); }
+    static mask mask_not(mask a) noexcept                   { return vmvnq_u32(a); }
+    static f32  select(mask m, f32 a, f32 b) noexcept       { return vbslq_f32(m, a, b); }
+
+    static mask first_n(size_t n) noexcept {
+        static const uint32_t iota[4] = {0, 1, 2, 3};
+        return vcltq_u32(vld1q_u32(iota), vdupq_n_u32(n < width ? n : width));
+    }
+
+    static float32_t hadd(f32 a) noexcept                   { return vaddvq_f32(a); }
+    static uint32_t  count(mask m) noexcept                 { return vaddvq_u32(vshrq_n_u32(m, 31)); }
+};
+
+namespace detail {
+template <typename F>
+__attribute__((flatten)) void run_neon(F& f) { f.template operator()<neon>(); }
+} // namespace detail
+#endif
+
+#if defined(CE_SIMD_X86)
+CE_SIMD_TARGET_PUSH("sse4.2")
+struct sse4 {
+    static constexpr uint32_t width = 4;
+
+    using f32   = __m128;
+    using u32   = __m128i;
+    using mask  = __m128;
+
+    static f32  load(const float32_t* p) noexcept           { return _mm_loadu_ps(p); }
+    static u32  load(const uint32_t* p) noexcept            { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    static f32  load_n(const float32_t* p, size_t n) noexcept {
+        if (n >= width) return _mm_loadu_ps(p);
+        float32_t tmp[4] = {0, 0, 0, 0};
+        std::memcpy(tmp, p, n * sizeof(float32_t));
+        return _mm_loadu_ps(tmp);
+    }
+    static u32  load_n(const uint32_t* p, size_t n) noexcept {
+        if (n >= width) return load(p);
+        uint32_t tmp[4] = {0, 0, 0, 0};
+        std::memcpy(tmp, p, n * sizeof(uint32_t));
+        return load(tmp);
+    }
+    static void store(float32_t* p, f32 v) noexcept         { _mm_storeu_ps(p, v); }
+    static void store_n(float32_t* p, f32 v, size_t n) noexcept {
+        if (n >= width) { _mm_storeu_ps(p, v); return; }
+        float32_t tmp[4];
+        _mm_storeu_ps(tmp, v);
+        std::memcpy(p, tmp, n * sizeof(float32_t));
+    }
+    static void store(uint32_t* p, u32 v) noexcept          { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    static void store_n(uint32_t* p, u32 v, size_t n) noexcept {
+        if (n >= width) { store(p, v); return; }
+        uint32_t tmp[4];
+        store(tmp, v);
+        std::memcpy(p, tmp, n * sizeof(uint32_t));
+    }
+    static f32  set1(float32_t v) noexcept                  { return _mm_set1_ps(v); }
+    static u32  set1(uint32_t v) noexcept                   { return _mm_set1_epi32(static_cast<int32_t>(v)); }
+
+    static f32  low_i16(u32 v) noexcept                     { return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(v, 16), 16)); }
+    static f32  high_i16(u32 v) noexcept                    { return _mm_cvtepi32_ps(_mm_srai_epi32(v, 16)); }
+    static u32  pack_i16(f32 low, f32 high) noexcept {
+        const __m128i lo = _mm_set1_epi32(-32768), hi = _mm_set1_epi32(32767);
+        const __m128i a = _mm_min_epi32(_mm_max_epi32(_mm_cvtps_epi32(low), lo), hi);
+        const __m128i b = _mm_min_epi32(_mm_max_epi32(_mm_cvtps_epi32(high), lo), hi);
+        return _mm_blend_epi16(a, _mm_slli_epi32(b, 16), 0xAA);
+    }
+    static u32  add_i16(u32 a, u32 b) noexcept              { return _mm_add_epi16(a, b); }
+    static u32  sub_i16(u32 a, u32 b) noexcept              { return _mm_sub_epi16(a, b); }
+    static f32  gather_n(const float32_t* table, const uint8_t* idx, size_t n) noexcept {
+        float32_t tmp[4] = {0, 0, 0, 0};
+        for (size_t i = 0; i < n && i < width; i++) tmp[i] = table[idx[i]];
+        return _mm_loadu_ps(tmp);
+    }
+
+    static f32  add(f32 a, f32 b) noexcept                  { return _mm_add_ps(a, b); }
+    static f32  sub(f32 a, f32 b) noexcept                  { return _mm_sub_ps(a, b); }
+    static f32  mul(f32 a, f32 b) noexcept                  { return _mm_mul_ps(a, b); }
+    static f32  fma(f32 a, f32 b, f32 c) noexcept           { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static f32  fnma(f32 a, f32 b, f32 c) noexcept          { return _mm_sub_ps(c, _mm_mul_ps(a, b)); }
+
+    static f32 rsqrt(f32 a) noexcept {
+        f32 r = _mm_rsqrt_ps(a);
+        f32 h = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), a), _mm_mul_ps(r, r));
+        return _mm_mul_ps(r, _mm_sub_ps(_mm_set1_ps(1.5f), h)); // one Newton-Raphson step
+    }
+    static f32 recip(f32 a) noexcept {
+        f32 r = _mm_rcp_ps(a);
+        return _mm_mul_ps(r, _mm_sub_ps(_mm_set1_ps(2.f), _mm_mul_ps(a, r)));
+    }
+
+    static mask lt(f32 a, f32 b) noexcept                   { return _mm_cmplt_ps(a, b); }
+    static mask gt(f32 a, f32 b) noexcept                   { return _mm_cmpgt_ps(a, b); }
+    static mask eq(u32 a, u32 b) noexcept                   { return _mm_castsi128_ps(_mm_cmpeq_epi32(a, b)); }
+    static mask mask_and(mask a, mask b) noexcept           { return _mm_and_ps(a, b); }
+    static mask mask_not(mask a) noexcept                   { return _mm_xor_ps(a, _mm_castsi128_ps(_mm_set1_epi32(-1))); }
+    static f32  select(mask m, f32 a, f32 b) noexcept       { return _mm_blendv_ps(b, a, m); }
+
+    static mask first_n(size_t n) noexcept {
+        const __m128i limit = _mm_set1_epi32(static_cast<int32_t>(n < width ? n : width));
+        return _mm_castsi128_ps(_mm_cmpgt_epi32(limit, _mm_setr_epi32(0, 1, 2, 3)));
+    }
+
+    static float32_t hadd(f32 a) noexcept {
+        f32 s = _mm_add_ps(a, _mm_movehl_ps(a, a));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 0x1));
+        return _mm_cvtss_f32(s);
+    }
+    static uint32_t  count(mask m) noexcept                 { return std::popcount(static_cast<uint32_t>(_mm_movemask_ps(m))); }
+};
+
+namespace detail {
+template <typename F>
+__attribute__((flatten)) void run_sse4(F& f) { f.template operator()<sse4>(); }
+} // namespace detail
+CE_SIMD_TARGET_POP()
+
+CE_SIMD_TARGET_PUSH("avx2,fma")
+struct avx2 {
+    static constexpr uint32_t width = 8;
+
+    using f32   = __m256;
+    using u32   = __m256i;
+    using mask  = __m256;
+
+    static f32  load(const float32_t* p) noexcept           { return _mm256_loadu_ps(p); }
+    static u32  load(const uint32_t* p) noexcept            { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+    static f32  load_n(const float32_t* p, size_t n) noexcept {
+        return _mm256_maskload_ps(p, _mm256_castps_si256(first_n(n)));
+    }
+    static u32  load_n(const uint32_t* p, size_t n) noexcept {
+        return _mm256_maskload_epi32(reinterpret_cast<const int*>(p), _mm256_castps_si256(first_n(n)));
+    }
+    static void store(float32_t* p, f32 v) noexcept         { _mm256_storeu_ps(p, v); }
+    static void store_n(float32_t* p, f32 v, size_t n) noexcept { _mm256_maskstore_ps(p, _mm256_castps_si256(first_n(n)), v); }
+    static void store(uint32_t* p, u32 v) noexcept          { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+    static void store_n(uint32_t* p, u32 v, size_t n) noexcept {
+        _mm256_maskstore_epi32(reinterpret_cast<int*>(p), _mm256_castps_si256(first_n(n)), v);
+    }
+    static f32  set1(float32_t v) noexcept                  { return _mm256_set1_ps(v); }
+    static u32  set1(uint32_t v) noexcept                   { return _mm256_set1_epi32(static_cast<int32_t>(v)); }
+
+    static f32  low_i16(u32 v) noexcept                     { return _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16)); }
+    static f32  high_i16(u32 v) noexcept                    { return _mm256_cvtepi32_ps(_mm256_srai_epi32(v, 16)); }
+    static u32  pack_i16(f32 low, f32 high) noexcept {
+        const __m256i lo = _mm256_set1_epi32(-32768), hi = _mm256_set1_epi32(32767);
+        const __m256i a = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvtps_epi32(low), lo), hi);
+        const __m256i b = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvtps_epi32(high), lo), hi);
+        return _mm256_blend_epi16(a, _mm256_slli_epi32(b, 16), 0xAA);
+    }
+    static u32  add_i16(u32 a, u32 b) noexcept              { return _mm256_add_epi16(a, b); }
+    static u32  sub_i16(u32 a, u32 b) noexcept              { return _mm256_sub_epi16(a, b); }
+    static f32  gather_n(const float32_t* table, const uint8_t* idx, size_t n) noexcept {
+        const __m256i ids = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(idx)));
+        return _mm256_mask_i32gather_ps(_mm256_setzero_ps(), table, ids, first_n(n), sizeof(float32_t));
+    }
+
+    static f32  add(f32 a, f32 b) noexcept                  { return _mm256_add_ps(a, b); }
+    static f32  sub(f32 a, f32 b) noexcept                  { return _mm256_sub_ps(a, b); }
+    static f32  mul(f32 a, f32 b) noexcept                  { return _mm256_mul_ps(a, b); }
+    static f32  fma(f32 a, f32 b, f32 c) noexcept           { return _mm256_fmadd_ps(a, b, c); }
+    static f32  fnma(f32 a, f32 b, f32 c) noexcept          { return _mm256_fnmadd_ps(a, b, c); }
+
+    static f32 rsqrt(f32 a) noexcept {
+        f32 r = _mm256_rsqrt_ps(a);
+        f32 h = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), a), _mm256_mul_ps(r, r));
+        return _mm256_mul_ps(r, _mm256_sub_ps(_mm256_set1_ps(1.5f), h)); // one Newton-Raphson step
+    }
+    static f32 recip(f32 a) noexcept {
+        f32 r = _mm256_rcp_ps(a);
+        return _mm256_mul_ps(r, _mm256_fnmadd_ps(a, r, _mm256_set1_ps(2.f)));
+    }
+
+    static mask lt(f32 a, f32 b) noexcept                   { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static mask gt(f32 a, f32 b) noexcept                   { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static mask eq(u32 a, u32 b) noexcept                   { return _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)); }
+    static mask mask_and(mask a, mask b) noexcept           { return _mm256_and_ps(a, b); }
+    static mask mask_not(mask a) noexcept                   { return _mm256_xor_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(-1))); }
+    static f32  select(mask m, f32 a, f32 b) noexcept       { return _mm256_blendv_ps(b, a, m); }
+
+    static mask first_n(size_t n) noexcept {
+        const __m256i limit = _mm256_set1_epi32(static_cast<int32_t>(n < width ? n : width));
+        return _mm256_castsi256_ps(_mm256_cmpgt_epi32(limit, _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+    }
+
+    static float32_t hadd(f32 a) noexcept {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 0x1));
+        return _mm_cvtss_f32(s);
+    }
+    static uint32_t  count(mask m) noexcept                 { return std::popcount(static_cast<uint32_t>(_mm256_movemask_ps(m))); }
+};
+
+namespace detail {
+template <typename F>
+__attribute__((flatten)) void run_avx2(F& f) { f.template operator()<avx2>(); }
+} // namespace detail
+CE_SIMD_TARGET_POP()
+
+CE_SIMD_TARGET_PUSH("avx512f")
+/**
+ * Comparisons produce real `__mmask16` mask registers, and the mask logic and
+ * blends operate on them directly instead of on all-ones vector lanes.
+ */
+struct avx512 {
+    static constexpr uint32_t width = 16;
+
+    using f32   = __m512;
+    using u32   = __m512i;
+    using mask  = __mmask16;
+
+    static f32  load(const float32_t* p) noexcept           { return _mm512_loadu_ps(p); }
+    static u32  load(const uint32_t* p) noexcept            { return _mm512_loadu_si512(p); }
+    static f32  load_n(const float32_t* p, size_t n) noexcept   { return _mm512_maskz_loadu_ps(first_n(n), p); }
+    static u32  load_n(const uint32_t* p, size_t n) noexcept    { return _mm512_maskz_loadu_epi32(first_n(n), p); }
+    static void store(float32_t* p, f32 v) noexcept         { _mm512_storeu_ps(p, v); }
+    static void store_n(float32_t* p, f32 v, size_t n) noexcept { _mm512_mask_storeu_ps(p, first_n(n), v); }
+    static void store(uint32_t* p, u32 v) noexcept          { _mm512_storeu_si512(p, v); }
+    static void store_n(uint32_t* p, u32 v, size_t n) noexcept  { _mm512_mask_storeu_epi32(p, first_n(n), v); }
+    static f32  set1(float32_t v) noexcept                  { return _mm512_set1_ps(v); }
+    static u32  set1(uint32_t v) noexcept                   { return _mm512_set1_epi32(static_cast<int32_t>(v)); }
+
+    static f32  low_i16(u32 v) noexcept                     { return _mm512_cvtepi32_ps(_mm512_srai_epi32(_mm512_slli_epi32(v, 16), 16)); }
+    static f32  high_i16(u32 v) noexcept                    { return _mm512_cvtepi32_ps(_mm512_srai_epi32(v, 16)); }
+    static u32  pack_i16(f32 low, f32 high) noexcept {
+        const __m512i lo = _mm512_set1_epi32(-32768), hi = _mm512_set1_epi32(32767);
+        const __m512i a = _mm512_min_epi32(_mm512_max_epi32(_mm512_cvtps_epi32(low), lo), hi);
+        const __m512i b = _mm512_min_epi32(_mm512_max_epi32(_mm512_cvtps_epi32(high), lo), hi);
+        return _mm512_or_si512(_mm512_and_si512(a, _mm512_set1_epi32(0xFFFF)), _mm512_slli_epi32(b, 16));
+    }
+    // without AVX512BW: the low halves of a 32-bit sum, and the sum of the high halves
+    static u32  add_i16(u32 a, u32 b) noexcept {
+        const __m512i high = _mm512_set1_epi32(static_cast<int32_t>(0xFFFF0000));
+        return _mm512_or_si512(_mm512_andnot_si512(high, _mm512_add_epi32(a, b)), _mm512_add_epi32(_mm512_and_si512(a, high), _mm512_and_si512(b, high)));
+    }
+    static u32  sub_i16(u32 a, u32 b) noexcept {
+        const __m512i high = _mm512_set1_epi32(static_cast<int32_t>(0xFFFF0000));
+        return _mm512_or_si512(_mm512_andnot_si512(high, _mm512_sub_epi32(a, b)), _mm512_sub_epi32(_mm512_and_si512(a, high), _mm512_and_si512(b, high)));
+    }
+    static f32  gather_n(const float32_t* table, const uint8_t* idx, size_t n) noexcept {
+        const __m512i ids = _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(idx)));
+        return _mm512_mask_i32gather_ps(_mm512_setzero_ps(), first_n(n), ids, table, sizeof(float32_t));
+    }
+
+    static f32  add(f32 a, f32 b) noexcept                  { return _mm512_add_ps(a, b); }
+    static f32  sub(f32 a, f32 b) noexcept                  { return _mm512_sub_ps(a, b); }
+    static f32  mul(f32 a, f32 b) noexcept                  { return _mm512_mul_ps(a, b); }
+    static f32  fma(f32 a, f32 b, f32 c) noexcept           { return _mm512_fmadd_ps(a, b, c); }
+    static f32  fnma(f32 a, f32 b, f32 c) noexcept          { return _mm512_fnmadd_ps(a, b, c); }
+
+    static f32 rsqrt(f32 a) noexcept {
+        f32 r = _mm512_rsqrt14_ps(a);
+        f32 h = _mm512_mul_ps(_mm512_mul_ps(_mm512_set1_ps(0.5f), a), _mm512_mul_ps(r, r));
+        return _mm512_mul_ps(r, _mm512_sub_ps(_mm512_set1_ps(1.5f), h)); // one Newton-Raphson step
+    }
+    static f32 recip(f32 a) noexcept {
+        f32 r = _mm512_rcp14_ps(a);
+        return _mm512_mul_ps(r, _mm512_fnmadd_ps(a, r, _mm512_set1_ps(2.f)));
+    }
+
+    static mask lt(f32 a, f32 b) noexcept                   { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static mask gt(f32 a, f32 b) noexcept                   { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static mask eq(u32 a, u32 b) noexcept                   { return _mm512_cmpeq_epi32_mask(a, b); }
+    static mask mask_and(mask a, mask b) noexcept           { return _kand_mask16(a, b); }
+    static mask mask_not(mask a) noexcept                   { return _knot_mask16(a); }
+    static f32  select(mask m, f32 a, f32 b) noexcept       { return _mm512_mask_blend_ps(m, b, a); }
+
+    static mask first_n(size_t n) noexcept {
+        return static_cast<mask>(n < width ? (1u << n) - 1 : 0xFFFFu);
+    }
+
+    static float32_t hadd(f32 a) noexcept                   { return _mm512_reduce_add_ps(a); }
+    static uint32_t  count(mask m) noexcept                 { return std::popcount(static_cast<uint32_t>(m)); }
+};
+
+namespace detail {
+template <typename F>
+__attribute__((flatten)) void run_avx512(F& f) { f.template operator()<avx512>(); }
+} // namespace detail
+CE_SIMD_TARGET_POP()
+#endif
+
+/**
+ * Instruction set levels a kernel can be dispatched to, ordered by width
+ */
+enum class level : uint8_t { scalar, neon, sse4, avx2, avx512 };
+
+inline const char* name(level l) noexcept {
+    switch (l) {
+    case level::neon:   return "neon";
+    case level::sse4:   return "sse4";
+    case level::avx2:   return "avx2";
+    case level::avx512: return "avx512";
+    default:            return "scalar";
+    }
+}
+
+/**
+ * @return whether the running CPU can execute kernels built for `l`
+ */
+inline bool supported(level l) noexcept {
+    switch (l) {
+    case level::scalar: return true;
+#if defined(CE_SIMD_NEON)
+    case level::neon:   return true;
+#elif defined(CE_SIMD_X86)
+    case level::sse4:   return __builtin_cpu_supports("sse4.2");
+    case level::avx2:   return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case level::avx512: return __builtin_cpu_supports("avx512f");
+#endif
+    default:            return false;
+    }
+}
+
+/**
+ * @return the widest level supported by the running CPU
+ */
+inline level detect() noexcept {
+    for (level l : {level::avx512, level::avx2, level::sse4, level::neon}) {
+        if (supported(l)) return l;
+    }
+    return level::scalar;
+}
+
+/**
+ * Level picked for newly constructed solvers, resolved once per process. The
+ * COLLISION_ENGINE_ISA environment variable (scalar, neon, sse4, avx2, avx512) forces
+ * a specific path, e.g. when benchmarking; unsupported values fall back to detect().
+ */
+inline level active() noexcept {
+    static const level selected = [] {
+        const char* forced = std::getenv("COLLISION_ENGINE_ISA");
+        if (forced != nullptr) {
+            for (level l : {level::scalar, level::neon, level::sse4, level::avx2, level::avx512}) {
+                if (std::strcmp(forced, name(l)) == 0 && supported(l)) return l;
+            }
+        }
+        return detect();
+    }();
+    return selected;
+}
+
+/**
+ * Calls `f.template operator()<ISA>()` with the backend matching `l`. The call is flattened
+ * into a function compiled for that backend, so `f` is typically a generic lambda forwarding
+ * to a kernel templated on the ISA.
+ *
+ * @param l level to run, must satisfy supported(l)
+ * @param f callable templated on the backend
+ */
+template <typename F>
+void dispatch(level l, F&& f) {
+    switch (l) {
+#if defined(CE_SIMD_NEON)
+    case level::neon:   detail::run_neon(f); return;
+#elif defined(CE_SIMD_X86)
+    case level::avx512: detail::run_avx512(f); return;
+    case level::avx2:   detail::run_avx2(f); return;
+    case level::sse4:   detail::run_sse4(f); return;
+#endif
+    default:            detail::run_scalar(f); return;
+    }
+}
+
+} // namespace collision_engine::simd::isa
+
+namespace collision_engine::simd {
+
+/**
+ * Two-lane register backing the AoS vec2 wrapper. NEON has native 64-bit registers,
+ * elsewhere the pair is kept as two scalars which the compiler packs on its own.
+ *
+ * @tparam T lane type (float32_t or uint32_t)
+ */
+template <typename T>
+struct lane2 {
+    struct reg { T v[2]; };
+
+    static reg  dup(T a) noexcept               { return reg{{a, a}}; }
+    static reg  make(T i, T j) noexcept         { return reg{{i, j}}; }
+    template <uint32_t L>
+    static T    get(reg a) noexcept             { return a.v[L]; }
+    template <uint32_t L>
+    static reg  set(reg a, T x) noexcept        { a.v[L] = x; return a; }
+
+    static reg  add(reg a, reg b) noexcept      { return reg{{a.v[0] + b.v[0], a.v[1] + b.v[1]}}; }
+    static reg  sub(reg a, reg b) noexcept      { return reg{{a.v[0] - b.v[0], a.v[1] - b.v[1]}}; }
+    static reg  mul(reg a, reg b) noexcept      { return reg{{a.v[0] * b.v[0], a.v[1] * b.v[1]}}; }
+    static reg  div(reg a, reg b) noexcept      { return reg{{a.v[0] / b.v[0], a.v[1] / b.v[1]}}; }
+};
+
+#if defined(CE_SIMD_NEON)
+template <>
+struct lane2<float32_t> {
+    using reg = float32x2_t;
+
+    static reg  dup(float32_t a) noexcept                   { return vdup_n_f32(a); }
+    static reg  make(float32_t i, float32_t j) noexcept     { return vset_lane_f32(j, vdup_n_f32(i), 1); }
+    template <uint32_t L>
+    static float32_t get(reg a) noexcept                    { return vget_lane_f32(a, L); }
+    template <uint32_t L>
+    static reg  set(reg a, float32_t x) noexcept            { return vset_lane_f32(x, a, L); }
+
+    static reg  add(reg a, reg b) noexcept                  { return vadd_f32(a, b); }
+    static reg  sub(reg a, reg b) noexcept                  { return vsub_f32(a, b); }
+    static reg  mul(reg a, reg b) noexcept                  { return vmul_f32(a, b); }
+    static reg  div(reg a, reg b) noexcept                  { return vdiv_f32(a, b); }
+};
+
+template <>
+struct lane2<uint32_t> {
+    using reg = uint32x2_t;
+
+    static reg  dup(uint32_t a) noexcept                    { return vdup_n_u32(a); }
+    static reg  make(uint32_t i, uint32_t j) noexcept       { return vset_lane_u32(j, vdup_n_u32(i), 1); }
+    template <uint32_t L>
+    static uint32_t get(reg a) noexcept                     { return vget_lane_u32(a, L); }
+    template <uint32_t L>
+    static reg  set(reg a, uint32_t x) noexcept             { return vset_lane_u32(x, a, L); }
+
+    static reg  add(reg a, reg b) noexcept                  { return vadd_u32(a, b); }
+    static reg  sub(reg a, reg b) noexcept                  { return vsub_u32(a, b); }
+    static reg  mul(reg a, reg b) noexcept                  { return vmul_u32(a, b); }
+};
+#endif
+
+/**
+ * Three-lane register backing the AoS vec3 wrapper. No backend has a three-lane register,
+ * so the lanes are kept as scalars for the compiler to pack.
+ *
+ * @tparam T lane type (float32_t or uint32_t)
+ */
+template <typename T>
+struct lane3 {
+    struct reg { T v[3]; };
+
+    static reg  dup(T a) noexcept               { return reg{{a, a, a}}; }
+    static reg  make(T i, T j, T k) noexcept    { return reg{{i, j, k}}; }
+    template <uint32_t L>
+    static T    get(reg a) noexcept             { return a.v[L]; }
+    template <uint32_t L>
+    static reg  set(reg a, T x) noexcept        { a.v[L] = x; return a; }
+
+    static reg  add(reg a, reg b) noexcept      { return reg{{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2]}}; }
+    static reg  sub(reg a, reg b) noexcept      { return reg{{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2]}}; }
+    static reg  mul(reg a, reg b) noexcept      { return reg{{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2]}}; }
+    static reg  div(reg a, reg b) noexcept      { return reg{{a.v[0] / b.v[0], a.v[1] / b.v[1], a.v[2] / b.v[2]}}; }
+};
+
+} // namespace collision_engine::simd
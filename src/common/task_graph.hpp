@@ -0,0 +1,101 @@
+#pragma once
+
+#include "thread_pool.hpp"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace collision_engine {
+
+/**
+ * @brief Static dependency graph of tasks executed on a thread_pool.
+ * A task is submitted as soon as all of its predecessors have finished, so
+ * independent chains make progress without a global barrier between phases.
+ * The topology is built once and can be run any number of times.
+ */
+class task_graph {
+public:
+    using task_id = uint32_t;
+
+private:
+    struct node {
+        std::function<void()>   callback;
+        std::vector<task_id>    successors;
+        uint32_t                n_predecessors = 0;
+        std::atomic_uint32_t    pending = 0;    // predecessors not yet finished in the current run
+    };
+
+    std::deque<node>        _nodes; // deque: nodes hold atomics and must never be relocated
+    std::vector<task_id>    _roots;
+    thread_pool*            _tp = nullptr;
+
+    void submit(task_id id) { _tp->submit([this, id]() { execute(id); }); }
+
+    void execute(task_id id) {
+        node& n = _nodes[id];
+        n.callback();
+        // successors are submitted before this task is marked done, so the pool
+        // never observes zero remaining tasks while the graph is still running
+        for (task_id s : n.successors) {
+            if (_nodes[s].pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                submit(s);
+            }
+        }
+    }
+
+public:
+    task_graph() = default;
+    task_graph(const task_graph&) = delete;
+    task_graph& operator=(const task_graph&) = delete;
+
+    /**
+     * @param callback work of the task
+     * @return id of the new task, used to declare dependencies
+     */
+    template <typename FunctionType>
+    task_id add(FunctionType&& callback) {
+        node& n = _nodes.emplace_back();
+        n.callback = std::forward<FunctionType>(callback);
+        return static_cast<task_id>(_nodes.size() - 1);
+    }
+
+    /**
+     * Declares that `after` may only start once `before` has finished
+     */
+    void precede(task_id before, task_id after) {
+        _nodes[before].successors.push_back(after);
+        _nodes[after].n_predecessors++;
+    }
+
+    size_t size() const noexcept { return _nodes.size(); }
+
+    void clear() noexcept {
+        _nodes.clear();
+        _roots.clear();
+    }
+
+    /**
+     * Runs every task once and returns when all of them have finished.
+     * The graph must be acyclic and must not be modified while running.
+     *
+     * @param tp pool the tasks are executed on
+     */
+    void run(thread_pool& tp) {
+        _tp = &tp;
+        _roots.clear();
+        for (task_id id = 0; id < _nodes.size(); id++) {
+            _nodes[id].pending.store(_nodes[id].n_predecessors, std::memory_order_relaxed);
+            if (_nodes[id].n_predecessors == 0) {
+                _roots.push_back(id);
+            }
+        }
+        for (task_id id : _roots) {
+            submit(id);
+        }
+        tp.wait_for_tasks();
+    }
+};
+
+} // namespace collision_engine
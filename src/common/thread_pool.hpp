@@ -1,7 +1,16 @@
 #pragma once
 
+#include "profiler.hpp"
 #include <thread>
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <vector>
+#include <functional>
+#include <condition_variable>
 
 namespace collision_engine {
 
@@ -90,16 +99,23 @@ public:
 
 class thread_pool {
 private:
-    join_threads                _joiner;
-    std::atomic_bool            _done;
-    std::vector<std::thread>    _threads;
-    thread_safe_task_queue      _queue;
+    // declaration order matters: _joiner must be destroyed (and join) before the rest
+    std::atomic_bool                    _done;
+    thread_safe_task_queue              _queue;
+    std::vector<std::atomic_uint64_t>   _busy_ns;   // time each worker spent running tasks
+    std::vector<std::thread>            _threads;
+    join_threads                        _joiner;
     
-    void worker_thread() {
+    void worker_thread(uint32_t index) {
+        CE_PROFILE_THREAD("worker " + std::to_string(index));
         while (!_done) {
             std::function<void()> task;
             if (_queue.try_pop(task)) {
+                const auto start = std::chrono::steady_clock::now();
                 task();
+                const auto elapsed = std::chrono::steady_clock::now() - start;
+                _busy_ns[index].fetch_add(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(), std::memory_order_relaxed);
                 _queue.work_done();
             } else {
                 std::this_thread::yield();
@@ -108,13 +124,19 @@ private:
     }
 
 public:
-    const uint32_t thread_count = std::thread::hardware_concurrency();
-    // const uint32_t thread_count = 2;
+    const uint32_t thread_count;
 
-    thread_pool() : _done(false), _joiner(_threads) {
+    static uint32_t hardware_threads() noexcept { return std::max(1u, std::thread::hardware_concurrency()); }
+
+    /**
+     * @param threads number of worker threads, one per hardware thread by default
+     */
+    explicit thread_pool(uint32_t threads = hardware_threads())
+        : _done(false), _joiner(_threads), thread_count(std::max(1u, threads)) {
+        _busy_ns = std::vector<std::atomic_uint64_t>(thread_count);
         try {
             for (uint32_t i = 0; i < thread_count; i++) {
-                _threads.push_back(std::thread(&thread_pool::worker_thread, this));
+                _threads.push_back(std::thread(&thread_pool::worker_thread, this, i));
             }            
         } catch (...) {
             _done = true;
@@ -128,6 +150,22 @@ public:
     void submit(FunctionType&& f) { _queue.push(std::forward<FunctionType>(f)); }
 
     void wait_for_tasks() const { _queue.wait_task_completion(); }
+
+    /**
+     * @return nanoseconds each worker spent running tasks since the last reset
+     */
+    std::vector<uint64_t> busy_time() const {
+        std::vector<uint64_t> busy(thread_count);
+        for (uint32_t i = 0; i < thread_count; i++) {
+            busy[i] = _busy_ns[i].load(std::memory_order_relaxed);
+        }
+        return busy;
+    }
+
+    void reset_busy_time() noexcept {
+        for (auto& ns : _busy_ns) { ns.store(0, std::memory_order_relaxed); }
+    }
+
     void stop() { 
         _done = true;
         _joiner.join_all_threads();
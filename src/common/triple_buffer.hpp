@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace collision_engine {
+
+/**
+ * @brief Wait-free single producer / single consumer handoff of the latest value.
+ *
+ * The producer fills back() and publish()es it; the consumer calls update() and reads
+ * front(). The third slot sits between them, so neither side ever waits for the other or
+ * sees a slot being written: a publish the consumer did not pick up in time is simply
+ * replaced by the next one.
+ *
+ * @tparam T slot type, constructed once per slot and reused (e.g. vectors keep capacity)
+ */
+template <typename T>
+class triple_buffer {
+private:
+    static constexpr uint32_t   _fresh = 4;         // set in _middle by publish, cleared by update
+
+    std::array<T, 3>            _slots;
+    alignas(64) std::atomic<uint32_t> _middle{1};   // index of the spare slot, | _fresh when unread
+    alignas(64) uint32_t        _back = 0;          // producer only
+    alignas(64) uint32_t        _front = 2;         // consumer only
+
+public:
+    /**
+     * @return the slot the producer writes next
+     */
+    T& back() noexcept { return _slots[_back]; }
+
+    /**
+     * Hands back() to the consumer and takes the spare slot as the new back()
+     */
+    void publish() noexcept {
+        _back = _middle.exchange(_back | _fresh, std::memory_order_acq_rel) & 3;
+    }
+
+    /**
+     * Makes the latest published slot front(), if there is one the consumer has not seen
+     *
+     * @return whether front() changed
+     */
+    bool update() noexcept {
+        if ((_middle.load(std::memory_order_relaxed) & _fresh) == 0) {
+            return false;
+        }
+        _front = _middle.exchange(_front, std::memory_order_acq_rel) & 3;
+        return true;
+    }
+
+    /**
+     * @return the slot the consumer reads, stable until its next update()
+     */
+    const T& front() const noexcept { return _slots[_front]; }
+};
+
+} // namespace collision_engine
@@ -1,3 +1,4 @@
+#include "color.hpp"
 #include <SFML/Graphics/Color.hpp>
 #include <SFML/Graphics/Text.hpp>
 #include <SFML/Graphics/Font.hpp>
@@ -6,25 +7,13 @@
 namespace collision_engine {
    
 static sf::Color hsv_to_rgb(float hue, float saturation, float value) {
-    int h = static_cast<int>(hue / 60) % 6;
-    float f = (hue / 60) - h;
-    float p = value * (1 - saturation);
-    float q = value * (1 - f * saturation);
-    float t = value * (1 - (1 - f) * saturation);
-
-    switch (h) {
-        case 0: return sf::Color(value * 255, t * 255, p * 255);
-        case 1: return sf::Color(q * 255, value * 255, p * 255);
-        case 2: return sf::Color(p * 255, value * 255, t * 255);
-        case 3: return sf::Color(p * 255, q * 255, value * 255);
-        case 4: return sf::Color(t * 255, p * 255, value * 255);
-        default: return sf::Color(value * 255, p * 255, q * 255);
-    }
+    const rgba c = hsv_to_rgba(hue, saturation, value);
+    return sf::Color(c.r, c.g, c.b);
 }
 
 struct renderer_metadata {
     std::string fps, latency, count;
-    sf::Text fps_text, latency_text, particle_count;
+    sf::Text fps_text, latency_text, particle_count, profile_text;
     sf::Font font;
 
     renderer_metadata() {
@@ -44,6 +33,11 @@ struct renderer_metadata {
         particle_count.setCharacterSize(12);
         particle_count.setFillColor(sf::Color::White);
         particle_count.setPosition(1030.f, 36.f); 
+
+        profile_text.setFont(font); // filled only in CE_PROFILE builds
+        profile_text.setCharacterSize(12);
+        profile_text.setFillColor(sf::Color::White);
+        profile_text.setPosition(1030.f, 55.f);
     }
 };
 
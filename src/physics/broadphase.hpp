@@ -0,0 +1,54 @@
+#pragma once
+
+#include "common/simd.hpp"
+#include <array>
+#include <concepts>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace collision_engine {
+
+/**
+ * @brief How an engine finds the candidate pairs it hands to its narrow phase, chosen at
+ * construction.
+ *
+ * uniform_grid:    dense grid(s) over the world; the fastest for a packed, bounded world.
+ * spatial_hash:    cells keyed by integer coordinates in an open-addressing table
+ *                  (spatial_hash.hpp), with memory in proportion to the occupied cells, for
+ *                  large or unbounded worlds with sparse clusters of particles.
+ * sweep_and_prune: particles sorted by the left end of their x extent (sweep_and_prune.hpp),
+ *                  each tested against the run of particles after it that its extent
+ *                  overlaps; no cell size, so density hot spots cost no more than elsewhere.
+ */
+enum class broadphase : uint8_t {
+    uniform_grid,
+    spatial_hash,
+    sweep_and_prune,
+};
+
+/**
+ * @brief What the engines need from a sparse broadphase (spatial_hash, sweep_and_prune).
+ * The dense grids stay outside it: their passes also carry sleeping, reordering, the
+ * coarse levels, fixed16 storage and the AoS task graph, which a pair stream cannot
+ * express. Each engine's barrier step runs one substep loop over either kind.
+ *
+ *  - populate(n, circle) orders n particles into slots, circle(idx) giving their (x, y, r)
+ *  - ids[slot] is the particle in each slot
+ *  - for_each_span(first, last, f) calls f(slot, lo, hi) for the slots of units [first,
+ *    last) (cells, or single slots) with ranges of later slots holding their candidates,
+ *    so every candidate pair is in exactly one range and a SIMD kernel can stream them
+ *  - for_each_pair(first, last, f) calls f(a, b) for the same pairs by particle index
+ *  - stripes(count) splits the units into at most count ranges whose spans reach at most
+ *    into the next range, for the engines' even then odd waves
+ */
+template <typename B>
+concept sparse_broadphase = requires(B& b, const B& cb, uint32_t n) {
+    b.populate(n, [](uint32_t) { return std::array<float32_t, 3>{}; });
+    { cb.ids[n] } -> std::convertible_to<uint32_t>;
+    cb.for_each_span(n, n, [](uint32_t, uint32_t, uint32_t) {});
+    cb.for_each_pair(n, n, [](uint32_t, uint32_t) {});
+    { b.stripes(n) } -> std::convertible_to<const std::vector<std::pair<uint32_t, uint32_t>>&>;
+};
+
+} // namespace collision_engine
@@ -1,7 +1,10 @@
 #pragma once
 
-#include "arm_neon.h"
+#include "common/simd.hpp"
+#include "grid_levels.hpp"
+#include <algorithm>
 #include <cstdint>
+#include <utility>
 #include <vector>
 
 namespace collision_engine {
@@ -17,6 +20,15 @@ public:
     std::vector<uint32_t>& particle_ids() noexcept { return _particle_ids; }
 
     void add(uint32_t id) { _particle_ids.push_back(id); }
+
+    /**
+     * Inserts keeping the ids ascending, the order populate() produces
+     */
+    void insert(uint32_t id) { _particle_ids.insert(std::lower_bound(_particle_ids.begin(), _particle_ids.end(), id), id); }
+
+    void remove(uint32_t id) { _particle_ids.erase(std::find(_particle_ids.begin(), _particle_ids.end(), id)); }
+
+    void clear() noexcept { _particle_ids.clear(); } // keeps capacity for the next rebuild
     
 private:    
     std::vector<uint32_t> _particle_ids;
@@ -31,11 +43,15 @@ private:
     const uint32_t          _cell_width;    // pixel width of each cell
     const uint32_t          _cell_height;   // pixel height of each cell
     std::vector<cell<PT*>>  _cells;
+    std::vector<uint32_t>   _particle_cells;    // cell each particle is currently binned in
+    std::vector<std::pair<uint32_t, uint32_t>> _migrants; // (particle index, new cell id) during update()
+    uint32_t                _migrations = 0;
 
 public:
     const uint32_t n_rows;  // no. of rows on the grid
     const uint32_t n_cols;  // no. of cols on the grid
     uint32_t cell_count;
+    float32_t rebuild_fraction = 0.1f; // update() migration share above which it repopulates
                                             
     /**
      * @param world_size world size of vec type W
@@ -52,14 +68,72 @@ public:
      * Populates _grid from a 1-dimensional std::vector<T*> of particles
      */
     void populate(const std::vector<PT*>& particles) {
-        _cells.clear();
-        _cells.assign(n_rows * n_cols, cell<PT*>());
+        clear(particles.size());
         for (uint32_t idx = 0; idx < particles.size(); idx++) {
             uint32_t cell_id = get_cell_id(particles[idx]->position.i(), particles[idx]->position.j());
             _cells[cell_id].add(idx);
+            _particle_cells[idx] = cell_id;
+        }
+        _migrations = particles.size();
+    }
+
+    /**
+     * Incremental alternative to populate(): only the particles whose cell changed since
+     * the last call are moved, keeping every cell in the order populate() would produce.
+     * Falls back to populate() when the particle count changed or more than
+     * `rebuild_fraction` of the particles migrated.
+     */
+    void update(const std::vector<PT*>& particles) {
+        if (particles.size() != _particle_cells.size()) {
+            populate(particles);
+            return;
+        }
+        _migrants.clear();
+        for (uint32_t idx = 0; idx < particles.size(); idx++) {
+            const uint32_t cell_id = get_cell_id(particles[idx]->position.i(), particles[idx]->position.j());
+            if (cell_id != _particle_cells[idx]) {
+                _migrants.emplace_back(idx, cell_id);
+            }
+        }
+        if (_migrants.size() > rebuild_fraction * particles.size()) {
+            populate(particles);
+        } else {
+            for (const auto& [idx, cell_id] : _migrants) {
+                remove(idx);
+                insert(cell_id, idx);
+            }
+        }
+        _migrations = _migrants.size();
+    }
+
+    /**
+     * Empties every cell and sizes the particle to cell map for n_particles
+     */
+    void clear(size_t n_particles) {
+        for (auto& c : _cells) {
+            c.clear();
         }
+        _particle_cells.resize(n_particles);
     }
 
+    /**
+     * Bins a particle into a cell (which need not contain it, e.g. when clamped to a stripe)
+     */
+    void insert(uint32_t cell_id, uint32_t idx) {
+        _cells[cell_id].insert(idx);
+        _particle_cells[idx] = cell_id;
+    }
+
+    void remove(uint32_t idx) { _cells[_particle_cells[idx]].remove(idx); }
+
+    uint32_t cell_of(uint32_t idx) const noexcept { return _particle_cells[idx]; }
+
+    /**
+     * @return number of particles that changed cell in the last populate() / update()
+     *         (a full populate counts every particle)
+     */
+    uint32_t migrations() const noexcept { return _migrations; }
+
     bool is_valid_cell(uint32_t cell_id) const noexcept {
         return (cell_id >= 0 && cell_id < n_rows * n_cols);
     }
@@ -67,16 +141,145 @@ public:
     uint32_t get_cell_id(float32_t i, float32_t j) {
         uint32_t i_cell = static_cast<uint32_t>(i) / _cell_height;
         uint32_t j_cell = static_cast<uint32_t>(j) / _cell_width;
-        if (i_cell == n_rows) {
-            i_cell--;
+        if (i_cell >= n_rows) {
+            i_cell = n_rows - 1;
         }
-        if (j_cell == n_cols) {
-            j_cell--;
+        if (j_cell >= n_cols) {
+            j_cell = n_cols - 1;
         }
         return i_cell * n_cols + j_cell;
     }
 
     std::vector<cell<PT*>>& cells() noexcept { return _cells; }
+
+    uint32_t cell_width() const noexcept { return _cell_width; }
+    uint32_t cell_height() const noexcept { return _cell_height; }
+
+    /**
+     * Calls f(cell_id) for every cell overlapping the square of half side `reach` around
+     * pixel (i, j)
+     */
+    template <typename F>
+    void for_each_cell_near(float32_t i, float32_t j, float32_t reach, F f) {
+        const uint32_t first = get_cell_id(std::max(i - reach, 0.f), std::max(j - reach, 0.f));
+        const uint32_t last = get_cell_id(std::max(i + reach, 0.f), std::max(j + reach, 0.f));
+        for (uint32_t row = first / n_cols; row <= last / n_cols; row++) {
+            for (uint32_t col = first % n_cols; col <= last % n_cols; col++) {
+                f(row * n_cols + col);
+            }
+        }
+    }
+
+    /**
+     * Calls f(idx) for every particle binned in a cell overlapping the square of half side
+     * `reach` around pixel (i, j)
+     */
+    template <typename F>
+    void for_each_near(float32_t i, float32_t j, float32_t reach, F f) {
+        for_each_cell_near(i, j, reach, [&](uint32_t cell_id) {
+            for (uint32_t idx : _cells[cell_id].particle_ids()) {
+                f(idx);
+            }
+        });
+    }
+};
+
+/**
+ * @brief Grids of doubling cell size stacked over one world, for particles of very different
+ * radii. Every particle is binned on the level whose cells fit its diameter (see
+ * grid_levels), so small particles keep small cells however large the largest one is.
+ * Pairs on one level come from the 3x3 cells around a particle; pairs across levels are
+ * found by the coarser particle among the cells of the finer level within its reach, so
+ * pair tests follow the local density of every level rather than the largest radius.
+ *
+ * @tparam PT (Particle Type) type of object the cells contain
+ */
+template <typename PT, typename W>
+class hierarchical_grid {
+private:
+    grid_levels                         _layout;
+    std::vector<grid<PT, W>>            _levels;
+    std::vector<std::vector<uint32_t>>  _members;   // particles binned on each level
+
+    void bin(const std::vector<PT*>& particles, uint32_t idx) {
+        const PT* p = particles[idx];
+        const uint32_t level = _layout.level_of(p->radius);
+        _levels[level].insert(_levels[level].get_cell_id(p->position.i(), p->position.j()), idx);
+        _members[level].push_back(idx);
+    }
+
+    void clear(size_t n_particles) {
+        for (uint32_t level = 0; level < _levels.size(); level++) {
+            _levels[level].clear(n_particles);
+            _members[level].clear();
+        }
+    }
+
+public:
+    /**
+     * @param n_rows, n_cols cells of level 0, halved on every level above
+     * @param levels number of levels, at most grid_levels::max_levels
+     */
+    hierarchical_grid(W world_size, uint32_t n_rows, uint32_t n_cols, uint32_t levels) {
+        _layout.base = static_cast<float32_t>(std::min(world_size.i() / n_cols, world_size.j() / n_rows));
+        _layout.count = std::clamp(levels, 1u, grid_levels::max_levels);
+        for (uint32_t level = 0; level < _layout.count; level++) {
+            _levels.emplace_back(world_size, std::max(1u, n_rows >> level), std::max(1u, n_cols >> level));
+        }
+        _members.resize(_layout.count);
+    }
+
+    /**
+     * Bins every particle on its level
+     */
+    void populate(const std::vector<PT*>& particles) {
+        clear(particles.size());
+        for (uint32_t idx = 0; idx < particles.size(); idx++) {
+            bin(particles, idx);
+        }
+    }
+
+    /**
+     * Bins only the given particles, e.g. the ones too large for another grid
+     */
+    void populate(const std::vector<PT*>& particles, const std::vector<uint32_t>& ids) {
+        clear(particles.size());
+        for (uint32_t idx : ids) {
+            bin(particles, idx);
+        }
+    }
+
+    /**
+     * Calls f(a, b) once for every pair of binned particles that may touch
+     */
+    template <typename F>
+    void for_each_pair(const std::vector<PT*>& particles, F f) {
+        for (uint32_t level = 0; level < _levels.size(); level++) {
+            grid<PT, W>& g = _levels[level];
+            std::vector<cell<PT*>>& cells = g.cells();
+            for (uint32_t idx : _members[level]) {
+                const uint32_t row = g.cell_of(idx) / g.n_cols;
+                const uint32_t col = g.cell_of(idx) % g.n_cols;
+                for (uint32_t r = row > 0 ? row - 1 : row; r <= std::min(row + 1, g.n_rows - 1); r++) {
+                    for (uint32_t c = col > 0 ? col - 1 : col; c <= std::min(col + 1, g.n_cols - 1); c++) {
+                        for (uint32_t o : cells[r * g.n_cols + c].particle_ids()) {
+                            if (o > idx) f(idx, o);
+                        }
+                    }
+                }
+                const PT* p = particles[idx];
+                for (uint32_t finer = 0; finer < level; finer++) {
+                    _levels[finer].for_each_near(p->position.i(), p->position.j(), p->radius + _layout.max_radius(finer),
+                                                 [&](uint32_t o) { f(idx, o); });
+                }
+            }
+        }
+    }
+
+    const grid_levels& layout() const noexcept { return _layout; }
+    uint32_t levels() const noexcept { return _layout.count; }
+    grid<PT, W>& level(uint32_t level) noexcept { return _levels[level]; }
+    const std::vector<uint32_t>& members(uint32_t level) const noexcept { return _members[level]; }
 };
 
 } // namespace collision_engine
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "common/simd.hpp"
+#include <cstdint>
+
+namespace collision_engine {
+
+/**
+ * @brief Cell sizes of a hierarchical grid: level l has cells at least `base * 2^l` pixels
+ * wide and holds the particles whose diameter fits them but not the level below. A pair
+ * on one level then lies in the 3x3 cells around either particle, and a particle of
+ * radius r touches particles of a finer level l only within r + max_radius(l) of it.
+ */
+struct grid_levels {
+    static constexpr uint32_t max_levels = 8;
+
+    float32_t   base    = 1;    // cell size of level 0 in pixels
+    uint32_t    count   = 1;
+
+    /**
+     * @return the fewest levels (at most max_levels) whose coarsest cells fit max_radius
+     */
+    static grid_levels fit(float32_t base, float32_t max_radius) noexcept {
+        grid_levels levels{base, 1};
+        while (levels.count < max_levels && levels.cell_size(levels.count - 1) < 2 * max_radius) {
+            levels.count++;
+        }
+        return levels;
+    }
+
+    float32_t cell_size(uint32_t level) const noexcept { return base * static_cast<float32_t>(1u << level); }
+
+    /**
+     * @return largest radius binned on the level
+     */
+    float32_t max_radius(uint32_t level) const noexcept { return cell_size(level) / 2; }
+
+    /**
+     * @return finest level whose cells fit the diameter; the coarsest for larger particles,
+     *         whose contacts on their own level may then be missed
+     */
+    uint32_t level_of(float32_t radius) const noexcept {
+        uint32_t level = 0;
+        while (level + 1 < count && cell_size(level) < 2 * radius) {
+            level++;
+        }
+        return level;
+    }
+
+    bool operator==(const grid_levels&) const noexcept = default;
+};
+
+} // namespace collision_engine
@@ -1,7 +1,7 @@
 #pragma once
 
 #include "vec.hpp"
-#include "arm_neon.h"
+#include "common/simd.hpp"
 #include <cstdint>
 
 namespace collision_engine {
@@ -27,6 +27,21 @@ struct vec_traits<vec2<uint32_t>> {
     static constexpr uint8_t n_dims = 2;
 };
 
+/**
+ * Template specialization of vec3 type traits
+ */
+template <>
+struct vec_traits<vec3<float32_t>> {
+    using element_type = float32_t;
+    static constexpr uint8_t n_dims = 3;
+};
+
+template <>
+struct vec_traits<vec3<uint32_t>> {
+    using element_type = uint32_t;
+    static constexpr uint8_t n_dims = 3;
+};
+
 /**
  * @tparam VT vector wrapper defined in particle.hpp (e.g. vec2, vec3)
  */
@@ -51,11 +66,12 @@ struct particle {
             + (acceleration - displacement * VELOCITY_DAMPING) * (dt * dt);
         prev_position = position;
         position = new_position;
-        acceleration = VT{0.f, 0.f};    
+        acceleration = VT{0.f};
     }        
-} __attribute__((__packed__, aligned(32))); 
+} __attribute__((aligned(32)));
 
 static_assert(sizeof(particle<vec2<float32_t>>) == 32 /* bytes */); 
+static_assert(sizeof(particle<vec3<float32_t>>) == 64 /* bytes */);
 
 } // namespace collision engine
 
@@ -0,0 +1,556 @@
+#pragma once
+
+#include "simd_solver.hpp"
+#include "solver.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+namespace collision_engine {
+
+/**
+ * Trajectory file layout (version 1), written front to back:
+ *
+ *   [trajectory_header][frame header, payload][frame header, payload]...[index][trajectory_trailer]
+ *
+ * Positions are quantized to 16 bit fixed point over the world extent and stored in handle
+ * order, so a particle keeps its slot across reorderings. A keyframe payload holds every x
+ * then every y as raw uint16; the other frames hold zigzag varints of the difference with
+ * the previous frame, which is one byte for anything moving less than 64 steps (~1/1024 of
+ * the extent, half a pixel in a 512 world). The index of keyframe offsets is only written by close(); a reader of a
+ * file without it rebuilds it by walking the frame headers.
+ */
+struct trajectory_header {
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    keyframe_interval;
+    float32_t   world_width;
+    float32_t   world_height;
+    uint32_t    reserved[2];
+};
+static_assert(sizeof(trajectory_header) == 32 && std::is_trivially_copyable_v<trajectory_header>);
+
+struct trajectory_frame_header {
+    uint32_t    magic;
+    uint32_t    keyframe;
+    uint64_t    frame;
+    uint64_t    count;          // particles
+    uint64_t    payload_bytes;
+};
+static_assert(sizeof(trajectory_frame_header) == 32);
+
+struct trajectory_keyframe {
+    uint64_t    frame;
+    uint64_t    offset;         // of its frame header
+};
+
+struct trajectory_trailer {
+    uint64_t    frames;
+    uint64_t    keyframes;
+    uint64_t    index_offset;
+    char        magic[8];
+};
+static_assert(sizeof(trajectory_trailer) == 32);
+
+namespace trajectory_detail {
+
+inline constexpr char       magic[8]        = {'C', 'E', 'T', 'R', 'A', 'J', 0, 0};
+inline constexpr char       index_magic[8]  = {'C', 'E', 'I', 'N', 'D', 'E', 'X', 0};
+inline constexpr uint32_t   frame_magic     = 0x52464543; // "CEFR"
+inline constexpr uint32_t   version         = 1;
+inline constexpr float32_t  steps           = 65535.f;
+
+inline uint16_t quantize(float32_t v, float32_t extent) noexcept {
+    const float32_t q = v * (steps / extent) + 0.5f;
+    return static_cast<uint16_t>(std::clamp(q, 0.f, steps));
+}
+
+inline float32_t dequantize(uint16_t q, float32_t extent) noexcept {
+    return q * (extent / steps);
+}
+
+/**
+ * Appends the difference of a plane with the previous one, as zigzag LEB128 varints
+ */
+inline void encode_delta(const uint16_t* cur, const uint16_t* prev, size_t n, std::vector<uint8_t>& out) {
+    for (size_t i = 0; i < n; i++) {
+        const int16_t d = static_cast<int16_t>(static_cast<uint16_t>(cur[i] - prev[i])); // wraps, so it is exact
+        uint32_t z = static_cast<uint16_t>((d << 1) ^ (d >> 15));
+        while (z >= 0x80) {
+            out.push_back(static_cast<uint8_t>(z | 0x80));
+            z >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(z));
+    }
+}
+
+/**
+ * @return bytes consumed, or 0 when the payload ends early
+ */
+inline size_t decode_delta(const uint8_t* in, size_t size, uint16_t* plane, size_t n) {
+    size_t at = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t z = 0;
+        for (uint32_t shift = 0;; shift += 7) {
+            if (at == size || shift > 14) {
+                return 0;
+            }
+            const uint8_t b = in[at++];
+            z |= static_cast<uint32_t>(b & 0x7f) << shift;
+            if (b < 0x80) {
+                break;
+            }
+        }
+        const int16_t d = static_cast<int16_t>((z >> 1) ^ (0u - (z & 1)));
+        plane[i] = static_cast<uint16_t>(plane[i] + d);
+    }
+    return at;
+}
+
+} // namespace trajectory_detail
+
+/**
+ * @brief Records particle positions to a trajectory file without stalling the simulation.
+ *
+ * record() copies the positions into the next free slot of a single producer / single
+ * consumer ring of preallocated buffers and returns; a background thread quantizes,
+ * delta encodes and appends them to the file. When the writer falls behind and the ring is
+ * full the frame is dropped (and counted) rather than blocking the caller.
+ */
+class trajectory_recorder {
+private:
+    struct slot {
+        std::vector<float32_t>  xs, ys;
+        std::vector<uint32_t>   handles;
+        size_t                  count = 0;
+        size_t                  width = 0;  // positions per recorded frame, count unless handles leave gaps
+        bool                    has_handles = false;
+    };
+
+    const float32_t         _world_width;
+    const float32_t         _world_height;
+    const uint32_t          _keyframe_interval;
+    const size_t            _max_particles;
+    std::vector<slot>       _slots;
+    alignas(64) std::atomic<uint64_t> _head{0};     // frames published by record()
+    alignas(64) std::atomic<uint64_t> _tail{0};     // frames consumed by the writer
+    alignas(64) std::atomic<uint32_t> _signal{0};   // bumped on publish and close, the writer sleeps on it
+    std::atomic<bool>       _closing{false};
+    std::atomic<bool>       _failed{false};
+    uint64_t                _dropped = 0;           // producer side only
+    int                     _fd = -1;
+    std::thread             _writer;
+
+    // writer side only
+    std::vector<uint16_t>   _cur, _prev;            // x plane then y plane, in handle order
+    std::vector<uint8_t>    _buffer;                // pending sequential write
+    std::vector<trajectory_keyframe> _keyframes;
+    uint64_t                _written_frames = 0;
+    uint64_t                _offset = 0;            // file offset of the end of _buffer, where the next frame starts
+    size_t                  _prev_count = 0;
+
+    static constexpr size_t _flush_bytes = size_t(1) << 20;
+
+    bool flush() {
+        size_t written = 0;
+        while (written < _buffer.size()) {
+            const ssize_t w = ::write(_fd, _buffer.data() + written, _buffer.size() - written);
+            if (w <= 0) {
+                _failed.store(true, std::memory_order_relaxed);
+                _buffer.clear();
+                return false;
+            }
+            written += static_cast<size_t>(w);
+        }
+        _buffer.clear();
+        return true;
+    }
+
+    template <typename T>
+    void append(const T& value) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        _buffer.insert(_buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+    void encode(const slot& s) {
+        const size_t n = s.width;
+        _cur.resize(2 * n);
+        if (s.count != n) {
+            std::fill(_cur.begin(), _cur.end(), 0);
+        }
+        for (size_t i = 0; i < s.count; i++) {
+            const size_t h = s.has_handles ? s.handles[i] : i;
+            _cur[h] = trajectory_detail::quantize(s.xs[i], _world_width);
+            _cur[n + h] = trajectory_detail::quantize(s.ys[i], _world_height);
+        }
+
+        const bool keyframe = _written_frames % _keyframe_interval == 0 || n != _prev_count;
+        const size_t header_at = _buffer.size();
+        trajectory_frame_header fh{trajectory_detail::frame_magic, keyframe, _written_frames, n, 0};
+        append(fh);
+        if (keyframe) {
+            _keyframes.push_back({_written_frames, _offset});
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(_cur.data());
+            _buffer.insert(_buffer.end(), bytes, bytes + 2 * n * sizeof(uint16_t));
+        } else {
+            trajectory_detail::encode_delta(_cur.data(), _prev.data(), 2 * n, _buffer);
+        }
+        fh.payload_bytes = _buffer.size() - header_at - sizeof(fh);
+        std::memcpy(_buffer.data() + header_at, &fh, sizeof(fh));
+
+        _cur.swap(_prev);
+        _prev_count = n;
+        _written_frames++;
+        _offset += _buffer.size() - header_at;
+        if (_buffer.size() >= _flush_bytes) {
+            flush();
+        }
+    }
+
+    void write_loop() {
+        for (;;) {
+            const uint32_t signal = _signal.load(std::memory_order_acquire);
+            const uint64_t tail = _tail.load(std::memory_order_relaxed);
+            if (tail == _head.load(std::memory_order_acquire)) {
+                if (_closing.load(std::memory_order_acquire)) {
+                    return;
+                }
+                _signal.wait(signal, std::memory_order_acquire);
+                continue;
+            }
+            encode(_slots[tail % _slots.size()]);
+            _tail.store(tail + 1, std::memory_order_release);
+        }
+    }
+
+    void publish(slot& s, size_t n, bool has_handles, size_t width) {
+        s.count = n;
+        s.width = std::max(n, width);
+        s.has_handles = has_handles;
+        _head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        _signal.fetch_add(1, std::memory_order_release);
+        _signal.notify_one();
+    }
+
+    /**
+     * @return the slot the next frame goes to, or null (counting a drop) when it cannot be recorded
+     */
+    slot* acquire(size_t n) {
+        const uint64_t head = _head.load(std::memory_order_relaxed);
+        if (!is_open() || n > _max_particles || head - _tail.load(std::memory_order_acquire) == _slots.size()) {
+            _dropped++;
+            return nullptr;
+        }
+        return &_slots[head % _slots.size()];
+    }
+
+public:
+    /**
+     * @param world_width, world_height extent the positions are quantized over
+     * @param max_particles largest frame record() accepts, every slot is sized for it
+     * @param slots frames the writer may fall behind by before frames are dropped
+     * @param keyframe_interval frames between keyframes, the granularity of seeking
+     */
+    trajectory_recorder(const std::string& path, float32_t world_width, float32_t world_height, size_t max_particles, size_t slots = 8, uint32_t keyframe_interval = 60)
+        :   _world_width(world_width),
+            _world_height(world_height),
+            _keyframe_interval(std::max(1u, keyframe_interval)),
+            _max_particles(max_particles),
+            _slots(std::max<size_t>(2, slots)) {
+        for (slot& s : _slots) {
+            s.xs.resize(max_particles);
+            s.ys.resize(max_particles);
+            s.handles.resize(max_particles);
+        }
+        _fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (_fd < 0) {
+            return;
+        }
+        trajectory_header h{};
+        std::memcpy(h.magic, trajectory_detail::magic, sizeof(h.magic));
+        h.version = trajectory_detail::version;
+        h.keyframe_interval = _keyframe_interval;
+        h.world_width = world_width;
+        h.world_height = world_height;
+        append(h);
+        _offset = _buffer.size();
+        _writer = std::thread(&trajectory_recorder::write_loop, this);
+    }
+
+    ~trajectory_recorder() { close(); }
+
+    trajectory_recorder(const trajectory_recorder&) = delete;
+    trajectory_recorder& operator=(const trajectory_recorder&) = delete;
+
+    bool is_open() const noexcept { return _fd >= 0 && !_closing.load(std::memory_order_relaxed); }
+
+    /**
+     * @return whether every frame so far reached the file (checked after close())
+     */
+    bool ok() const noexcept { return !_failed.load(std::memory_order_relaxed); }
+
+    /**
+     * @return frames handed to the writer
+     */
+    uint64_t frames() const noexcept { return _head.load(std::memory_order_relaxed); }
+
+    /**
+     * @return frames not recorded because the ring was full or they were too large
+     */
+    uint64_t dropped() const noexcept { return _dropped; }
+
+    /**
+     * Records one frame of positions, from the simulation thread
+     *
+     * @param handles position of each index in the recorded frame (e.g. its handle slot),
+     *                identity when null
+     * @param width positions in the recorded frame, at least n and above every handle;
+     *              the ones no index maps to read as (0, 0)
+     * @return false when the frame was dropped
+     */
+    bool record(const float32_t* xs, const float32_t* ys, size_t n, const uint32_t* handles = nullptr, size_t width = 0) {
+        slot* s = acquire(n);
+        if (!s) {
+            return false;
+        }
+        std::memcpy(s->xs.data(), xs, n * sizeof(float32_t));
+        std::memcpy(s->ys.data(), ys, n * sizeof(float32_t));
+        if (handles) {
+            std::memcpy(s->handles.data(), handles, n * sizeof(uint32_t));
+        }
+        publish(*s, n, handles != nullptr, width);
+        return true;
+    }
+
+    /**
+     * Particles are recorded by handle slot, so each keeps its place in the frame
+     */
+    bool record(const simd::f32_solver& solver) {
+        const simd::particle_collection<float32_t>& pc = solver.pc();
+        return record(pc.xs.data(), pc.ys.data(), pc.size(), pc.slots().data(), pc.slot_count());
+    }
+
+    /**
+     * The environment does not store positions contiguously, so this gathers them instead
+     * of copying; particles are recorded by handle slot, i.e. in insertion order until
+     * some are removed
+     */
+    template <typename VT, typename W>
+    bool record(const environment<VT, W>& env) {
+        const std::vector<particle<VT>*>& particles = env.particles();
+        slot* s = acquire(particles.size());
+        if (!s) {
+            return false;
+        }
+        for (size_t i = 0; i < particles.size(); i++) {
+            s->xs[i] = particles[i]->position.i();
+            s->ys[i] = particles[i]->position.j();
+        }
+        std::copy(env.handles().slots().begin(), env.handles().slots().end(), s->handles.begin());
+        publish(*s, particles.size(), true, env.handles().slot_count());
+        return true;
+    }
+
+    /**
+     * Drains the ring, writes the keyframe index and closes the file
+     */
+    void close() {
+        if (_fd < 0) {
+            return;
+        }
+        _closing.store(true, std::memory_order_release);
+        _signal.fetch_add(1, std::memory_order_release);
+        _signal.notify_one();
+        _writer.join();
+
+        trajectory_trailer t{_written_frames, _keyframes.size(), _offset, {}};
+        std::memcpy(t.magic, trajectory_detail::index_magic, sizeof(t.magic));
+        for (const trajectory_keyframe& k : _keyframes) {
+            append(k);
+        }
+        append(t);
+        flush();
+        if (::close(_fd) != 0) {
+            _failed.store(true, std::memory_order_relaxed);
+        }
+        _fd = -1;
+    }
+};
+
+/**
+ * @brief Decodes a trajectory file frame by frame, seeking through its keyframes.
+ * Positions are in handle order.
+ */
+class trajectory_reader {
+private:
+    std::ifstream                       _in;
+    trajectory_header                   _header{};
+    std::vector<trajectory_keyframe>    _keyframes;
+    uint64_t                            _frames = 0;
+    uint64_t                            _frame = 0;     // decoded frame, _frames before the first
+    uint64_t                            _next_offset = 0;
+    size_t                              _count = 0;
+    std::vector<uint16_t>               _plane;         // x plane then y plane
+    std::vector<uint8_t>                _payload;
+    std::vector<float32_t>              _xs, _ys;
+
+    template <typename T>
+    bool read_at(uint64_t offset, T& value) {
+        _in.clear();
+        _in.seekg(offset);
+        return static_cast<bool>(_in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+
+    bool read_index(uint64_t file_size) {
+        trajectory_trailer t;
+        if (file_size < sizeof(trajectory_header) + sizeof(t) || !read_at(file_size - sizeof(t), t)
+            || std::memcmp(t.magic, trajectory_detail::index_magic, sizeof(t.magic)) != 0
+            || t.index_offset + t.keyframes * sizeof(trajectory_keyframe) + sizeof(t) != file_size) {
+            return false;
+        }
+        _keyframes.resize(t.keyframes);
+        _in.seekg(t.index_offset);
+        _in.read(reinterpret_cast<char*>(_keyframes.data()), t.keyframes * sizeof(trajectory_keyframe));
+        _frames = t.frames;
+        return static_cast<bool>(_in);
+    }
+
+    /**
+     * Walks the frame headers of a file whose recorder did not close it
+     */
+    void scan_index(uint64_t file_size) {
+        uint64_t offset = sizeof(trajectory_header);
+        trajectory_frame_header fh;
+        while (offset + sizeof(fh) <= file_size && read_at(offset, fh) && fh.magic == trajectory_detail::frame_magic
+               && offset + sizeof(fh) + fh.payload_bytes <= file_size) {
+            if (fh.keyframe) {
+                _keyframes.push_back({fh.frame, offset});
+            }
+            offset += sizeof(fh) + fh.payload_bytes;
+            _frames = fh.frame + 1;
+        }
+    }
+
+    bool decode_at(uint64_t offset) {
+        trajectory_frame_header fh;
+        if (!read_at(offset, fh) || fh.magic != trajectory_detail::frame_magic) {
+            return false;
+        }
+        _payload.resize(fh.payload_bytes);
+        if (!_in.read(reinterpret_cast<char*>(_payload.data()), fh.payload_bytes)) {
+            return false;
+        }
+        const size_t n = fh.count;
+        if (fh.keyframe) {
+            if (fh.payload_bytes != 2 * n * sizeof(uint16_t)) {
+                return false;
+            }
+            _plane.resize(2 * n);
+            std::memcpy(_plane.data(), _payload.data(), fh.payload_bytes);
+        } else if (n != _count || _frame + 1 != fh.frame
+                   || trajectory_detail::decode_delta(_payload.data(), _payload.size(), _plane.data(), 2 * n) != _payload.size()) {
+            return false;
+        }
+
+        _count = n;
+        _frame = fh.frame;
+        _next_offset = offset + sizeof(fh) + fh.payload_bytes;
+        _xs.resize(n);
+        _ys.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            _xs[i] = trajectory_detail::dequantize(_plane[i], _header.world_width);
+            _ys[i] = trajectory_detail::dequantize(_plane[n + i], _header.world_height);
+        }
+        return true;
+    }
+
+public:
+    explicit trajectory_reader(const std::string& path) : _in(path, std::ios::binary) {
+        if (!_in || !_in.read(reinterpret_cast<char*>(&_header), sizeof(_header))
+            || std::memcmp(_header.magic, trajectory_detail::magic, sizeof(_header.magic)) != 0
+            || _header.version != trajectory_detail::version) {
+            _header = {};
+            return;
+        }
+        _in.seekg(0, std::ios::end);
+        const uint64_t file_size = static_cast<uint64_t>(_in.tellg());
+        if (!read_index(file_size)) {
+            _keyframes.clear();
+            _frames = 0;
+            scan_index(file_size);
+        }
+        _frame = _frames;
+    }
+
+    bool is_open() const noexcept { return _header.version == trajectory_detail::version; }
+
+    uint64_t frames() const noexcept { return _frames; }
+    uint32_t keyframe_interval() const noexcept { return _header.keyframe_interval; }
+    float32_t world_width() const noexcept { return _header.world_width; }
+    float32_t world_height() const noexcept { return _header.world_height; }
+
+    /**
+     * @return the current frame, valid after a successful seek() or next()
+     */
+    uint64_t frame() const noexcept { return _frame; }
+    size_t size() const noexcept { return _count; }
+    const std::vector<float32_t>& xs() const noexcept { return _xs; }
+    const std::vector<float32_t>& ys() const noexcept { return _ys; }
+
+    /**
+     * Decodes `frame`, starting from the closest keyframe at or before it
+     */
+    bool seek(uint64_t frame) {
+        if (frame >= _frames) {
+            return false;
+        }
+        const auto k = std::upper_bound(_keyframes.begin(), _keyframes.end(), frame,
+            [](uint64_t f, const trajectory_keyframe& key) { return f < key.frame; });
+        if (k == _keyframes.begin()) {
+            return false;
+        }
+        if (_frame < _frames && _frame <= frame && _frame >= std::prev(k)->frame) { // already on the way
+            while (_frame < frame) {
+                if (!next()) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        if (!decode_at(std::prev(k)->offset)) {
+            _frame = _frames;
+            return false;
+        }
+        while (_frame < frame) {
+            if (!next()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Decodes the frame after the current one (the first frame before any seek)
+     */
+    bool next() {
+        if (_frame >= _frames) {
+            return seek(0);
+        }
+        if (_frame + 1 >= _frames || !decode_at(_next_offset)) {
+            return false;
+        }
+        return true;
+    }
+};
+
+} // namespace collision_engine
@@ -0,0 +1,245 @@
+#pragma once
+
+#include "common/profiler.hpp"
+#include "common/triple_buffer.hpp"
+#include "simd_solver.hpp"
+#include "solver.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace collision_engine {
+
+/**
+ * @brief Particle positions of the two most recent physics steps, as published by
+ * simulation_runner. Arrays are indexed by handle slot, so a particle keeps its place from
+ * frame to frame; the slots of removed particles have a radius of 0.
+ */
+struct state_frame {
+    using clock = std::chrono::steady_clock;
+
+    std::vector<float32_t>  xs, ys;     // after the latest step
+    std::vector<float32_t>  pxs, pys;   // after the step before it
+    std::vector<float32_t>  rs;
+    size_t                  count = 0;  // slots, live or not
+    uint64_t                step = 0;   // steps taken so far
+    clock::time_point       stamp;      // time the latest step is scheduled at
+    float32_t               dt = 0;
+
+    /**
+     * Interpolation factor for drawing at `now`: the previous state at `stamp`, the latest
+     * one a step later, so what is drawn trails the simulation by at most one step
+     */
+    float32_t alpha(clock::time_point now) const noexcept {
+        const float32_t a = std::chrono::duration<float32_t>(now - stamp).count() / dt;
+        return std::clamp(a, 0.f, 1.f);
+    }
+};
+
+namespace runner_detail {
+
+inline void step(simd::f32_solver& solver, float32_t) { solver.step(); }
+
+template <typename VT, typename W>
+void step(environment<VT, W>& env, float32_t dt) { env.step(dt); }
+
+/**
+ * Sizes the arrays to the table's slots and empties the free ones
+ */
+inline void capture_slots(const handle_table& handles, std::vector<float32_t>& xs, std::vector<float32_t>& ys, std::vector<float32_t>& rs) {
+    const size_t n = handles.slot_count();
+    xs.resize(n);
+    ys.resize(n);
+    rs.resize(n);
+    for (uint32_t slot : handles.free_slots()) {
+        xs[slot] = ys[slot] = rs[slot] = 0;
+    }
+}
+
+inline void capture(const simd::f32_solver& solver, std::vector<float32_t>& xs, std::vector<float32_t>& ys, std::vector<float32_t>& rs) {
+    const simd::particle_collection<float32_t>& pc = solver.pc();
+    capture_slots(pc.handles(), xs, ys, rs);
+    for (uint32_t i = 0; i < pc.size(); i++) {
+        const uint32_t slot = pc.slot_of(i);
+        xs[slot] = pc.xs[i];
+        ys[slot] = pc.ys[i];
+        rs[slot] = pc.rs[i];
+    }
+}
+
+template <typename VT, typename W>
+void capture(const environment<VT, W>& env, std::vector<float32_t>& xs, std::vector<float32_t>& ys, std::vector<float32_t>& rs) {
+    const std::vector<particle<VT>*>& particles = env.particles();
+    capture_slots(env.handles(), xs, ys, rs);
+    for (size_t i = 0; i < particles.size(); i++) {
+        const uint32_t slot = env.handles().slot_of(i);
+        xs[slot] = particles[i]->position.i();
+        ys[slot] = particles[i]->position.j();
+        rs[slot] = particles[i]->radius;
+    }
+}
+
+} // namespace runner_detail
+
+/**
+ * @brief Runs an engine on a dedicated thread at a fixed timestep and publishes its state
+ * through a triple buffer, so physics and rendering proceed at independent rates and
+ * neither ever waits for the other.
+ *
+ * In real time mode the thread accumulates wall time and takes one step per `dt` of it,
+ * sleeping in between; when it falls more than `max_catch_up` steps behind, the backlog
+ * is dropped (and counted) rather than letting the simulation spiral. Otherwise it steps
+ * as fast as it can. Every step is published with the positions of the step before it,
+ * for the consumer to interpolate.
+ *
+ * While running, the engine belongs to the physics thread: modify it only from on_step().
+ *
+ * @tparam Engine simd::f32_solver or environment<VT, W>
+ */
+template <typename Engine>
+class simulation_runner {
+private:
+    using clock = state_frame::clock;
+
+    Engine&                         _engine;
+    const float32_t                 _dt;
+    const bool                      _realtime;
+    const uint32_t                  _max_catch_up;
+    std::function<void(Engine&)>    _on_step;
+    triple_buffer<state_frame>      _frames;
+    std::atomic<bool>               _running{false};
+    std::atomic<uint64_t>           _steps{0};
+    std::atomic<uint64_t>           _dropped{0};
+    std::thread                     _thread;
+
+    // physics thread only
+    std::vector<float32_t>          _xs, _ys, _pxs, _pys, _rs, _prs;
+
+    void advance(clock::time_point scheduled) {
+        runner_detail::step(_engine, _dt);
+        std::swap(_xs, _pxs);
+        std::swap(_ys, _pys);
+        std::swap(_rs, _prs);
+        runner_detail::capture(_engine, _xs, _ys, _rs);
+        const size_t n = _xs.size();
+        const size_t known = std::min(_pxs.size(), n);
+        _pxs.resize(n);
+        _pys.resize(n);
+        std::copy(_xs.begin() + known, _xs.end(), _pxs.begin() + known); // spawned this step: nothing to interpolate from
+        std::copy(_ys.begin() + known, _ys.end(), _pys.begin() + known);
+        for (size_t h = 0; h < known; h++) {
+            if (_prs[h] == 0) { // nor for slots reused this step
+                _pxs[h] = _xs[h];
+                _pys[h] = _ys[h];
+            }
+        }
+        if (_on_step) {
+            _on_step(_engine);
+        }
+        const uint64_t steps = _steps.load(std::memory_order_relaxed) + 1;
+        _steps.store(steps, std::memory_order_relaxed);
+
+        state_frame& f = _frames.back();
+        f.xs.assign(_xs.begin(), _xs.end());
+        f.ys.assign(_ys.begin(), _ys.end());
+        f.pxs.assign(_pxs.begin(), _pxs.end());
+        f.pys.assign(_pys.begin(), _pys.end());
+        f.rs.assign(_rs.begin(), _rs.end());
+        f.count = n;
+        f.step = steps;
+        f.stamp = scheduled;
+        f.dt = _dt;
+        _frames.publish();
+    }
+
+    void loop() {
+        CE_PROFILE_THREAD("physics");
+        const auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(_dt));
+        clock::time_point next = clock::now();
+        while (_running.load(std::memory_order_relaxed)) {
+            if (!_realtime) {
+                advance(clock::now());
+                continue;
+            }
+            clock::time_point now = clock::now();
+            for (uint32_t s = 0; s < _max_catch_up && next <= now; s++) {
+                advance(next);
+                next += period;
+            }
+            now = clock::now();
+            if (next <= now) { // still behind after catching up: skip the backlog
+                const uint64_t behind = (now - next) / period + 1;
+                _dropped.fetch_add(behind, std::memory_order_relaxed);
+                next += behind * period;
+            }
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+public:
+    /**
+     * @param dt simulated seconds per step (for simd::f32_solver, the solver's own dt)
+     * @param realtime pace steps to wall time, or step as fast as possible
+     * @param max_catch_up most steps taken back to back to catch up with wall time
+     */
+    simulation_runner(Engine& engine, float32_t dt, bool realtime = true, uint32_t max_catch_up = 4)
+        : _engine(engine), _dt(dt), _realtime(realtime), _max_catch_up(std::max(1u, max_catch_up)) {
+        runner_detail::capture(_engine, _xs, _ys, _rs); // state before the first step
+        _pxs = _xs;
+        _pys = _ys;
+        _prs = _rs;
+    }
+
+    ~simulation_runner() { stop(); }
+
+    simulation_runner(const simulation_runner&) = delete;
+    simulation_runner& operator=(const simulation_runner&) = delete;
+
+    /**
+     * @param f called on the physics thread after every step, e.g. to spawn particles or
+     *          record; set it before start()
+     */
+    void on_step(std::function<void(Engine&)> f) { _on_step = std::move(f); }
+
+    void start() {
+        if (_running.exchange(true)) {
+            return;
+        }
+        _thread = std::thread(&simulation_runner::loop, this);
+    }
+
+    /**
+     * Stops after the current step; the engine belongs to the caller again afterwards
+     */
+    void stop() {
+        _running.store(false, std::memory_order_relaxed);
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+    }
+
+    bool running() const noexcept { return _running.load(std::memory_order_relaxed); }
+    uint64_t steps() const noexcept { return _steps.load(std::memory_order_relaxed); }
+
+    /**
+     * @return steps skipped because the physics thread fell too far behind wall time
+     */
+    uint64_t dropped() const noexcept { return _dropped.load(std::memory_order_relaxed); }
+
+    /**
+     * The most recently published state, from the consumer thread. Never waits; the frame
+     * stays valid and unchanged until the next call.
+     *
+     * @return null until the first step is published
+     */
+    const state_frame* latest() {
+        _frames.update();
+        return _frames.front().step > 0 ? &_frames.front() : nullptr;
+    }
+};
+
+} // namespace collision_engine
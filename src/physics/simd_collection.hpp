@@ -1,11 +1,21 @@
+#pragma once
+
 #include "common/allocator.hpp"
-#include "arm_neon.h"
+#include "common/handle_table.hpp"
+#include "common/simd.hpp"
+#include <algorithm>
+#include <array>
 #include <vector>
+#include <cstdint>
 #include <cstdlib>
 
 namespace collision_engine::simd {
 
-template <typename T>
+/**
+ * @tparam T type of primitive (e.g. float32_t, uint32_t, etc.)
+ * @tparam D number of dimensions, 2 or 3
+ */
+template <typename T, uint32_t D = 2>
 struct particle {
     T x, y, px, py, r;
 
@@ -14,74 +24,395 @@ struct particle {
 
 } __attribute__((aligned(64)));
 
+template <typename T>
+struct particle<T, 3> {
+    T x, y, z, px, py, pz, r;
+
+    particle(T x, T y, T z, T px, T py, T pz, T r) noexcept : x(x), y(y), z(z), px(px), py(py), pz(pz), r(r) {};
+    ~particle() noexcept = default;
+
+} __attribute__((aligned(64)));
+
+/**
+ * Verlet update of one register of particles along one axis,
+ * x(t + dt) = x(t) + v(t)dt + a(t) * dt^2 with v(t)dt = x(t) - x(t - dt) damped, clamped
+ * to [lo, hi] and written to buffer
+ */
+template <typename V>
+void verlet_update_impl(const float32_t* ps, const float32_t* cs, float32_t* buffer, size_t offset,
+                        float32_t a, float32_t damping, float32_t dt_sq, float32_t lo, float32_t hi) noexcept {
+    using f32 = typename V::f32;
+    using mask = typename V::mask;
+
+    f32 p_reg = V::load(ps + offset);     // prev position register
+    f32 c_reg = V::load(cs + offset);     // current position register
+
+    f32 d_reg = V::sub(c_reg, p_reg);     // position delta/difference register
+    f32 n_reg = V::add(c_reg, d_reg);     // new position register 
+
+    // n_reg is currently x(t) + v(t)dt
+    // the line below adds a(t) * dt^2 to n_reg
+    f32 a_reg = V::fnma(d_reg, V::set1(damping), V::set1(a));
+    n_reg = V::fma(a_reg, V::set1(dt_sq), n_reg);
+
+    // boundary check
+    mask mask_lt = V::lt(n_reg, V::set1(lo));
+    n_reg = V::select(mask_lt, V::set1(lo), n_reg);
+    mask mask_gt = V::gt(n_reg, V::set1(hi)); 
+    n_reg = V::select(mask_gt, V::set1(hi), n_reg);
+
+    V::store(buffer + offset, n_reg); //store into buffer
+}
+
 /**
  * @tparam T type of primitive (e.g. float32_t, uint32_t, etc.)
+ * @tparam D number of dimensions, 2 or 3
  */
-template <typename T>
+template <typename T, uint32_t D = 2>
 struct particle_collection {} __attribute__((aligned(64)));
 
-template <>
-struct particle_collection<float32_t> {
+/**
+ * Particles of a world_width x world_height box, or of a world_width x world_height x
+ * world_depth one in 3D, with gravity along y; every axis is integrated the same way, one
+ * at a time. zs, pzs and z_buffer stay empty in 2D.
+ */
+template <uint32_t D>
+struct particle_collection<float32_t, D> {
+    static_assert(D == 2 || D == 3, "particle_collection is 2D or 3D");
+
 private:
-    static constexpr float32_t  _margin = 4.f; 
+    static constexpr float32_t  _margin             = 4.f; 
+    static constexpr float32_t  _velocity_damping   = 40.f;
 
     const float32_t  _WW; 
     const float32_t  _WH; 
-    const float32x4_t VELOCITY_DAMPING_REG = vdupq_n_f32(40.f);
-    const float32x4_t DT_SQ_REG;
+    const float32_t  _WD; 
+    const float32_t  _dt_sq;
+    isa::level       _isa;
+
+    bool            _sleeping           = false;
+    float32_t       _sleep_threshold_sq = 0;
+    float32_t       _sleep_substeps     = 0;
+
+    handle_table            _handles;
+    simd_vector<float32_t>  _scratch;   // reorder staging
+    simd_vector<uint8_t>    _id_scratch;
+    bool                    _radii_overflow = false;
+
+    /**
+     * @return index of r in the radius table, added if new; 0 with the table marked
+     *         overflowed once it holds max_radii radii
+     */
+    uint8_t radius_id(float32_t r) {
+        const auto it = std::find(radii.begin(), radii.end(), r);
+        if (it != radii.end()) {
+            return static_cast<uint8_t>(it - radii.begin());
+        }
+        if (radii.size() == max_radii) {
+            _radii_overflow = true;
+            return 0;
+        }
+        radii.push_back(r);
+        return static_cast<uint8_t>(radii.size() - 1);
+    }
+
+    /**
+     * @return every float array indexed by particle, except the integration buffers
+     */
+    auto arrays() noexcept {
+        if constexpr (D == 3) {
+            return std::array{&xs, &ys, &zs, &pxs, &pys, &pzs, &rs, &rest, &quiet};
+        } else {
+            return std::array{&xs, &ys, &pxs, &pys, &rs, &rest, &quiet};
+        }
+    }
+
+    auto buffers() noexcept {
+        if constexpr (D == 3) {
+            return std::array{&x_buffer, &y_buffer, &z_buffer};
+        } else {
+            return std::array{&x_buffer, &y_buffer};
+        }
+    }
 
 public:
     float32_t dt;
-    std::vector<float32_t, aligned_allocator<float32_t, 16>> xs; 
-    std::vector<float32_t, aligned_allocator<float32_t, 16>> ys; 
-    std::vector<float32_t, aligned_allocator<float32_t, 16>> pxs; 
-    std::vector<float32_t, aligned_allocator<float32_t, 16>> pys; 
-    std::vector<float32_t, aligned_allocator<float32_t, 16>> x_buffer; 
-    std::vector<float32_t, aligned_allocator<float32_t, 16>> y_buffer; 
-    std::vector<float32_t, aligned_allocator<float32_t, 16>> rs; 
+    simd_vector<float32_t> xs; 
+    simd_vector<float32_t> ys; 
+    simd_vector<float32_t> zs; 
+    simd_vector<float32_t> pxs; 
+    simd_vector<float32_t> pys; 
+    simd_vector<float32_t> pzs; 
+    simd_vector<float32_t> x_buffer; 
+    simd_vector<float32_t> y_buffer; 
+    simd_vector<float32_t> z_buffer; 
+    simd_vector<float32_t> rs; 
+    simd_vector<float32_t> rest;    // consecutive substeps the particle moved less than the sleep threshold
+    simd_vector<float32_t> quiet;   // 1 when no awake particle is in the 3x3 cells around it (set by the solver)
 
-    const float32x4_t ax_reg = vdupq_n_f32(0.f); 
-    const float32x4_t ay_reg = vdupq_n_f32(98.1f); // gravity
+    static constexpr size_t max_radii = 256;
+    std::vector<float32_t> radii;       // distinct radii, for the reduced-precision grids
+    simd_vector<uint8_t>   radius_ids;  // index of each particle's radius in radii, see radii_indexed
 
-    particle_collection(float32_t WW, float32_t WH, float32_t dt) : _WW(WW), _WH(WH), dt(dt), DT_SQ_REG(vdupq_n_f32(dt * dt)) {}
+    const float32_t ax = 0.f; 
+    const float32_t ay = 98.1f; // gravity
+    const float32_t az = 0.f; 
+
+    /**
+     * @param isa_level   instruction set the kernels dispatch to, detected at startup by default
+     */
+    particle_collection(float32_t WW, float32_t WH, float32_t dt, isa::level isa_level = isa::active()) requires (D == 2)
+        : _WW(WW), _WH(WH), _WD(0), _dt_sq(dt * dt), _isa(isa_level), dt(dt) {}
+
+    particle_collection(float32_t WW, float32_t WH, float32_t WD, float32_t dt, isa::level isa_level = isa::active()) requires (D == 3)
+        : _WW(WW), _WH(WH), _WD(WD), _dt_sq(dt * dt), _isa(isa_level), dt(dt) {}
 
     ~particle_collection() {};
     
-    void add(const particle<float32_t>& p) {
+    /**
+     * @return stable handle of the particle, valid across reorder() and remove() until the
+     *         particle itself is removed
+     */
+    uint32_t add(const particle<float32_t, D>& p) {
+        const uint32_t handle = _handles.add();
         xs.push_back(p.x);
         ys.push_back(p.y);
         pxs.push_back(p.px);
         pys.push_back(p.py);
+        if constexpr (D == 3) {
+            zs.push_back(p.z);
+            pzs.push_back(p.pz);
+        }
         rs.push_back(p.r);
-        x_buffer.push_back(0); // fill buffer with dummy data
-        y_buffer.push_back(0);
+        radius_ids.push_back(radius_id(p.r));
+        rest.push_back(0);
+        quiet.push_back(0);
+        for (simd_vector<float32_t>* v : buffers()) {
+            v->push_back(0); // fill buffer with dummy data
+        }
+        return handle;
     }
 
+    /**
+     * Removes the particles of the given handles (stale ones are skipped) in one pass, moving
+     * the last particles into the holes they leave; handles of the others stay valid
+     *
+     * @return number of particles removed
+     */
+    uint32_t remove(const std::vector<uint32_t>& handles) {
+        const size_t n = xs.size();
+        const auto& moves = _handles.remove(handles.data(), handles.size());
+        const size_t m = _handles.size();
+        for (simd_vector<float32_t>* v : arrays()) {
+            for (const auto& [from, to] : moves) {
+                (*v)[to] = (*v)[from];
+            }
+            v->resize(m);
+        }
+        for (const auto& [from, to] : moves) {
+            radius_ids[to] = radius_ids[from];
+        }
+        radius_ids.resize(m);
+        for (simd_vector<float32_t>* v : buffers()) {
+            v->resize(m); // rewritten before they are read
+        }
+        return n - m;
+    }
+
+    uint32_t handle_of(uint32_t index) const noexcept { return _handles.handle_of(index); }
+
+    /**
+     * @return current index of the handle's particle, handle_table::invalid once removed
+     */
+    uint32_t index_of(uint32_t handle) const noexcept { return _handles.index_of(handle); }
+
+    /**
+     * @return slot of the particle at the index: below slot_count() and kept for the
+     *         particle's life, for consumers to key their per-particle state by
+     */
+    uint32_t slot_of(uint32_t index) const noexcept { return _handles.slot_of(index); }
+    const std::vector<uint32_t>& slots() const noexcept { return _handles.slots(); }
+    size_t slot_count() const noexcept { return _handles.slot_count(); }
+    const handle_table& handles() const noexcept { return _handles; }
+    size_t size() const noexcept { return xs.size(); }
+
+    /**
+     * Resizes every array to n particles, e.g. before they are overwritten wholesale by a
+     * snapshot. Added particles are zeroed and every handle starts over at generation 0;
+     * call index_radii() once the radii are written.
+     *
+     * @param slots slot of each index (distinct values), identity when null
+     */
+    void resize(size_t n, const uint32_t* slots = nullptr) {
+        for (simd_vector<float32_t>* v : arrays()) {
+            v->resize(n, 0.f);
+        }
+        for (simd_vector<float32_t>* v : buffers()) {
+            v->resize(n, 0.f);
+        }
+        radius_ids.resize(n, 0);
+        _handles.reset(n, slots);
+    }
+
+    /**
+     * Physically permutes every particle array so index i holds the particle previously at
+     * order[i], keeping handles pointing at the same particles. The integration buffers
+     * are left alone, they are rewritten before they are read.
+     *
+     * @param order permutation of [0, size()) listing old indices in their new order
+     */
+    void reorder(const std::vector<uint32_t>& order) {
+        const size_t n = xs.size();
+        _scratch.resize(n);
+        for (simd_vector<float32_t>* v : arrays()) {
+            for (size_t i = 0; i < n; i++) {
+                _scratch[i] = (*v)[order[i]];
+            }
+            v->swap(_scratch);
+        }
+        _id_scratch.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            _id_scratch[i] = radius_ids[order[i]];
+        }
+        radius_ids.swap(_id_scratch);
+        _handles.permute(order);
+    }
+
+    /**
+     * Rebuilds the radius table from rs, e.g. after rs was overwritten wholesale or after
+     * removals left radii no particle uses
+     */
+    void index_radii() {
+        radii.clear();
+        _radii_overflow = false;
+        for (size_t i = 0; i < rs.size(); i++) {
+            radius_ids[i] = radius_id(rs[i]);
+        }
+    }
+
+    /**
+     * @return whether every particle's radius is radii[radius_ids[i]], i.e. there are at
+     *         most max_radii distinct radii
+     */
+    bool radii_indexed() const noexcept { return !_radii_overflow; }
+
     /**
      * Increments new position of all particles
      */
     void step() {
-        for (size_t offset = 0; offset < xs.size(); offset += 4) {
-            single_dim_verlet_update(pxs.data(), xs.data(), ax_reg, offset, x_buffer.data(), _WW);
+        integrate(0, xs.size());
+        swap_buffers();
+    }
+
+    /**
+     * A particle falls asleep once it moved less than `threshold` pixels per substep for
+     * `substeps` substeps in a row while its neighbourhood is quiet; it then keeps its
+     * position and loses its velocity until it is pushed or an awake neighbour shows up.
+     * Only the 2D solver marks quiet neighbourhoods.
+     */
+    void set_sleeping(bool enabled, float32_t threshold = 0.01f, uint32_t substeps = 60) noexcept {
+        _sleeping = enabled;
+        _sleep_threshold_sq = threshold * threshold;
+        _sleep_substeps = substeps;
+        if (!enabled) {
+            std::fill(rest.begin(), rest.end(), 0.f);
+        }
+    }
+
+    bool sleeping() const noexcept { return _sleeping; }
+
+    /**
+     * @return whether particle i rested long enough to sleep (its neighbours decide whether it does)
+     */
+    bool resting(uint32_t i) const noexcept { return _sleeping && rest[i] >= _sleep_substeps; }
+
+    bool asleep(uint32_t i) const noexcept { return resting(i) && quiet[i] != 0.f; }
+
+    /**
+     * Writes the next position of particles [begin, end) into the buffers. Disjoint ranges
+     * whose `begin` is a multiple of 16 can be integrated concurrently.
+     */
+    void integrate(size_t begin, size_t end) {
+        isa::dispatch(_isa, [=, this]<typename V>() { integrate_impl<V>(begin, end); });
+    }
+
+    template <typename V>
+    void integrate_impl(size_t begin, size_t end) {
+        for (size_t offset = begin; offset < end; offset += V::width) {
+            single_dim_verlet_update_impl<V>(pxs.data(), xs.data(), ax, offset, x_buffer.data(), _WW);
+        }
+        for (size_t offset = begin; offset < end; offset += V::width) {
+            single_dim_verlet_update_impl<V>(pys.data(), ys.data(), ay, offset, y_buffer.data(), _WH); 
+        }
+        if constexpr (D == 3) {
+            for (size_t offset = begin; offset < end; offset += V::width) {
+                single_dim_verlet_update_impl<V>(pzs.data(), zs.data(), az, offset, z_buffer.data(), _WD);
+            }
+        }
+        if (_sleeping) {
+            for (size_t offset = begin; offset < end; offset += V::width) {
+                sleep_update_impl<V>(offset);
+            }
+        }
+    }
+
+    /**
+     * Updates the rest counters of one register of particles and pins the sleeping ones
+     * to their current position (so their velocity becomes zero after the swap)
+     */
+    template <typename V>
+    void sleep_update_impl(size_t offset) {
+        using f32 = typename V::f32;
+        using mask = typename V::mask;
+
+        const f32 c_x = V::load(xs.data() + offset);
+        const f32 c_y = V::load(ys.data() + offset);
+        const f32 d_x = V::sub(c_x, V::load(pxs.data() + offset));
+        const f32 d_y = V::sub(c_y, V::load(pys.data() + offset));
+        f32 moved_sq = V::fma(d_x, d_x, V::mul(d_y, d_y));
+        if constexpr (D == 3) {
+            const f32 d_z = V::sub(V::load(zs.data() + offset), V::load(pzs.data() + offset));
+            moved_sq = V::fma(d_z, d_z, moved_sq);
         }
-        for (size_t offset = 0; offset < ys.size(); offset += 4) {
-            single_dim_verlet_update(pys.data(), ys.data(), ay_reg, offset, y_buffer.data(), _WH); 
+        const mask calm = V::lt(moved_sq, V::set1(_sleep_threshold_sq));
+
+        const f32 limit = V::set1(_sleep_substeps);
+        f32 r = V::add(V::load(rest.data() + offset), V::set1(1.f));
+        r = V::select(V::gt(r, limit), limit, r);
+        r = V::select(calm, r, V::set1(0.f));
+        V::store(rest.data() + offset, r);
+
+        const mask asleep = V::mask_and(
+            V::mask_and(calm, V::mask_not(V::lt(r, limit))), V::gt(V::load(quiet.data() + offset), V::set1(0.5f)));
+        V::store(x_buffer.data() + offset, V::select(asleep, c_x, V::load(x_buffer.data() + offset)));
+        V::store(y_buffer.data() + offset, V::select(asleep, c_y, V::load(y_buffer.data() + offset)));
+        if constexpr (D == 3) {
+            V::store(z_buffer.data() + offset, V::select(asleep, V::load(zs.data() + offset), V::load(z_buffer.data() + offset)));
         }
-        // update previous and current positions with buffer
-        // (cycles around 3 buffers)
-        std::vector<float32_t, aligned_allocator<float32_t, 16>> temp_buffer_x = std::move(pxs); 
-        pxs = std::move(xs); 
-        xs = std::move(x_buffer); 
-        x_buffer = std::move(temp_buffer_x); 
+    }
 
-        std::vector<float32_t, aligned_allocator<float32_t, 16>> temp_buffer_y = std::move(pys);
-        pys = std::move(ys);
-        ys = std::move(y_buffer);
-        y_buffer = std::move(temp_buffer_y); 
+    /**
+     * Update previous and current positions with buffer once every range is integrated
+     * (cycles around 3 buffers)
+     */
+    void swap_buffers() noexcept {
+        auto cycle = [](simd_vector<float32_t>& p, simd_vector<float32_t>& c, simd_vector<float32_t>& buffer) {
+            simd_vector<float32_t> temp = std::move(p);
+            p = std::move(c);
+            c = std::move(buffer);
+            buffer = std::move(temp);
+        };
+        cycle(pxs, xs, x_buffer);
+        cycle(pys, ys, y_buffer);
+        if constexpr (D == 3) {
+            cycle(pzs, zs, z_buffer);
+        }
     }
 
+    isa::level isa_level() const noexcept { return _isa; }
+
     /**
-     * Perform updates for a single set of float32x4_t register 
+     * Perform updates for a single SIMD register (V::width particles)
      * for a single dimension (i.e. either x or y if its 2D) to be called
      * repeatedly within step(float32_t dt). 
      *
@@ -90,32 +421,22 @@ public:
      *
      * @param ps        previous position of particles
      * @param cs        current position of particles
+     * @param a         acceleration along this dimension
      * @param offset    offset to location in memory
      */
     void single_dim_verlet_update(
-            float32_t* ps, float32_t* cs, float32x4_t a_reg, size_t offset, float32_t* buffer, uint32_t world_size) {
-        float32x4_t p_reg = vld1q_f32(ps + offset);     // prev position register
-        float32x4_t c_reg = vld1q_f32(cs + offset);     // current position register
-
-        float32x4_t d_reg = vsubq_f32(c_reg, p_reg);    // position delta/difference register
-        float32x4_t n_reg = vaddq_f32(c_reg, d_reg);    // new position register 
-
-        // n_reg is currently x(t) + v(t)dt
-        // the line below adds a(t) * dt^2 to n_reg
-        n_reg = vaddq_f32(n_reg, vmulq_f32(vsubq_f32(a_reg, vmulq_f32(d_reg, VELOCITY_DAMPING_REG)), DT_SQ_REG));
-
-        // boundary check
-        uint32x4_t mask_lt = vcltq_f32(n_reg, vdupq_n_f32(_margin));
-        n_reg = vbslq_f32(mask_lt, vdupq_n_f32(_margin), n_reg);
-        uint32x4_t mask_gt = vcgtq_f32(n_reg, vdupq_n_f32(world_size - _margin)); 
-        n_reg = vbslq_f32(mask_gt, vdupq_n_f32(world_size - _margin), n_reg);
+            float32_t* ps, float32_t* cs, float32_t a, size_t offset, float32_t* buffer, uint32_t world_size) {
+        isa::dispatch(_isa, [&]<typename V>() { single_dim_verlet_update_impl<V>(ps, cs, a, offset, buffer, world_size); });
+    }
 
-        vst1q_f32(buffer + offset, n_reg); //store into buffer
+    template <typename V>
+    void single_dim_verlet_update_impl(
+            float32_t* ps, float32_t* cs, float32_t a, size_t offset, float32_t* buffer, uint32_t world_size) {
+        verlet_update_impl<V>(ps, cs, buffer, offset, a, _velocity_damping, _dt_sq, _margin, world_size - _margin);
     }
 
 } __attribute__((aligned(64)));
 
-
 } // namespace collision_engine
 
 
@@ -1,109 +1,748 @@
 #pragma once
 
 #include "simd_collection.hpp"
-#include "arm_neon.h"
+#include "grid_levels.hpp"
+#include "spatial_hash.hpp"
+#include "sweep_and_prune.hpp"
+#include "common/allocator.hpp"
+#include "common/simd.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
 namespace collision_engine::simd {
 
+/**
+ * Non-owning view of one cell's contiguous range inside the grid's flat arrays
+ */
 template <typename T>
 struct cell {
-    cell() = default;
-   
-    size_t size;
-    std::vector<uint32_t> ids;
-    std::vector<T> xs, ys, rs; // temporary expendable storage
-    
+    size_t      size;
+    uint32_t*   ids;
+    T*          xs;
+    T*          ys;
+    T*          rs; // temporary expendable storage
+
     /**
      * Update the particle collection with current cell data
-     *  
-     * @param pc collection of particle 
+     *
+     * @param pc collection of particle
      */
     void load_to_collection(particle_collection<T>& pc) noexcept {
+        if (size == 0) return;
+        // ids within a cell are increasing, so equal spans mean one contiguous range
+        // (always the case right after a reorder into cell order)
+        if (ids[size - 1] - ids[0] == size - 1) {
+            std::memcpy(pc.xs.data() + ids[0], xs, size * sizeof(T));
+            std::memcpy(pc.ys.data() + ids[0], ys, size * sizeof(T));
+            return;
+        }
         for(uint32_t i = 0; i < size; i++) {
             uint32_t id = ids[i];
             pc.xs[id] = xs[i];
             pc.ys[id] = ys[i];
         }
     }
+};
 
-    /**
-     * Add (the state of) a particle to the cell
-     *
-     * @param id    index of the particle in the main particle collection
-     * @param x     x-coordinate of the particle
-     * @param y     y-coordinate of the particle
-     * @param r     radius of particle
-     */
-    void add(uint32_t id, T x, T y, T r) {
-        ids.push_back(id);
-        xs.push_back(x);
-        ys.push_back(y);
-        rs.push_back(r);
-        ++size;
-    }
+/**
+ * How a grid maps a position to its cell
+ */
+enum class binning {
+    reciprocal, // multiply by the reciprocal cell size, any cell size
+    shift,      // shift by log2 of the cell size, power of 2 cell sizes only
+};
+
+/**
+ * How a grid stores the per-slot state its collision kernels stream
+ */
+enum class precision : uint8_t {
+    f32,        // xs, ys, rs: 12 bytes per slot
+    fixed16,    // qs, 16-bit fixed-point x and y, and rids into the collection's radius
+                // table: 5 bytes per slot
 };
 
 /**
+ * Uniform grid stored CSR-style: particles are counting-sorted by cell into flat
+ * `xs/ys/rs/ids` arrays and each cell owns the range [offsets[c], offsets[c + 1]).
+ * The cells are surrounded by a one-cell ring of permanently empty sentinels, so
+ * any 3x3 neighbourhood of a real cell is addressable without bounds checks.
+ * Rows split the world height (y), columns its width (x).
+ *
+ * With precision::fixed16 the slots hold fixed-point positions at a power of 2 scale(),
+ * modulo 2^16 and packed into one 32-bit word so the kernels load and store them like ids,
+ * and the radius as an 8-bit index into particle_collection::radii; xs/ys/rs stay empty.
+ * The 16-bit difference of two positions wraps around to their exact offset as long as
+ * they are less than range() apart, at least four cells, so the kernels only widen offsets
+ * to f32 and never need absolute positions. The collection keeps the full precision
+ * positions and only takes the quantized corrections back, see store_to_collection.
+ *
  * @tparam T    primitive data type of the grid
- * @tparam WH   world height in pixels (must be power of 2)
- * @tparam WW   world width in pixels (must be power of 2)
- * @tparam R    number of rows 
- * @tparam C    number of cols
+ * @tparam B    binning::shift is the fast path for power of 2 cell sizes
+ * @tparam D    number of dimensions, the 3D grid is specialized below
  */
-template <typename T, uint32_t WH, uint32_t WW, uint32_t R, uint32_t C>
+template <typename T, binning B = binning::reciprocal, uint32_t D = 2>
 struct grid {
 private:
-    constexpr bool is_power_of_2(uint32_t n) { return (n > 0) && ((n & (n - 1)) == 0); }
-    constexpr uint32_t log2_constexpr(uint32_t n) { return (n > 1) ? 1 + log2_constexpr(n >> 1) : 0; }
-    uint32_t  _cell_height_log2;
-    uint32_t  _cell_width_log2;
+    static constexpr bool is_power_of_2(uint32_t n) { return (n > 0) && ((n & (n - 1)) == 0); }
+    static constexpr uint32_t log2_constexpr(uint32_t n) { return (n > 1) ? 1 + log2_constexpr(n >> 1) : 0; }
+
+    float32_t _inv_cell_width   = 0;    // binning::reciprocal
+    float32_t _inv_cell_height  = 0;
+    uint32_t  _cell_width_log2  = 0;    // binning::shift
+    uint32_t  _cell_height_log2 = 0;
+    float32_t _cell_width       = 0;
+    float32_t _cell_height      = 0;
+    float32_t _scale            = 1;    // precision::fixed16 units per pixel
+    float32_t _inv_scale        = 1;
+    simd::precision _precision  = simd::precision::f32;
+
+    /**
+     * Writes particle idx into the slot of the current arrays, or of the
+     * next ones during update()
+     */
+    void write_slot(const particle_collection<T>& pc, uint32_t idx, uint32_t slot, bool next) noexcept {
+        (next ? _next_ids : ids)[slot] = idx;
+        if (_precision == simd::precision::fixed16) {
+            (next ? _next_qs : qs)[slot] = pack(quantize(pc.xs[idx]), quantize(pc.ys[idx]));
+            (next ? _next_rids : rids)[slot] = pc.radius_ids[idx];
+        } else {
+            (next ? _next_xs : xs)[slot] = pc.xs[idx];
+            (next ? _next_ys : ys)[slot] = pc.ys[idx];
+            (next ? _next_rs : rs)[slot] = pc.rs[idx];
+        }
+    }
+
+    /**
+     * Resizes the state arrays of the grid's precision to n slots, the others to none; rids
+     * gets rid_padding more, so a kernel can read a full register of indices from any slot
+     */
+    void resize_slots(uint32_t n, bool next) {
+        const uint32_t f = _precision == simd::precision::f32 ? n : 0;
+        const uint32_t q = n - f;
+        (next ? _next_ids : ids).resize(n);
+        (next ? _next_xs : xs).resize(f);
+        (next ? _next_ys : ys).resize(f);
+        (next ? _next_rs : rs).resize(f);
+        (next ? _next_qs : qs).resize(q);
+        (next ? _next_rids : rids).resize(q ? q + rid_padding : 0);
+    }
+
+public:
+    uint32_t rows       = 0;
+    uint32_t cols       = 0;
+    uint32_t stride     = 0;    // row pitch including the sentinel border
+    uint32_t cell_count = 0;    // cells including the sentinel border
 
-#define STATIC_ASSERT_POWER_OF_2(n) static_assert(is_power_of_2(n), "Number is not a power of 2");
+    /**
+     * @param world_width, world_height extent of the world in pixels
+     * @param rows, cols number of cells along each axis
+     */
+    grid(uint32_t world_width, uint32_t world_height, uint32_t rows, uint32_t cols) {
+        resize(world_width, world_height, rows, cols);
+    }
+
+    /**
+     * Changes the cell layout and empties the grid; the next update() repopulates it
+     *
+     * @throws std::invalid_argument for binning::shift when a cell is not a power of 2
+     *         pixels wide and high
+     */
+    void resize(uint32_t world_width, uint32_t world_height, uint32_t rows, uint32_t cols) {
+        this->rows = std::max(1u, rows);
+        this->cols = std::max(1u, cols);
+        if constexpr (B == binning::shift) {
+            if (world_width % this->cols || world_height % this->rows
+                || !is_power_of_2(world_width / this->cols) || !is_power_of_2(world_height / this->rows)) {
+                throw std::invalid_argument("grid: shift binning needs power of 2 cell sizes");
+            }
+            _cell_width_log2 = log2_constexpr(world_width / this->cols);
+            _cell_height_log2 = log2_constexpr(world_height / this->rows);
+        } else {
+            _inv_cell_width = static_cast<float32_t>(this->cols) / world_width;
+            _inv_cell_height = static_cast<float32_t>(this->rows) / world_height;
+        }
+        _cell_width = static_cast<float32_t>(world_width) / this->cols;
+        _cell_height = static_cast<float32_t>(world_height) / this->rows;
+        // the largest power of 2 keeping at least 4 cells in range(), so scaling is exact
+        _scale = std::ldexp(1.f, std::ilogb(8191.f / std::max(_cell_width, _cell_height)));
+        _inv_scale = 1.f / _scale;
+        stride = this->cols + 2;
+        cell_count = (this->rows + 2) * stride;
+
+        _offsets.assign(cell_count + 1, 0);
+        _next_offsets.assign(cell_count + 1, 0);
+        _cursor.assign(cell_count, 0);
+        _particle_cells.clear();
+        resize_slots(0, false);
+    }
+
+    /**
+     * Switches the per-slot storage; the grid is empty until the next populate() or update()
+     */
+    void set_precision(simd::precision p) {
+        if (p != _precision) {
+            _precision = p;
+            resize_slots(0, false);
+        }
+    }
 
-public:             
-    constexpr grid() noexcept {
-        // STATIC_ASSERT_POWER_OF_2(WH); 
-        // STATIC_ASSERT_POWER_OF_2(WW);
-        // STATIC_ASSERT_POWER_OF_2(R); 
-        // STATIC_ASSERT_POWER_OF_2(C);
-        
-        _cell_height_log2 = log2_constexpr(WH / R);   // log_2(pixel height) of each cell
-        _cell_width_log2 = log2_constexpr(WW / C);    // log_2(pixel width) of each cell
+    simd::precision precision() const noexcept { return _precision; }
 
-        _cells.assign(R * C, cell<T>());
+    /**
+     * @return bytes of per-slot state the collision kernels read and write
+     */
+    uint32_t slot_bytes() const noexcept {
+        return _precision == simd::precision::fixed16 ? sizeof(uint32_t) + sizeof(uint8_t) : 3 * sizeof(T);
     }
-    
+
     /**
-     * Populate the grid with particles
+     * Populate the grid with particles: one histogram pass, an exclusive prefix
+     * sum over the counts, then a scatter into the flat arrays. Storage is reused
+     * across calls, so steady-state rebuilds do not allocate.
      *
      * @param pc collection of particle to populate the grid
      */
-    constexpr void populate(particle_collection<T>& pc) {
-        _cells.clear();
-        _cells.assign(R * C, cell<T>());
-        for (uint32_t idx = 0; idx < pc.xs.size(); idx++) {
+    void populate(particle_collection<T>& pc) { bin<false>(pc, nullptr, pc.xs.size()); }
+
+    /**
+     * Populates the grid with only the given particles, e.g. the ones of one level of a
+     * hierarchical_grid. update() does not track subsets, it repopulates with every particle.
+     */
+    void populate(particle_collection<T>& pc, const std::vector<uint32_t>& members) {
+        bin<true>(pc, members.data(), members.size());
+    }
+
+    template <bool Subset>
+    void bin(particle_collection<T>& pc, const uint32_t* members, uint32_t n) {
+        _migrations = n;
+        _particle_cells.resize(pc.xs.size());
+        resize_slots(n, false);
+
+        // histogram, shifted by one so the scan below yields exclusive offsets
+        std::fill(_offsets.begin(), _offsets.end(), 0);
+        for (uint32_t k = 0; k < n; k++) {
+            const uint32_t idx = Subset ? members[k] : k;
             uint32_t cell_id = get_cell_id(pc.xs[idx], pc.ys[idx]);
-            _cells[cell_id].add(idx, pc.xs[idx], pc.ys[idx], pc.rs[idx]);
+            _particle_cells[idx] = cell_id;
+            ++_offsets[cell_id + 1];
+        }
+        for (uint32_t cell_id = 1; cell_id <= cell_count; cell_id++) {
+            _offsets[cell_id] += _offsets[cell_id - 1];
+        }
+
+        std::copy(_offsets.begin(), _offsets.end() - 1, _cursor.begin());
+        for (uint32_t k = 0; k < n; k++) {
+            const uint32_t idx = Subset ? members[k] : k;
+            const uint32_t cell_id = _particle_cells[idx];
+            write_slot(pc, idx, _cursor[cell_id]++, false);
+        }
+        std::fill(_cursor.begin(), _cursor.end(), 0); // update() accumulates size changes here
+    }
+
+    /**
+     * Incremental alternative to populate(): compares every particle's cell with the one
+     * it was binned in and only moves the particles whose cell changed. Survivors and the
+     * sorted migrants are merged into every cell in one sequential pass, yielding exactly
+     * the layout populate() would. Falls back to populate() when the particle count
+     * changed or more than `rebuild_fraction` of the particles migrated.
+     *
+     * @param pc collection of particle the grid was populated from
+     */
+    void update(particle_collection<T>& pc) {
+        const uint32_t n = pc.xs.size();
+        if (n != ids.size()) {
+            populate(pc);
+            return;
+        }
+
+        _migrants.clear();
+        for (uint32_t idx = 0; idx < n; idx++) {
+            const uint32_t cell_id = get_cell_id(pc.xs[idx], pc.ys[idx]);
+            if (cell_id != _particle_cells[idx]) {
+                _migrants.emplace_back(cell_id, idx);
+                --_cursor[_particle_cells[idx]];
+                ++_cursor[cell_id];
+                _particle_cells[idx] = cell_id;
+            }
+        }
+        _migrations = _migrants.size();
+        if (_migrants.empty()) {
+            if (_precision == simd::precision::fixed16) {
+                for (uint32_t slot = 0; slot < n; slot++) {
+                    write_slot(pc, ids[slot], slot, false);
+                }
+                return;
+            }
+            for (uint32_t slot = 0; slot < n; slot++) {
+                xs[slot] = pc.xs[ids[slot]];
+                ys[slot] = pc.ys[ids[slot]];
+            }
+            return;
+        }
+        if (_migrants.size() > rebuild_fraction * n) {
+            populate(pc);
+            _migrations = _migrants.size();
+            return;
+        }
+
+        // _cursor holds the per-cell size change, turn it into the new offsets
+        std::sort(_migrants.begin(), _migrants.end());
+        _next_offsets[0] = 0;
+        for (uint32_t cell_id = 0; cell_id < cell_count; cell_id++) {
+            const int32_t size = static_cast<int32_t>(cell_size(cell_id)) + static_cast<int32_t>(_cursor[cell_id]);
+            _next_offsets[cell_id + 1] = _next_offsets[cell_id] + size;
+            _cursor[cell_id] = 0;
+        }
+
+        resize_slots(n, true);
+        // survivors and migrants are both sorted by particle index; merging them keeps every
+        // cell in the exact order populate() would produce
+        auto migrant = _migrants.begin();
+        for (uint32_t cell_id = 0; cell_id < cell_count; cell_id++) {
+            uint32_t dst = _next_offsets[cell_id];
+            for (uint32_t slot = _offsets[cell_id]; slot < _offsets[cell_id + 1]; slot++) {
+                if (_particle_cells[ids[slot]] != cell_id) continue;
+                for (; migrant != _migrants.end() && migrant->first == cell_id && migrant->second < ids[slot]; ++migrant) {
+                    write_slot(pc, migrant->second, dst++, true);
+                }
+                write_slot(pc, ids[slot], dst++, true);
+            }
+            for (; migrant != _migrants.end() && migrant->first == cell_id; ++migrant) {
+                write_slot(pc, migrant->second, dst++, true);
+            }
+        }
+        ids.swap(_next_ids);
+        xs.swap(_next_xs);
+        ys.swap(_next_ys);
+        rs.swap(_next_rs);
+        qs.swap(_next_qs);
+        rids.swap(_next_rids);
+        _offsets.swap(_next_offsets);
+    }
+
+    /**
+     * Renames every particle index after the collection was permuted
+     *
+     * @param rank new index of each old particle index
+     */
+    void renumber(const std::vector<uint32_t>& rank) {
+        for (uint32_t slot = 0; slot < ids.size(); slot++) {
+            ids[slot] = rank[ids[slot]];
+        }
+        for (uint32_t cell_id = 0; cell_id < cell_count; cell_id++) {
+            for (uint32_t slot = _offsets[cell_id]; slot < _offsets[cell_id + 1]; slot++) {
+                _particle_cells[ids[slot]] = cell_id;
+            }
+        }
+    }
+
+    /**
+     * @return number of particles that changed cell in the last populate() / update()
+     *         (a full populate counts every particle)
+     */
+    uint32_t migrations() const noexcept { return _migrations; }
+
+    /**
+     * @return index of the (bordered) cell containing pixel (i, j)
+     */
+    uint32_t get_cell_id(float32_t i, float32_t j) const noexcept {
+        uint32_t col, row;
+        if constexpr (B == binning::shift) {
+            col = static_cast<uint32_t>(std::max(i, 0.f)) >> _cell_width_log2;
+            row = static_cast<uint32_t>(std::max(j, 0.f)) >> _cell_height_log2;
+        } else {
+            col = static_cast<uint32_t>(std::max(i, 0.f) * _inv_cell_width);
+            row = static_cast<uint32_t>(std::max(j, 0.f) * _inv_cell_height);
+        }
+        if (col >= cols) { col = cols - 1; }
+        if (row >= rows) { row = rows - 1; }
+        return (row + 1) * stride + (col + 1);
+    }
+
+    /**
+     * Calls f(first_cell, end_cell) for every row of cells overlapping the square of half
+     * side `reach` around pixel (i, j); the cells of a row, like their slots, are adjacent
+     */
+    template <typename F>
+    void for_each_cell_row(float32_t i, float32_t j, float32_t reach, F f) const {
+        const uint32_t first = get_cell_id(i - reach, j - reach);
+        const uint32_t last = get_cell_id(i + reach, j + reach);
+        const uint32_t width = last % stride - first % stride + 1;
+        for (uint32_t row_first = first; row_first <= last; row_first += stride) {
+            f(row_first, row_first + width);
+        }
+    }
+
+    /**
+     * @return top left corner of a cell
+     */
+    float32_t cell_x(uint32_t cell_id) const noexcept { return static_cast<float32_t>(static_cast<int32_t>(cell_id % stride) - 1) * _cell_width; }
+    float32_t cell_y(uint32_t cell_id) const noexcept { return static_cast<float32_t>(static_cast<int32_t>(cell_id / stride) - 1) * _cell_height; }
+    float32_t cell_width() const noexcept { return _cell_width; }
+    float32_t cell_height() const noexcept { return _cell_height; }
+
+    /**
+     * @return precision::fixed16 units per pixel
+     */
+    float32_t scale() const noexcept { return _scale; }
+    float32_t inv_scale() const noexcept { return _inv_scale; }
+
+    /**
+     * @return distance below which precision::fixed16 offsets are exact
+     */
+    float32_t range() const noexcept { return 32768 * _inv_scale; }
+
+    /**
+     * @return v pixels in precision::fixed16 units, rounded to nearest, modulo 2^16
+     */
+    uint16_t quantize(float32_t v) const noexcept { return static_cast<uint16_t>(std::lrint(v * _scale)); }
+
+    /**
+     * @return precision::fixed16 position with x in the low 16 bits and y in the high ones
+     */
+    static uint32_t pack(uint16_t x, uint16_t y) noexcept { return x | static_cast<uint32_t>(y) << 16; }
+    static uint16_t qx(uint32_t q) noexcept { return q & 0xFFFF; }
+    static uint16_t qy(uint32_t q) noexcept { return q >> 16; }
+
+    /**
+     * @return offset from precision::fixed16 coordinate b to a, in units
+     */
+    static int16_t offset(uint16_t a, uint16_t b) noexcept { return static_cast<int16_t>(a - b); }
+
+    /**
+     * @return the cell's slots; its positions and radii only with precision::f32
+     */
+    cell<T> get_cell(uint32_t cell_id) noexcept {
+        const uint32_t begin = _offsets[cell_id];
+        return cell<T>{_offsets[cell_id + 1] - begin, ids.data() + begin, xs.data() + begin, ys.data() + begin, rs.data() + begin};
+    }
+
+    size_t cell_size(uint32_t cell_id) const noexcept { return _offsets[cell_id + 1] - _offsets[cell_id]; }
+
+    /**
+     * @return first slot of a cell; the cells of one row are adjacent, so
+     *         [cell_begin(c), cell_begin(c + k)) spans k neighbouring cells
+     */
+    uint32_t cell_begin(uint32_t cell_id) const noexcept { return _offsets[cell_id]; }
+
+    /**
+     * Copies the positions held in slots [begin, end) back into the particle collection.
+     * With precision::fixed16 only the change of the quantized position is added, so a
+     * particle nothing pushed keeps its exact position.
+     */
+    void store_to_collection(particle_collection<T>& pc, uint32_t begin, uint32_t end) const noexcept {
+        if (_precision == simd::precision::fixed16) {
+            for (uint32_t slot = begin; slot < end; slot++) {
+                const uint32_t idx = ids[slot];
+                pc.xs[idx] += offset(qx(qs[slot]), quantize(pc.xs[idx])) * _inv_scale;
+                pc.ys[idx] += offset(qy(qs[slot]), quantize(pc.ys[idx])) * _inv_scale;
+            }
+            return;
+        }
+        for (uint32_t slot = begin; slot < end; slot++) {
+            pc.xs[ids[slot]] = xs[slot];
+            pc.ys[ids[slot]] = ys[slot];
+        }
+    }
+
+    simd_vector<uint32_t>   ids;        // particle index per slot, grouped by cell
+    simd_vector<T>          xs, ys, rs; // particle state per slot, grouped by cell
+    simd_vector<uint32_t>   qs;         // precision::fixed16 position per slot modulo 2^16 units, see pack
+    simd_vector<uint8_t>    rids;       // precision::fixed16 index into particle_collection::radii
+
+    static constexpr uint32_t rid_padding = 64;
+
+    float32_t               rebuild_fraction = 0.1f; // update() migration share above which it repopulates
+
+private:
+    std::vector<uint32_t>   _offsets;           // exclusive prefix sum of cell counts (cell_count + 1 entries)
+    std::vector<uint32_t>   _cursor;            // per-cell write position during the scatter / size change during update()
+    std::vector<uint32_t>   _particle_cells;    // current cell id of each particle
+
+    // incremental update state
+    std::vector<std::pair<uint32_t, uint32_t>>  _migrants;  // (new cell id, particle index)
+    std::vector<uint32_t>                       _next_offsets;
+    simd_vector<uint32_t>                       _next_ids;
+    simd_vector<T>                              _next_xs, _next_ys, _next_rs;
+    simd_vector<uint32_t>                       _next_qs;
+    simd_vector<uint8_t>                        _next_rids;
+    uint32_t                                    _migrations = 0;
+};
+
+/**
+ * 3D uniform grid, laid out like the 2D one: cells are numbered column first, then row,
+ * then layer, so the cells of one row stay adjacent in the flat arrays, and a one-cell
+ * sentinel border surrounds them on all six sides. Layers split the world depth (z).
+ * Only full rebuilds with precision::f32 storage; no subsets, update() or renumber().
+ */
+template <typename T, binning B>
+struct grid<T, B, 3> {
+private:
+    static constexpr bool is_power_of_2(uint32_t n) { return (n > 0) && ((n & (n - 1)) == 0); }
+    static constexpr uint32_t log2_constexpr(uint32_t n) { return (n > 1) ? 1 + log2_constexpr(n >> 1) : 0; }
+
+    float32_t _inv_cell_width   = 0;    // binning::reciprocal
+    float32_t _inv_cell_height  = 0;
+    float32_t _inv_cell_depth   = 0;
+    uint32_t  _cell_width_log2  = 0;    // binning::shift
+    uint32_t  _cell_height_log2 = 0;
+    uint32_t  _cell_depth_log2  = 0;
+
+public:
+    uint32_t rows       = 0;
+    uint32_t cols       = 0;
+    uint32_t layers     = 0;
+    uint32_t stride     = 0;    // row pitch including the sentinel border
+    uint32_t plane      = 0;    // layer pitch including the sentinel border
+    uint32_t cell_count = 0;    // cells including the sentinel border
+
+    /**
+     * @param world_width, world_height, world_depth extent of the world in pixels
+     * @param rows, cols, layers number of cells along y, x and z
+     */
+    grid(uint32_t world_width, uint32_t world_height, uint32_t world_depth, uint32_t rows, uint32_t cols, uint32_t layers) {
+        resize(world_width, world_height, world_depth, rows, cols, layers);
+    }
+
+    /**
+     * Changes the cell layout and empties the grid
+     *
+     * @throws std::invalid_argument for binning::shift when a cell is not a power of 2
+     *         pixels along every axis
+     */
+    void resize(uint32_t world_width, uint32_t world_height, uint32_t world_depth, uint32_t rows, uint32_t cols, uint32_t layers) {
+        this->rows = std::max(1u, rows);
+        this->cols = std::max(1u, cols);
+        this->layers = std::max(1u, layers);
+        if constexpr (B == binning::shift) {
+            if (world_width % this->cols || world_height % this->rows || world_depth % this->layers
+                || !is_power_of_2(world_width / this->cols) || !is_power_of_2(world_height / this->rows)
+                || !is_power_of_2(world_depth / this->layers)) {
+                throw std::invalid_argument("grid: shift binning needs power of 2 cell sizes");
+            }
+            _cell_width_log2 = log2_constexpr(world_width / this->cols);
+            _cell_height_log2 = log2_constexpr(world_height / this->rows);
+            _cell_depth_log2 = log2_constexpr(world_depth / this->layers);
+        } else {
+            _inv_cell_width = static_cast<float32_t>(this->cols) / world_width;
+            _inv_cell_height = static_cast<float32_t>(this->rows) / world_height;
+            _inv_cell_depth = static_cast<float32_t>(this->layers) / world_depth;
+        }
+        stride = this->cols + 2;
+        plane = (this->rows + 2) * stride;
+        cell_count = (this->layers + 2) * plane;
+
+        _offsets.assign(cell_count + 1, 0);
+        _cursor.assign(cell_count, 0);
+        _particle_cells.clear();
+        ids.clear();
+        xs.clear();
+        ys.clear();
+        zs.clear();
+        rs.clear();
+    }
+
+    /**
+     * Populates the grid with every particle, see grid<T>::populate
+     */
+    void populate(particle_collection<T, 3>& pc) {
+        const uint32_t n = pc.xs.size();
+        _particle_cells.resize(n);
+        ids.resize(n);
+        xs.resize(n);
+        ys.resize(n);
+        zs.resize(n);
+        rs.resize(n);
+
+        // histogram, shifted by one so the scan below yields exclusive offsets
+        std::fill(_offsets.begin(), _offsets.end(), 0);
+        for (uint32_t idx = 0; idx < n; idx++) {
+            const uint32_t cell_id = get_cell_id(pc.xs[idx], pc.ys[idx], pc.zs[idx]);
+            _particle_cells[idx] = cell_id;
+            ++_offsets[cell_id + 1];
+        }
+        for (uint32_t cell_id = 1; cell_id <= cell_count; cell_id++) {
+            _offsets[cell_id] += _offsets[cell_id - 1];
+        }
+
+        std::copy(_offsets.begin(), _offsets.end() - 1, _cursor.begin());
+        for (uint32_t idx = 0; idx < n; idx++) {
+            const uint32_t slot = _cursor[_particle_cells[idx]]++;
+            ids[slot] = idx;
+            xs[slot] = pc.xs[idx];
+            ys[slot] = pc.ys[idx];
+            zs[slot] = pc.zs[idx];
+            rs[slot] = pc.rs[idx];
         }
     }
 
-    constexpr uint32_t get_cell_id(float32_t i, float32_t j) const noexcept {
-        uint32_t i_cell = static_cast<uint32_t>(i) >> _cell_height_log2;
-        uint32_t j_cell = static_cast<uint32_t>(j) >> _cell_width_log2;
-        if (i_cell == R) { i_cell--; }
-        if (j_cell == C) { j_cell--; }
-        return i_cell * C + j_cell;
+    /**
+     * @return index of the (bordered) cell containing pixel (i, j, k)
+     */
+    uint32_t get_cell_id(float32_t i, float32_t j, float32_t k) const noexcept {
+        uint32_t col, row, layer;
+        if constexpr (B == binning::shift) {
+            col = static_cast<uint32_t>(std::max(i, 0.f)) >> _cell_width_log2;
+            row = static_cast<uint32_t>(std::max(j, 0.f)) >> _cell_height_log2;
+            layer = static_cast<uint32_t>(std::max(k, 0.f)) >> _cell_depth_log2;
+        } else {
+            col = static_cast<uint32_t>(std::max(i, 0.f) * _inv_cell_width);
+            row = static_cast<uint32_t>(std::max(j, 0.f) * _inv_cell_height);
+            layer = static_cast<uint32_t>(std::max(k, 0.f) * _inv_cell_depth);
+        }
+        if (col >= cols) { col = cols - 1; }
+        if (row >= rows) { row = rows - 1; }
+        if (layer >= layers) { layer = layers - 1; }
+        return (layer + 1) * plane + (row + 1) * stride + (col + 1);
     }
 
-    bool is_valid_cell(uint32_t cell_id) const noexcept { return (cell_id >= 0 && cell_id < R * C); }
+    size_t cell_size(uint32_t cell_id) const noexcept { return _offsets[cell_id + 1] - _offsets[cell_id]; }
+
+    /**
+     * @return first slot of a cell; [cell_begin(c), cell_begin(c + k)) spans k neighbouring
+     *         cells of one row
+     */
+    uint32_t cell_begin(uint32_t cell_id) const noexcept { return _offsets[cell_id]; }
+
+    /**
+     * Copies the positions held in slots [begin, end) back into the particle collection
+     */
+    void store_to_collection(particle_collection<T, 3>& pc, uint32_t begin, uint32_t end) const noexcept {
+        for (uint32_t slot = begin; slot < end; slot++) {
+            pc.xs[ids[slot]] = xs[slot];
+            pc.ys[ids[slot]] = ys[slot];
+            pc.zs[ids[slot]] = zs[slot];
+        }
+    }
 
-    cell<T>& get_cell(uint32_t cell_id) noexcept { return _cells[cell_id]; }
+    simd_vector<uint32_t>   ids;            // particle index per slot, grouped by cell
+    simd_vector<T>          xs, ys, zs, rs; // particle state per slot, grouped by cell
 
 private:
-    std::vector<cell<T>> _cells;
+    std::vector<uint32_t>   _offsets;           // exclusive prefix sum of cell counts (cell_count + 1 entries)
+    std::vector<uint32_t>   _cursor;            // scatter cursors
+    std::vector<uint32_t>   _particle_cells;    // cell of every particle
 };
 
-} // namespace collision engine
+/**
+ * @brief CSR grids of doubling cell size over one world, for particles of very different
+ * radii: each level holds the particles whose diameter its cells fit (see grid_levels),
+ * binned with grid::populate(pc, members). The solver runs its cell kernels on every
+ * level and finds pairs across levels from the coarser particle, over the rows of cells
+ * of the finer level within its reach (grid::for_each_cell_row).
+ */
+template <typename T>
+struct hierarchical_grid {
+    grid_levels                         layout;
+    std::vector<grid<T>>                levels;
+    std::vector<std::vector<uint32_t>>  members;    // particles binned on each level
+
+    /**
+     * @param layout levels to lay out, none for a count of 0
+     * @param max_cells most cells of a level along each axis
+     */
+    hierarchical_grid(uint32_t world_width, uint32_t world_height, grid_levels layout, uint32_t max_cells = 1024) {
+        resize(world_width, world_height, layout, max_cells);
+    }
+
+    /**
+     * Lays the levels out anew and empties them
+     */
+    void resize(uint32_t world_width, uint32_t world_height, grid_levels layout, uint32_t max_cells = 1024) {
+        this->layout = layout;
+        levels.clear();
+        for (uint32_t level = 0; level < layout.count; level++) {
+            const float32_t size = layout.cell_size(level);
+            levels.emplace_back(world_width, world_height,
+                std::clamp(static_cast<uint32_t>(world_height / size), 1u, max_cells),
+                std::clamp(static_cast<uint32_t>(world_width / size), 1u, max_cells));
+        }
+        members.assign(layout.count, {});
+    }
+
+    /**
+     * Bins the given particles on their levels, or every particle of the collection
+     */
+    void populate(particle_collection<T>& pc, const std::vector<uint32_t>* ids = nullptr) {
+        for (std::vector<uint32_t>& m : members) {
+            m.clear();
+        }
+        const uint32_t n = ids ? ids->size() : pc.xs.size();
+        for (uint32_t k = 0; k < n; k++) {
+            const uint32_t idx = ids ? (*ids)[k] : k;
+            members[layout.level_of(pc.rs[idx])].push_back(idx);
+        }
+        for (uint32_t level = 0; level < layout.count; level++) {
+            levels[level].populate(pc, members[level]);
+        }
+    }
+
+    /**
+     * Renames every particle index after the collection was permuted, see grid::renumber
+     */
+    void renumber(const std::vector<uint32_t>& rank) {
+        for (grid<T>& g : levels) {
+            g.renumber(rank);
+        }
+        for (std::vector<uint32_t>& m : members) {
+            for (uint32_t& idx : m) {
+                idx = rank[idx];
+            }
+        }
+    }
+
+    size_t size() const noexcept {
+        size_t n = 0;
+        for (const grid<T>& g : levels) {
+            n += g.ids.size();
+        }
+        return n;
+    }
+};
+
+/**
+ * @brief The particles of a collection laid out by a sparse_broadphase (spatial_hash or
+ * sweep_and_prune), with the state the collision kernel streams copied per slot like
+ * grid's, so the kernel runs over the spans the layout hands out. Only full rebuilds
+ * with precision::f32 storage.
+ */
+template <typename T, sparse_broadphase B>
+struct sparse_grid {
+    B                       layout;
+    simd_vector<T>          xs, ys, rs; // particle state per slot, in the layout's order
 
+    /**
+     * Populates the grid with every particle, see B::populate
+     */
+    void populate(particle_collection<T>& pc) {
+        const uint32_t n = pc.xs.size();
+        layout.populate(n, [&pc](uint32_t idx) { return std::array{pc.xs[idx], pc.ys[idx], pc.rs[idx]}; });
+        xs.resize(n);
+        ys.resize(n);
+        rs.resize(n);
+        for (uint32_t slot = 0; slot < n; slot++) {
+            const uint32_t idx = layout.ids[slot];
+            xs[slot] = pc.xs[idx];
+            ys[slot] = pc.ys[idx];
+            rs[slot] = pc.rs[idx];
+        }
+    }
+
+    /**
+     * Copies the positions held in slots [begin, end) back into the particle collection
+     */
+    void store_to_collection(particle_collection<T>& pc, uint32_t begin, uint32_t end) const noexcept {
+        for (uint32_t slot = begin; slot < end; slot++) {
+            pc.xs[layout.ids[slot]] = xs[slot];
+            pc.ys[layout.ids[slot]] = ys[slot];
+        }
+    }
+};
+
+} // namespace collision engine
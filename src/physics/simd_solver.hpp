@@ -1,16 +1,92 @@
 #pragma once
 
 #include "simd_grid.hpp"
-#include <arm_neon.h>
+#include "broadphase.hpp"
+#include "common/simd.hpp"
+#include "common/profiler.hpp"
+#include "common/thread_pool.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <utility>
+#include <vector>
 
 namespace collision_engine::simd {
 
+/**
+ * Memory order particle_collection is periodically permuted into
+ */
+enum class ordering {
+    none,   // spawn order
+    cell,   // row-major grid cell order
+    morton, // grid cells along a Z-order curve
+};
+
 template <typename T>
 struct simd_solver {
     void step() { static_cast<T*>(this)->step_impl(); }
+
+protected:
+    static constexpr float32_t  _eps        = 0.001f;
+    static constexpr float32_t  _pair_coef  = 3.5f; // half stencil corrects each pair once per substep, not twice
+
+    /**
+     * Resolves a particle at p of radius p_r against one register of particles, lanes from
+     * `remaining` on being padding: moves theirs (os, one register per axis) in place and
+     * accumulates its own correction and, when profiling, its contacts. Shared by the 2D
+     * and 3D solvers.
+     */
+    template <typename V, size_t D>
+    static void collide_impl(const typename V::f32 (&p)[D], typename V::f32 p_r,
+                             typename V::f32 (&os)[D], typename V::f32 rs, size_t remaining,
+                             typename V::f32 (&acc)[D], typename V::f32& acc_contacts) noexcept {
+        using f32 = typename V::f32;
+        using mask = typename V::mask;
+
+        const f32 zero_reg = V::set1(0.f);
+        f32 ds[D];
+        for (size_t a = 0; a < D; a++) {
+            ds[a] = V::sub(p[a], os[a]);
+        }
+        f32 dist_sq = V::mul(ds[D - 1], ds[D - 1]);
+        for (size_t a = D - 1; a-- > 0;) {
+            dist_sq = V::fma(ds[a], ds[a], dist_sq);
+        }
+        f32 inv_dist = V::rsqrt(dist_sq);
+        f32 dist = V::mul(dist_sq, inv_dist);
+
+        f32 radius_sum = V::add(p_r, rs);
+        f32 inv_radius_sum = V::recip(radius_sum);
+        f32 delta = V::mul(V::mul(V::sub(radius_sum, dist), inv_radius_sum), V::set1(_pair_coef));
+
+        mask m = V::mask_and(V::mask_and(V::lt(dist, radius_sum), V::gt(dist, V::set1(_eps))), V::first_n(remaining));
+#if defined(CE_PROFILE)
+        acc_contacts = V::add(acc_contacts, V::select(m, V::set1(1.f), zero_reg));
+#else
+        (void)acc_contacts;
+#endif
+
+        // each side moves in proportion to the other's radius
+        f32 scale = V::mul(delta, inv_dist);
+        f32 p_share = V::mul(rs, inv_radius_sum);
+        f32 o_share = V::mul(p_r, inv_radius_sum);
+        for (size_t a = 0; a < D; a++) {
+            const f32 n = V::select(m, V::mul(ds[a], scale), zero_reg);
+            acc[a] = V::fma(n, p_share, acc[a]);
+            os[a] = V::fnma(n, o_share, os[a]);
+        }
+    }
 }; 
 
-class f32_solver : public simd_solver<f32_solver> {    
+/**
+ * @tparam Bin binning of the fine grid: binning::shift bins with shifts instead of a
+ *             multiply, sizing the cells to powers of 2, so both world sides must be
+ *             multiples of every cell size it picks (powers of 2 in practice); the coarse
+ *             levels of a hierarchy always bin by reciprocal
+ */
+template <binning Bin = binning::reciprocal>
+class basic_f32_solver : public simd_solver<basic_f32_solver<Bin>> {    
 public:
     using T = float32_t;
 
@@ -18,85 +94,439 @@ private:
     const T         _sub_dt;
     const T         _dt;
 
-    static constexpr T          _eps            = 0.001f;
+    using base = simd_solver<basic_f32_solver<Bin>>;
+    using base::_eps;
+    using base::_pair_coef;
+
     static constexpr T          _response_coef  = 3.f;
     static constexpr uint32_t   _sub_steps      = 4;
-    static constexpr uint32_t   _WW             = 512;
-    static constexpr uint32_t   _WH             = 512;
-    static constexpr uint32_t   _C              = 64;
-    static constexpr uint32_t   _R              = 64; 
+    static constexpr T          _min_cell_size  = 8.f;  // pixels, below it per-cell overhead outweighs the fewer pair tests
+    static constexpr uint32_t   _max_cells      = 1024; // per axis
+
+    const uint32_t              _WW;
+    const uint32_t              _WH;
+    const broadphase            _broadphase;
+    T                           _max_radius     = 0;
+    T                           _min_radius     = 0;
+    bool                        _fixed_grid     = false;
 
-    grid<T, _WH, _WW, _R, _C>   _grid;
+    simd::grid<T, Bin>          _grid;
+    // particles too large for _grid's cells live on the coarser levels of _coarse
+    simd::hierarchical_grid<T>  _coarse;
+    bool                        _hierarchical   = false;
+    // every particle, when the solver was built with broadphase::spatial_hash or
+    // broadphase::sweep_and_prune instead
+    simd::sparse_grid<T, spatial_hash>      _hash;
+    simd::sparse_grid<T, sweep_and_prune>   _sap;
+    T                           _fine_radius    = 0;    // largest radius binned on _grid when hierarchical
+    std::vector<uint32_t>       _fine_ids;
+    std::vector<uint32_t>       _coarse_ids;
     particle_collection<T>      _pc __attribute__((aligned(16))); 
+    thread_pool                 _tp;
+
+    simd::precision             _precision          = simd::precision::f32;
+    bool                        _incremental_grid   = false;
+    bool                        _stale_grid         = false;    // particles were removed since the last populate
+    std::array<uint32_t, _sub_steps> _migrations    = {};   // particles that changed cell in each substep of the last step
+    std::vector<uint32_t>       _cell_awake;        // awake particles per cell
+    std::vector<uint8_t>        _cell_quiet;        // 1 when a cell and its 8 neighbours hold no awake particle
+    ordering                    _ordering           = ordering::none;
+    uint32_t                    _reorder_interval   = 0;
+    uint32_t                    _substep            = 0;
+    std::vector<uint32_t>       _order;         // old index of each particle in the new layout
+    std::vector<uint32_t>       _rank;          // new index of each old index
+    std::vector<uint32_t>       _cell_order;    // interior cell ids in Z-order
+
+    // [first, last) grid rows of each stripe; stripes of one colour (even/odd index) are
+    // at least 2 rows tall and never adjacent, so their 3x3 neighbourhoods are disjoint
+    std::vector<std::pair<uint32_t, uint32_t>> _stripes;
+
+    void build_morton_order() {
+        auto spread = [](uint32_t v) {
+            v &= 0xFFFF;
+            v = (v | (v << 8)) & 0x00FF00FF;
+            v = (v | (v << 4)) & 0x0F0F0F0F;
+            v = (v | (v << 2)) & 0x33333333;
+            v = (v | (v << 1)) & 0x55555555;
+            return v;
+        };
+        std::vector<std::pair<uint32_t, uint32_t>> keyed; // (morton key, bordered cell id)
+        for (uint32_t row = 0; row < _grid.rows; row++) {
+            for (uint32_t col = 0; col < _grid.cols; col++) {
+                keyed.emplace_back(spread(col) | (spread(row) << 1), (row + 1) * _grid.stride + col + 1);
+            }
+        }
+        std::sort(keyed.begin(), keyed.end());
+        _cell_order.clear();
+        for (const auto& [key, cell_id] : keyed) {
+            _cell_order.push_back(cell_id);
+        }
+    }
+
+    void build_stripes() {
+        const uint32_t stripe_count = std::max(1u, std::min(2 * _tp.thread_count, _grid.rows / 2));
+        const uint32_t rows = _grid.rows / stripe_count;
+        const uint32_t remainder = _grid.rows % stripe_count;
+        _stripes.clear();
+        uint32_t first = 0;
+        for (uint32_t s = 0; s < stripe_count; s++) {
+            const uint32_t last = first + rows + (s < remainder ? 1 : 0);
+            _stripes.emplace_back(first, last);
+            first = last;
+        }
+    }
+
+    /**
+     * Rebuilds everything laid out per cell; the grid itself is repopulated by the next step
+     */
+    void resize_grid(uint32_t rows, uint32_t cols) {
+        _grid.resize(_WW, _WH, rows, cols);
+        build_stripes();
+        if (_ordering == ordering::morton) {
+            build_morton_order();
+        }
+        if (_pc.sleeping()) {
+            _cell_awake.assign(_grid.cell_count, 0);
+            _cell_quiet.assign(_grid.cell_count, 0);
+        }
+    }
+
+    /**
+     * Sizes the cells to the largest particle diameter, so every contact lies within a
+     * cell's 3x3 neighbourhood, keeping them at least _min_cell_size pixels. When the
+     * radii span more than a factor of two the cells only fit twice the smallest
+     * diameter, and the larger particles go to the coarser levels of _coarse.
+     */
+    void size_cells() {
+        if (_broadphase == broadphase::spatial_hash) {
+            // as many cells as the particles occupy, so none is capped and no hierarchy is needed
+            const T size = std::max(2 * _max_radius, _min_cell_size);
+            if (size != _hash.layout.cell_size()) {
+                _hash.layout.resize(size);
+            }
+            return;
+        }
+        if (_broadphase == broadphase::sweep_and_prune) {
+            return;
+        }
+        T size = std::max(2 * std::min(_max_radius, 2 * _min_radius), _min_cell_size);
+        if constexpr (Bin == binning::shift) {
+            // the next power of 2, doubled until the cells per axis fit _max_cells
+            uint32_t pow2 = std::bit_ceil(static_cast<uint32_t>(std::ceil(size)));
+            while (std::max(_WW, _WH) / pow2 > _max_cells) {
+                pow2 *= 2;
+            }
+            size = static_cast<T>(pow2);
+        }
+        const uint32_t cols = std::clamp(static_cast<uint32_t>(_WW / size), 1u, _max_cells);
+        const uint32_t rows = std::clamp(static_cast<uint32_t>(_WH / size), 1u, _max_cells);
+        if (rows != _grid.rows || cols != _grid.cols) {
+            resize_grid(rows, cols);
+        }
+        _fine_radius = size / 2;
+        _hierarchical = !_fixed_grid && _max_radius > _fine_radius;
+        const grid_levels layout = _hierarchical ? grid_levels::fit(2 * size, _max_radius) : grid_levels{0, 0};
+        if (!(layout == _coarse.layout)) {
+            _coarse.resize(_WW, _WH, layout, _max_cells);
+        }
+    }
+
+    /**
+     * Bins the particles for the next substep: all of them on _grid, or when hierarchical
+     * the ones up to _fine_radius on _grid and the rest on the levels of _coarse
+     */
+    void populate_grids() {
+        const bool incremental = _incremental_grid && !_stale_grid;
+        _stale_grid = false;
+        _grid.set_precision(precision());
+        if (!_hierarchical) {
+            _coarse_ids.clear();
+            if (incremental) {
+                _grid.update(_pc);
+            } else {
+                _grid.populate(_pc);
+            }
+            return;
+        }
+        _fine_ids.clear();
+        _coarse_ids.clear();
+        for (uint32_t idx = 0; idx < _pc.xs.size(); idx++) {
+            (_pc.rs[idx] > _fine_radius ? _coarse_ids : _fine_ids).push_back(idx);
+        }
+        _grid.populate(_pc, _fine_ids);
+        _coarse.populate(_pc, &_coarse_ids);
+    }
 
 public:
-    f32_solver(T dt) noexcept : _dt(dt), _sub_dt(dt / static_cast<T>(_sub_steps)), _pc(_WW, _WH, _sub_dt), _grid() {};
+    /**
+     * @param world_width, world_height extent of the world in pixels; the grid's cells are
+     *                    sized from the particles added, see set_grid
+     * @param isa_level instruction set the kernels dispatch to, detected at startup by default
+     * @param threads worker threads of the solver's pool
+     * @param bp broadphase::spatial_hash or broadphase::sweep_and_prune lay the particles out
+     *           on a sparse_grid instead of the dense grids; it is rebuilt every substep
+     *           with precision::f32 and ignores set_grid, set_precision,
+     *           set_incremental_grid, set_reordering and set_sleeping
+     * @throws std::invalid_argument for binning::shift when the world sides are not
+     *         multiples of the cell size
+     */
+    basic_f32_solver(T dt, uint32_t world_width, uint32_t world_height, isa::level isa_level = isa::active(), uint32_t threads = thread_pool::hardware_threads(),
+               broadphase bp = broadphase::uniform_grid) 
+        :   _dt(dt), _sub_dt(dt / static_cast<T>(_sub_steps)), _WW(world_width), _WH(world_height), _broadphase(bp),
+            _grid(world_width, world_height, 1, 1), _coarse(world_width, world_height, grid_levels{0, 0}),
+            _sap{sweep_and_prune(isa_level)}, _pc(world_width, world_height, _sub_dt, isa_level), _tp(threads) { size_cells(); };
+
+    /**
+     * A 512x512 world
+     */
+    basic_f32_solver(T dt, isa::level isa_level = isa::active(), uint32_t threads = thread_pool::hardware_threads())
+        : basic_f32_solver(dt, 512, 512, isa_level, threads) {}
+
+    /**
+     * @return stable handle of the particle, see particle_collection::index_of
+     */
+    uint32_t add_particle(const particle<T>& p) noexcept {
+        const bool first = _pc.size() == 0;
+        if (first || p.r > _max_radius || p.r < _min_radius) {
+            _max_radius = first ? p.r : std::max(_max_radius, p.r);
+            _min_radius = first ? p.r : std::min(_min_radius, p.r);
+            if (!_fixed_grid) {
+                size_cells();
+            }
+        }
+        return _pc.add(p);
+    }
+
+    /**
+     * Removes the particles of the given handles in one pass, see particle_collection::remove;
+     * the grid is rebuilt at the next substep and refitted when the smallest or largest
+     * particle went
+     *
+     * @return number of particles removed
+     */
+    uint32_t remove_particles(const std::vector<uint32_t>& handles) {
+        bool extreme = false;
+        for (uint32_t h : handles) {
+            const uint32_t i = _pc.index_of(h);
+            extreme |= i != handle_table::invalid && (_pc.rs[i] == _max_radius || _pc.rs[i] == _min_radius);
+        }
+        const uint32_t removed = _pc.remove(handles);
+        _stale_grid |= removed != 0;
+        if (extreme) {
+            fit_grid();
+        }
+        return removed;
+    }
+
+    bool remove_particle(uint32_t handle) { return remove_particles({handle}) != 0; }
+    void stop() { _tp.stop(); }
+
+    /**
+     * Permutes the particle arrays into the given order every n substeps (0 disables it),
+     * so the particles of a cell occupy one contiguous index range
+     */
+    void set_reordering(ordering order, uint32_t every_n_substeps) {
+        _ordering = order;
+        _reorder_interval = order == ordering::none ? 0 : every_n_substeps;
+        if (order == ordering::morton && _cell_order.empty()) {
+            build_morton_order();
+        }
+    }
+
+    /**
+     * Fixes the grid at rows x cols cells, or with 0 x 0 goes back to sizing the cells from
+     * the particle radii. A fixed grid has a single level: cells narrower than the largest
+     * diameter miss contacts.
+     */
+    void set_grid(uint32_t rows, uint32_t cols) {
+        _fixed_grid = rows && cols;
+        if (_fixed_grid) {
+            resize_grid(rows, cols);
+            _hierarchical = false;
+        } else {
+            size_cells();
+        }
+    }
+
+    /**
+     * Re-reads the radii from the collection, for when it was replaced wholesale (e.g.
+     * restored from a snapshot), and resizes the cells to match
+     */
+    void fit_grid() {
+        const auto [lo, hi] = std::minmax_element(_pc.rs.begin(), _pc.rs.end());
+        _min_radius = _pc.size() ? *lo : 0;
+        _max_radius = _pc.size() ? *hi : 0;
+        _pc.index_radii();
+        if (!_fixed_grid) {
+            size_cells();
+        }
+    }
+
+    /**
+     * Sets how the fine grid stores the state the collision kernels stream, see
+     * simd::precision. precision::fixed16 needs at most particle_collection::max_radii
+     * distinct radii and otherwise falls back to precision::f32; the coarse levels of a
+     * hierarchy always use precision::f32.
+     */
+    void set_precision(simd::precision p) noexcept { _precision = p; }
+
+    /**
+     * @return the precision the fine grid is binned with from the next substep on
+     */
+    simd::precision precision() const noexcept {
+        return _pc.radii_indexed() && _broadphase == broadphase::uniform_grid ? _precision : simd::precision::f32;
+    }
+
+    /**
+     * @param incremental rebuild the grid from scratch every substep (false, the default) or
+     *                    only move the particles that changed cell (true); both give the same layout
+     */
+    void set_incremental_grid(bool incremental) noexcept { _incremental_grid = incremental; }
+
+    /**
+     * Lets resting particles fall asleep, see particle_collection::set_sleeping. Cells whose
+     * whole 3x3 neighbourhood is asleep are skipped by the collision kernel.
+     */
+    void set_sleeping(bool enabled, T threshold = 0.01f, uint32_t substeps = 60) {
+        _pc.set_sleeping(enabled, threshold, substeps);
+        _cell_awake.assign(_grid.cell_count, 0);
+        _cell_quiet.assign(_grid.cell_count, 0);
+    }
+
+    /**
+     * Counts the awake particles of every cell and marks the cells (and their particles)
+     * whose 3x3 neighbourhood has none. A resting particle next to an awake one stays
+     * awake, so sleep spreads and wakes one cell per substep.
+     */
+    void update_sleep_state() {
+        for (uint32_t cell_id = 0; cell_id < _grid.cell_count; cell_id++) {
+            uint32_t awake = 0;
+            for (uint32_t slot = _grid.cell_begin(cell_id); slot < _grid.cell_begin(cell_id + 1); slot++) {
+                awake += !_pc.resting(_grid.ids[slot]);
+            }
+            _cell_awake[cell_id] = awake;
+        }
+        // a large particle never sleeps and keeps awake every cell it overlaps, and so their neighbours
+        for (uint32_t idx : _coarse_ids) {
+            _pc.quiet[idx] = 0;
+            _grid.for_each_cell_row(_pc.xs[idx], _pc.ys[idx], _pc.rs[idx], [this](uint32_t first, uint32_t last) {
+                for (uint32_t cell_id = first; cell_id < last; cell_id++) {
+                    _cell_awake[cell_id]++;
+                }
+            });
+        }
+        const uint32_t stride = _grid.stride;
+        for (uint32_t row = 1; row <= _grid.rows; row++) {
+            for (uint32_t col = 1; col <= _grid.cols; col++) {
+                const uint32_t cell_id = row * stride + col;
+                uint32_t awake = 0;
+                for (uint32_t o : {cell_id - stride, cell_id, cell_id + stride}) {
+                    awake += _cell_awake[o - 1] + _cell_awake[o] + _cell_awake[o + 1];
+                }
+                _cell_quiet[cell_id] = awake == 0;
+                for (uint32_t slot = _grid.cell_begin(cell_id); slot < _grid.cell_begin(cell_id + 1); slot++) {
+                    _pc.quiet[_grid.ids[slot]] = _cell_quiet[cell_id];
+                }
+            }
+        }
+    }
 
-    void add_particle(const particle<T>& p) noexcept { _pc.add(p); }
-    void remove_particle(const particle<T>& p) noexcept {};
+    const std::array<uint32_t, _sub_steps>& migrations() const noexcept { return _migrations; }
 
     particle_collection<T>& pc() noexcept { return _pc; }
-    grid<T, _WH, _WW, _R, _C>& grid() noexcept { return _grid; }
+    const particle_collection<T>& pc() const noexcept { return _pc; }
+    T dt() const noexcept { return _dt; }
+    static constexpr uint32_t sub_steps() noexcept { return _sub_steps; }
+    uint32_t world_width() const noexcept { return _WW; }
+    uint32_t world_height() const noexcept { return _WH; }
+    uint32_t grid_rows() const noexcept { return _grid.rows; }
+    uint32_t grid_cols() const noexcept { return _grid.cols; }
+    /**
+     * @return levels the particles are binned on: 1, or 1 + those of coarse_grid()
+     */
+    uint32_t level_count() const noexcept { return _hierarchical ? 1 + _coarse.layout.count : 1; }
+    bool hierarchical() const noexcept { return _hierarchical; }
+    uint32_t thread_count() const noexcept { return _tp.thread_count; }
+    simd::grid<T, Bin>& grid() noexcept { return _grid; }
+    simd::hierarchical_grid<T>& coarse_grid() noexcept { return _coarse; }
+    simd::sparse_grid<T, spatial_hash>& hash_grid() noexcept { return _hash; }
+    simd::sparse_grid<T, sweep_and_prune>& sap_grid() noexcept { return _sap; }
+    broadphase active_broadphase() const noexcept { return _broadphase; }
  
     /**
-     * Resolves collision for 1 particle against all particles in a given cell (identified by cell_id)
+     * Resolves collision for 1 particle against all particles in a given cell (identified by cell_id).
+     * Does nothing unless the grid holds positions, i.e. its precision is precision::f32
+     * (see grid::get_cell).
      *
      * @param p_idx     index of the single particle
      * @param cell_id   index of cell to resolve collision with
      */
     void resolve_particle_collision_simd(uint32_t p_idx, uint32_t cell_id) noexcept {
-        if (!_grid.is_valid_cell(cell_id)) {
-            return;
-        }
-        cell<T>& cell = _grid.get_cell(cell_id);
+        if (_grid.precision() != simd::precision::f32) return;
+        isa::dispatch(_pc.isa_level(), [=, this]<typename V>() { resolve_particle_collision_impl<V>(p_idx, cell_id); });
+    }
+
+    template <typename V>
+    void resolve_particle_collision_impl(uint32_t p_idx, uint32_t cell_id) noexcept {
+        using f32 = typename V::f32;
+        using u32 = typename V::u32;
+        using mask = typename V::mask;
+
+        cell<T> cell = _grid.get_cell(cell_id);
 
         float32_t p_dx = 0, p_dy = 0;
-        float32x4_t p_x_reg = vdupq_n_f32(_pc.xs[p_idx]);
-        float32x4_t p_y_reg = vdupq_n_f32(_pc.ys[p_idx]);
-        float32x4_t p_r_reg = vdupq_n_f32(_pc.rs[p_idx]);
-        uint32x4_t p_id_reg = vdupq_n_u32(p_idx);
+        const f32 p_x_reg = V::set1(_pc.xs[p_idx]);
+        const f32 p_y_reg = V::set1(_pc.ys[p_idx]);
+        const f32 p_r_reg = V::set1(_pc.rs[p_idx]);
+        const u32 p_id_reg = V::set1(p_idx);
+        const f32 zero_reg = V::set1(0.f);
+        const f32 eps_reg = V::set1(_eps);
+        const f32 coef_reg = V::set1(_response_coef);
 
-        float32x4_t acc_dx = vdupq_n_f32(0);
-        float32x4_t acc_dy = vdupq_n_f32(0);
+        f32 acc_dx = zero_reg;
+        f32 acc_dy = zero_reg;
             
-        for (size_t offset = 0; offset < cell.size; offset += 4) {
-            float32x4_t xs = vld1q_f32(cell.xs.data() + offset);
-            float32x4_t ys = vld1q_f32(cell.ys.data() + offset);
-            float32x4_t rs = vld1q_f32(cell.rs.data() + offset);
-            uint32x4_t ids = vld1q_u32(cell.ids.data() + offset);
+        for (size_t offset = 0; offset < cell.size; offset += V::width) {
+            const size_t remaining = cell.size - offset;
+            f32 xs = V::load_n(cell.xs + offset, remaining);
+            f32 ys = V::load_n(cell.ys + offset, remaining);
+            f32 rs = V::load_n(cell.rs + offset, remaining);
+            u32 ids = V::load_n(cell.ids + offset, remaining);
 
-            float32x4_t dxs = vsubq_f32(p_x_reg, xs);
-            float32x4_t dys = vsubq_f32(p_y_reg, ys);
+            f32 dxs = V::sub(p_x_reg, xs);
+            f32 dys = V::sub(p_y_reg, ys);
 
-            float32x4_t dist_sq = vaddq_f32(vmulq_f32(dxs, dxs), vmulq_f32(dys, dys));
-            float32x4_t inv_dist = vrsqrteq_f32(dist_sq);
-            inv_dist = vmulq_f32(vrsqrtsq_f32(vmulq_f32(dist_sq, inv_dist), inv_dist), inv_dist); // Refine
-            float32x4_t dist = vmulq_f32(dist_sq, inv_dist);
+            f32 dist_sq = V::fma(dxs, dxs, V::mul(dys, dys));
+            f32 inv_dist = V::rsqrt(dist_sq);
+            f32 dist = V::mul(dist_sq, inv_dist);
 
-            float32x4_t radius_sum = vaddq_f32(p_r_reg, rs);
-            float32x4_t radius_ratio = vmulq_f32(rs, vrecpeq_f32(radius_sum));
-            float32x4_t delta = vmulq_n_f32(vmulq_f32(vsubq_f32(radius_sum, dist), vrecpeq_f32(radius_sum)), _response_coef);
+            f32 radius_sum = V::add(p_r_reg, rs);
+            f32 inv_radius_sum = V::recip(radius_sum);
+            f32 radius_ratio = V::mul(rs, inv_radius_sum);
+            f32 delta = V::mul(V::mul(V::sub(radius_sum, dist), inv_radius_sum), coef_reg);
 
-            // Compute masks
-            uint32x4_t mask_lt = vcltq_f32(dist, radius_sum); 
-            uint32x4_t mask_gt = vcgtq_f32(dist, vdupq_n_f32(_eps)); 
-            uint32x4_t neq_id_mask = vmvnq_u32(vceqq_u32(p_id_reg, ids));
-            uint32x4_t mask = vandq_u32(vandq_u32(mask_lt, mask_gt), neq_id_mask);
+            // Compute masks, lanes past the end of the cell are zero-filled padding
+            mask mask_lt = V::lt(dist, radius_sum); 
+            mask mask_gt = V::gt(dist, eps_reg); 
+            mask neq_id_mask = V::mask_not(V::eq(p_id_reg, ids));
+            mask tail_mask = V::first_n(remaining);
+            mask mask = V::mask_and(V::mask_and(mask_lt, mask_gt), V::mask_and(neq_id_mask, tail_mask));
 
-            float32x4_t nx = vbslq_f32(mask, vmulq_f32(dxs, vmulq_f32(delta, inv_dist)), vdupq_n_f32(0));
-            float32x4_t ny = vbslq_f32(mask, vmulq_f32(dys, vmulq_f32(delta, inv_dist)), vdupq_n_f32(0));
+            f32 scale = V::mul(delta, inv_dist);
+            f32 nx = V::select(mask, V::mul(dxs, scale), zero_reg);
+            f32 ny = V::select(mask, V::mul(dys, scale), zero_reg);
 
-            acc_dx = vaddq_f32(acc_dx, vmulq_f32(nx, radius_ratio));
-            acc_dy = vaddq_f32(acc_dy, vmulq_f32(ny, radius_ratio));
+            acc_dx = V::fma(nx, radius_ratio, acc_dx);
+            acc_dy = V::fma(ny, radius_ratio, acc_dy);
 
             // Update other particles in the cell
-            xs = vsubq_f32(xs, vmulq_f32(nx, radius_ratio));
-            ys = vsubq_f32(ys, vmulq_f32(ny, radius_ratio));
-            vst1q_f32(cell.xs.data() + offset, xs);
-            vst1q_f32(cell.ys.data() + offset, ys);
+            xs = V::fnma(nx, radius_ratio, xs);
+            ys = V::fnma(ny, radius_ratio, ys);
+            V::store_n(cell.xs + offset, xs, remaining);
+            V::store_n(cell.ys + offset, ys, remaining);
         }
-        p_dx += vaddvq_f32(acc_dx);
-        p_dy += vaddvq_f32(acc_dy);
+        p_dx += V::hadd(acc_dx);
+        p_dy += V::hadd(acc_dy);
 
         // update collection data
         cell.load_to_collection(_pc);
@@ -104,30 +534,419 @@ public:
         _pc.ys[p_idx] += p_dy;
     }
     
+    /**
+     * Resolves all collisions in two waves: every even stripe in parallel, then every odd one,
+     * and finally copies the corrected positions from the grid back into the collection.
+     * When hierarchical the coarse levels go first, serially, so the waves settle the small
+     * particles the large ones pushed into each other.
+     */
     void resolve_collision() noexcept {
-        for (uint32_t p_id = 0; p_id < _pc.xs.size(); p_id++) {
-            uint32_t p_cell_id = _grid.get_cell_id(_pc.xs[p_id], _pc.ys[p_id]);
-            resolve_particle_collision_simd(p_id, p_cell_id);
-            resolve_particle_collision_simd(p_id, p_cell_id - 1);
-            resolve_particle_collision_simd(p_id, p_cell_id + 1);
+        if (_hierarchical) {
+            CE_PROFILE_SCOPE("collide_coarse");
+            resolve_coarse();
+        }
+        for (uint32_t colour = 0; colour < 2; colour++) {
+            for (uint32_t s = colour; s < _stripes.size(); s += 2) {
+                const auto [first, last] = _stripes[s];
+                _tp.submit([this, first, last]() {
+                    CE_PROFILE_SCOPE("collide");
+                    resolve_rows(first, last);
+                });
+            }
+            _tp.wait_for_tasks();
+        }
+
+        const uint32_t count = _grid.ids.size();
+        const uint32_t chunk = (count + _tp.thread_count - 1) / _tp.thread_count;
+        for (uint32_t begin = 0; begin < count; begin += chunk) {
+            const uint32_t end = std::min(begin + chunk, count);
+            _tp.submit([this, begin, end]() {
+                CE_PROFILE_SCOPE("store");
+                _grid.store_to_collection(_pc, begin, end);
+            });
+        }
+        _tp.wait_for_tasks();
+        if (_hierarchical) {
+            for (simd::grid<T>& level : _coarse.levels) {
+                level.store_to_collection(_pc, 0, level.ids.size());
+            }
+        }
+    }
 
-            resolve_particle_collision_simd(p_id, p_cell_id + _C);
-            resolve_particle_collision_simd(p_id, p_cell_id + _C - 1);
-            resolve_particle_collision_simd(p_id, p_cell_id + _C + 1);
+    /**
+     * Resolves collisions of every cell in grid rows [first, last) against its half stencil
+     */
+    void resolve_rows(uint32_t first, uint32_t last) noexcept {
+        isa::dispatch(_pc.isa_level(), [=, this]<typename V>() { resolve_rows_impl<V>(first, last); });
+    }
 
-            resolve_particle_collision_simd(p_id, p_cell_id - _C);
-            resolve_particle_collision_simd(p_id, p_cell_id - _C - 1);
-            resolve_particle_collision_simd(p_id, p_cell_id - _C + 1);
+    template <typename V>
+    void resolve_rows_impl(uint32_t first, uint32_t last) noexcept {
+        for (uint32_t row = first; row < last; row++) {
+            for (uint32_t col = 0; col < _grid.cols; col++) {
+                const uint32_t cell_id = (row + 1) * _grid.stride + col + 1;
+                if (_pc.sleeping() && _cell_quiet[cell_id]) continue; // every pair here is between sleepers
+                if (_grid.precision() == simd::precision::fixed16) {
+                    resolve_cell_q_impl<V>(_grid, cell_id);
+                } else {
+                    resolve_cell_impl<V>(_grid, cell_id);
+                }
+            }
         }
     }
 
-    void step_impl() {
-        for(uint32_t i{_sub_steps}; i--;) {
-            _grid.populate(_pc);
+    /**
+     * resolve_collision over a sparse_grid: the waves run over the stripes of its layout,
+     * see spatial_hash::stripes and sweep_and_prune::stripes
+     */
+    template <sparse_broadphase B>
+    void resolve_collision_sparse(simd::sparse_grid<T, B>& g) noexcept {
+        const auto& stripes = g.layout.stripes(2 * _tp.thread_count);
+        for (uint32_t colour = 0; colour < 2; colour++) {
+            for (uint32_t s = colour; s < stripes.size(); s += 2) {
+                const auto [first, last] = stripes[s];
+                _tp.submit([this, &g, first, last]() {
+                    CE_PROFILE_SCOPE("collide");
+                    isa::dispatch(_pc.isa_level(), [=, this, &g]<typename V>() { resolve_spans_impl<V>(g, first, last); });
+                });
+            }
+            _tp.wait_for_tasks();
+        }
+
+        const uint32_t count = g.layout.ids.size();
+        const uint32_t chunk = (count + _tp.thread_count - 1) / _tp.thread_count;
+        for (uint32_t begin = 0; begin < count; begin += chunk) {
+            const uint32_t end = std::min(begin + chunk, count);
+            _tp.submit([this, &g, begin, end]() {
+                CE_PROFILE_SCOPE("store");
+                g.store_to_collection(_pc, begin, end);
+            });
+        }
+        _tp.wait_for_tasks();
+    }
+
+    /**
+     * Resolves every slot of units [first, last) of a sparse_grid's layout against the
+     * spans of candidates it hands out, like resolve_cell_impl's half stencil
+     */
+    template <typename V, sparse_broadphase B>
+    void resolve_spans_impl(simd::sparse_grid<T, B>& g, uint32_t first, uint32_t last) noexcept {
+        g.layout.for_each_span(first, last, [&](uint32_t slot, uint32_t lo, uint32_t hi) {
+            if (lo >= hi) return;
+            CE_PROFILE_COUNT(pair_tests, hi - lo);
+            T dx = 0, dy = 0;
+            resolve_span_impl<V>(g.xs[slot], g.ys[slot], g.rs[slot], g, lo, hi, dx, dy);
+            g.xs[slot] += dx;
+            g.ys[slot] += dy;
+        });
+    }
+
+    /**
+     * Resolves the particles of the coarse levels, before the fine grid's waves: each level
+     * against its own half stencil, then every coarse particle against the rows of cells
+     * of each finer level (and of the fine grid) within its radius plus the largest radius
+     * binned there. Cross-level pairs are found from the coarser particle only, so the
+     * many small particles never look into the mostly empty coarse cells.
+     */
+    void resolve_coarse() noexcept {
+        isa::dispatch(_pc.isa_level(), [this]<typename V>() { resolve_coarse_impl<V>(); });
+    }
+
+    template <typename V>
+    void resolve_coarse_impl() noexcept {
+        for (simd::grid<T>& level : _coarse.levels) {
+            for (uint32_t row = 1; row <= level.rows; row++) {
+                for (uint32_t col = 1; col <= level.cols; col++) {
+                    resolve_cell_impl<V>(level, row * level.stride + col);
+                }
+            }
+        }
+        for (uint32_t l = 0; l < _coarse.levels.size(); l++) {
+            simd::grid<T>& level = _coarse.levels[l];
+            for (uint32_t slot = 0; slot < level.ids.size(); slot++) {
+                const T r = level.rs[slot];
+                // a large particle has many contacts: it moves after every row rather than
+                // summing them all from one position, which would overshoot
+                auto scan = [&](auto& finer, T finer_radius) {
+                    finer.for_each_cell_row(level.xs[slot], level.ys[slot], r + finer_radius, [&](uint32_t first, uint32_t last) {
+                        const uint32_t begin = finer.cell_begin(first), end = finer.cell_begin(last);
+                        CE_PROFILE_COUNT(pair_tests, end - begin);
+                        T dx = 0, dy = 0;
+                        if (finer.precision() == simd::precision::fixed16) {
+                            // offsets are only exact within range(), so the row goes in chunks
+                            // of three cells relative to the origin of each
+                            for (uint32_t c = first; c < last; c += 3) {
+                                const long ux = std::lrint(finer.cell_x(c) * finer.scale()), uy = std::lrint(finer.cell_y(c) * finer.scale());
+                                const uint32_t ref = finer.pack(static_cast<uint16_t>(ux), static_cast<uint16_t>(uy));
+                                resolve_span_q_impl<V>(level.xs[slot] - ux * finer.inv_scale(), level.ys[slot] - uy * finer.inv_scale(), r,
+                                    ref, finer, finer.cell_begin(c), finer.cell_begin(std::min(c + 3, last)), dx, dy);
+                            }
+                        } else {
+                            resolve_span_impl<V>(level.xs[slot], level.ys[slot], r, finer, begin, end, dx, dy);
+                        }
+                        level.xs[slot] += dx;
+                        level.ys[slot] += dy;
+                    });
+                };
+                scan(_grid, _fine_radius);
+                for (uint32_t f = 0; f < l; f++) {
+                    scan(_coarse.levels[f], _coarse.layout.max_radius(f));
+                }
+            }
+        }
+    }
+
+    /**
+     * Half-stencil cell kernel: every particle of the cell is tested against the particles
+     * after it in its own cell and the cell to the right, then against the three cells of
+     * the row below. Every pair in the grid is visited exactly once and both particles
+     * receive their (radius weighted) equal and opposite correction. Both neighbourhoods
+     * are contiguous slot ranges thanks to the CSR layout and the sentinel border.
+     * Corrections are applied to the grid's copy only, see resolve_collision.
+     */
+    template <typename V, typename G>
+    void resolve_cell_impl(G& g, uint32_t cell_id) noexcept {
+        const uint32_t begin = g.cell_begin(cell_id);
+        const uint32_t end = g.cell_begin(cell_id + 1);
+        if (begin == end) return;
+
+        const uint32_t stride = g.stride;
+        const uint32_t same_row_end = g.cell_begin(cell_id + 2);
+        const uint32_t next_row_begin = g.cell_begin(cell_id + stride - 1);
+        const uint32_t next_row_end = g.cell_begin(cell_id + stride + 2);
+        CE_PROFILE_MAX(max_cell_occupancy, end - begin);
+        CE_PROFILE_COUNT(pair_tests, (end - begin) * (same_row_end - begin + next_row_end - next_row_begin)
+            - (end - begin) * (end - begin + 1) / 2);
+
+        for (uint32_t slot = begin; slot < end; slot++) {
+            const T x = g.xs[slot], y = g.ys[slot], r = g.rs[slot];
+            T dx = 0, dy = 0;
+            resolve_span_impl<V>(x, y, r, g, slot + 1, same_row_end, dx, dy);
+            resolve_span_impl<V>(x, y, r, g, next_row_begin, next_row_end, dx, dy);
+            g.xs[slot] += dx;
+            g.ys[slot] += dy;
+        }
+    }
+
+    /**
+     * resolve_cell_impl over a precision::fixed16 grid; each particle is resolved relative to
+     * its own position
+     */
+    template <typename V, typename G>
+    void resolve_cell_q_impl(G& g, uint32_t cell_id) noexcept {
+        const uint32_t begin = g.cell_begin(cell_id);
+        const uint32_t end = g.cell_begin(cell_id + 1);
+        if (begin == end) return;
+
+        const uint32_t stride = g.stride;
+        const uint32_t same_row_end = g.cell_begin(cell_id + 2);
+        const uint32_t next_row_begin = g.cell_begin(cell_id + stride - 1);
+        const uint32_t next_row_end = g.cell_begin(cell_id + stride + 2);
+        CE_PROFILE_MAX(max_cell_occupancy, end - begin);
+        CE_PROFILE_COUNT(pair_tests, (end - begin) * (same_row_end - begin + next_row_end - next_row_begin)
+            - (end - begin) * (end - begin + 1) / 2);
+
+        for (uint32_t slot = begin; slot < end; slot++) {
+            const uint32_t ref = g.qs[slot];
+            const T r = _pc.radii[g.rids[slot]];
+            T dx = 0, dy = 0;
+            resolve_span_q_impl<V>(0, 0, r, ref, g, slot + 1, same_row_end, dx, dy);
+            resolve_span_q_impl<V>(0, 0, r, ref, g, next_row_begin, next_row_end, dx, dy);
+            g.qs[slot] = g.pack(g.qx(ref) + g.quantize(dx), g.qy(ref) + g.quantize(dy));
+        }
+    }
+
+    /**
+     * Resolves a particle at (x, y) of radius r against slots [first, last) of g (a grid or
+     * a sparse_grid), writing their corrections back in place and accumulating its own into (dx, dy)
+     */
+    template <typename V, typename G>
+    void resolve_span_impl(T x, T y, T r, G& g, uint32_t first, uint32_t last, T& dx, T& dy) noexcept {
+        using f32 = typename V::f32;
+
+        T* xs_ptr = g.xs.data();
+        T* ys_ptr = g.ys.data();
+        const T* rs_ptr = g.rs.data();
+
+        const f32 p_reg[2] = {V::set1(x), V::set1(y)};
+        const f32 p_r_reg = V::set1(r);
+        f32 acc[2] = {V::set1(0.f), V::set1(0.f)};
+        f32 acc_contacts = V::set1(0.f);
+
+        for (uint32_t offset = first; offset < last; offset += V::width) {
+            const size_t remaining = last - offset;
+            f32 os[2] = {V::load_n(xs_ptr + offset, remaining), V::load_n(ys_ptr + offset, remaining)};
+            const f32 rs = V::load_n(rs_ptr + offset, remaining);
+            base::template collide_impl<V>(p_reg, p_r_reg, os, rs, remaining, acc, acc_contacts);
+            V::store_n(xs_ptr + offset, os[0], remaining);
+            V::store_n(ys_ptr + offset, os[1], remaining);
+        }
+        dx += V::hadd(acc[0]);
+        dy += V::hadd(acc[1]);
+        CE_PROFILE_COUNT(contacts, static_cast<uint64_t>(V::hadd(acc_contacts)));
+    }
+
+    /**
+     * resolve_span_impl over a precision::fixed16 grid, with (x, y) relative to the packed
+     * position ref: each lane widens its offset from ref, and only the quantized change of
+     * that offset is added back, so untouched lanes keep their bits
+     */
+    template <typename V, typename G>
+    void resolve_span_q_impl(T x, T y, T r, uint32_t ref, G& g, uint32_t first, uint32_t last, T& dx, T& dy) noexcept {
+        using f32 = typename V::f32;
+        using u32 = typename V::u32;
+
+        uint32_t* qs_ptr = g.qs.data();
+        const uint8_t* rids_ptr = g.rids.data();
+        const T* radii = _pc.radii.data();
+
+        const f32 p_reg[2] = {V::set1(x), V::set1(y)};
+        const f32 p_r_reg = V::set1(r);
+        const u32 ref_reg = V::set1(ref);
+        const f32 scale_reg = V::set1(g.scale());
+        const f32 inv_scale_reg = V::set1(g.inv_scale());
+        f32 acc[2] = {V::set1(0.f), V::set1(0.f)};
+        f32 acc_contacts = V::set1(0.f);
+
+        for (uint32_t offset = first; offset < last; offset += V::width) {
+            const size_t remaining = last - offset;
+            const u32 q = V::load_n(qs_ptr + offset, remaining);
+            const u32 d = V::sub_i16(q, ref_reg);
+            const f32 xs_old = V::mul(V::low_i16(d), inv_scale_reg);
+            const f32 ys_old = V::mul(V::high_i16(d), inv_scale_reg);
+            f32 os[2] = {xs_old, ys_old};
+            const f32 rs = V::gather_n(radii, rids_ptr + offset, remaining);
+            base::template collide_impl<V>(p_reg, p_r_reg, os, rs, remaining, acc, acc_contacts);
+            const u32 moved = V::pack_i16(V::mul(V::sub(os[0], xs_old), scale_reg), V::mul(V::sub(os[1], ys_old), scale_reg));
+            V::store_n(qs_ptr + offset, V::add_i16(q, moved), remaining);
+        }
+        dx += V::hadd(acc[0]);
+        dy += V::hadd(acc[1]);
+        CE_PROFILE_COUNT(contacts, static_cast<uint64_t>(V::hadd(acc_contacts)));
+    }
+
+    /**
+     * Integrates all particles in 16-aligned chunks, one per thread
+     */
+    void update_particles() {
+        const size_t count = _pc.xs.size();
+        const size_t chunk = ((count + _tp.thread_count - 1) / _tp.thread_count + 15) & ~size_t(15);
+        for (size_t begin = 0; begin < count; begin += chunk) {
+            const size_t end = std::min(begin + chunk, count);
+            _tp.submit([this, begin, end]() {
+                CE_PROFILE_SCOPE("integrate");
+                _pc.integrate(begin, end);
+            });
+        }
+        _tp.wait_for_tasks();
+        _pc.swap_buffers();
+    }
+
+    /**
+     * Permutes the collection into the configured order, using the freshly populated grid,
+     * and renumbers the grid slots to match; the particles of the coarse levels follow
+     * those of the fine grid, level by level in cell order. Does nothing under
+     * ordering::none, or when the dense grid is not the broadphase.
+     */
+    void reorder_particles() {
+        if (_ordering == ordering::none || _broadphase != broadphase::uniform_grid) return;
+        const uint32_t n = _pc.xs.size();
+        _order.clear();
+        if (_ordering == ordering::cell) {
+            _order.assign(_grid.ids.begin(), _grid.ids.end());
+        } else {
+            for (uint32_t cell_id : _cell_order) {
+                const cell<T> c = _grid.get_cell(cell_id);
+                _order.insert(_order.end(), c.ids, c.ids + c.size);
+            }
+        }
+        if (_hierarchical) {
+            for (const simd::grid<T>& level : _coarse.levels) {
+                _order.insert(_order.end(), level.ids.begin(), level.ids.end());
+            }
+        }
+        _rank.resize(n);
+        for (uint32_t i = 0; i < n; i++) {
+            _rank[_order[i]] = i;
+        }
+        _pc.reorder(_order);
+        _grid.renumber(_rank);
+        if (_hierarchical) {
+            _coarse.renumber(_rank);
+            for (std::vector<uint32_t>* ids : {&_fine_ids, &_coarse_ids}) {
+                for (uint32_t& idx : *ids) {
+                    idx = _rank[idx];
+                }
+            }
+        }
+    }
+
+    /**
+     * Bins the particles on the broadphase the solver was built with
+     */
+    void populate_broadphase() {
+        if (_broadphase == broadphase::spatial_hash) {
+            _hash.populate(_pc);
+        } else if (_broadphase == broadphase::sweep_and_prune) {
+            _sap.populate(_pc);
+        } else {
+            populate_grids();
+        }
+    }
+
+    /**
+     * resolve_collision on the broadphase the solver was built with
+     */
+    void resolve_broadphase() noexcept {
+        if (_broadphase == broadphase::spatial_hash) {
+            resolve_collision_sparse(_hash);
+        } else if (_broadphase == broadphase::sweep_and_prune) {
+            resolve_collision_sparse(_sap);
+        } else {
             resolve_collision();
-            _pc.step();
+        }
+    }
+
+    /**
+     * Substeps with a barrier after every phase; migrations, reordering and sleeping are
+     * bookkeeping of the dense grid and are skipped on a sparse_grid
+     */
+    void step_impl() {
+        CE_PROFILE_SCOPE("step");
+        const bool dense = _broadphase == broadphase::uniform_grid;
+        for(uint32_t i = 0; i < _sub_steps; i++) {
+            {
+                CE_PROFILE_SCOPE("populate");
+                populate_broadphase();
+            }
+            if (dense) {
+                _migrations[i] = _grid.migrations();
+                if (_reorder_interval && ++_substep % _reorder_interval == 0) {
+                    CE_PROFILE_SCOPE("reorder");
+                    reorder_particles();
+                }
+                if (_pc.sleeping()) {
+                    CE_PROFILE_SCOPE("sleep");
+                    update_sleep_state();
+                }
+            }
+            {
+                CE_PROFILE_SCOPE("resolve_collision");
+                resolve_broadphase();
+            }
+            {
+                CE_PROFILE_SCOPE("update_particles");
+                update_particles();
+            }
         }
     }
 }; 
+
+using f32_solver = basic_f32_solver<>;
+
+/**
+ * SoA solver on power of 2 cells binned by shifting, for power of 2 worlds
+ */
+using f32_shift_solver = basic_f32_solver<binning::shift>;
     
 } // namespace collision engine
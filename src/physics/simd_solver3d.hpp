@@ -0,0 +1,278 @@
+#pragma once
+
+#include "simd_solver.hpp"
+#include "simd_grid.hpp"
+#include "common/simd.hpp"
+#include "common/profiler.hpp"
+#include "common/thread_pool.hpp"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace collision_engine::simd {
+
+/**
+ * 3D counterpart of f32_solver: particles in a box, binned on a 3D grid whose cells fit
+ * the largest diameter, so every contact lies within a cell's 3x3x3 neighbourhood. The
+ * cell kernel visits the half stencil of 13 forward neighbours plus the cell itself, as
+ * five contiguous slot ranges: the rest of the cell and the cell to its right, the three
+ * cells of the row below, and the three rows of three cells of the layer behind.
+ * Collisions run in slabs of layers, even slabs in parallel, then odd ones.
+ */
+class f32_solver3d : public simd_solver<f32_solver3d> {
+public:
+    using T = float32_t;
+
+private:
+    const T         _sub_dt;
+    const T         _dt;
+
+    static constexpr uint32_t   _sub_steps      = 4;
+    static constexpr T          _min_cell_size  = 8.f;  // pixels
+    static constexpr uint32_t   _max_cells      = 256;  // per axis
+
+    const uint32_t              _WW;
+    const uint32_t              _WH;
+    const uint32_t              _WD;
+    T                           _max_radius     = 0;
+
+    simd::grid<T, binning::reciprocal, 3>   _grid;
+    particle_collection<T, 3>               _pc __attribute__((aligned(16)));
+    thread_pool                             _tp;
+
+    // [first, last) grid layers of each slab; slabs of one colour are at least 2 layers
+    // deep and never adjacent, so their 3x3x3 neighbourhoods are disjoint
+    std::vector<std::pair<uint32_t, uint32_t>> _slabs;
+
+    void build_slabs() {
+        const uint32_t slab_count = std::max(1u, std::min(2 * _tp.thread_count, _grid.layers / 2));
+        const uint32_t layers = _grid.layers / slab_count;
+        const uint32_t remainder = _grid.layers % slab_count;
+        _slabs.clear();
+        uint32_t first = 0;
+        for (uint32_t s = 0; s < slab_count; s++) {
+            const uint32_t last = first + layers + (s < remainder ? 1 : 0);
+            _slabs.emplace_back(first, last);
+            first = last;
+        }
+    }
+
+    /**
+     * Sizes the cells to the largest particle diameter, keeping them at least
+     * _min_cell_size pixels
+     */
+    void size_cells() {
+        const T size = std::max(2 * _max_radius, _min_cell_size);
+        const uint32_t cols = std::clamp(static_cast<uint32_t>(_WW / size), 1u, _max_cells);
+        const uint32_t rows = std::clamp(static_cast<uint32_t>(_WH / size), 1u, _max_cells);
+        const uint32_t layers = std::clamp(static_cast<uint32_t>(_WD / size), 1u, _max_cells);
+        if (rows != _grid.rows || cols != _grid.cols || layers != _grid.layers) {
+            _grid.resize(_WW, _WH, _WD, rows, cols, layers);
+            build_slabs();
+        }
+    }
+
+public:
+    /**
+     * @param world_width, world_height, world_depth extent of the world in pixels
+     * @param isa_level instruction set the kernels dispatch to, detected at startup by default
+     * @param threads worker threads of the solver's pool
+     */
+    f32_solver3d(T dt, uint32_t world_width, uint32_t world_height, uint32_t world_depth,
+                 isa::level isa_level = isa::active(), uint32_t threads = thread_pool::hardware_threads())
+        :   _sub_dt(dt / static_cast<T>(_sub_steps)), _dt(dt), _WW(world_width), _WH(world_height), _WD(world_depth),
+            _grid(world_width, world_height, world_depth, 1, 1, 1), _pc(world_width, world_height, world_depth, _sub_dt, isa_level),
+            _tp(threads) { size_cells(); }
+
+    /**
+     * @return stable handle of the particle, see particle_collection::index_of
+     */
+    uint32_t add_particle(const particle<T, 3>& p) {
+        if (_pc.size() == 0 || p.r > _max_radius) {
+            _max_radius = p.r;
+            size_cells();
+        }
+        return _pc.add(p);
+    }
+
+    /**
+     * Removes the particles of the given handles in one pass, see particle_collection::remove;
+     * the cells are resized when the largest particle went, see f32_solver::remove_particles
+     *
+     * @return number of particles removed
+     */
+    uint32_t remove_particles(const std::vector<uint32_t>& handles) {
+        bool largest = false;
+        for (uint32_t h : handles) {
+            const uint32_t i = _pc.index_of(h);
+            largest |= i != handle_table::invalid && _pc.rs[i] == _max_radius;
+        }
+        const uint32_t removed = _pc.remove(handles);
+        if (largest) {
+            _max_radius = _pc.size() ? *std::max_element(_pc.rs.begin(), _pc.rs.end()) : 0;
+            size_cells();
+        }
+        return removed;
+    }
+
+    void stop() { _tp.stop(); }
+
+    particle_collection<T, 3>& pc() noexcept { return _pc; }
+    const particle_collection<T, 3>& pc() const noexcept { return _pc; }
+    T dt() const noexcept { return _dt; }
+    static constexpr uint32_t sub_steps() noexcept { return _sub_steps; }
+    uint32_t thread_count() const noexcept { return _tp.thread_count; }
+    simd::grid<T, binning::reciprocal, 3>& grid() noexcept { return _grid; }
+
+    /**
+     * Resolves all collisions in two waves of slabs, then copies the corrected positions
+     * from the grid back into the collection, see f32_solver::resolve_collision
+     */
+    void resolve_collision() noexcept {
+        for (uint32_t colour = 0; colour < 2; colour++) {
+            for (uint32_t s = colour; s < _slabs.size(); s += 2) {
+                const auto [first, last] = _slabs[s];
+                _tp.submit([this, first, last]() {
+                    CE_PROFILE_SCOPE("collide");
+                    resolve_layers(first, last);
+                });
+            }
+            _tp.wait_for_tasks();
+        }
+
+        const uint32_t count = _grid.ids.size();
+        const uint32_t chunk = (count + _tp.thread_count - 1) / _tp.thread_count;
+        for (uint32_t begin = 0; begin < count; begin += chunk) {
+            const uint32_t end = std::min(begin + chunk, count);
+            _tp.submit([this, begin, end]() {
+                CE_PROFILE_SCOPE("store");
+                _grid.store_to_collection(_pc, begin, end);
+            });
+        }
+        _tp.wait_for_tasks();
+    }
+
+    /**
+     * Resolves collisions of every cell in grid layers [first, last) against its half stencil
+     */
+    void resolve_layers(uint32_t first, uint32_t last) noexcept {
+        isa::dispatch(_pc.isa_level(), [=, this]<typename V>() { resolve_layers_impl<V>(first, last); });
+    }
+
+    template <typename V>
+    void resolve_layers_impl(uint32_t first, uint32_t last) noexcept {
+        for (uint32_t layer = first; layer < last; layer++) {
+            for (uint32_t row = 0; row < _grid.rows; row++) {
+                for (uint32_t col = 0; col < _grid.cols; col++) {
+                    resolve_cell_impl<V>((layer + 1) * _grid.plane + (row + 1) * _grid.stride + col + 1);
+                }
+            }
+        }
+    }
+
+    /**
+     * Half-stencil cell kernel: every particle of the cell is tested against the particles
+     * after it in its own cell and the 13 forward neighbours, so every pair is visited once
+     */
+    template <typename V>
+    void resolve_cell_impl(uint32_t cell_id) noexcept {
+        const uint32_t begin = _grid.cell_begin(cell_id);
+        const uint32_t end = _grid.cell_begin(cell_id + 1);
+        if (begin == end) return;
+
+        const uint32_t stride = _grid.stride;
+        const uint32_t behind = cell_id + _grid.plane;
+        const uint32_t spans[4][2] = {
+            {_grid.cell_begin(cell_id + stride - 1), _grid.cell_begin(cell_id + stride + 2)},
+            {_grid.cell_begin(behind - stride - 1), _grid.cell_begin(behind - stride + 2)},
+            {_grid.cell_begin(behind - 1), _grid.cell_begin(behind + 2)},
+            {_grid.cell_begin(behind + stride - 1), _grid.cell_begin(behind + stride + 2)},
+        };
+        const uint32_t same_row_end = _grid.cell_begin(cell_id + 2);
+        CE_PROFILE_MAX(max_cell_occupancy, end - begin);
+
+        for (uint32_t slot = begin; slot < end; slot++) {
+            const T x = _grid.xs[slot], y = _grid.ys[slot], z = _grid.zs[slot], r = _grid.rs[slot];
+            T dx = 0, dy = 0, dz = 0;
+            resolve_span_impl<V>(x, y, z, r, slot + 1, same_row_end, dx, dy, dz);
+            for (const auto& [first, last] : spans) {
+                resolve_span_impl<V>(x, y, z, r, first, last, dx, dy, dz);
+            }
+            _grid.xs[slot] += dx;
+            _grid.ys[slot] += dy;
+            _grid.zs[slot] += dz;
+        }
+    }
+
+    /**
+     * Resolves a particle at (x, y, z) of radius r against grid slots [first, last), writing
+     * their corrections back in place and accumulating its own into (dx, dy, dz)
+     */
+    template <typename V>
+    void resolve_span_impl(T x, T y, T z, T r, uint32_t first, uint32_t last, T& dx, T& dy, T& dz) noexcept {
+        using f32 = typename V::f32;
+
+        T* xs_ptr = _grid.xs.data();
+        T* ys_ptr = _grid.ys.data();
+        T* zs_ptr = _grid.zs.data();
+        const T* rs_ptr = _grid.rs.data();
+
+        const f32 p_reg[3] = {V::set1(x), V::set1(y), V::set1(z)};
+        const f32 p_r_reg = V::set1(r);
+        f32 acc[3] = {V::set1(0.f), V::set1(0.f), V::set1(0.f)};
+        f32 acc_contacts = V::set1(0.f);
+        CE_PROFILE_COUNT(pair_tests, last - first);
+
+        for (uint32_t offset = first; offset < last; offset += V::width) {
+            const size_t remaining = last - offset;
+            f32 os[3] = {
+                V::load_n(xs_ptr + offset, remaining), V::load_n(ys_ptr + offset, remaining), V::load_n(zs_ptr + offset, remaining)};
+            const f32 rs = V::load_n(rs_ptr + offset, remaining);
+            collide_impl<V>(p_reg, p_r_reg, os, rs, remaining, acc, acc_contacts);
+            V::store_n(xs_ptr + offset, os[0], remaining);
+            V::store_n(ys_ptr + offset, os[1], remaining);
+            V::store_n(zs_ptr + offset, os[2], remaining);
+        }
+        dx += V::hadd(acc[0]);
+        dy += V::hadd(acc[1]);
+        dz += V::hadd(acc[2]);
+        CE_PROFILE_COUNT(contacts, static_cast<uint64_t>(V::hadd(acc_contacts)));
+    }
+
+    /**
+     * Integrates all particles in 16-aligned chunks, one per thread
+     */
+    void update_particles() {
+        const size_t count = _pc.xs.size();
+        const size_t chunk = ((count + _tp.thread_count - 1) / _tp.thread_count + 15) & ~size_t(15);
+        for (size_t begin = 0; begin < count; begin += chunk) {
+            const size_t end = std::min(begin + chunk, count);
+            _tp.submit([this, begin, end]() {
+                CE_PROFILE_SCOPE("integrate");
+                _pc.integrate(begin, end);
+            });
+        }
+        _tp.wait_for_tasks();
+        _pc.swap_buffers();
+    }
+
+    void step_impl() {
+        CE_PROFILE_SCOPE("step");
+        for (uint32_t i = 0; i < _sub_steps; i++) {
+            {
+                CE_PROFILE_SCOPE("populate");
+                _grid.populate(_pc);
+            }
+            {
+                CE_PROFILE_SCOPE("resolve_collision");
+                resolve_collision();
+            }
+            {
+                CE_PROFILE_SCOPE("update_particles");
+                update_particles();
+            }
+        }
+    }
+};
+
+} // namespace collision engine
@@ -0,0 +1,376 @@
+#pragma once
+
+#include "simd_solver.hpp"
+#include "solver.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+namespace collision_engine {
+
+/**
+ * Snapshot image layout (version 2), identical in memory and on disk:
+ *
+ *   [snapshot_header, 64 bytes][section 0][section 1]...
+ *
+ * Every section starts on a 64 byte boundary, so a mapped file can be copied straight into
+ * the solver's aligned arrays without any parsing.
+ *  - soa: xs, ys, pxs, pys, rs, rest (float32) then the handle slot of each index (uint32)
+ *  - aos: one section holding the particle structs of the environment, in order
+ */
+enum class snapshot_kind : uint32_t { soa = 1, aos = 2 };
+
+struct snapshot_header {
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    kind;
+    uint64_t    count;          // particles
+    uint64_t    image_bytes;    // header and every section, i.e. the file size
+    float32_t   dt;             // soa only, the collection's integration depends on it
+    uint32_t    world_width;
+    uint32_t    world_height;
+    uint32_t    grid_rows;      // soa only
+    uint32_t    grid_cols;      // soa only
+    uint32_t    element_bytes;  // size of one particle of a section
+    uint32_t    slot_count;     // soa only, handle slots in use or free; every slot is below it
+    uint32_t    reserved;
+};
+static_assert(sizeof(snapshot_header) == 64 && std::is_trivially_copyable_v<snapshot_header>);
+
+namespace snapshot_detail {
+
+inline constexpr char       magic[8]        = {'C', 'E', 'S', 'N', 'A', 'P', 0, 0};
+inline constexpr uint32_t   version         = 2;
+inline constexpr uint32_t   soa_sections    = 7;
+
+inline size_t section_bytes(uint64_t count, uint32_t element_bytes) noexcept {
+    return (count * element_bytes + 63) & ~size_t(63);
+}
+
+inline size_t section_offset(const snapshot_header& h, uint32_t k) noexcept {
+    return sizeof(snapshot_header) + k * section_bytes(h.count, h.element_bytes);
+}
+
+inline snapshot_header make_header(snapshot_kind kind, uint64_t count, uint32_t element_bytes, uint32_t sections) {
+    snapshot_header h{};
+    std::memcpy(h.magic, magic, sizeof(magic));
+    h.version = version;
+    h.kind = static_cast<uint32_t>(kind);
+    h.count = count;
+    h.element_bytes = element_bytes;
+    h.image_bytes = sizeof(snapshot_header) + sections * section_bytes(count, element_bytes);
+    return h;
+}
+
+} // namespace snapshot_detail
+
+/**
+ * @brief Non-owning view of a snapshot image, in memory (snapshot_ring) or mapped (snapshot_file)
+ */
+class snapshot_view {
+private:
+    const std::byte*    _data = nullptr;
+    size_t              _size = 0;
+
+public:
+    snapshot_view() = default;
+    snapshot_view(const std::byte* data, size_t size) noexcept : _data(data), _size(size) {}
+
+    /**
+     * @return whether the image is complete, of a version this build reads, and its sections
+     *         are exactly as large as its header says
+     */
+    bool valid() const noexcept {
+        if (_size < sizeof(snapshot_header)) {
+            return false;
+        }
+        const snapshot_header& h = header();
+        if (std::memcmp(h.magic, snapshot_detail::magic, sizeof(h.magic)) != 0 || h.version != snapshot_detail::version) {
+            return false;
+        }
+        uint32_t sections = 1;
+        if (h.kind == static_cast<uint32_t>(snapshot_kind::soa)) {
+            if (h.element_bytes != sizeof(float32_t) || h.count > h.slot_count) {
+                return false;
+            }
+            sections = snapshot_detail::soa_sections;
+        } else if (h.kind != static_cast<uint32_t>(snapshot_kind::aos) || h.element_bytes == 0) {
+            return false;
+        }
+        // bounded by the image first, so the section sizes cannot overflow
+        return h.image_bytes <= _size && h.count <= h.image_bytes / h.element_bytes
+            && h.image_bytes == sizeof(snapshot_header) + sections * snapshot_detail::section_bytes(h.count, h.element_bytes);
+    }
+
+    const snapshot_header& header() const noexcept { return *reinterpret_cast<const snapshot_header*>(_data); }
+    snapshot_kind kind() const noexcept { return static_cast<snapshot_kind>(header().kind); }
+
+    /**
+     * @return start of section k
+     */
+    const std::byte* section(uint32_t k) const noexcept {
+        return _data + snapshot_detail::section_offset(header(), k);
+    }
+
+    const std::byte* data() const noexcept { return _data; }
+    size_t size() const noexcept { return _size; }
+};
+
+/**
+ * @brief Read-only private mapping of a snapshot file; pages are faulted in on first touch
+ */
+class snapshot_file {
+private:
+    void*   _map = MAP_FAILED;
+    size_t  _size = 0;
+
+public:
+    explicit snapshot_file(const std::string& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            _size = static_cast<size_t>(st.st_size);
+            _map = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (_map != MAP_FAILED) {
+                ::madvise(_map, _size, MADV_WILLNEED); // start reading ahead before restore() touches it
+            }
+        }
+        ::close(fd); // the mapping keeps the file alive
+    }
+
+    ~snapshot_file() {
+        if (_map != MAP_FAILED) {
+            ::munmap(_map, _size);
+        }
+    }
+
+    snapshot_file(const snapshot_file&) = delete;
+    snapshot_file& operator=(const snapshot_file&) = delete;
+
+    bool is_open() const noexcept { return _map != MAP_FAILED; }
+
+    snapshot_view view() const noexcept {
+        return is_open() ? snapshot_view(static_cast<const std::byte*>(_map), _size) : snapshot_view();
+    }
+};
+
+/**
+ * Serializes the full state of the SoA solver into `image`, reusing its capacity
+ */
+inline void capture(const simd::f32_solver& solver, std::vector<std::byte>& image) {
+    const simd::particle_collection<float32_t>& pc = solver.pc();
+    const size_t n = pc.size();
+    snapshot_header h = snapshot_detail::make_header(snapshot_kind::soa, n, sizeof(float32_t), snapshot_detail::soa_sections);
+    h.dt = solver.dt();
+    h.world_width = solver.world_width();
+    h.world_height = solver.world_height();
+    h.grid_rows = solver.grid_rows();
+    h.grid_cols = solver.grid_cols();
+    h.slot_count = pc.slot_count();
+
+    image.resize(h.image_bytes);
+    std::memcpy(image.data(), &h, sizeof(h));
+    uint32_t k = 0;
+    for (const simd_vector<float32_t>* v : {&pc.xs, &pc.ys, &pc.pxs, &pc.pys, &pc.rs, &pc.rest}) {
+        std::memcpy(image.data() + snapshot_detail::section_offset(h, k++), v->data(), n * sizeof(float32_t));
+    }
+    std::memcpy(image.data() + snapshot_detail::section_offset(h, k), pc.slots().data(), n * sizeof(uint32_t));
+}
+
+/**
+ * Replaces every particle of the SoA solver with the snapshot's and rebuilds its grid
+ *
+ * @return false (leaving the solver untouched) when the image is not a soa snapshot taken
+ *         with the same world and dt, or its handle slots are out of range or repeated;
+ *         the grid is resized to the restored radii
+ */
+inline bool restore(const snapshot_view& view, simd::f32_solver& solver) {
+    if (!view.valid() || view.kind() != snapshot_kind::soa) {
+        return false;
+    }
+    const snapshot_header& h = view.header();
+    if (h.dt != solver.dt() || h.element_bytes != sizeof(float32_t)
+        || h.world_width != solver.world_width() || h.world_height != solver.world_height()) {
+        return false;
+    }
+
+    const size_t n = h.count;
+    const uint32_t* slots = reinterpret_cast<const uint32_t*>(view.section(snapshot_detail::soa_sections - 1));
+    std::vector<uint8_t> used(h.slot_count, 0);
+    for (size_t i = 0; i < n; i++) {
+        if (slots[i] >= h.slot_count || used[slots[i]]++) {
+            return false;
+        }
+    }
+
+    simd::particle_collection<float32_t>& pc = solver.pc();
+    pc.resize(n, slots);
+    uint32_t k = 0;
+    for (simd_vector<float32_t>* v : {&pc.xs, &pc.ys, &pc.pxs, &pc.pys, &pc.rs, &pc.rest}) {
+        std::memcpy(v->data(), view.section(k++), n * sizeof(float32_t));
+    }
+    solver.fit_grid();
+    solver.grid().populate(pc);
+    return true;
+}
+
+/**
+ * Serializes the particles of the AoS environment into `image`, reusing its capacity
+ */
+template <typename VT, typename W>
+void capture(const environment<VT, W>& env, std::vector<std::byte>& image) {
+    using PT = particle<VT>;
+    static_assert(std::is_trivially_copyable_v<PT>);
+    const std::vector<PT*>& particles = env.particles();
+    snapshot_header h = snapshot_detail::make_header(snapshot_kind::aos, particles.size(), sizeof(PT), 1);
+    h.world_width = env.world_size().i();
+    h.world_height = env.world_size().j();
+
+    image.resize(h.image_bytes);
+    std::memcpy(image.data(), &h, sizeof(h));
+    std::byte* out = image.data() + sizeof(snapshot_header);
+    for (const PT* p : particles) {
+        std::memcpy(out, p, sizeof(PT));
+        out += sizeof(PT);
+    }
+}
+
+/**
+ * Restores the particles of the AoS environment. The environment does not own its
+ * particles, so they are either overwritten in place (same count, e.g. when rewinding) or,
+ * for an empty environment, copied into `storage` and added.
+ *
+ * @param storage room for the snapshot's particles, only used when env is empty
+ * @return false (leaving the environment untouched) when the image is not an aos snapshot
+ *         of the same world and particle layout, or has nowhere to go
+ */
+template <typename VT, typename W>
+bool restore(const snapshot_view& view, environment<VT, W>& env, particle<VT>* storage = nullptr) {
+    using PT = particle<VT>;
+    if (!view.valid() || view.kind() != snapshot_kind::aos) {
+        return false;
+    }
+    const snapshot_header& h = view.header();
+    const W world = env.world_size();
+    if (h.element_bytes != sizeof(PT) || h.world_width != world.i() || h.world_height != world.j()) {
+        return false;
+    }
+
+    const std::vector<PT*>& particles = env.particles();
+    const std::byte* in = view.section(0);
+    if (particles.size() == h.count) {
+        for (PT* p : particles) {
+            std::memcpy(p, in, sizeof(PT));
+            in += sizeof(PT);
+        }
+    } else if (particles.empty() && storage) {
+        std::memcpy(storage, in, h.count * sizeof(PT));
+        for (uint64_t i = 0; i < h.count; i++) {
+            env.add_particle(storage + i);
+        }
+    } else {
+        return false;
+    }
+    env.invalidate_grid();
+    return true;
+}
+
+/**
+ * Writes an image with one sequential write
+ */
+inline bool write_snapshot(const std::string& path, const std::vector<std::byte>& image) {
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    size_t written = 0;
+    while (written < image.size()) {
+        const ssize_t w = ::write(fd, image.data() + written, image.size() - written);
+        if (w <= 0) {
+            ::close(fd);
+            return false;
+        }
+        written += static_cast<size_t>(w);
+    }
+    return ::close(fd) == 0;
+}
+
+/**
+ * @tparam Engine simd::f32_solver or environment<VT, W>
+ */
+template <typename Engine>
+bool save_snapshot(const std::string& path, const Engine& engine) {
+    std::vector<std::byte> image;
+    capture(engine, image);
+    return write_snapshot(path, image);
+}
+
+/**
+ * Maps the snapshot file and restores `engine` from it, see restore()
+ */
+template <typename Engine, typename... Storage>
+bool load_snapshot(const std::string& path, Engine& engine, Storage... storage) {
+    const snapshot_file file(path);
+    return file.is_open() && restore(file.view(), engine, storage...);
+}
+
+/**
+ * @brief In-memory ring of the last N snapshots, for rewinding a running simulation.
+ * Slots keep their capacity, so pushing a scene of constant size does not allocate.
+ */
+class snapshot_ring {
+private:
+    std::vector<std::vector<std::byte>> _slots;
+    size_t                              _next = 0;  // slot the next push overwrites
+    size_t                              _size = 0;
+
+public:
+    explicit snapshot_ring(size_t capacity) : _slots(std::max<size_t>(1, capacity)) {}
+
+    template <typename Engine>
+    void push(const Engine& engine) {
+        capture(engine, _slots[_next]);
+        _next = (_next + 1) % _slots.size();
+        _size = std::min(_size + 1, _slots.size());
+    }
+
+    size_t size() const noexcept { return _size; }
+    size_t capacity() const noexcept { return _slots.size(); }
+    void clear() noexcept { _next = _size = 0; }
+
+    /**
+     * @param back 0 for the latest snapshot, 1 for the one before, ...
+     */
+    snapshot_view at(size_t back) const noexcept {
+        if (back >= _size) {
+            return snapshot_view();
+        }
+        const std::vector<std::byte>& slot = _slots[(_next + _slots.size() - 1 - back) % _slots.size()];
+        return snapshot_view(slot.data(), slot.size());
+    }
+
+    /**
+     * Restores `engine` to the snapshot `back` pushes ago and drops the newer ones
+     */
+    template <typename Engine>
+    bool rewind(size_t back, Engine& engine) {
+        if (!restore(at(back), engine)) {
+            return false;
+        }
+        _next = (_next + _slots.size() - back) % _slots.size();
+        _size -= back;
+        return true;
+    }
+};
+
+} // namespace collision_engine
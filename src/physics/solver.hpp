@@ -1,10 +1,19 @@
 #pragma once
 
+#include "common/handle_table.hpp"
+#include "common/profiler.hpp"
 #include "common/thread_pool.hpp"
+#include "common/task_graph.hpp"
 #include "object.hpp"
 #include "grid.hpp"
-#include <arm_neon.h>
+#include "spatial_hash.hpp"
+#include "sweep_and_prune.hpp"
+#include "common/simd.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstdint>
+#include <utility>
 #include <vector>
 
 namespace collision_engine {
@@ -18,8 +27,26 @@ private:
     using T = typename vec_traits<VT>::element_type;
 
     grid<particle<VT>, W>       _grid;
+    hierarchical_grid<particle<VT>, W> _coarse;         // particles too large for _grid's cells
+    std::vector<uint32_t>       _coarse_ids;
+    std::vector<uint8_t>        _is_coarse;
+    const broadphase            _broadphase;
+    spatial_hash                _hash;                  // every particle, with broadphase::spatial_hash
+    sweep_and_prune             _sap;                   // every particle, with broadphase::sweep_and_prune
     std::vector<particle<VT>*>  _particles;
+    handle_table                _handles;
     thread_pool                 _tp;
+    task_graph                  _graph;
+    T                           _sub_dt = 0;
+
+    // [first, last) grid rows of each stripe, every stripe is at least 2 rows tall
+    std::vector<std::pair<uint32_t, uint32_t>>          _stripes;
+    std::vector<uint32_t>                               _row_stripe;    // stripe index of each grid row
+    std::vector<std::vector<uint32_t>>                  _members;       // particles binned into each stripe
+    std::vector<std::array<std::vector<uint32_t>, 3>>   _outbox;        // particles leaving each stripe for stripe k-1, k, k+1
+    std::vector<uint32_t>                               _cell_counts;   // particles per cell the stripes are balanced on
+    std::vector<uint32_t>                               _particle_cells;
+    std::vector<uint64_t>                               _row_work;
 
     // Constants
     W                           _world_size;
@@ -28,17 +55,89 @@ private:
     static constexpr T          _margin             = 4.f; 
     static constexpr T          _response_coef      = 4.f;
     static constexpr uint32_t   _sub_steps          = 4;
+    static constexpr uint32_t   _rebalance_interval = 60;   // frames between forced rebuilds (and stripe rebalancing)
+
+    // the graph keeps the grid up to date incrementally between full rebuilds
+    bool                                        _needs_rebuild          = true;
+    size_t                                      _binned_count           = 0;    // particles in the grid after the last rebuild
+    uint32_t                                    _frames_since_rebuild   = 0;
+    std::array<std::atomic_uint32_t, _sub_steps> _migrations            = {};   // particles that changed cell in each substep
+
+    // sleeping, off unless enabled: see enable_sleeping
+    bool                        _sleeping           = false;
+    T                           _sleep_threshold_sq = 0;
+    uint32_t                    _sleep_substeps     = 0;
+    std::vector<uint32_t>       _rest;          // consecutive calm substeps of each particle
+    std::vector<uint32_t>       _cell_awake;    // particles per cell that did not rest long enough
 
 public:
-    environment(W world_size) noexcept : _world_size(world_size), _grid{world_size, 128, 128} {};
+    /**
+     * @param threads worker threads of the environment's pool
+     * @param bp broadphase::spatial_hash (with cells fitting the largest particle) or
+     *           broadphase::sweep_and_prune find the pairs instead of the 128x128 grid;
+     *           step() then runs step_barrier()
+     */
+    environment(W world_size, uint32_t threads = thread_pool::hardware_threads(), broadphase bp = broadphase::uniform_grid) noexcept
+        : _world_size(world_size), _grid{world_size, 128, 128}, _coarse{world_size, 64, 64, grid_levels::max_levels}, _broadphase(bp), _tp(threads) {
+        build_stripes();
+        build_graph();
+    };
     
-    void add_particle(particle<VT> *p) noexcept { _particles.push_back(p); }
-    void remove_particle(particle<VT>* p) {}
+    /**
+     * @return stable handle of the particle, valid until it is removed (see handle_table)
+     */
+    uint32_t add_particle(particle<VT> *p) noexcept {
+        _particles.push_back(p);
+        _rest.push_back(0);
+        return _handles.add();
+    }
+
+    /**
+     * Drops the particles of the given handles (stale ones are skipped) in one pass, moving
+     * the last particles into the holes they leave; the caller still owns their storage.
+     * The grid and stripes are rebuilt at the next step.
+     *
+     * @return number of particles removed
+     */
+    uint32_t remove_particles(const std::vector<uint32_t>& handles) {
+        const size_t n = _particles.size();
+        for (const auto& [from, to] : _handles.remove(handles.data(), handles.size())) {
+            _particles[to] = _particles[from];
+            _rest[to] = _rest[from];
+        }
+        _particles.resize(_handles.size());
+        _rest.resize(_handles.size());
+        if (_particles.size() != n) {
+            _needs_rebuild = true;
+            _grid.clear(0); // step_barrier's update() repopulates it
+        }
+        return n - _particles.size();
+    }
+
+    bool remove_particle(uint32_t handle) { return remove_particles({handle}) != 0; }
     void stop() { _tp.stop(); }
     
     const std::vector<particle<VT>*>& particles() const noexcept { return _particles; }
+    const handle_table& handles() const noexcept { return _handles; }
+    static constexpr uint32_t sub_steps() noexcept { return _sub_steps; }
+    uint32_t thread_count() const noexcept { return _tp.thread_count; }
+    W world_size() const noexcept { return _world_size; }
+    const spatial_hash& hash() const noexcept { return _hash; }
+    const sweep_and_prune& sap() const noexcept { return _sap; }
+
+    /**
+     * Forces a full grid rebuild at the next step, needed after particles were moved from
+     * outside (e.g. restored from a snapshot) further than one cell. Sleepers are woken.
+     */
+    void invalidate_grid() noexcept {
+        _needs_rebuild = true;
+        std::fill(_rest.begin(), _rest.end(), 0);
+    }
     
-    void resolve_particle_collision(uint32_t p1_idx, uint32_t p2_idx) const noexcept {
+    /**
+     * @return whether the two particles overlapped (and were pushed apart)
+     */
+    bool resolve_particle_collision(uint32_t p1_idx, uint32_t p2_idx) const noexcept {
         particle<VT>* p1 = _particles[p1_idx];
         particle<VT>* p2 = _particles[p2_idx];
         const T r1 = p1->radius;
@@ -47,7 +146,7 @@ public:
         const VT p2_p1 = p1->position - p2->position;
         const T dist_sq = (p2_p1.i() * p2_p1.i()) + (p2_p1.j() * p2_p1.j());
 
-        if (dist_sq < combined_radius * combined_radius) {
+        if (dist_sq < combined_radius * combined_radius && dist_sq > _eps) {
             const T dist = sqrt(dist_sq);
             const T recip_combined_radius = 1 / combined_radius;
             const T delta = _response_coef * (combined_radius - dist) * recip_combined_radius;
@@ -56,84 +155,672 @@ public:
 
             p1->position += col_vec * (r2 * recip_combined_radius); // simulates momentum
             p2->position -= col_vec * (r1 * recip_combined_radius); 
+            return true;
         }
+        return false;
     }
 
-    void resolve_cell_collision(uint32_t cell_id, uint32_t o_cell_id) {
+    /**
+     * @return number of overlapping pairs that were pushed apart
+     */
+    uint32_t resolve_cell_collision(uint32_t cell_id, uint32_t o_cell_id) {
         if (!_grid.is_valid_cell(o_cell_id)) {
-            return;
+            return 0;
         }
         std::vector<cell<particle<VT>*>>& cells = _grid.cells();
         std::vector<uint32_t>& cur_cell = cells[cell_id].particle_ids();
         std::vector<uint32_t>& o_cell = cells[o_cell_id].particle_ids();
         
+        uint32_t contacts = 0;
         for (uint32_t c_particle_id : cur_cell) {
             for (uint32_t o_particle_id : o_cell) {
                 if(c_particle_id == o_particle_id) continue;
-                resolve_particle_collision(c_particle_id, o_particle_id); // resovlve 1v1 particle collision
+                contacts += resolve_particle_collision(c_particle_id, o_particle_id); // resovlve 1v1 particle collision
             }
         }
+        return contacts;
     }
 
     void resolve_collisions(uint32_t start, uint32_t end) {
+        std::vector<cell<particle<VT>*>>& cells = _grid.cells();
+        // profiling counters are summed per task and only in CE_PROFILE builds
+        [[maybe_unused]] uint64_t pair_tests = 0;
+        [[maybe_unused]] uint64_t contacts = 0;
+        [[maybe_unused]] uint64_t max_occupancy = 0;
+
         for (uint32_t cell_id = start; cell_id < end; cell_id++) {
-            resolve_cell_collision(cell_id, cell_id);
-            resolve_cell_collision(cell_id, cell_id - 1);
-            resolve_cell_collision(cell_id, cell_id + 1);
+            if (_sleeping && quiet(cell_id)) {
+                continue; // every pair here is between sleepers
+            }
+            const uint64_t occupancy = cells[cell_id].particle_ids().size();
+            max_occupancy = std::max(max_occupancy, occupancy);
+            const auto resolve = [&](uint32_t o_cell_id) {
+                if constexpr (profiling) {
+                    if (_grid.is_valid_cell(o_cell_id)) {
+                        pair_tests += occupancy * cells[o_cell_id].particle_ids().size() - (o_cell_id == cell_id ? occupancy : 0);
+                    }
+                    contacts += resolve_cell_collision(cell_id, o_cell_id);
+                } else {
+                    resolve_cell_collision(cell_id, o_cell_id);
+                }
+            };
+            // neighbours are skipped across the left/right edges, a wrapped neighbour
+            // lies two rows away and would break the stripe disjointness
+            const uint32_t col = cell_id % _grid.n_cols;
+            const bool has_left = col > 0;
+            const bool has_right = col + 1 < _grid.n_cols;
+
+            resolve(cell_id);
+            if (has_left)   resolve(cell_id - 1);
+            if (has_right)  resolve(cell_id + 1);
 
-            resolve_cell_collision(cell_id, cell_id + _grid.n_cols);
-            resolve_cell_collision(cell_id, cell_id + _grid.n_cols - 1);
-            resolve_cell_collision(cell_id, cell_id + _grid.n_cols + 1);
+            resolve(cell_id + _grid.n_cols);
+            if (has_left)   resolve(cell_id + _grid.n_cols - 1);
+            if (has_right)  resolve(cell_id + _grid.n_cols + 1);
 
-            resolve_cell_collision(cell_id, cell_id - _grid.n_cols);
-            resolve_cell_collision(cell_id, cell_id - _grid.n_cols - 1);
-            resolve_cell_collision(cell_id, cell_id - _grid.n_cols + 1);
+            resolve(cell_id - _grid.n_cols);
+            if (has_left)   resolve(cell_id - _grid.n_cols - 1);
+            if (has_right)  resolve(cell_id - _grid.n_cols + 1);
         }
+        CE_PROFILE_COUNT(pair_tests, pair_tests);
+        CE_PROFILE_COUNT(contacts, contacts);
+        CE_PROFILE_MAX(max_cell_occupancy, max_occupancy);
     }
     
+    /**
+     * Resolves all collisions of the populated grid in two waves (even stripes, then odd
+     * ones), with stripe boundaries balanced on the current per-cell particle counts
+     */
     void resolve_collisions_multi() {
-        uint32_t cells_per_thread = _grid.cell_count / (_tp.thread_count * 2);
-        uint32_t start, end;
-        for (uint32_t i = 0; i < _tp.thread_count; i++) {
-            start = 2 * i * cells_per_thread;
-            end = start + cells_per_thread;
-            _tp.submit([this, start, end]() { resolve_collisions(start, end); });
+        std::vector<cell<particle<VT>*>>& cells = _grid.cells();
+        for (uint32_t cell_id = 0; cell_id < _grid.cell_count; cell_id++) {
+            _cell_counts[cell_id] = cells[cell_id].particle_ids().size();
         }
-        _tp.wait_for_tasks();
-        for (uint32_t i = 0; i < _tp.thread_count; i++) {
-            start = (2 * i + 1) * cells_per_thread;
-            end = start + cells_per_thread;
-            _tp.submit([this, start, end]() { resolve_collisions(start, end); });
+        balance_stripes();
+
+        for (uint32_t colour = 0; colour < 2; colour++) {
+            for (uint32_t s = colour; s < _stripes.size(); s += 2) {
+                const uint32_t start = _stripes[s].first * _grid.n_cols;
+                const uint32_t end = _stripes[s].second * _grid.n_cols;
+                _tp.submit([this, start, end]() {
+                    CE_PROFILE_SCOPE("collide");
+                    resolve_collisions(start, end);
+                });
+            }
+            _tp.wait_for_tasks();
+        }
+    }
+
+    /**
+     * @return largest radius _grid's cells fit, larger particles are coarse
+     */
+    T fine_radius() const noexcept { return std::min(_grid.cell_width(), _grid.cell_height()) / 2.f; }
+
+    /**
+     * Resolves every pair involving a coarse particle: among themselves through the
+     * hierarchy, and against the fine particles of _grid within reach of each. Runs on
+     * one thread once the stripes are done, coarse particles being few.
+     */
+    void resolve_coarse() {
+        [[maybe_unused]] uint64_t pair_tests = 0;
+        [[maybe_unused]] uint64_t contacts = 0;
+        const auto resolve = [&](uint32_t a, uint32_t b) {
+            pair_tests++;
+            contacts += resolve_particle_collision(a, b);
+        };
+        _coarse.populate(_particles, _coarse_ids);
+        _coarse.for_each_pair(_particles, resolve);
+        const T reach = fine_radius();
+        for (uint32_t idx : _coarse_ids) {
+            const particle<VT>* p = _particles[idx];
+            _grid.for_each_near(p->position.i(), p->position.j(), p->radius + reach, [&](uint32_t o) { resolve(idx, o); });
+        }
+        CE_PROFILE_COUNT(pair_tests, pair_tests);
+        CE_PROFILE_COUNT(contacts, contacts);
+    }
+
+    void update_object(particle<VT>* particle, T dt) {
+        particle->acceleration += _gravity;
+        particle->step(dt); // update particle position and trajectory
+        
+        if (particle->position.i() > _world_size.i() - _margin) { // boundary checks
+            particle->position.set_i(_world_size.i() - _margin);
+        } else if (particle->position.i() < _margin) {
+            particle->position.set_i(_margin);
+        }
+
+        if (particle->position.j() > _world_size.j() - _margin) { // boundary checks
+            particle->position.set_j(_world_size.j() - _margin);
+        } else if (particle->position.j() < _margin) {
+            particle->position.set_j(_margin);
         }
-        _tp.wait_for_tasks();
     }
 
     void update_objects(T dt) {
+        if (_sleeping) {
+            for (uint32_t idx = 0; idx < _particles.size(); idx++) {
+                if (!_coarse_ids.empty() && _is_coarse[idx]) {
+                    update_object(_particles[idx], dt); // coarse particles are never put to sleep
+                    continue;
+                }
+                update_or_sleep(idx, dt);
+            }
+            return;
+        }
         for (auto *particle : _particles) {
-            particle->acceleration += _gravity;
-            particle->step(dt); // update particle position and trajectory
-            
-            if (particle->position.i() > _world_size.i() - _margin) { // boundary checks
-                particle->position.set_i(_world_size.i() - _margin);
-            } else if (particle->position.i() < _margin) {
-                particle->position.set_i(_margin);
+            update_object(particle, dt);
+        } 
+    }
+
+    /**
+     * Integrates particle idx unless it is asleep: it moved less than the threshold for
+     * long enough and no awake particle is in the 3x3 cells around it. A sleeper keeps its
+     * position and loses its velocity, its rest counter is updated either way. The cell it
+     * is binned in is used, so a task only reads the counts of its own and adjacent stripes.
+     */
+    void update_or_sleep(uint32_t idx, T dt) {
+        particle<VT>* p = _particles[idx];
+        const VT d = p->position - p->prev_position;
+        const bool calm = d.i() * d.i() + d.j() * d.j() < _sleep_threshold_sq;
+        _rest[idx] = calm ? std::min(_rest[idx] + 1, _sleep_substeps) : 0;
+        if (calm && _rest[idx] >= _sleep_substeps && quiet(_grid.cell_of(idx))) {
+            p->prev_position = p->position;
+            p->acceleration = VT{0.f, 0.f};
+            return;
+        }
+        update_object(p, dt);
+    }
+
+    /**
+     * A particle falls asleep once it moved less than `threshold` pixels per substep for
+     * `substeps` substeps in a row while its neighbourhood is quiet. Cells whose whole 3x3
+     * neighbourhood is asleep are skipped by the collision pass.
+     */
+    void enable_sleeping(T threshold = 0.01f, uint32_t substeps = 60) {
+        _sleeping = true;
+        _sleep_threshold_sq = threshold * threshold;
+        _sleep_substeps = substeps;
+        _rest.assign(_particles.size(), 0);
+        _cell_awake.assign(_grid.cell_count, 0);
+    }
+
+    void disable_sleeping() noexcept { _sleeping = false; }
+
+    /**
+     * @return whether particle idx rested long enough to sleep (its neighbours decide whether it does)
+     */
+    bool resting(uint32_t idx) const noexcept { return _sleeping && _rest[idx] >= _sleep_substeps; }
+
+    /**
+     * @return whether no awake particle is in cell_id and its 8 neighbours
+     */
+    bool quiet(uint32_t cell_id) const noexcept {
+        const uint32_t row = cell_id / _grid.n_cols;
+        const uint32_t col = cell_id % _grid.n_cols;
+        for (uint32_t r = row > 0 ? row - 1 : row; r <= std::min(row + 1, _grid.n_rows - 1); r++) {
+            for (uint32_t c = col > 0 ? col - 1 : col; c <= std::min(col + 1, _grid.n_cols - 1); c++) {
+                if (_cell_awake[r * _grid.n_cols + c]) {
+                    return false;
+                }
             }
+        }
+        return true;
+    }
 
-            if (particle->position.j() > _world_size.j() - _margin) { // boundary checks
-                particle->position.set_j(_world_size.j() - _margin);
-            } else if (particle->position.j() < _margin) {
-                particle->position.set_j(_margin);
+    /**
+     * Substeps with a global barrier after every phase (populate, even stripes, odd stripes,
+     * integrate). Over the spatial hash or sweep and prune, rebuilt each substep, each
+     * candidate pair is resolved both ways, as the grid's full 3x3 pass does, and sleeping
+     * and the coarse levels do not apply.
+     */
+    void step_barrier(T dt) {
+        CE_PROFILE_SCOPE("step");
+        const float32_t sub_dt = dt / static_cast<float32_t>(_sub_steps);
+        const bool dense = _broadphase == broadphase::uniform_grid;
+        if (dense) {
+            split_particles();
+        } else if (_broadphase == broadphase::spatial_hash) {
+            size_hash();
+        }
+        for(uint32_t i = 0; i < _sub_steps; i++) {
+            {
+                CE_PROFILE_SCOPE("populate");
+                if (dense) {
+                    populate_grid();
+                } else {
+                    with_sparse([this](auto& b) { populate_sparse(b); });
+                }
             }
-        } 
+            if (dense) {
+                _migrations[i] = _grid.migrations();
+                if (_sleeping) {
+                    count_awake(0, _grid.n_rows);
+                }
+            }
+            {
+                CE_PROFILE_SCOPE("resolve_collisions_multi");
+                if (dense) {
+                    resolve_collisions_multi();
+                } else {
+                    with_sparse([this](auto& b) { resolve_sparse(b); });
+                }
+            }
+            if (!_coarse_ids.empty()) {
+                CE_PROFILE_SCOPE("coarse");
+                resolve_coarse();
+            }
+            {
+                CE_PROFILE_SCOPE("update_objects");
+                if (dense) {
+                    update_objects(sub_dt);
+                } else {
+                    update_objects_parallel(sub_dt);
+                }
+            }
+        }
+        _needs_rebuild = true; // the stripe bookkeeping of step() is stale now
     }
-    
+
+    /**
+     * Runs all substeps as one task graph of per-stripe bin -> collide -> integrate tasks,
+     * so stripes only wait on their neighbours instead of on every core at each phase;
+     * the sparse broadphases have no stripes to chain and run step_barrier
+     */
     void step(T dt) {
-        const float32_t sub_dt = dt / static_cast<float32_t>(_sub_steps);
-        for(uint32_t i{_sub_steps}; i--;) {
-            _grid.populate(_particles);
-            resolve_collisions_multi();
-            update_objects(sub_dt);
+        if (_broadphase != broadphase::uniform_grid) {
+            step_barrier(dt);
+            return;
+        }
+        CE_PROFILE_SCOPE("step");
+        _sub_dt = dt / static_cast<T>(_sub_steps);
+        {
+            CE_PROFILE_SCOPE("seed");
+            seed_stripes();
+        }
+        for (auto& m : _migrations) { m.store(0, std::memory_order_relaxed); }
+        _graph.run(_tp);
+    }
+
+    /**
+     * @return particles that changed cell in each substep of the last step
+     */
+    std::array<uint32_t, _sub_steps> migrations() const noexcept {
+        std::array<uint32_t, _sub_steps> migrations;
+        for (uint32_t s = 0; s < _sub_steps; s++) {
+            migrations[s] = _migrations[s].load(std::memory_order_relaxed);
+        }
+        return migrations;
+    }
+
+    const std::vector<std::pair<uint32_t, uint32_t>>& stripes() const noexcept { return _stripes; }
+
+    /**
+     * @return nanoseconds each worker thread spent running tasks since the last reset
+     */
+    std::vector<uint64_t> busy_time() const { return _tp.busy_time(); }
+    void reset_busy_time() noexcept { _tp.reset_busy_time(); }
+
+private:
+    /**
+     * Bins the fine particles on _grid, the coarse ones being left to resolve_coarse
+     */
+    void populate_grid() {
+        if (_coarse_ids.empty()) {
+            _grid.update(_particles);
+            return;
+        }
+        _grid.clear(_particles.size());
+        for (uint32_t idx = 0; idx < _particles.size(); idx++) {
+            if (!_is_coarse[idx]) {
+                _grid.insert(_grid.get_cell_id(_particles[idx]->position.i(), _particles[idx]->position.j()), idx);
+            }
+        }
+    }
+
+    /**
+     * Fits the spatial hash's cells to the largest particle
+     */
+    void size_hash() {
+        T max_radius = 0;
+        for (const particle<VT>* p : _particles) {
+            max_radius = std::max(max_radius, p->radius);
+        }
+        const T size = std::max(2 * max_radius, T{1});
+        if (size != _hash.cell_size()) {
+            _hash.resize(size);
+        }
+    }
+
+    /**
+     * Calls f with the sparse broadphase the environment was built with
+     */
+    template <typename F>
+    void with_sparse(F f) {
+        if (_broadphase == broadphase::spatial_hash) {
+            f(_hash);
+        } else {
+            f(_sap);
+        }
+    }
+
+    template <sparse_broadphase B>
+    void populate_sparse(B& b) {
+        b.populate(_particles.size(), [this](uint32_t idx) {
+            const particle<VT>* p = _particles[idx];
+            return std::array{p->position.i(), p->position.j(), p->radius};
+        });
+    }
+
+    /**
+     * Resolves every candidate pair of b both ways, in even then odd stripes
+     */
+    template <sparse_broadphase B>
+    void resolve_sparse(B& b) {
+        const auto& stripes = b.stripes(2 * _tp.thread_count);
+        for (uint32_t colour = 0; colour < 2; colour++) {
+            for (uint32_t s = colour; s < stripes.size(); s += 2) {
+                const auto [first, last] = stripes[s];
+                _tp.submit([this, &b, first, last]() {
+                    CE_PROFILE_SCOPE("collide");
+                    [[maybe_unused]] uint64_t pair_tests = 0;
+                    [[maybe_unused]] uint64_t contacts = 0;
+                    b.for_each_pair(first, last, [&](uint32_t p1, uint32_t p2) {
+                        pair_tests += 2;
+                        contacts += resolve_particle_collision(p1, p2);
+                        contacts += resolve_particle_collision(p2, p1);
+                    });
+                    CE_PROFILE_COUNT(pair_tests, pair_tests);
+                    CE_PROFILE_COUNT(contacts, contacts);
+                });
+            }
+            _tp.wait_for_tasks();
+        }
+    }
+
+    /**
+     * Integrates every particle in one chunk per thread, none sleeping
+     */
+    void update_objects_parallel(T sub_dt) {
+        const uint32_t count = _particles.size();
+        const uint32_t chunk = (count + _tp.thread_count - 1) / _tp.thread_count;
+        for (uint32_t begin = 0; begin < count; begin += chunk) {
+            const uint32_t end = std::min(begin + chunk, count);
+            _tp.submit([this, begin, end, sub_dt]() {
+                CE_PROFILE_SCOPE("integrate");
+                for (uint32_t idx = begin; idx < end; idx++) {
+                    update_object(_particles[idx], sub_dt);
+                }
+            });
+        }
+        _tp.wait_for_tasks();
+    }
+
+    /**
+     * Splits the particles into the ones _grid's cells fit, owned by the stripes, and the
+     * coarse ones
+     *
+     * @return whether there were coarse particles before but none now, or the other way round
+     */
+    bool split_particles() {
+        const bool had_coarse = !_coarse_ids.empty();
+        const T fine = fine_radius();
+        _coarse_ids.clear();
+        _is_coarse.assign(_particles.size(), 0);
+        for (uint32_t idx = 0; idx < _particles.size(); idx++) {
+            if (_particles[idx]->radius > fine) {
+                _coarse_ids.push_back(idx);
+                _is_coarse[idx] = 1;
+            }
+        }
+        return had_coarse != !_coarse_ids.empty();
+    }
+
+    void build_stripes() {
+        // more stripes than threads, so the graph has independent work to overlap phases with,
+        // but at most a quarter of the rows, so balance_stripes has room to move the boundaries
+        const uint32_t stripe_count = std::max(1u, std::min(4 * _tp.thread_count, _grid.n_rows / 4));
+        _stripes.resize(stripe_count);
+        _row_stripe.resize(_grid.n_rows);
+        _members.resize(stripe_count);
+        _outbox.resize(stripe_count);
+        _cell_counts.assign(_grid.cell_count, 0);
+        _row_work.resize(_grid.n_rows);
+        balance_stripes(); // no particles yet: equal row counts
+    }
+
+    /**
+     * Moves the stripe boundaries so every stripe carries about the same collision work,
+     * estimated per cell as its particle count times the particle count of its 3x3
+     * neighbourhood (plus one per particle for binning and integration). The stripe
+     * count stays fixed and every stripe keeps at least 2 rows, so the two-colour
+     * schedule stays race-free.
+     */
+    void balance_stripes() {
+        const uint32_t n_rows = _grid.n_rows;
+        const uint32_t n_cols = _grid.n_cols;
+        const uint32_t n = _stripes.size();
+
+        uint64_t total = 0;
+        for (uint32_t row = 0; row < n_rows; row++) {
+            uint64_t work = 0;
+            for (uint32_t col = 0; col < n_cols; col++) {
+                const uint32_t count = _cell_counts[row * n_cols + col];
+                if (count == 0) continue;
+                uint32_t neighbours = 0;
+                for (uint32_t r = (row > 0 ? row - 1 : row); r <= std::min(row + 1, n_rows - 1); r++) {
+                    for (uint32_t c = (col > 0 ? col - 1 : col); c <= std::min(col + 1, n_cols - 1); c++) {
+                        neighbours += _cell_counts[r * n_cols + c];
+                    }
+                }
+                work += static_cast<uint64_t>(count) * (neighbours + 1);
+            }
+            _row_work[row] = work + 1; // empty rows still cost a sweep over their cells
+            total += _row_work[row];
+        }
+
+        uint32_t first = 0;
+        uint64_t acc = 0;
+        for (uint32_t s = 0; s < n; s++) {
+            uint32_t last = n_rows;
+            if (s + 1 < n) {
+                // an even share of the work left, so a stripe forced past its share by the
+                // 2 row minimum does not squeeze the ones after it
+                const uint64_t target = acc + (total - acc) / (n - s);
+                const uint32_t max_last = n_rows - 2 * (n - 1 - s); // leave 2 rows for every later stripe
+                last = first + 2;
+                acc += _row_work[first] + _row_work[first + 1];
+                while (last < max_last && acc + _row_work[last] / 2 < target) {
+                    acc += _row_work[last++];
+                }
+            }
+            std::fill(_row_stripe.begin() + first, _row_stripe.begin() + last, s);
+            _stripes[s] = {first, last};
+            first = last;
+        }
+    }
+
+    /**
+     * Per substep s and stripe k:
+     *   bin(s, k)       <- integrate(s - 1, k - 1 .. k + 1)
+     *   collide(s, k)   <- bin(s, k - 1 .. k + 1), and for odd k also collide(s, k +- 1)
+     *   integrate(s, k) <- collide(s, k - 1 .. k + 1)
+     * Every particle is owned by one stripe per substep and only touched by tasks of that
+     * stripe and its neighbours, which these edges order. Coarse particles belong to no
+     * stripe; while there are any, a coarse(s) task between every collide(s, k) and every
+     * integrate(s, k) resolves and integrates them.
+     */
+    void build_graph() {
+        const uint32_t n = _stripes.size();
+        std::vector<task_graph::task_id> bin(n), collide(n), integrate(n), prev_integrate;
+
+        for (uint32_t s = 0; s < _sub_steps; s++) {
+            for (uint32_t k = 0; k < n; k++) {
+                bin[k] = _graph.add([this, k]() {
+                    CE_PROFILE_SCOPE("bin");
+                    bin_stripe(k);
+                });
+                collide[k] = _graph.add([this, k]() {
+                    CE_PROFILE_SCOPE("collide");
+                    resolve_collisions(_stripes[k].first * _grid.n_cols, _stripes[k].second * _grid.n_cols);
+                });
+                integrate[k] = _graph.add([this, k, s]() {
+                    CE_PROFILE_SCOPE("integrate");
+                    integrate_stripe(k, s);
+                });
+            }
+            for (uint32_t k = 0; k < n; k++) {
+                const uint32_t lo = k > 0 ? k - 1 : k;
+                const uint32_t hi = std::min(k + 1, n - 1);
+                for (uint32_t o = lo; o <= hi; o++) {
+                    if (s > 0) { _graph.precede(prev_integrate[o], bin[k]); }
+                    _graph.precede(bin[o], collide[k]);
+                    if (k % 2 == 1 && o != k) { _graph.precede(collide[o], collide[k]); }
+                    _graph.precede(collide[o], integrate[k]);
+                }
+            }
+            if (!_coarse_ids.empty()) {
+                const task_graph::task_id coarse = _graph.add([this]() {
+                    CE_PROFILE_SCOPE("coarse");
+                    resolve_coarse();
+                    for (uint32_t idx : _coarse_ids) {
+                        update_object(_particles[idx], _sub_dt);
+                    }
+                });
+                for (uint32_t k = 0; k < n; k++) {
+                    _graph.precede(collide[k], coarse);
+                    _graph.precede(coarse, integrate[k]);
+                }
+            }
+            prev_integrate = integrate;
+        }
+    }
+
+    /**
+     * Between rebuilds the grid and the stripe membership carry over from the last step,
+     * the first bin tasks consume what the last integrate tasks handed over. A full
+     * rebuild rebalances the stripes on the current particle distribution, empties the
+     * grid and hands every particle to the stripe it lies in. It happens when particles
+     * were added, when a substep of the last step migrated more than `rebuild_fraction`
+     * of the particles, and every `_rebalance_interval` frames.
+     */
+    void seed_stripes() {
+        uint32_t max_migrations = 0;
+        for (const auto& m : _migrations) { max_migrations = std::max(max_migrations, m.load(std::memory_order_relaxed)); }
+        const bool rebuild = _needs_rebuild
+            || _particles.size() != _binned_count
+            || max_migrations > _grid.rebuild_fraction * _particles.size()
+            || ++_frames_since_rebuild >= _rebalance_interval;
+        if (!rebuild) {
+            return;
+        }
+        _needs_rebuild = false;
+        _binned_count = _particles.size();
+        _frames_since_rebuild = 0;
+        if (split_particles()) {
+            _graph.clear();
+            build_graph();
+        }
+
+        std::fill(_cell_counts.begin(), _cell_counts.end(), 0);
+        _particle_cells.resize(_particles.size());
+        for (uint32_t idx = 0; idx < _particles.size(); idx++) {
+            const particle<VT>* p = _particles[idx];
+            _particle_cells[idx] = _grid.get_cell_id(p->position.i(), p->position.j());
+            _cell_counts[_particle_cells[idx]] += !_is_coarse[idx];
+        }
+        balance_stripes();
+
+        _grid.clear(_particles.size());
+        for (auto& members : _members) { members.clear(); }
+        for (auto& outbox : _outbox) {
+            for (auto& ids : outbox) { ids.clear(); }
+        }
+        for (uint32_t idx = 0; idx < _particles.size(); idx++) {
+            if (!_is_coarse[idx]) {
+                _outbox[_row_stripe[_particle_cells[idx] / _grid.n_cols]][1].push_back(idx);
+            }
+        }
+    }
+
+    /**
+     * Bins the particles the neighbours (and stripe k itself) handed over into the cells
+     * of stripe k. A particle that moved further than one stripe in a substep is clamped
+     * into the nearest row of the neighbour it reached; it only misses collisions until
+     * it catches up, one stripe per substep.
+     */
+    void bin_stripe(uint32_t k) {
+        const auto [first, last] = _stripes[k];
+        const uint32_t lo = k > 0 ? k - 1 : k;
+        const uint32_t hi = std::min<uint32_t>(k + 1, _stripes.size() - 1);
+        for (uint32_t o = lo; o <= hi; o++) {
+            for (uint32_t idx : _outbox[o][k + 1 - o]) {
+                const particle<VT>* p = _particles[idx];
+                const uint32_t cell_id = _grid.get_cell_id(p->position.i(), p->position.j());
+                const uint32_t row = std::clamp(cell_id / _grid.n_cols, first, last - 1);
+                _grid.insert(row * _grid.n_cols + cell_id % _grid.n_cols, idx);
+                _members[k].push_back(idx);
+            }
+        }
+        if (_sleeping) {
+            count_awake(first, last);
+        }
+    }
+
+    /**
+     * Recounts the awake particles of the cells in grid rows [first, last). A coarse
+     * particle never sleeps and counts in every cell within its reach of the fine ones, so
+     * the sleepers it pushes are resolved against their neighbours in the same substep.
+     */
+    void count_awake(uint32_t first, uint32_t last) {
+        std::vector<cell<particle<VT>*>>& cells = _grid.cells();
+        for (uint32_t cell_id = first * _grid.n_cols; cell_id < last * _grid.n_cols; cell_id++) {
+            uint32_t awake = 0;
+            for (uint32_t idx : cells[cell_id].particle_ids()) {
+                awake += !resting(idx);
+            }
+            _cell_awake[cell_id] = awake;
+        }
+        const T reach = fine_radius();
+        for (uint32_t idx : _coarse_ids) {
+            const particle<VT>* p = _particles[idx];
+            _grid.for_each_cell_near(p->position.i(), p->position.j(), p->radius + reach, [&](uint32_t cell_id) {
+                const uint32_t row = cell_id / _grid.n_cols;
+                if (row >= first && row < last) {
+                    _cell_awake[cell_id]++;
+                }
+            });
+        }
+    }
+
+    /**
+     * Integrates the particles of stripe k. Particles that stay in their cell are left
+     * alone, the rest are removed from their cell and handed to the stripe they reached.
+     */
+    void integrate_stripe(uint32_t k, uint32_t substep) {
+        for (auto& ids : _outbox[k]) { ids.clear(); }
+
+        const uint32_t lo = k > 0 ? k - 1 : k;
+        const uint32_t hi = std::min<uint32_t>(k + 1, _stripes.size() - 1);
+        std::vector<uint32_t>& members = _members[k];
+        size_t kept = 0;
+        for (uint32_t idx : members) {
+            particle<VT>* p = _particles[idx];
+            if (_sleeping) {
+                update_or_sleep(idx, _sub_dt);
+            } else {
+                update_object(p, _sub_dt);
+            }
+            const uint32_t cell_id = _grid.get_cell_id(p->position.i(), p->position.j());
+            if (cell_id == _grid.cell_of(idx)) {
+                members[kept++] = idx;
+                continue;
+            }
+            _grid.remove(idx);
+            const uint32_t dest = std::clamp(_row_stripe[cell_id / _grid.n_cols], lo, hi);
+            _outbox[k][dest + 1 - k].push_back(idx);
         }
+        _migrations[substep].fetch_add(members.size() - kept, std::memory_order_relaxed);
+        members.resize(kept);
     }
 };
 
@@ -0,0 +1,294 @@
+#pragma once
+
+#include "broadphase.hpp"
+#include "common/simd.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace collision_engine {
+
+/**
+ * @brief Sparse uniform grid over the unbounded plane: only the cells holding particles
+ * exist, found through an open-addressing table (linear probing, Fibonacci hashing) keyed
+ * by their integer coordinates, so memory follows the occupied cells rather than the world.
+ *
+ * populate() lays the particles out in CSR form like the dense grids, over the occupied
+ * cells sorted row-major by (y, x). A cell's right neighbour is then the next cell when
+ * it is occupied, and the occupied cells among the three below it are consecutive, so the
+ * half stencil is still two contiguous slot ranges, see same_row_end and next_row.
+ */
+class spatial_hash {
+public:
+    static constexpr uint32_t npos = ~0u;
+
+private:
+    static constexpr uint64_t   _empty      = ~0ull;    // (INT32_MAX, INT32_MAX), past any clamped coordinate
+    static constexpr int32_t    _max_coord  = 1 << 30;  // cells per half axis
+
+    struct entry {
+        uint64_t key;
+        uint32_t cell;  // occupied cell index, in insertion order until populate sorts them
+    };
+
+    float32_t                   _cell_size      = 1;
+    float32_t                   _inv_cell_size  = 1;
+    std::vector<entry>          _table;             // power of 2 entries, at most half used
+    uint32_t                    _shift          = 64;
+    std::vector<uint64_t>       _keys;              // key of every occupied cell, ascending
+    std::vector<uint32_t>       _offsets;           // exclusive prefix sum of cell counts (cells + 1 entries)
+    std::vector<uint32_t>       _cursor;            // scatter cursors
+    std::vector<uint32_t>       _particle_cells;    // occupied cell of every particle
+    std::vector<std::pair<uint64_t, uint32_t>> _sorted; // (key, insertion index) of the occupied cells
+    std::vector<uint32_t>       _rank;              // sorted index of each insertion index
+    std::vector<std::pair<uint32_t, uint32_t>> _stripes;
+
+    uint32_t probe(uint64_t key) const noexcept {
+        const size_t mask = _table.size() - 1;
+        size_t i = (key * 0x9E3779B97F4A7C15ull) >> _shift;
+        while (_table[i].key != key && _table[i].key != _empty) {
+            i = (i + 1) & mask;
+        }
+        return static_cast<uint32_t>(i);
+    }
+
+    /**
+     * Empties the table at the given power of 2 size
+     */
+    void reset_table(size_t size) {
+        if (_table.size() == size) {
+            std::fill(_table.begin(), _table.end(), entry{_empty, 0});
+        } else {
+            _table.assign(size, entry{_empty, 0});
+        }
+        _shift = 64 - std::countr_zero(size);
+    }
+
+    /**
+     * Doubles the table and reinserts the cells found so far
+     */
+    void grow() {
+        reset_table(2 * _table.size());
+        for (uint32_t c = 0; c < _sorted.size(); c++) {
+            _table[probe(_sorted[c].first)] = {_sorted[c].first, c};
+        }
+    }
+
+public:
+    /**
+     * @param cell_size side of a cell in pixels, at least the largest particle diameter
+     */
+    explicit spatial_hash(float32_t cell_size = 1) { resize(cell_size); }
+
+    /**
+     * Changes the cell size and empties the hash
+     */
+    void resize(float32_t cell_size) {
+        _cell_size = cell_size;
+        _inv_cell_size = 1 / cell_size;
+        _keys.clear();
+        _offsets.assign(1, 0);
+        ids.clear();
+        reset_table(16);
+    }
+
+    float32_t cell_size() const noexcept { return _cell_size; }
+
+    /**
+     * @return integer cell coordinate of pixel coordinate v, clamped to +-2^30 cells
+     */
+    int32_t coordinate(float32_t v) const noexcept {
+        const float32_t c = std::floor(v * _inv_cell_size);
+        return static_cast<int32_t>(std::clamp(c, -static_cast<float32_t>(_max_coord), static_cast<float32_t>(_max_coord)));
+    }
+
+    /**
+     * @return key of cell (cx, cy): biased row in the high half, biased column in the low
+     *         one, so keys ascend row-major
+     */
+    static uint64_t key(int32_t cx, int32_t cy) noexcept {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(cy) ^ 0x80000000u) << 32) | (static_cast<uint32_t>(cx) ^ 0x80000000u);
+    }
+
+    /**
+     * Bins n particles, circle(idx) giving the (x, y, r) of each, into the cells their
+     * centres lie in. Slots follow the sorted cells, and each cell holds its particles in
+     * index order.
+     */
+    template <typename F>
+    void populate(uint32_t n, F circle) {
+        // sized on the last populate's cells with room to spare, so it rarely grows mid-frame
+        // and shrinks back when the particles gather again
+        reset_table(std::bit_ceil(std::max<size_t>(16, 3 * _keys.size())));
+        _particle_cells.resize(n);
+        _sorted.clear();
+        _cursor.clear();
+        for (uint32_t idx = 0; idx < n; idx++) {
+            const auto [x, y, r] = circle(idx);
+            const uint64_t k = key(coordinate(x), coordinate(y));
+            uint32_t i = probe(k);
+            if (_table[i].key == _empty) {
+                if (2 * (_sorted.size() + 1) > _table.size()) {
+                    grow();
+                    i = probe(k);
+                }
+                _table[i] = {k, static_cast<uint32_t>(_sorted.size())};
+                _sorted.emplace_back(k, _sorted.size());
+                _cursor.push_back(0);
+            }
+            _particle_cells[idx] = _table[i].cell;
+            ++_cursor[_table[i].cell];
+        }
+
+        // renumber the cells in key order and point the table at the new numbers
+        std::sort(_sorted.begin(), _sorted.end());
+        const uint32_t cells = _sorted.size();
+        _keys.resize(cells);
+        _rank.resize(cells);
+        _offsets.resize(cells + 1);
+        _offsets[0] = 0;
+        for (uint32_t c = 0; c < cells; c++) {
+            const auto [k, inserted] = _sorted[c];
+            _keys[c] = k;
+            _rank[inserted] = c;
+            _offsets[c + 1] = _offsets[c] + _cursor[inserted];
+            _table[probe(k)].cell = c;
+        }
+
+        std::copy(_offsets.begin(), _offsets.end() - 1, _cursor.begin());
+        ids.resize(n);
+        for (uint32_t idx = 0; idx < n; idx++) {
+            const uint32_t c = _rank[_particle_cells[idx]];
+            _particle_cells[idx] = c;
+            ids[_cursor[c]++] = idx;
+        }
+    }
+
+    uint32_t cell_count() const noexcept { return _keys.size(); }
+
+    /**
+     * @return first slot of occupied cell c, cell_begin(cell_count()) being the slot count
+     */
+    uint32_t cell_begin(uint32_t c) const noexcept { return _offsets[c]; }
+
+    /**
+     * @return occupied cell of particle idx, as of the last populate
+     */
+    uint32_t cell_of(uint32_t idx) const noexcept { return _particle_cells[idx]; }
+
+    int32_t cell_x(uint32_t c) const noexcept { return static_cast<int32_t>(static_cast<uint32_t>(_keys[c]) ^ 0x80000000u); }
+    int32_t cell_y(uint32_t c) const noexcept { return static_cast<int32_t>(static_cast<uint32_t>(_keys[c] >> 32) ^ 0x80000000u); }
+
+    /**
+     * @return occupied cell at (cx, cy), or npos
+     */
+    uint32_t find(int32_t cx, int32_t cy) const noexcept { return find(key(cx, cy)); }
+
+    uint32_t find(uint64_t k) const noexcept {
+        const entry& e = _table[probe(k)];
+        return e.key == k ? e.cell : npos;
+    }
+
+    /**
+     * @return first occupied cell of row cy or after it
+     */
+    uint32_t row_begin(int32_t cy) const noexcept {
+        return std::lower_bound(_keys.begin(), _keys.end(), key(std::numeric_limits<int32_t>::min(), cy)) - _keys.begin();
+    }
+
+    /**
+     * @return end of the slots of cell c and, when occupied, its right neighbour
+     */
+    uint32_t same_row_end(uint32_t c) const noexcept {
+        const bool right = c + 1 < _keys.size() && _keys[c + 1] == _keys[c] + 1;
+        return _offsets[c + (right ? 2 : 1)];
+    }
+
+    /**
+     * @return [first, last) slots of the occupied cells among the three below cell c
+     */
+    std::pair<uint32_t, uint32_t> next_row(uint32_t c) const noexcept {
+        const int32_t cx = cell_x(c), cy = cell_y(c) + 1;
+        uint32_t first = npos, last = npos;
+        for (int32_t x = cx - 1; x <= cx + 1; x++) {
+            const uint32_t o = find(x, cy);
+            if (o != npos) {
+                first = first == npos ? o : first;
+                last = o;
+            }
+        }
+        return first == npos ? std::pair{0u, 0u} : std::pair{_offsets[first], _offsets[last + 1]};
+    }
+
+    /**
+     * Calls f(slot, first, last) for every slot of occupied cells [first, last) with the
+     * slot ranges of its half stencil: the rest of its cell and its right neighbour, then
+     * the cells below. Every candidate pair of the hash is in exactly one range.
+     */
+    template <typename F>
+    void for_each_span(uint32_t first, uint32_t last, F f) const {
+        for (uint32_t c = first; c < last; c++) {
+            const uint32_t end = _offsets[c + 1], row_end = same_row_end(c);
+            const auto [below, below_end] = next_row(c);
+            for (uint32_t s = _offsets[c]; s < end; s++) {
+                f(s, s + 1, row_end);
+                f(s, below, below_end);
+            }
+        }
+    }
+
+    /**
+     * Calls f(a, b) for every candidate pair of particles found from occupied cells
+     * [first, last), each pair of the hash once
+     */
+    template <typename F>
+    void for_each_pair(uint32_t first, uint32_t last, F f) const {
+        for_each_span(first, last, [&](uint32_t s, uint32_t lo, uint32_t hi) {
+            for (uint32_t o = lo; o < hi; o++) {
+                f(ids[s], ids[o]);
+            }
+        });
+    }
+
+    /**
+     * Splits the occupied cells into at most count [first, last) ranges of whole rows with
+     * about as many particles each. Every range spans at least 2 rows, so ranges of one
+     * colour (even/odd index) never touch each other's 3x3 neighbourhoods.
+     */
+    const std::vector<std::pair<uint32_t, uint32_t>>& stripes(uint32_t count) {
+        _stripes.clear();
+        const uint32_t cells = _keys.size();
+        if (!cells) return _stripes;
+        const uint64_t n = _offsets[cells];
+        uint32_t first = 0;
+        for (uint32_t c = 1; c < cells && _stripes.size() + 1 < count; c++) {
+            const int32_t row = cell_y(c);
+            if (row != cell_y(c - 1) && static_cast<int64_t>(row) >= static_cast<int64_t>(cell_y(first)) + 2
+                && _offsets[c] >= n * (_stripes.size() + 1) / count) {
+                _stripes.emplace_back(first, c);
+                first = c;
+            }
+        }
+        _stripes.emplace_back(first, cells);
+        return _stripes;
+    }
+
+    /**
+     * @return bytes held by the table and the per cell arrays; the per particle arrays are
+     *         the same as a dense grid's
+     */
+    size_t memory_bytes() const noexcept {
+        return _table.capacity() * sizeof(entry) + _keys.capacity() * sizeof(uint64_t) + _sorted.capacity() * sizeof(_sorted[0])
+            + (_offsets.capacity() + _cursor.capacity() + _rank.capacity()) * sizeof(uint32_t);
+    }
+
+    std::vector<uint32_t> ids;  // particle index per slot, grouped by cell
+};
+
+static_assert(sparse_broadphase<spatial_hash>);
+
+} // namespace collision_engine
@@ -0,0 +1,245 @@
+#pragma once
+
+#include "broadphase.hpp"
+#include "common/simd.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace collision_engine {
+
+/**
+ * @brief Sweep and prune along x: the particles are kept sorted by the left end of their x
+ * extent, so the particles whose extent overlaps a particle's and that come after it are
+ * the contiguous run of slots up to span_end. Each pair overlapping along x is in exactly
+ * one such span; the narrow phase prunes along y.
+ *
+ * populate() reuses the last frame's order: the extents are refreshed in place and an
+ * insertion sort restores the order, in about n steps when the particles barely moved. It
+ * gives up after _moves_per_particle moves per particle, and on a different particle count,
+ * for a radix sort of the extents, 8 bits at a time. The span ends are then counted a
+ * register of left ends at a time.
+ */
+class sweep_and_prune {
+    static constexpr uint32_t _moves_per_particle = 8;
+
+    simd::isa::level        _isa;
+
+    std::vector<float32_t>  _min_xs;        // left end of the x extent per slot, ascending
+    std::vector<float32_t>  _max_xs;        // right end of the x extent per slot
+    std::vector<uint32_t>   _ends;          // end of the span of every slot
+    float32_t               _max_diameter   = 0;
+    uint32_t                _moves          = 0;
+    bool                    _radix_sorted   = false;
+    std::vector<uint32_t>   _keys, _next_keys, _next_ids;   // radix sort scratch
+    std::vector<float32_t>  _next_min_xs, _next_max_xs;
+    std::vector<std::pair<uint32_t, uint32_t>> _stripes;
+
+    /**
+     * @return v as an unsigned integer of the same order
+     */
+    static uint32_t key(float32_t v) noexcept {
+        const uint32_t u = std::bit_cast<uint32_t>(v);
+        return u & 0x80000000u ? ~u : u | 0x80000000u;
+    }
+
+    /**
+     * Sorts the slots by _min_xs in place, unless that takes more than the move budget
+     *
+     * @return whether the slots are sorted
+     */
+    bool insertion_sort() noexcept {
+        const uint32_t n = ids.size();
+        const uint64_t budget = static_cast<uint64_t>(_moves_per_particle) * n;
+        for (uint32_t i = 1; i < n; i++) {
+            const float32_t min_x = _min_xs[i];
+            if (_min_xs[i - 1] <= min_x) continue;
+            const float32_t max_x = _max_xs[i];
+            const uint32_t id = ids[i];
+            uint32_t j = i;
+            for (; j > 0 && _min_xs[j - 1] > min_x; j--) {
+                _min_xs[j] = _min_xs[j - 1];
+                _max_xs[j] = _max_xs[j - 1];
+                ids[j] = ids[j - 1];
+                _moves++;
+            }
+            _min_xs[j] = min_x;
+            _max_xs[j] = max_x;
+            ids[j] = id;
+            if (_moves > budget) return false;
+        }
+        return true;
+    }
+
+    /**
+     * Sorts the slots by _min_xs, least significant byte of their keys first; passes
+     * where every key has the same byte are skipped
+     */
+    void radix_sort() {
+        const uint32_t n = ids.size();
+        _keys.resize(n);
+        _next_keys.resize(n);
+        _next_ids.resize(n);
+        _next_min_xs.resize(n);
+        _next_max_xs.resize(n);
+        for (uint32_t s = 0; s < n; s++) {
+            _keys[s] = key(_min_xs[s]);
+        }
+        for (uint32_t shift = 0; shift < 32; shift += 8) {
+            std::array<uint32_t, 257> offsets{};
+            for (uint32_t s = 0; s < n; s++) {
+                ++offsets[((_keys[s] >> shift) & 0xFF) + 1];
+            }
+            if (std::find(offsets.begin() + 1, offsets.end(), n) != offsets.end()) continue;
+            std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+            for (uint32_t s = 0; s < n; s++) {
+                const uint32_t d = offsets[(_keys[s] >> shift) & 0xFF]++;
+                _next_keys[d] = _keys[s];
+                _next_ids[d] = ids[s];
+                _next_min_xs[d] = _min_xs[s];
+                _next_max_xs[d] = _max_xs[s];
+            }
+            _keys.swap(_next_keys);
+            ids.swap(_next_ids);
+            _min_xs.swap(_next_min_xs);
+            _max_xs.swap(_next_max_xs);
+        }
+    }
+
+    /**
+     * Finds the end of every slot's span: as the left ends ascend, the ones within a
+     * slot's extent are a prefix of the slots after it, counted a register at a time.
+     * The count starts from the previous slot's end while it is still within the extent,
+     * which it is unless the slot is narrower, so the next few slots are all it loads.
+     */
+    template <typename V>
+    void find_ends_impl() noexcept {
+        using f32 = typename V::f32;
+
+        const uint32_t n = ids.size();
+        const float32_t* min_xs = _min_xs.data();
+        uint32_t end = 0;
+        for (uint32_t s = 0; s < n; s++) {
+            const float32_t max_x = _max_xs[s];
+            if (end <= s + 1 || min_xs[end - 1] > max_x) {
+                end = s + 1;
+            }
+            const f32 max_x_reg = V::set1(max_x);
+            for (uint32_t remaining = n - end; remaining > 0; remaining = n - end) {
+                const uint32_t count = V::count(V::mask_and(V::mask_not(V::gt(V::load_n(min_xs + end, remaining), max_x_reg)), V::first_n(remaining)));
+                end += count;
+                if (count < V::width) break;
+            }
+            _ends[s] = end;
+        }
+    }
+
+public:
+    /**
+     * @param isa_level instruction set the span search dispatches to, detected at startup by default
+     */
+    explicit sweep_and_prune(simd::isa::level isa_level = simd::isa::active()) noexcept : _isa(isa_level) {}
+
+    /**
+     * Sorts n particles by the left end of their x extent, circle(idx) giving the (x, y, r)
+     * of each, and finds the span of every slot
+     */
+    template <typename F>
+    void populate(uint32_t n, F circle) {
+        const bool reuse = ids.size() == n; // the last order of the same particles
+        if (!reuse) {
+            ids.resize(n);
+            std::iota(ids.begin(), ids.end(), 0u);
+        }
+        _min_xs.resize(n);
+        _max_xs.resize(n);
+        _max_diameter = 0;
+        for (uint32_t s = 0; s < n; s++) {
+            const auto [x, y, r] = circle(ids[s]);
+            _min_xs[s] = x - r;
+            _max_xs[s] = x + r;
+            _max_diameter = std::max(_max_diameter, 2 * r);
+        }
+        _moves = 0;
+        _radix_sorted = !reuse || !insertion_sort();
+        if (_radix_sorted) {
+            radix_sort();
+        }
+
+        // the span of s ends at the first slot starting right of s
+        _ends.resize(n);
+        simd::isa::dispatch(_isa, [this]<typename V>() { find_ends_impl<V>(); });
+    }
+
+    uint32_t size() const noexcept { return ids.size(); }
+    float32_t min_x(uint32_t slot) const noexcept { return _min_xs[slot]; }
+    float32_t max_x(uint32_t slot) const noexcept { return _max_xs[slot]; }
+
+    /**
+     * @return end of the slots after slot whose x extent overlaps its own
+     */
+    uint32_t span_end(uint32_t slot) const noexcept { return _ends[slot]; }
+
+    /**
+     * @return insertion sort moves of the last populate, up to where it gave up
+     */
+    uint32_t moves() const noexcept { return _moves; }
+
+    /**
+     * @return whether the last populate fell back to a radix sort
+     */
+    bool radix_sorted() const noexcept { return _radix_sorted; }
+
+    /**
+     * Calls f(slot, slot + 1, span_end(slot)) for every slot in [first, last)
+     */
+    template <typename F>
+    void for_each_span(uint32_t first, uint32_t last, F f) const {
+        for (uint32_t s = first; s < last; s++) {
+            f(s, s + 1, _ends[s]);
+        }
+    }
+
+    /**
+     * Calls f(a, b) for every pair of particles overlapping along x found from slots
+     * [first, last), each pair once
+     */
+    template <typename F>
+    void for_each_pair(uint32_t first, uint32_t last, F f) const {
+        for (uint32_t s = first; s < last; s++) {
+            for (uint32_t o = s + 1; o < _ends[s]; o++) {
+                f(ids[s], ids[o]);
+            }
+        }
+    }
+
+    /**
+     * Splits the slots into at most count [first, last) ranges with about as many
+     * particles each, each range's extents starting over more than the largest diameter,
+     * so spans reach at most into the next range
+     */
+    const std::vector<std::pair<uint32_t, uint32_t>>& stripes(uint32_t count) {
+        _stripes.clear();
+        const uint32_t n = ids.size();
+        if (!n) return _stripes;
+        uint32_t first = 0;
+        for (uint32_t s = 1; s < n && _stripes.size() + 1 < count; s++) {
+            if (s >= static_cast<uint64_t>(n) * (_stripes.size() + 1) / count && _min_xs[s] - _min_xs[first] > _max_diameter) {
+                _stripes.emplace_back(first, s);
+                first = s;
+            }
+        }
+        _stripes.emplace_back(first, n);
+        return _stripes;
+    }
+
+    std::vector<uint32_t> ids;  // particle index per slot, by ascending left end
+};
+
+static_assert(sparse_broadphase<sweep_and_prune>);
+
+} // namespace collision_engine
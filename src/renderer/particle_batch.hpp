@@ -0,0 +1,183 @@
+#pragma once
+
+#include "common/simd.hpp"
+#include "physics/simd_collection.hpp"
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace collision_engine {
+
+/**
+ * How the renderers draw particles
+ */
+enum class draw_mode {
+    shapes,     // one sf::CircleShape and draw call per particle
+    sprites,    // one textured quad per particle in a single vertex array, one draw call
+    points,     // one pixel per particle in a single vertex array, one draw call
+};
+
+/**
+ * @brief All particles of a frame in one sf::VertexArray, drawn with a single call.
+ *
+ * A particle owns the vertices at its slot (its handle, or its index in the environment).
+ * Colours and texture coordinates are written once by add(); each frame only rewrites the
+ * positions. Like sf::CircleShape placed at the particle's position, the quad spans
+ * [x, x + 2r] x [y, y + 2r].
+ */
+class particle_batch {
+private:
+    static constexpr uint32_t   _sprite_size = 64;
+
+    draw_mode           _mode;
+    uint32_t            _per_particle;
+    sf::VertexArray     _vertices;
+    sf::Texture         _sprite;    // white disc with an anti-aliased edge, tinted by the vertex colour
+
+    void create_sprite() {
+        sf::Image disc;
+        disc.create(_sprite_size, _sprite_size, sf::Color::Transparent);
+        const float32_t c = _sprite_size / 2.f;
+        for (uint32_t y = 0; y < _sprite_size; y++) {
+            for (uint32_t x = 0; x < _sprite_size; x++) {
+                const float32_t d = std::hypot(x + 0.5f - c, y + 0.5f - c);
+                const float32_t alpha = std::clamp(c - d, 0.f, 1.f); // one texel of coverage falloff
+                disc.setPixel(x, y, sf::Color(255, 255, 255, static_cast<sf::Uint8>(alpha * 255)));
+            }
+        }
+        _sprite.loadFromImage(disc);
+        _sprite.setSmooth(true);
+    }
+
+    void place(sf::Vertex* v, float32_t x0, float32_t y0, float32_t x1, float32_t y1) const noexcept {
+        if (_mode == draw_mode::points) {
+            v[0].position = sf::Vector2f((x0 + x1) / 2, (y0 + y1) / 2);
+            return;
+        }
+        v[0].position = sf::Vector2f(x0, y0);
+        v[1].position = sf::Vector2f(x1, y0);
+        v[2].position = sf::Vector2f(x1, y1);
+        v[3].position = sf::Vector2f(x0, y1);
+    }
+
+    /**
+     * Computes the corners of each particle's quad a register at a time, then scatters them
+     * to the vertices of its slot
+     *
+     * @tparam Lerp positions are pxs + alpha * (xs - pxs) rather than xs
+     * @param slots slot of each particle, identity when null
+     */
+    template <typename V, bool Lerp>
+    void update_impl(const float32_t* xs, const float32_t* ys, const float32_t* pxs, const float32_t* pys,
+                     const float32_t* rs, const uint32_t* slots, size_t n, float32_t alpha) {
+        float32_t x0[V::width], y0[V::width], x1[V::width], y1[V::width];
+        const typename V::f32 a = V::set1(alpha);
+        sf::Vertex* vertices = &_vertices[0];
+        for (size_t i = 0; i < n; i += V::width) {
+            const size_t m = std::min<size_t>(V::width, n - i);
+            typename V::f32 x = V::load_n(xs + i, m);
+            typename V::f32 y = V::load_n(ys + i, m);
+            if constexpr (Lerp) {
+                const typename V::f32 px = V::load_n(pxs + i, m);
+                const typename V::f32 py = V::load_n(pys + i, m);
+                x = V::fma(a, V::sub(x, px), px);
+                y = V::fma(a, V::sub(y, py), py);
+            }
+            const typename V::f32 d = V::add(V::load_n(rs + i, m), V::load_n(rs + i, m));
+            V::store_n(x0, x, m);
+            V::store_n(y0, y, m);
+            V::store_n(x1, V::add(x, d), m);
+            V::store_n(y1, V::add(y, d), m);
+            for (size_t k = 0; k < m; k++) {
+                const size_t slot = slots ? slots[i + k] : i + k;
+                place(vertices + size_t(_per_particle) * slot, x0[k], y0[k], x1[k], y1[k]);
+            }
+        }
+    }
+
+public:
+    explicit particle_batch(draw_mode mode)
+        :   _mode(mode),
+            _per_particle(mode == draw_mode::points ? 1 : 4),
+            _vertices(mode == draw_mode::points ? sf::Points : sf::Quads) {
+        if (_mode == draw_mode::sprites) {
+            create_sprite();
+        }
+    }
+
+    draw_mode mode() const noexcept { return _mode; }
+    size_t size() const noexcept { return _vertices.getVertexCount() / _per_particle; }
+    void clear() { _vertices.clear(); }
+
+    /**
+     * Appends a particle in the next slot, fixing its colour
+     */
+    void add(float32_t x, float32_t y, float32_t r, sf::Color color) {
+        const size_t first = _vertices.getVertexCount();
+        _vertices.resize(first + _per_particle);
+        sf::Vertex* v = &_vertices[first];
+        for (uint32_t k = 0; k < _per_particle; k++) {
+            v[k].color = color;
+        }
+        if (_mode == draw_mode::sprites) {
+            const float32_t s = static_cast<float32_t>(_sprite_size);
+            v[0].texCoords = sf::Vector2f(0, 0);
+            v[1].texCoords = sf::Vector2f(s, 0);
+            v[2].texCoords = sf::Vector2f(s, s);
+            v[3].texCoords = sf::Vector2f(0, s);
+        }
+        set(static_cast<uint32_t>(first / _per_particle), x, y, r);
+    }
+
+    void set(uint32_t slot, float32_t x, float32_t y, float32_t r) noexcept {
+        place(&_vertices[size_t(_per_particle) * slot], x, y, x + 2 * r, y + 2 * r);
+    }
+
+    /**
+     * @return the area the particle of the slot covers, empty for a collapsed slot or a point
+     */
+    sf::FloatRect bounds(uint32_t slot) const noexcept {
+        const sf::Vertex* v = &_vertices[size_t(_per_particle) * slot];
+        if (_mode == draw_mode::points) {
+            return sf::FloatRect(v[0].position.x, v[0].position.y, 0, 0);
+        }
+        return sf::FloatRect(v[0].position.x, v[0].position.y, v[2].position.x - v[0].position.x, v[2].position.y - v[0].position.y);
+    }
+
+    /**
+     * Moves every particle to its position in the SoA collection, batch slots being the
+     * collection's; the slots of removed particles collapse to nothing
+     */
+    void update(const simd::particle_collection<float32_t>& pc) {
+        if (pc.size() != 0) {
+            simd::isa::dispatch(pc.isa_level(), [&, this]<typename V>() {
+                update_impl<V, false>(pc.xs.data(), pc.ys.data(), nullptr, nullptr, pc.rs.data(), pc.slots().data(), pc.size(), 1.f);
+            });
+        }
+        for (uint32_t slot : pc.handles().free_slots()) {
+            if (slot < size()) {
+                set(slot, 0, 0, 0);
+            }
+        }
+    }
+
+    /**
+     * Moves particle i (slot i) to the point `alpha` of the way from (pxs, pys) to (xs, ys)
+     */
+    void update(const float32_t* xs, const float32_t* ys, const float32_t* pxs, const float32_t* pys, const float32_t* rs,
+                size_t n, float32_t alpha, simd::isa::level isa_level = simd::isa::active()) {
+        if (n == 0) {
+            return;
+        }
+        simd::isa::dispatch(isa_level, [&, this]<typename V>() {
+            update_impl<V, true>(xs, ys, pxs, pys, rs, nullptr, n, alpha);
+        });
+    }
+
+    void draw(sf::RenderTarget& target) const {
+        target.draw(_vertices, sf::RenderStates(_mode == draw_mode::sprites ? &_sprite : nullptr));
+    }
+};
+
+} // namespace collision_engine
@@ -0,0 +1,362 @@
+#pragma once
+
+#include "common/color.hpp"
+#include "common/profiler.hpp"
+#include "common/simd.hpp"
+#include "common/thread_pool.hpp"
+#include "physics/object.hpp"
+#include "physics/simd_collection.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace collision_engine {
+
+/**
+ * @brief RGBA8 image, one uint32_t per pixel holding R, G, B, A in memory order
+ */
+class framebuffer {
+private:
+    uint32_t                _width;
+    uint32_t                _height;
+    std::vector<uint32_t>   _pixels;
+
+public:
+    framebuffer(uint32_t width, uint32_t height) : _width(width), _height(height), _pixels(size_t(width) * height) {}
+
+    uint32_t width() const noexcept { return _width; }
+    uint32_t height() const noexcept { return _height; }
+    uint32_t* row(uint32_t y) noexcept { return _pixels.data() + size_t(y) * _width; }
+    const uint32_t* data() const noexcept { return _pixels.data(); }
+    uint32_t pixel(uint32_t x, uint32_t y) const noexcept { return _pixels[size_t(y) * _width + x]; }
+
+    /**
+     * Raw RGBA8 rows, top to bottom, e.g. for `ffmpeg -f rawvideo -pix_fmt rgba -s WxH -i -`
+     */
+    void write_raw(std::ostream& out) const {
+        out.write(reinterpret_cast<const char*>(_pixels.data()), _pixels.size() * sizeof(uint32_t));
+    }
+
+    /**
+     * Binary PPM (P6), alpha dropped
+     */
+    void write_ppm(std::ostream& out) const {
+        out<<"P6\n"<<_width<<" "<<_height<<"\n255\n";
+        std::vector<uint8_t> line(size_t(_width) * 3);
+        for (uint32_t y = 0; y < _height; y++) {
+            const uint8_t* in = reinterpret_cast<const uint8_t*>(_pixels.data() + size_t(y) * _width);
+            for (uint32_t x = 0; x < _width; x++) {
+                line[3 * x] = in[4 * x];
+                line[3 * x + 1] = in[4 * x + 1];
+                line[3 * x + 2] = in[4 * x + 2];
+            }
+            out.write(reinterpret_cast<const char*>(line.data()), line.size());
+        }
+    }
+
+    /**
+     * RGBA PNG. The zlib stream uses stored (uncompressed) deflate blocks: frames are
+     * written for later encoding, so export speed matters more than their size.
+     */
+    void write_png(std::ostream& out) const {
+        static const std::array<uint32_t, 256> crc_table = [] {
+            std::array<uint32_t, 256> t{};
+            for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++) {
+                    c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+                t[n] = c;
+            }
+            return t;
+        }();
+        const auto crc = [](uint32_t c, const uint8_t* p, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                c = crc_table[(c ^ p[i]) & 0xff] ^ (c >> 8);
+            }
+            return c;
+        };
+        const auto be32 = [](std::vector<uint8_t>& v, uint32_t x) {
+            v.insert(v.end(), {uint8_t(x >> 24), uint8_t(x >> 16), uint8_t(x >> 8), uint8_t(x)});
+        };
+        const auto chunk = [&](const char* type, const std::vector<uint8_t>& body) {
+            std::vector<uint8_t> head;
+            be32(head, static_cast<uint32_t>(body.size()));
+            head.insert(head.end(), type, type + 4);
+            uint32_t c = crc(0xffffffffu, head.data() + 4, 4);
+            c = crc(c, body.data(), body.size()) ^ 0xffffffffu;
+            std::vector<uint8_t> tail;
+            be32(tail, c);
+            out.write(reinterpret_cast<const char*>(head.data()), head.size());
+            out.write(reinterpret_cast<const char*>(body.data()), body.size());
+            out.write(reinterpret_cast<const char*>(tail.data()), tail.size());
+        };
+
+        static constexpr uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        out.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+        std::vector<uint8_t> ihdr;
+        be32(ihdr, _width);
+        be32(ihdr, _height);
+        ihdr.insert(ihdr.end(), {8, 6, 0, 0, 0}); // 8 bit RGBA, deflate, no filter, no interlace
+        chunk("IHDR", ihdr);
+
+        // every row is prefixed by its filter type (none)
+        const size_t row_bytes = size_t(_width) * 4;
+        std::vector<uint8_t> raw((row_bytes + 1) * _height);
+        for (uint32_t y = 0; y < _height; y++) {
+            raw[y * (row_bytes + 1)] = 0;
+            std::memcpy(raw.data() + y * (row_bytes + 1) + 1, _pixels.data() + size_t(y) * _width, row_bytes);
+        }
+        uint32_t a = 1, b = 0;
+        for (size_t at = 0; at < raw.size(); at += 5552) { // largest run before the sums can overflow
+            const size_t end = std::min(raw.size(), at + 5552);
+            for (size_t i = at; i < end; i++) {
+                a += raw[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+
+        std::vector<uint8_t> idat = {0x78, 0x01};
+        idat.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+        for (size_t at = 0;; at += 65535) {
+            const uint16_t len = static_cast<uint16_t>(std::min<size_t>(65535, raw.size() - at));
+            const uint8_t last = at + len == raw.size();
+            idat.insert(idat.end(), {last, uint8_t(len), uint8_t(len >> 8), uint8_t(~len), uint8_t(~len >> 8)});
+            idat.insert(idat.end(), raw.begin() + at, raw.begin() + at + len);
+            if (last) {
+                break;
+            }
+        }
+        be32(idat, b << 16 | a);
+        chunk("IDAT", idat);
+        chunk("IEND", {});
+    }
+
+    /**
+     * Writes the image in the format named by the extension: .ppm, .png, anything else raw
+     */
+    bool save(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary);
+        const auto ends_with = [&](const char* ext) {
+            const std::string e(ext);
+            return path.size() >= e.size() && path.compare(path.size() - e.size(), e.size(), e) == 0;
+        };
+        if (ends_with(".ppm")) {
+            write_ppm(out);
+        } else if (ends_with(".png")) {
+            write_png(out);
+        } else {
+            write_raw(out);
+        }
+        return static_cast<bool>(out);
+    }
+};
+
+/**
+ * @brief Software renderer drawing particles as filled circles into a framebuffer, for
+ * exporting frames on machines without a display.
+ *
+ * A frame is drawn in two parallel passes. Each thread first scales a contiguous range of
+ * particles to pixels and bins them into the square tiles their bounding box overlaps; then
+ * each task rasterizes a row of tiles, walking the bins in particle order and filling the
+ * circle's span on every scanline with SIMD stores. Tiles are disjoint, so no pixel is
+ * written by two threads and the image does not depend on the thread count.
+ *
+ * Particles get the same hue cycle as the window renderers, by handle for the SoA solver
+ * and by insertion order for the AoS environment.
+ */
+class raster_renderer {
+private:
+    static constexpr uint32_t   _tile = 64;
+    static constexpr float32_t  _particle_color_cycle = 360;
+
+    framebuffer             _fb;
+    const float32_t         _scale_x;       // pixels per world unit
+    const float32_t         _scale_y;
+    const uint32_t          _tiles_x;
+    const uint32_t          _tiles_y;
+    uint32_t                _background = rgba{}.packed();
+    simd::isa::level        _isa;
+    thread_pool             _tp;
+
+    std::vector<uint32_t>   _palette;       // colour of each handle
+    std::vector<float32_t>  _cx, _cy, _cr;  // particles in pixel space
+    std::vector<uint32_t>   _color;
+    std::vector<std::vector<std::vector<uint32_t>>> _bins; // particles of each tile, per binning task
+
+    uint32_t color_of(uint32_t handle) {
+        while (_palette.size() <= handle) {
+            const float32_t hue = std::fmod(_palette.size() * 0.05f, _particle_color_cycle);
+            _palette.push_back(hsv_to_rgba(hue, 0.8f, 0.8f).packed());
+        }
+        return _palette[handle];
+    }
+
+    template <typename V>
+    static void fill_span(uint32_t* p, uint32_t n, uint32_t color) noexcept {
+        const typename V::u32 c = V::set1(color);
+        uint32_t i = 0;
+        for (; i + V::width <= n; i += V::width) {
+            V::store(p + i, c);
+        }
+        if (i < n) {
+            V::store_n(p + i, c, n - i);
+        }
+    }
+
+    /**
+     * Stages particles [first, last) in pixel space and bins them, `at(i)` giving the world
+     * position, radius and handle of particle i
+     */
+    template <typename At>
+    void bin(uint32_t task, uint32_t first, uint32_t last, At at) {
+        std::vector<std::vector<uint32_t>>& bins = _bins[task];
+        for (uint32_t i = first; i < last; i++) {
+            const auto [x, y, r, handle] = at(i);
+            const float32_t cx = x * _scale_x, cy = y * _scale_y, cr = r * _scale_x;
+            _cx[i] = cx;
+            _cy[i] = cy;
+            _cr[i] = cr;
+            _color[i] = _palette[handle];
+            const int32_t x0 = std::max(0, static_cast<int32_t>(std::floor(cx - cr)));
+            const int32_t x1 = std::min<int32_t>(_fb.width() - 1, static_cast<int32_t>(std::floor(cx + cr)));
+            const int32_t y0 = std::max(0, static_cast<int32_t>(std::floor(cy - cr)));
+            const int32_t y1 = std::min<int32_t>(_fb.height() - 1, static_cast<int32_t>(std::floor(cy + cr)));
+            if (x0 > x1 || y0 > y1) {
+                continue; // off screen
+            }
+            for (int32_t ty = y0 / _tile; ty <= y1 / static_cast<int32_t>(_tile); ty++) {
+                for (int32_t tx = x0 / _tile; tx <= x1 / static_cast<int32_t>(_tile); tx++) {
+                    bins[ty * _tiles_x + tx].push_back(i);
+                }
+            }
+        }
+    }
+
+    template <typename V>
+    void raster_tile_row(uint32_t ty) {
+        const int32_t y_lo = ty * _tile;
+        const int32_t y_hi = std::min(y_lo + _tile, _fb.height());
+        for (uint32_t tx = 0; tx < _tiles_x; tx++) {
+            const int32_t x_lo = tx * _tile;
+            const int32_t x_hi = std::min(x_lo + _tile, _fb.width());
+            for (int32_t y = y_lo; y < y_hi; y++) {
+                fill_span<V>(_fb.row(y) + x_lo, x_hi - x_lo, _background);
+            }
+            for (const std::vector<std::vector<uint32_t>>& bins : _bins) {
+                for (const uint32_t i : bins[ty * _tiles_x + tx]) {
+                    const float32_t cx = _cx[i], cy = _cy[i], r2 = _cr[i] * _cr[i];
+                    // pixel (x, y) is covered when its centre (x + 0.5, y + 0.5) is inside the circle
+                    const int32_t y0 = std::max(y_lo, static_cast<int32_t>(std::ceil(cy - _cr[i] - 0.5f)));
+                    const int32_t y1 = std::min(y_hi, static_cast<int32_t>(std::floor(cy + _cr[i] - 0.5f)) + 1);
+                    for (int32_t y = y0; y < y1; y++) {
+                        const float32_t dy = y + 0.5f - cy;
+                        const float32_t h2 = r2 - dy * dy;
+                        if (h2 < 0) {
+                            continue;
+                        }
+                        const float32_t h = std::sqrt(h2);
+                        const int32_t x0 = std::max(x_lo, static_cast<int32_t>(std::ceil(cx - h - 0.5f)));
+                        const int32_t x1 = std::min(x_hi, static_cast<int32_t>(std::floor(cx + h - 0.5f)) + 1);
+                        if (x0 < x1) {
+                            fill_span<V>(_fb.row(y) + x0, x1 - x0, _color[i]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * @param colors number of colours `at` can hand out: the handles it gives are below it
+     */
+    template <typename At>
+    void render_impl(uint32_t n, uint32_t colors, At at) {
+        CE_PROFILE_SCOPE("raster");
+        _cx.resize(n);
+        _cy.resize(n);
+        _cr.resize(n);
+        _color.resize(n);
+        if (colors > 0) {
+            color_of(colors - 1); // grow the palette up front so binning only reads it
+        }
+
+        const uint32_t tasks = static_cast<uint32_t>(_bins.size());
+        const uint32_t chunk = (n + tasks - 1) / tasks;
+        for (uint32_t t = 0; t < tasks; t++) {
+            for (std::vector<uint32_t>& b : _bins[t]) {
+                b.clear();
+            }
+            const uint32_t first = std::min(n, t * chunk);
+            const uint32_t last = std::min(n, first + chunk);
+            _tp.submit([this, t, first, last, at]() {
+                CE_PROFILE_SCOPE("bin");
+                bin(t, first, last, at);
+            });
+        }
+        _tp.wait_for_tasks();
+
+        for (uint32_t ty = 0; ty < _tiles_y; ty++) {
+            _tp.submit([this, ty]() {
+                CE_PROFILE_SCOPE("fill");
+                simd::isa::dispatch(_isa, [=, this]<typename V>() { raster_tile_row<V>(ty); });
+            });
+        }
+        _tp.wait_for_tasks();
+    }
+
+public:
+    /**
+     * @param width, height framebuffer size in pixels
+     * @param world_width, world_height extent of the simulation mapped onto it
+     * @param threads binning and rasterization threads
+     */
+    raster_renderer(uint32_t width, uint32_t height, float32_t world_width, float32_t world_height,
+                    uint32_t threads = thread_pool::hardware_threads(), simd::isa::level isa_level = simd::isa::active())
+        :   _fb(width, height),
+            _scale_x(width / world_width),
+            _scale_y(height / world_height),
+            _tiles_x((width + _tile - 1) / _tile),
+            _tiles_y((height + _tile - 1) / _tile),
+            _isa(isa_level),
+            _tp(threads),
+            _bins(_tp.thread_count, std::vector<std::vector<uint32_t>>(size_t(_tiles_x) * _tiles_y)) {}
+
+    void stop() { _tp.stop(); }
+
+    const framebuffer& frame() const noexcept { return _fb; }
+    void set_background(rgba c) noexcept { _background = c.packed(); }
+
+    /**
+     * Draws the SoA collection, colouring particles by handle slot
+     */
+    void render(const simd::particle_collection<float32_t>& pc) {
+        // slots outlive removals, so they run up to slot_count() rather than size()
+        render_impl(static_cast<uint32_t>(pc.size()), static_cast<uint32_t>(pc.slot_count()), [&pc](uint32_t i) {
+            return std::make_tuple(pc.xs[i], pc.ys[i], pc.rs[i], pc.slot_of(i));
+        });
+    }
+
+    /**
+     * Draws AoS particles, colouring them by their index in `particles`
+     */
+    template <typename VT>
+    void render(const std::vector<particle<VT>*>& particles) {
+        render_impl(static_cast<uint32_t>(particles.size()), static_cast<uint32_t>(particles.size()), [&particles](uint32_t i) {
+            const particle<VT>& p = *particles[i];
+            return std::make_tuple(static_cast<float32_t>(p.position.i()), static_cast<float32_t>(p.position.j()),
+                                   static_cast<float32_t>(p.radius), i);
+        });
+    }
+};
+
+} // namespace collision_engine
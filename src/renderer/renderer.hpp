@@ -1,12 +1,14 @@
 #pragma once
 
 #include "common/utils.hpp"
+#include "particle_batch.hpp"
 #include "common/constants.hpp"
 #include "physics/solver.hpp"
 #include "SFML/Window/WindowStyle.hpp"
 #include <SFML/Window/Event.hpp>
 #include <SFML/Graphics.hpp>
-#include <arm_neon.h>
+#include "common/simd.hpp"
+#include "common/profiler.hpp"
 
 namespace collision_engine {
 
@@ -18,50 +20,86 @@ class renderer {
 private:
     using T = typename vec_traits<VT>::element_type;
 public:
-    explicit renderer(environment<VT, W>& env) 
+    /**
+     * @param mode sprites batch every particle into one draw call, shapes draws them one by one
+     */
+    explicit renderer(environment<VT, W>& env, draw_mode mode = draw_mode::sprites) 
         :   _env(env), 
             _r_metadata(),
-            _window(sf::VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), "Collision Engine", sf::Style::Close | sf::Style::Titlebar) {}
+            _window(sf::VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), "Collision Engine", sf::Style::Close | sf::Style::Titlebar),
+            _batch(mode) {}
     
     /**
      * Populate the frame with particles on viewport
      */
     void init_frame() {
+        _frame_particles.clear();
+        _batch.clear();
         const std::vector<particle<VT>*>& particles = _env.particles();
-
-        for(particle<VT>* particle : particles) {
-            sf::CircleShape circle(particle->radius);
-            circle.setPosition(particle->position.i(), particle->position.j());
-            circle.setFillColor(collision_engine::hsv_to_rgb(_hue, 0.8f, 0.8f));
-            _frame_particles.push_back(circle);
-            _hue += 0.05;
-            if (_hue > _particle_color_cycle) _hue -= _particle_color_cycle;
+        const handle_table& handles = _env.handles();
+        for (uint32_t slot = 0; slot < handles.slot_count(); slot++) { // frame particles are indexed by handle slot
+            const uint32_t i = handles.index_of_slot(slot);
+            if (i == handle_table::invalid) {
+                add_to_frame(0, 0, 0);
+                continue;
+            }
+            add_object_to_frame(particles[i]);
         }
     }
 
+    /**
+     * Appends a particle in the next slot; the environment hands out new slots in the same
+     * order, reused ones are already in the frame
+     */
     void add_object_to_frame(particle<VT>* particle) {
-        sf::CircleShape circle(particle->radius);
-        circle.setPosition(particle->position.i(), particle->position.j());
-        circle.setFillColor(collision_engine::hsv_to_rgb(_hue, 0.8f, 0.8f));
-        _frame_particles.push_back(circle);
-        _hue += 0.05;
-        if (_hue > _particle_color_cycle) _hue -= _particle_color_cycle;
+        add_to_frame(particle->position.i(), particle->position.j(), particle->radius);
     }
 
     /**
-     * Update position of SFML particles on viewport
+     * Update position of SFML particles on viewport. Vertices and shapes are indexed by
+     * handle slot, so particles keep their colour while others are removed, and the slots
+     * of removed particles collapse to nothing.
      */
     void update_frame() {
+        CE_PROFILE_SCOPE("update_frame");
         const std::vector<particle<VT>*>& particles = _env.particles();
+        const handle_table& handles = _env.handles();
+        for (size_t slot = frame_size(); slot < handles.slot_count(); slot++) {
+            add_to_frame(0, 0, 0);
+        }
 
         // this may be temporary, consider updating position immediately 
         // after obj.position is updated to preserve locality
-        for (int i = 0; i < particles.size(); i++) { 
+        if (_batch.mode() != draw_mode::shapes) { // positions sit behind pointers, gather them one by one
+            for (uint32_t i = 0; i < particles.size(); i++) {
+                const auto* obj = particles[i];
+                _batch.set(handles.slot_of(i), obj->position.i(), obj->position.j(), obj->radius);
+            }
+            for (uint32_t slot : handles.free_slots()) {
+                _batch.set(slot, 0, 0, 0);
+            }
+            for (size_t slot = handles.slot_count(); slot < _batch.size(); slot++) {
+                _batch.set(slot, 0, 0, 0);
+            }
+            return;
+        }
+        for (uint32_t i = 0; i < particles.size(); i++) { 
             const auto* obj = particles[i];
-            _frame_particles[i].setPosition(obj->position.i(), obj->position.j());
+            sf::CircleShape& shape = _frame_particles[handles.slot_of(i)];
+            shape.setPosition(obj->position.i(), obj->position.j());
+            shape.setRadius(obj->radius);
+        }
+        for (uint32_t slot : handles.free_slots()) {
+            _frame_particles[slot].setRadius(0);
+        }
+        for (size_t slot = handles.slot_count(); slot < _frame_particles.size(); slot++) {
+            _frame_particles[slot].setRadius(0);
         }
     }
 
+    const particle_batch& batch() const noexcept { return _batch; }
+    const std::vector<sf::CircleShape>& shapes() const noexcept { return _frame_particles; }
+
     void set_frame_limit(uint32_t frame_limit) noexcept { _window.setFramerateLimit(frame_limit); }
    
     bool is_running() const noexcept { return _window.isOpen(); }
@@ -85,12 +123,11 @@ public:
      * Show image to the viewport
      */
     void render() {
+        CE_PROFILE_SCOPE("render");
         // this may be temporary, consider updating position immediately 
         // after obj.position is updated to preserve locality
         _window.clear();
-        for (const auto& particle : _frame_particles) {
-            _window.draw(particle);
-        }
+        draw_particles();
         _window.display();
     }
     
@@ -98,31 +135,61 @@ public:
         _r_metadata.fps_text.setString("fps: " + std::to_string(fps));
         _r_metadata.latency_text.setString("latency: " + std::to_string(latency) + "s");
         _r_metadata.particle_count.setString("count: " + std::to_string(count));
+#if defined(CE_PROFILE)
+        _r_metadata.profile_text.setString(profiler::instance().summary());
+#endif
     }
 
     void render_with_metadata() {
+        CE_PROFILE_SCOPE("render");
         // this may be temporary, consider updating position immediately 
         // after obj.position is updated to preserve locality
         _window.clear();
 
-        for (const auto& particle : _frame_particles) {
-            _window.draw(particle);
-        }
+        draw_particles();
 
         _window.draw(_r_metadata.fps_text);
         _window.draw(_r_metadata.latency_text);
         _window.draw(_r_metadata.particle_count);
+        _window.draw(_r_metadata.profile_text);
 
         _window.display();
     }
     
 private:
+    size_t frame_size() const noexcept { return _batch.mode() != draw_mode::shapes ? _batch.size() : _frame_particles.size(); }
+
+    void add_to_frame(T x, T y, T r) {
+        const sf::Color color = collision_engine::hsv_to_rgb(_hue, 0.8f, 0.8f);
+        _hue += 0.05;
+        if (_hue > _particle_color_cycle) _hue -= _particle_color_cycle;
+        if (_batch.mode() != draw_mode::shapes) {
+            _batch.add(x, y, r, color);
+            return;
+        }
+        sf::CircleShape circle(r);
+        circle.setPosition(x, y);
+        circle.setFillColor(color);
+        _frame_particles.push_back(circle);
+    }
+
+    void draw_particles() {
+        if (_batch.mode() != draw_mode::shapes) {
+            _batch.draw(_window);
+            return;
+        }
+        for (const auto& particle : _frame_particles) {
+            _window.draw(particle);
+        }
+    }
+
     float32_t                       _hue = 0;
     static constexpr float32_t      _particle_color_cycle = 360;
     environment<VT, W>&             _env;
-    std::vector<sf::CircleShape>    _frame_particles;
+    std::vector<sf::CircleShape>    _frame_particles;   // draw_mode::shapes only
     sf::RenderWindow                _window;
     renderer_metadata               _r_metadata;
+    particle_batch                  _batch;
 };
 
 } // namespace collision engine
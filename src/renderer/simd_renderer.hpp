@@ -1,12 +1,15 @@
 #pragma once
 
 #include "common/utils.hpp"
+#include "particle_batch.hpp"
+#include "physics/runner.hpp"
 #include "physics/simd_grid.hpp"
 #include "physics/simd_solver.hpp"
 #include "SFML/Window/WindowStyle.hpp"
 #include <SFML/Graphics/Color.hpp>
 #include <SFML/Graphics.hpp>
-#include <arm_neon.h>
+#include "common/simd.hpp"
+#include "common/profiler.hpp"
 
 namespace collision_engine::simd {
 
@@ -16,45 +19,84 @@ private:
     f32_solver&                         _solver;
     renderer_metadata                   _r_metadata;
     sf::RenderWindow                    _window;
-    std::vector<sf::CircleShape>        _frame_particles;
+    std::vector<sf::CircleShape>        _frame_particles;   // draw_mode::shapes only
+    particle_batch                      _batch;
     static constexpr float32_t          _particle_color_cycle = 360;
     particle_collection<f32_solver::T>& _pc;
 
 public:
-    explicit renderer(f32_solver& solver) 
+    /**
+     * @param mode sprites batch every particle into one draw call, shapes draws them one by one
+     */
+    explicit renderer(f32_solver& solver, draw_mode mode = draw_mode::sprites) 
         :   _solver(solver), 
             _r_metadata(),
-            _pc(solver.pc()),
-            _window(sf::VideoMode(1280, 720), "Collision Engine", sf::Style::Close | sf::Style::Titlebar) {}
+            _window(sf::VideoMode(1280, 720), "Collision Engine", sf::Style::Close | sf::Style::Titlebar),
+            _batch(mode),
+            _pc(solver.pc()) {}
 
     /**
      * Populate the frame with particles on viewport
      */
     void init_frame() {
-        for(uint32_t i = 0; i < _pc.xs.size(); i++) {
-            sf::CircleShape circle(_pc.rs[i]);
-            circle.setPosition(_pc.xs[i], _pc.ys[i]);
-            circle.setFillColor(hsv_to_rgb(_hue, 0.8f, 0.8f));
-            _frame_particles.push_back(circle);
-            _hue += 0.05;
-            if (_hue > _particle_color_cycle) _hue -= _particle_color_cycle;
+        _frame_particles.clear();
+        _batch.clear();
+        for(uint32_t slot = 0; slot < _pc.slot_count(); slot++) { // frame particles are indexed by handle slot
+            const uint32_t i = _pc.handles().index_of_slot(slot);
+            if (i == handle_table::invalid) {
+                add_object_to_frame(particle<f32_solver::T>(0, 0, 0, 0, 0));
+                continue;
+            }
+            add_object_to_frame(particle<f32_solver::T>(_pc.xs[i], _pc.ys[i], _pc.pxs[i], _pc.pys[i], _pc.rs[i]));
         }
     }
 
     void add_object_to_frame(particle<f32_solver::T> p) {
+        const sf::Color color = hsv_to_rgb(_hue, 0.8f, 0.8f);
+        _hue += 0.05;
+        if (_hue > _particle_color_cycle) _hue -= _particle_color_cycle; 
+        if (_batch.mode() != draw_mode::shapes) {
+            _batch.add(p.x, p.y, p.r, color);
+            return;
+        }
         sf::CircleShape circle(p.r);
         circle.setPosition(p.x, p.y);
-        circle.setFillColor(hsv_to_rgb(_hue, 0.8f, 0.8f));
+        circle.setFillColor(color);
         _frame_particles.push_back(circle);
-        _hue += 0.05;
-        if (_hue > _particle_color_cycle) _hue -= _particle_color_cycle; 
     }
 
     void update_frame() {
-        // this may be temporary, consider updating position immediately 
-        // after obj.position is updated to preserve locality
+        CE_PROFILE_SCOPE("update_frame");
+        if (_batch.mode() != draw_mode::shapes) {
+            _batch.update(_pc);
+            return;
+        }
         for(uint32_t i = 0; i < _pc.xs.size(); i++) {
-            _frame_particles[i].setPosition(_pc.xs[i], _pc.ys[i]);
+            _frame_particles[_pc.slot_of(i)].setPosition(_pc.xs[i], _pc.ys[i]);
+            _frame_particles[_pc.slot_of(i)].setRadius(_pc.rs[i]);
+        }
+        for (uint32_t slot : _pc.handles().free_slots()) {
+            _frame_particles[slot].setRadius(0);
+        }
+    }
+
+    /**
+     * Draws a state published by simulation_runner, `alpha` of the way from its previous
+     * step to its latest one; particles spawned since the last frame get their colour here
+     */
+    void update_frame(const state_frame& frame, float32_t alpha) {
+        CE_PROFILE_SCOPE("update_frame");
+        const size_t known = _batch.mode() != draw_mode::shapes ? _batch.size() : _frame_particles.size();
+        for (size_t h = known; h < frame.count; h++) {
+            add_object_to_frame(particle<f32_solver::T>(frame.xs[h], frame.ys[h], frame.pxs[h], frame.pys[h], frame.rs[h]));
+        }
+        if (_batch.mode() != draw_mode::shapes) {
+            _batch.update(frame.xs.data(), frame.ys.data(), frame.pxs.data(), frame.pys.data(), frame.rs.data(), frame.count, alpha, _pc.isa_level());
+            return;
+        }
+        for (size_t h = 0; h < frame.count; h++) {
+            _frame_particles[h].setPosition(frame.pxs[h] + alpha * (frame.xs[h] - frame.pxs[h]), frame.pys[h] + alpha * (frame.ys[h] - frame.pys[h]));
+            _frame_particles[h].setRadius(frame.rs[h]); // 0 for the slots of removed particles
         }
     }
 
@@ -80,12 +122,11 @@ public:
      * Show image to the viewport
      */
     void render() {
+        CE_PROFILE_SCOPE("render");
         // this may be temporary, consider updating position immediately 
         // after obj.position is updated to preserve locality
         _window.clear();
-        for (const auto& particle : _frame_particles) {
-            _window.draw(particle);
-        }
+        draw_particles();
         _window.display();
     }
 
@@ -93,23 +134,37 @@ public:
         _r_metadata.fps_text.setString("fps: " + std::to_string(fps));
         _r_metadata.latency_text.setString("latency: " + std::to_string(latency) + "s");
         _r_metadata.particle_count.setString("count: " + std::to_string(count));
+#if defined(CE_PROFILE)
+        _r_metadata.profile_text.setString(profiler::instance().summary());
+#endif
     }
 
     void render_with_metadata() {
+        CE_PROFILE_SCOPE("render");
         // this may be temporary, consider updating position immediately 
         // after obj.position is updated to preserve locality
         _window.clear();
 
-        for (const auto& particle : _frame_particles) {
-            _window.draw(particle);
-        }
+        draw_particles();
 
         _window.draw(_r_metadata.fps_text);
         _window.draw(_r_metadata.latency_text);
         _window.draw(_r_metadata.particle_count);
+        _window.draw(_r_metadata.profile_text);
 
         _window.display();
     }
+
+private:
+    void draw_particles() {
+        if (_batch.mode() != draw_mode::shapes) {
+            _batch.draw(_window);
+            return;
+        }
+        for (const auto& particle : _frame_particles) {
+            _window.draw(particle);
+        }
+    }
 };
 
 } // namespace collision engine simd
@@ -1,6 +1,9 @@
 #include "../src/common/allocator.hpp"
 #include "../src/physics/object.hpp"
+#include <cassert>
+#include <cstdint>
 #include <iostream>
+#include <vector>
 
 namespace collision_engine {
 
@@ -25,6 +28,98 @@ void linear_allocator_multple_allocation() {
 }
 
 
+void linear_allocator_reset_and_deallocate() {
+    using PT = particle<vec2<float32_t>>;
+
+    linear_allocator alloc(100 * sizeof(PT));
+    std::vector<void*> blocks;
+    for (void* p; (p = alloc.allocate(sizeof(PT), alignof(PT)));) { // fills up exactly, then refuses
+        assert(reinterpret_cast<uintptr_t>(p) % alignof(PT) == 0);
+        blocks.push_back(p);
+    }
+    assert(blocks.size() == 100 && alloc.used() == 100 * sizeof(PT));
+
+    alloc.deallocate(blocks[10], sizeof(PT)); // not the last one: kept until reset
+    assert(alloc.used() == 100 * sizeof(PT));
+    alloc.deallocate(blocks.back(), sizeof(PT));
+    assert(alloc.allocate(sizeof(PT), alignof(PT)) == blocks.back());
+
+    alloc.reset(); // the same buffer from its start
+    assert(alloc.used() == 0 && alloc.allocate(sizeof(PT), alignof(PT)) == blocks.front());
+    std::cout<<"\n3 - ok: linear_allocator: reset and deallocate"<<std::endl;
+}
+
+void pool_allocator_growth_and_recycling() {
+    using PT = particle<vec2<float32_t>>;
+
+    pool_allocator pool(sizeof(PT), alignof(PT), 1000);
+    assert(pool.block_stride() == sizeof(PT) && pool.blocks_per_chunk() >= 1000);
+
+    // grows chunk by chunk, particles already handed out stay where they are
+    const std::size_t n = 3 * pool.blocks_per_chunk() + 17;
+    std::vector<PT*> particles;
+    for (std::size_t i = 0; i < n; i++) {
+        PT* p = new (pool.allocate(sizeof(PT), alignof(PT))) PT();
+        assert(reinterpret_cast<uintptr_t>(p) % alignof(PT) == 0);
+        p->radius = static_cast<float32_t>(i);
+        particles.push_back(p);
+    }
+    assert(pool.chunk_count() == 4 && pool.used() == n * sizeof(PT));
+    for (std::size_t i = 0; i < n; i++) {
+        assert(particles[i]->radius == static_cast<float32_t>(i));
+    }
+
+    // freed particles are recycled before the pool grows again, most recently freed first
+    for (std::size_t i = 0; i < n; i += 2) {
+        pool.deallocate(particles[i], sizeof(PT));
+    }
+    assert(pool.free_blocks() == (n + 1) / 2);
+    for (std::size_t i = (n - 1) / 2 * 2; i < n; i -= 2) {
+        assert(pool.allocate(sizeof(PT), alignof(PT)) == particles[i]);
+    }
+    assert(pool.free_blocks() == 0 && pool.chunk_count() == 4);
+    for (std::size_t i = 1; i < n; i += 2) {
+        assert(particles[i]->radius == static_cast<float32_t>(i));
+    }
+
+    // a run of adjacent blocks, e.g. a restored snapshot, opens a chunk of its own
+    const std::size_t run = pool.blocks_per_chunk() - 5;
+    PT* storage = static_cast<PT*>(pool.allocate(run * sizeof(PT), alignof(PT)));
+    assert(storage && pool.chunk_count() == 5 && pool.free_blocks() == pool.blocks_per_chunk() - 17);
+    assert(!pool.allocate((pool.blocks_per_chunk() + 1) * sizeof(PT), alignof(PT))); // larger than a chunk
+    assert(!pool.allocate(sizeof(PT), 2 * pool.block_stride() * 4096)); // stricter than the blocks
+
+    pool.reset(); // everything freed, the chunks are kept
+    assert(pool.used() == 0 && pool.chunk_count() == 5);
+    assert(pool.allocate(sizeof(PT), alignof(PT)) == particles[0]);
+
+    std::cout<<"\n4 - ok: pool_allocator: "<<n<<" particles over "<<pool.chunk_count()<<" chunks, recycled through the free list"<<std::endl;
+}
+
+void pool_allocator_huge_pages() {
+    using PT = particle<vec2<float32_t>>;
+
+    for (page_backing backing : {page_backing::transparent, page_backing::huge}) {
+        pool_allocator pool(sizeof(PT), alignof(PT), 100000, backing);
+        assert(pool.blocks_per_chunk() * sizeof(PT) % pool_allocator::huge_page_size == 0);
+        std::vector<PT*> particles;
+        for (std::size_t i = 0; i < 2 * pool.blocks_per_chunk(); i++) {
+            PT* p = new (pool.allocate(sizeof(PT), alignof(PT))) PT();
+            p->radius = 1;
+            particles.push_back(p);
+        }
+        assert(pool.chunk_count() == 2);
+        const std::size_t huge = pool.chunks_backed_by(page_backing::huge);
+        const std::size_t transparent = pool.chunks_backed_by(page_backing::transparent);
+        if (transparent > 0) { // aligned for the kernel to back them with huge pages
+            assert(reinterpret_cast<uintptr_t>(particles[0]) % pool_allocator::huge_page_size == 0);
+        }
+        std::cout<<"\n"<<(backing == page_backing::huge ? 6 : 5)<<" - ok: pool_allocator: "
+                 <<(backing == page_backing::huge ? "MAP_HUGETLB" : "transparent huge page")<<" backing ("
+                 <<huge<<" hugetlb, "<<transparent<<" transparent of "<<pool.chunk_count()<<" chunks)"<<std::endl;
+    }
+}
+
 }// namespace collision engine
 
 int main() {
@@ -34,6 +129,9 @@ int main() {
 
     collision_engine::linear_allocator_single_allocation();
     collision_engine::linear_allocator_multple_allocation();
+    collision_engine::linear_allocator_reset_and_deallocate();
+    collision_engine::pool_allocator_growth_and_recycling();
+    collision_engine::pool_allocator_huge_pages();
 
     std::cout<<"==================================================================="<<std::endl;
     std::cout<<"allocator_test - ok"<<std::endl;
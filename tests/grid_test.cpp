@@ -4,6 +4,8 @@
 #include <cassert>
 #include <cstdint>
 #include <iostream>
+#include <random>
+#include <set>
 
 namespace collision_engine {
 
@@ -54,6 +56,98 @@ void populate_grid() {
     std::cout<<"\n1 - ok: populate grid"<<std::endl;
 } 
     
+void update_grid() {
+    using W = vec2<uint32_t>;
+    using VT = vec2<float32_t>;
+    using PT = particle<VT>;
+
+    std::vector<PT> particles(300);
+    std::vector<PT*> ptrs;
+    for (uint32_t idx = 0; idx < particles.size(); ++idx) { // 3 particles in each cell
+        particles[idx].position = VT((idx % 100) / 10 * 10 + 2 + idx / 100, (idx % 10) * 10 + 5);
+        ptrs.push_back(&particles[idx]);
+    }
+
+    W world_size(100, 100);
+    grid<PT, W> incremental(world_size, 10, 10);
+    grid<PT, W> reference(world_size, 10, 10);
+    incremental.populate(ptrs);
+    assert(incremental.migrations() == ptrs.size());
+
+    uint32_t moved = 0;
+    for (uint32_t idx = 0; idx < particles.size(); idx += 25) { // move a few into the next column
+        particles[idx].position.set_j(particles[idx].position.j() + (particles[idx].position.j() < 90 ? 10 : -10));
+        moved++;
+    }
+    incremental.update(ptrs);
+    reference.populate(ptrs);
+    assert(incremental.migrations() == moved);
+    for (uint32_t i = 0; i < reference.cells().size(); ++i) { // same cells in the same order
+        assert(incremental.cells()[i].particle_ids() == reference.cells()[i].particle_ids());
+    }
+
+    incremental.update(ptrs);
+    assert(incremental.migrations() == 0);
+
+    for (auto& p : particles) { // churn above the threshold repopulates
+        p.position.set_i(99 - p.position.i());
+    }
+    incremental.update(ptrs);
+    reference.populate(ptrs);
+    assert(incremental.migrations() > incremental.rebuild_fraction * ptrs.size());
+    for (uint32_t i = 0; i < reference.cells().size(); ++i) {
+        assert(incremental.cells()[i].particle_ids() == reference.cells()[i].particle_ids());
+    }
+
+    std::cout<<"\n2 - ok: incremental grid update ("<<moved<<" migrated)"<<std::endl;
+}
+
+void hierarchical_grid_test() {
+    using W = vec2<uint32_t>;
+    using VT = vec2<float32_t>;
+    using PT = particle<VT>;
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float32_t> unit(0, 1);
+    std::vector<PT> particles(2000);
+    std::vector<PT*> ptrs;
+    for (uint32_t idx = 0; idx < particles.size(); ++idx) { // grains, and a few boulders up to 30px
+        particles[idx].position = VT(256 * unit(rng), 256 * unit(rng));
+        particles[idx].radius = idx % 100 == 0 ? 5 + 25 * unit(rng) : 1 + 2 * unit(rng);
+        ptrs.push_back(&particles[idx]);
+    }
+
+    W world_size(256, 256);
+    hierarchical_grid<PT, W> levels(world_size, 32, 32, grid_levels::max_levels); // 8px cells upwards
+    hierarchical_grid<PT, W> single(world_size, 4, 4, 1);   // 64px cells fit every particle
+    assert(levels.layout().base == 8 && levels.layout().level_of(3) == 0 && levels.layout().level_of(30) == 3);
+    levels.populate(ptrs);
+    single.populate(ptrs);
+
+    std::set<std::pair<uint32_t, uint32_t>> found;
+    uint64_t tests = 0, single_tests = 0;
+    levels.for_each_pair(ptrs, [&](uint32_t a, uint32_t b) {
+        assert(found.emplace(std::min(a, b), std::max(a, b)).second && "pair visited twice");
+        tests++;
+    });
+    single.for_each_pair(ptrs, [&](uint32_t, uint32_t) { single_tests++; });
+
+    uint32_t touching = 0;
+    for (uint32_t a = 0; a < ptrs.size(); ++a) { // every touching pair is among the candidates
+        for (uint32_t b = a + 1; b < ptrs.size(); ++b) {
+            const VT d = particles[a].position - particles[b].position;
+            const float32_t r = particles[a].radius + particles[b].radius;
+            if (d.i() * d.i() + d.j() * d.j() < r * r) {
+                assert(found.count({a, b}));
+                touching++;
+            }
+        }
+    }
+    assert(tests * 4 < single_tests);
+
+    std::cout<<"\n3 - ok: hierarchical grid ("<<touching<<" contacts in "<<tests<<" pair tests, "<<single_tests<<" on one level)"<<std::endl;
+}
+
 } //namespace collision engine
 
 int main() {
@@ -62,6 +156,8 @@ int main() {
     std::cout<<"==================================================================="<<std::endl;
 
     collision_engine::populate_grid();    
+    collision_engine::update_grid();
+    collision_engine::hierarchical_grid_test();
 
     std::cout<<"==================================================================="<<std::endl;
     std::cout<<"grid_test - ok."<<std::endl;
@@ -0,0 +1,73 @@
+#include "physics/simd_solver.hpp"
+#include "renderer/raster_renderer.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace collision_engine::simd {
+
+/**
+ * The SoA demo scene drawn without a display. Frames go to `out`: "-" streams raw RGBA to
+ * stdout, a printf pattern such as frames/%05d.png writes one file per frame, and no output
+ * only measures. Progress is reported on stderr so stdout can be piped, e.g.
+ *
+ *   headless_renderer_test 600 - | ffmpeg -f rawvideo -pix_fmt rgba -s 1280x1280 -r 60 -i - out.mp4
+ */
+void render_without_display(uint32_t frames, const char* out) {
+    constexpr uint32_t fps_cap      = 60;
+    constexpr uint32_t n_particles  = 15000;
+    constexpr uint32_t size         = 1280;
+    const float dt = 1.f / static_cast<float32_t>(fps_cap);
+
+    f32_solver solver(dt, size, size);
+    raster_renderer r(size, size, solver.world_width(), solver.world_height());
+
+    float32_t radius    = 2;
+    float32_t start_i   = 10;
+    float32_t prev_i    = 9.5;
+    uint32_t count      = 0;
+    double raster_ms    = 0;
+    for (uint32_t f = 0; f < frames; f++) {
+        if (count < n_particles) {
+            for (int i{4};i--;) {
+                particle<float32_t> p(start_i, 50 - 5 * i, prev_i, 50 - 5 * i, radius);
+                solver.add_particle(p);
+            }
+            count += 4;
+        }
+        solver.step();
+
+        const auto start = std::chrono::steady_clock::now();
+        r.render(solver.pc());
+        raster_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (out && std::string(out) == "-") {
+            r.frame().write_raw(std::cout);
+        } else if (out) {
+            char path[512];
+            std::snprintf(path, sizeof(path), out, f);
+            r.frame().save(path);
+        }
+        CE_PROFILE_FRAME();
+    }
+    std::cout.flush();
+    r.stop();
+    solver.stop();
+    std::cerr<<frames<<" frames of up to "<<count<<" particles at "<<size<<"x"<<size<<", "
+             <<raster_ms / std::max(1u, frames)<<" ms/frame rasterizing"<<std::endl;
+}
+
+} // namespace collision engine simd
+
+int main(int argc, char** argv) {
+    std::cerr<<"Running headless_renderer_test.cpp..."<<std::endl;
+
+    const uint32_t frames = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 120;
+    collision_engine::simd::render_without_display(frames, argc > 2 ? argv[2] : nullptr);
+
+    std::cerr<<"headless_renderer_test - ok."<<std::endl;
+
+    return 0;
+}
@@ -0,0 +1,154 @@
+#ifndef CE_PROFILE
+#define CE_PROFILE // instrumentation is compiled out unless defined
+#endif
+#include "../src/common/profiler.hpp"
+#include "../src/physics/simd_solver.hpp"
+#include "../src/physics/solver.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace collision_engine {
+
+const profiler::phase* find_phase(const std::vector<profiler::phase>& phases, const std::string& name) {
+    for (const profiler::phase& p : phases) {
+        if (name == p.name) {
+            return &p;
+        }
+    }
+    return nullptr;
+}
+
+void histogram_test() {
+    frame_histogram h;
+    assert(h.percentile(50) == 0);
+    for (uint64_t us = 1; us <= 10000; us++) { // 1us .. 10ms, uniform
+        h.record(us * 1000);
+    }
+    const auto close = [](uint64_t value, double expected) { return std::abs(value - expected) <= 0.035 * expected; };
+    assert(h.count() == 10000);
+    assert(h.max() == 10000 * 1000);
+    assert(close(h.percentile(50), 5000e3));
+    assert(close(h.percentile(99), 9900e3));
+    assert(close(h.percentile(99.9), 9990e3));
+    assert(h.percentile(100) == h.max());
+    assert(std::abs(h.mean() - 5000.5e3) < 1);
+
+    h.record(7); // tiny values get exact buckets
+    h.reset();
+    h.record(7);
+    assert(h.percentile(50) == 7);
+
+    std::cout<<"\n1 - ok: frame histogram percentiles"<<std::endl;
+}
+
+void scope_and_counter_test() {
+    profiler& prof = profiler::instance();
+    prof.reset();
+    prof.set_tracing(true);
+
+    thread_pool tp(4);
+    for (uint32_t t = 0; t < 8; t++) {
+        tp.submit([t]() {
+            CE_PROFILE_SCOPE("task");
+            CE_PROFILE_COUNT(pair_tests, 10);
+            CE_PROFILE_COUNT(contacts, 1);
+            CE_PROFILE_MAX(max_cell_occupancy, t);
+        });
+    }
+    tp.wait_for_tasks();
+    {
+        CE_PROFILE_SCOPE("main");
+    }
+    CE_PROFILE_FRAME();
+
+    const std::vector<profiler::phase> phases = prof.phases();
+    assert(find_phase(phases, "task") && find_phase(phases, "task")->calls == 8);
+    assert(find_phase(phases, "main") && find_phase(phases, "main")->calls == 1);
+    assert(prof.value(profiler::counter::pair_tests) == 80);
+    assert(prof.value(profiler::counter::contacts) == 8);
+    assert(prof.value(profiler::counter::max_cell_occupancy) == 7);
+
+    CE_PROFILE_FRAME(); // nothing recorded since: counters and phases start over
+    assert(prof.phases().empty());
+    assert(prof.value(profiler::counter::pair_tests) == 0);
+    assert(prof.frames().count() == 1);
+
+    std::ostringstream trace;
+    prof.write_chrome_trace(trace);
+    const std::string json = trace.str();
+    assert(json.find("\"traceEvents\"") != std::string::npos);
+    assert(json.find("\"name\": \"task\", \"ph\": \"X\"") != std::string::npos);
+    assert(json.find("\"name\": \"worker 0\"") != std::string::npos);
+    assert(json.find("\"pair_tests\": 80") != std::string::npos);
+    assert(prof.summary().find("p99.9") != std::string::npos);
+
+    prof.set_tracing(false);
+    tp.stop();
+    std::cout<<"\n2 - ok: scoped timers and counters"<<std::endl;
+}
+
+void engine_instrumentation_test() {
+    profiler& prof = profiler::instance();
+    prof.reset();
+
+    simd::f32_solver solver(0.01f);
+    for (int i = 0; i < 600; i++) {
+        simd::particle<float32_t> p(3.5 * (i % 40) + 30, 3.5 * (i / 40) + 30, 3.5 * (i % 40) + 30, 3.5 * (i / 40) + 30, 2);
+        solver.add_particle(p);
+    }
+    solver.step();
+    CE_PROFILE_FRAME();
+    std::vector<profiler::phase> phases = prof.phases();
+    for (const char* name : {"step", "populate", "resolve_collision", "collide", "store", "update_particles", "integrate"}) {
+        assert(find_phase(phases, name));
+    }
+    const uint64_t soa_pairs = prof.value(profiler::counter::pair_tests);
+    const uint64_t soa_contacts = prof.value(profiler::counter::contacts);
+    assert(soa_contacts > 0 && soa_contacts <= soa_pairs);
+    assert(prof.value(profiler::counter::max_cell_occupancy) > 0);
+    solver.stop();
+
+    using W = vec2<uint32_t>;
+    using VT = vec2<float32_t>;
+    using PT = particle<VT>;
+    environment<VT, W> env(W{512, 512});
+    std::vector<PT> storage(600);
+    for (uint32_t i = 0; i < storage.size(); i++) {
+        storage[i].radius = 2;
+        storage[i].position = VT(3.5f * (i % 40) + 30, 3.5f * (i / 40) + 30);
+        storage[i].prev_position = storage[i].position;
+        env.add_particle(&storage[i]);
+    }
+    env.step(0.01f);
+    CE_PROFILE_FRAME();
+    phases = prof.phases();
+    for (const char* name : {"step", "seed", "bin", "collide", "integrate"}) {
+        assert(find_phase(phases, name));
+    }
+    const uint64_t aos_contacts = prof.value(profiler::counter::contacts);
+    assert(aos_contacts > 0 && aos_contacts <= prof.value(profiler::counter::pair_tests));
+    env.stop();
+
+    std::cout<<"\n3 - ok: engine phases and counters (soa: "<<soa_contacts<<"/"<<soa_pairs<<" contacts/pairs)"<<std::endl;
+}
+
+} // namespace collision_engine
+
+int main() {
+    std::cout<<"==================================================================="<<std::endl;
+    std::cout<<"Running profiler_test.cpp..."<<std::endl;
+    std::cout<<"==================================================================="<<std::endl;
+
+    collision_engine::histogram_test();
+    collision_engine::scope_and_counter_test();
+    collision_engine::engine_instrumentation_test();
+
+    std::cout<<"==================================================================="<<std::endl;
+    std::cout<<"profiler_test - ok."<<std::endl;
+
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include "../src/renderer/raster_renderer.hpp"
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace collision_engine {
+
+using VT = vec2<float32_t>;
+using PT = particle<VT>;
+
+void coverage_test() {
+    simd::particle_collection<float32_t> pc(1280, 1280, 0.01f);
+    pc.add(simd::particle<float32_t>(50, 50, 50, 50, 10));
+    raster_renderer r(100, 100, 100, 100, 2);
+    r.set_background(rgba{0, 0, 0, 255});
+    r.render(pc);
+
+    const uint32_t color = hsv_to_rgba(0, 0.8f, 0.8f).packed();
+    uint32_t covered = 0;
+    for (uint32_t y = 0; y < 100; y++) {
+        for (uint32_t x = 0; x < 100; x++) {
+            const uint32_t p = r.frame().pixel(x, y);
+            assert(p == color || p == (rgba{0, 0, 0, 255}.packed()));
+            covered += p == color;
+            const float32_t dx = x + 0.5f - 50, dy = y + 0.5f - 50;
+            assert((p == color) == (dx * dx + dy * dy <= 100)); // exactly the pixel centres inside
+        }
+    }
+    assert(std::abs(covered - 314.16) < 0.05 * 314.16);
+
+    simd::particle_collection<float32_t> edge(1280, 1280, 0.01f); // clipped by the image border on two sides
+    edge.add(simd::particle<float32_t>(1, 99, 1, 99, 5));
+    r.render(edge);
+    assert(r.frame().pixel(0, 99) == color && r.frame().pixel(10, 90) != color);
+    r.stop();
+
+    std::cout<<"\n1 - ok: circle coverage and clipping ("<<covered<<" pixels)"<<std::endl;
+}
+
+void determinism_test() {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float32_t> pos(-5, 405), rad(1, 6);
+    simd::particle_collection<float32_t> pc(1280, 1280, 0.01f);
+    std::vector<PT> storage(3000);
+    std::vector<PT*> particles;
+    for (PT& p : storage) {
+        p.position = VT(pos(rng), pos(rng));
+        p.radius = rad(rng);
+        pc.add(simd::particle<float32_t>(p.position.i(), p.position.j(), p.position.i(), p.position.j(), p.radius));
+        particles.push_back(&p);
+    }
+
+    raster_renderer serial(333, 257, 400, 400, 1, simd::isa::level::scalar); // sizes that are not multiples of a tile
+    raster_renderer parallel(333, 257, 400, 400, 3);
+    raster_renderer aos(333, 257, 400, 400, 2);
+    serial.render(pc);
+    parallel.render(pc);
+    aos.render(particles);
+    for (uint32_t y = 0; y < 257; y++) {
+        for (uint32_t x = 0; x < 333; x++) {
+            assert(serial.frame().pixel(x, y) == parallel.frame().pixel(x, y));
+            assert(serial.frame().pixel(x, y) == aos.frame().pixel(x, y));
+        }
+    }
+    serial.stop();
+    parallel.stop();
+    aos.stop();
+
+    std::cout<<"\n2 - ok: identical frames across threads, isa and engines"<<std::endl;
+}
+
+void removal_test() {
+    simd::particle_collection<float32_t> pc(1280, 1280, 0.01f);
+    std::vector<uint32_t> handles;
+    for (uint32_t i = 0; i < 4; i++) {
+        handles.push_back(pc.add(simd::particle<float32_t>(12.5f + 25 * i, 50, 12.5f + 25 * i, 50, 5)));
+    }
+    // the last particle moves into index 0 and keeps slot 3, above the 3 particles left
+    assert(pc.remove({handles[0]}) == 1);
+    assert(pc.slot_of(0) == 3 && pc.slot_count() > pc.size());
+
+    raster_renderer r(100, 100, 100, 100, 2);
+    r.set_background(rgba{0, 0, 0, 255});
+    r.render(pc);
+    assert(r.frame().pixel(12, 50) == (rgba{0, 0, 0, 255}.packed()));
+    for (uint32_t slot = 1; slot < 4; slot++) {
+        assert(r.frame().pixel(12 + 25 * slot, 50) == hsv_to_rgba(slot * 0.05f, 0.8f, 0.8f).packed());
+    }
+    r.stop();
+
+    std::cout<<"\n3 - ok: particles keep their colour across a removal"<<std::endl;
+}
+
+void output_test() {
+    simd::particle_collection<float32_t> pc(1280, 1280, 0.01f);
+    pc.add(simd::particle<float32_t>(20, 20, 20, 20, 8));
+    raster_renderer r(40, 30, 40, 30, 1);
+    r.render(pc);
+
+    std::ostringstream raw, ppm, png;
+    r.frame().write_raw(raw);
+    assert(raw.str().size() == 40 * 30 * 4);
+    r.frame().write_ppm(ppm);
+    assert(ppm.str().rfind("P6\n40 30\n255\n", 0) == 0 && ppm.str().size() == 13 + 40 * 30 * 3);
+    const rgba c = hsv_to_rgba(0, 0.8f, 0.8f);
+    const size_t centre = 13 + (20 * 40 + 20) * 3;
+    assert(static_cast<uint8_t>(ppm.str()[centre]) == c.r && static_cast<uint8_t>(ppm.str()[centre + 1]) == c.g);
+
+    r.frame().write_png(png);
+    const std::string s = png.str();
+    assert(s.compare(1, 3, "PNG") == 0 && s.compare(12, 4, "IHDR") == 0 && s.compare(37, 4, "IDAT") == 0);
+    const size_t raw_bytes = (40 * 4 + 1) * 30;
+    assert(s.size() == 8 + 25 + 12 + 2 + 5 + raw_bytes + 4 + 12); // one stored block
+    assert(s.compare(s.size() - 8, 4, "IEND") == 0);
+    r.stop();
+
+    std::cout<<"\n4 - ok: raw, ppm and png output"<<std::endl;
+}
+
+void throughput_test() {
+    constexpr uint32_t n = 100000;
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float32_t> pos(0, 1280);
+    simd::particle_collection<float32_t> pc(1280, 1280, 0.01f);
+    for (uint32_t i = 0; i < n; i++) {
+        const float32_t x = pos(rng), y = pos(rng);
+        pc.add(simd::particle<float32_t>(x, y, x, y, 2));
+    }
+    raster_renderer r(1280, 1280, 1280, 1280);
+    r.render(pc); // warm up the bins
+    const uint32_t frames = 20;
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t f = 0; f < frames; f++) {
+        r.render(pc);
+    }
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+    r.stop();
+
+    std::cout<<"\n5 - ok: "<<n<<" particles at 1280x1280 in "<<ms<<" ms/frame ("<<thread_pool::hardware_threads()<<" threads, "<<simd::isa::name(simd::isa::active())<<")"<<std::endl;
+}
+
+} // namespace collision_engine
+
+int main() {
+    std::cout<<"==================================================================="<<std::endl;
+    std::cout<<"Running raster_renderer_test.cpp..."<<std::endl;
+    std::cout<<"==================================================================="<<std::endl;
+
+    collision_engine::coverage_test();
+    collision_engine::determinism_test();
+    collision_engine::removal_test();
+    collision_engine::output_test();
+    collision_engine::throughput_test();
+
+    std::cout<<"==================================================================="<<std::endl;
+    std::cout<<"raster_renderer_test - ok."<<std::endl;
+
+    return 0;
+}
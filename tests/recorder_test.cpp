@@ -0,0 +1,171 @@
+#include "../src/physics/recorder.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace collision_engine {
+
+void encoding_test() {
+    const float32_t extent = 512;
+    const float32_t step = extent / 65535.f;
+    for (float32_t v : {0.f, 0.3f, 17.25f, 255.999f, 511.9f, 512.f}) {
+        assert(std::abs(trajectory_detail::dequantize(trajectory_detail::quantize(v, extent), extent) - v) <= step);
+    }
+    assert(trajectory_detail::quantize(-3.f, extent) == 0); // outside the world is clamped
+    assert(trajectory_detail::quantize(600.f, extent) == 65535);
+
+    const std::vector<uint16_t> prev = {0, 100, 65535, 30000, 7};
+    const std::vector<uint16_t> cur = {65535, 101, 0, 29990, 7};
+    std::vector<uint8_t> bytes;
+    trajectory_detail::encode_delta(cur.data(), prev.data(), cur.size(), bytes);
+    assert(bytes.size() == 5); // wrapping differences of +-1, +1, -10 and 0 take one byte each
+    std::vector<uint16_t> plane = prev;
+    assert(trajectory_detail::decode_delta(bytes.data(), bytes.size(), plane.data(), plane.size()) == bytes.size());
+    assert(plane == cur);
+    assert(trajectory_detail::decode_delta(bytes.data(), bytes.size() - 1, plane.data(), plane.size()) == 0);
+
+    std::cout<<"\n1 - ok: quantization and delta encoding"<<std::endl;
+}
+
+/**
+ * Records `frames` steps of a reordering solver that loses particles at frame 40 and
+ * refills one of their slots at frame 60, keeping the exact positions in slot order
+ */
+std::vector<std::vector<float32_t>> record_solver(const std::string& path, uint32_t frames, uint32_t keyframe_interval) {
+    simd::f32_solver solver(0.01f);
+    solver.set_reordering(simd::ordering::cell, 4);
+    std::vector<uint32_t> doomed;
+    for (int i = 0; i < 500; i++) {
+        simd::particle<float32_t> p(3.5 * (i % 40) + 30, 3.5 * (i / 40) + 30, 3.5 * (i % 40) + 29.5, 3.5 * (i / 40) + 30, 1.5);
+        const uint32_t handle = solver.add_particle(p);
+        if (i % 50 == 7) doomed.push_back(handle);
+    }
+
+    std::vector<std::vector<float32_t>> expected; // x plane then y plane
+    trajectory_recorder recorder(path, solver.world_width(), solver.world_height(), 1000, 256, keyframe_interval);
+    assert(recorder.is_open());
+    const auto& pc = solver.pc();
+    for (uint32_t f = 0; f < frames; f++) {
+        if (f == 40) {
+            assert(solver.remove_particles(doomed) == 10);
+        } else if (f == 60) {
+            solver.add_particle(simd::particle<float32_t>(200, 30, 200, 30, 1.5));
+        }
+        solver.step();
+        assert(recorder.record(solver)); // the ring is larger than the recording
+        const size_t n = pc.slot_count();
+        std::vector<float32_t> planes(2 * n); // free slots read as (0, 0)
+        for (uint32_t h = 0; h < n; h++) {
+            const uint32_t idx = pc.handles().index_of_slot(h);
+            if (idx != handle_table::invalid) {
+                planes[h] = pc.xs[idx];
+                planes[n + h] = pc.ys[idx];
+            }
+        }
+        expected.push_back(planes);
+    }
+    recorder.close();
+    assert(recorder.ok() && recorder.frames() == frames && recorder.dropped() == 0);
+    assert(!recorder.record(solver));
+    solver.stop();
+    return expected;
+}
+
+bool matches(const trajectory_reader& reader, const std::vector<float32_t>& planes) {
+    const float32_t tolerance = 512.f / 65535.f;
+    const size_t n = reader.size();
+    if (planes.size() != 2 * n) {
+        return false;
+    }
+    for (size_t h = 0; h < n; h++) {
+        if (std::abs(reader.xs()[h] - planes[h]) > tolerance || std::abs(reader.ys()[h] - planes[n + h]) > tolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void record_and_read_test() {
+    const std::string path = "recorder_test.traj";
+    const std::vector<std::vector<float32_t>> expected = record_solver(path, 150, 32);
+
+    trajectory_reader reader(path);
+    assert(reader.is_open() && reader.frames() == 150 && reader.keyframe_interval() == 32);
+    for (uint32_t f = 0; f < 150; f++) {
+        assert(reader.next() && reader.frame() == f);
+        assert(matches(reader, expected[f]));
+    }
+    assert(!reader.next());
+
+    struct stat st;
+    assert(::stat(path.c_str(), &st) == 0);
+    const size_t raw = 150 * 500 * 2 * sizeof(float32_t);
+    assert(static_cast<size_t>(st.st_size) < raw / 2); // 16 bit quantization alone halves it
+    std::remove(path.c_str());
+
+    std::cout<<"\n2 - ok: record and read back ("<<st.st_size<<" bytes, "<<raw<<" raw)"<<std::endl;
+}
+
+void seek_test() {
+    const std::string path = "recorder_test_seek.traj";
+    const std::vector<std::vector<float32_t>> expected = record_solver(path, 100, 16);
+    {
+        trajectory_reader reader(path);
+        for (uint64_t f : {0, 99, 16, 15, 47, 48, 49, 3, 3, 80}) {
+            assert(reader.seek(f) && reader.frame() == f);
+            assert(matches(reader, expected[f]));
+        }
+        assert(!reader.seek(100));
+    }
+
+    struct stat st; // an unfinished recording (no index) is still readable
+    assert(::stat(path.c_str(), &st) == 0);
+    const uint64_t index_bytes = 7 * sizeof(trajectory_keyframe) + sizeof(trajectory_trailer); // keyframes 0, 16, .., 96
+    assert(::truncate(path.c_str(), st.st_size - index_bytes - 10) == 0); // and the last frame cut short
+    trajectory_reader reader(path);
+    assert(reader.is_open() && reader.frames() == 99);
+    assert(reader.seek(98) && matches(reader, expected[98]));
+    assert(reader.seek(20) && matches(reader, expected[20]));
+    std::remove(path.c_str());
+
+    assert(!trajectory_reader("recorder_test_missing.traj").is_open());
+
+    std::vector<float32_t> xs(4001, 100.f), ys(4001, 200.f); // a writer that falls behind drops frames, never blocks
+    {
+        trajectory_recorder recorder(path, 512, 512, 4000, 2, 8);
+        for (uint32_t f = 0; f < 500; f++) {
+            xs[f] += 1;
+            recorder.record(xs.data(), ys.data(), 4000);
+        }
+        assert(!recorder.record(xs.data(), ys.data(), xs.size())); // larger than the slots
+        recorder.close();
+        assert(recorder.frames() + recorder.dropped() == 501);
+        assert(trajectory_reader(path).frames() == recorder.frames());
+    }
+    std::remove(path.c_str());
+
+    std::cout<<"\n3 - ok: keyframe seeking"<<std::endl;
+}
+
+} // namespace collision_engine
+
+int main() {
+    std::cout<<"==================================================================="<<std::endl;
+    std::cout<<"Running recorder_test.cpp..."<<std::endl;
+    std::cout<<"==================================================================="<<std::endl;
+
+    collision_engine::encoding_test();
+    collision_engine::record_and_read_test();
+    collision_engine::seek_test();
+
+    std::cout<<"==================================================================="<<std::endl;
+    std::cout<<"recorder_test - ok."<<std::endl;
+
+    return 0;
+}
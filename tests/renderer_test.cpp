@@ -1,11 +1,55 @@
 #include "../src/renderer/renderer.hpp"
+#include "../src/physics/snapshot.hpp"
 #include "SFML/System/Clock.hpp"
 #include "common/allocator.hpp"
+#include <cassert>
 #include <cstdint>
+#include <cstdlib>
 #include <iostream>
+#include <vector>
 
 namespace collision_engine {
 
+/**
+ * Removing particles moves the last ones into the holes; their quads must follow their
+ * handle slots and the slots of removed particles must collapse
+ */
+void remove_particles_keeps_slots_test() {
+    using W = vec2<uint32_t>;
+    using VT = vec2<float32_t>;
+    using PT = particle<VT>;
+    constexpr uint32_t n = 8;
+
+    environment<VT, W> env(W{256, 256});
+    std::vector<PT> particles(n);
+    std::vector<uint32_t> handles;
+    for (uint32_t i = 0; i < n; i++) {
+        particles[i].radius = 2 + i % 3;
+        particles[i].position = VT(20 + 20 * i, 40);
+        particles[i].prev_position = particles[i].position;
+        handles.push_back(env.add_particle(&particles[i]));
+    }
+    renderer<VT, W> r(env);
+    r.init_frame();
+
+    // the holes are refilled from the tail, so index and slot part ways
+    assert(env.remove_particles({handles[1], handles[4]}) == 2);
+    r.update_frame();
+
+    const particle_batch& batch = r.batch();
+    assert(batch.size() == n);
+    for (uint32_t i = 0; i < n; i++) {
+        const sf::FloatRect quad = batch.bounds(handles[i] & handle_table::slot_mask);
+        if (i == 1 || i == 4) {
+            assert(quad.width == 0 && quad.height == 0);
+            continue;
+        }
+        assert(quad.left == particles[i].position.i() && quad.top == particles[i].position.j());
+        assert(quad.width == 2 * particles[i].radius && quad.height == 2 * particles[i].radius);
+    }
+    std::cout<<"1 - ok: removed particles leave their slots empty"<<std::endl;
+}
+
 void allocate_particle_during_simulation() { 
     constexpr uint32_t fps_cap      = 60;
     constexpr uint32_t n_particles  = 28000;
@@ -29,7 +73,28 @@ void allocate_particle_during_simulation() {
     float32_t fps           = 0;
     int count               = 0;
 
-    linear_allocator alloc(n_particles * sizeof(PT));
+    // grows as particles are emitted; a chunk holds a whole restored scene
+    pool_allocator alloc(sizeof(PT), alignof(PT), n_particles, page_backing::transparent);
+
+    // start from (and save back to) a settled scene instead of emitting it particle by particle
+    const char* snapshot_path = std::getenv("COLLISION_ENGINE_SNAPSHOT");
+    if (snapshot_path) {
+        const snapshot_file file(snapshot_path);
+        const uint64_t n = file.view().valid() ? file.view().header().count : 0;
+        if (n > 0 && n <= n_particles) {
+            auto* storage = static_cast<PT*>(alloc.allocate(n * sizeof(PT), alignof(PT)));
+            if (restore(file.view(), env, storage)) {
+                for (uint64_t i = 0; i < n; i++) {
+                    r.add_object_to_frame(storage + i);
+                }
+                count = n;
+            }
+        }
+    }
+#if defined(CE_PROFILE)
+    const char* trace_path = std::getenv("COLLISION_ENGINE_TRACE"); // Chrome trace written on exit
+    profiler::instance().set_tracing(trace_path != nullptr);
+#endif
 
     while(r.run()) {
         if (count < n_particles) {
@@ -54,6 +119,15 @@ void allocate_particle_during_simulation() {
 
         r.update_metadata(fps, c_time, count); 
         r.render_with_metadata();
+        CE_PROFILE_FRAME();
+    }
+#if defined(CE_PROFILE)
+    if (trace_path) {
+        profiler::instance().write_chrome_trace(trace_path);
+    }
+#endif
+    if (snapshot_path) {
+        save_snapshot(snapshot_path, env);
     }
 }
 
@@ -63,6 +137,7 @@ void allocate_particle_during_simulation() {
 int main() {
     std::cout<<"Running renderer_test.cpp..."<<std::endl;
     
+    collision_engine::remove_particles_keeps_slots_test();
     collision_engine::allocate_particle_during_simulation();
 
     std::cout<<"renderer_test - ok."<<std::endl;
@@ -0,0 +1,196 @@
+#include "../src/physics/runner.hpp"
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace collision_engine {
+
+using W = vec2<uint32_t>;
+using VT = vec2<float32_t>;
+using PT = particle<VT>;
+
+void triple_buffer_test() {
+    triple_buffer<std::vector<uint64_t>> tb;
+    assert(!tb.update());
+    tb.back().assign(4, 1);
+    tb.publish();
+    tb.back().assign(4, 2); // the consumer only ever sees the latest publish
+    tb.publish();
+    assert(tb.update() && tb.front() == std::vector<uint64_t>(4, 2));
+    assert(!tb.update() && tb.front() == std::vector<uint64_t>(4, 2));
+
+    triple_buffer<std::vector<uint64_t>> stream; // every slot read is one complete, newer publish
+    constexpr uint64_t publishes = 200000;
+    std::thread producer([&stream]() {
+        for (uint64_t v = 1; v <= publishes; v++) {
+            stream.back().assign(64, v);
+            stream.publish();
+        }
+    });
+    uint64_t last = 0, seen = 0;
+    while (last < publishes) {
+        if (!stream.update()) {
+            continue;
+        }
+        const std::vector<uint64_t>& slot = stream.front();
+        for (uint64_t x : slot) {
+            assert(x == slot[0]);
+        }
+        assert(slot[0] > last);
+        last = slot[0];
+        seen++;
+    }
+    producer.join();
+
+    std::cout<<"\n1 - ok: triple buffer ("<<seen<<" of "<<publishes<<" publishes seen)"<<std::endl;
+}
+
+void free_running_test() {
+    simd::f32_solver solver(0.01f);
+    solver.set_reordering(simd::ordering::cell, 4); // frames stay in handle order regardless
+    for (int i = 0; i < 300; i++) {
+        simd::particle<float32_t> p(3.5 * (i % 30) + 30, 3.5 * (i / 30) + 30, 3.5 * (i % 30) + 30, 3.5 * (i / 30) + 30, 1.5);
+        solver.add_particle(p);
+    }
+    simulation_runner<simd::f32_solver> runner(solver, solver.dt(), false);
+    assert(runner.latest() == nullptr);
+    uint32_t spawned = 0;
+    runner.on_step([&spawned](simd::f32_solver& s) { // runs on the physics thread
+        if (spawned < 40) {
+            s.add_particle(simd::particle<float32_t>(200, 400, 200, 400, 1.5));
+            spawned++;
+        }
+    });
+    runner.start();
+
+    uint64_t last_step = 0;
+    uint32_t frames = 0;
+    while (runner.steps() < 100) {
+        const state_frame* f = runner.latest();
+        if (f && f->step != last_step) {
+            assert(f->step > last_step);
+            assert(f->count == f->xs.size() && f->pxs.size() == f->count && f->rs.size() == f->count);
+            last_step = f->step;
+            frames++;
+        }
+    }
+    runner.stop();
+    assert(!runner.running() && runner.dropped() == 0);
+
+    const state_frame* f = runner.latest(); // the last step is published before stop() returns
+    assert(f && f->step == runner.steps() && f->count == 340);
+    const auto& pc = solver.pc();
+    for (uint32_t h = 0; h < f->count; h++) {
+        assert(f->xs[h] == pc.xs[pc.index_of(h)] && f->ys[h] == pc.ys[pc.index_of(h)]);
+    }
+    solver.stop();
+
+    std::cout<<"\n2 - ok: free running solver ("<<runner.steps()<<" steps, "<<frames<<" frames read)"<<std::endl;
+}
+
+void realtime_test() {
+    environment<VT, W> env(W{256, 256}, 1);
+    std::vector<PT> storage(50);
+    for (uint32_t i = 0; i < storage.size(); i++) {
+        storage[i].radius = 2;
+        storage[i].position = VT(10.f * (i % 10) + 50, 10.f * (i / 10) + 50);
+        storage[i].prev_position = storage[i].position;
+        env.add_particle(&storage[i]);
+    }
+    const float32_t dt = 1.f / 200;
+    simulation_runner<environment<VT, W>> runner(env, dt);
+    const auto start = state_frame::clock::now();
+    runner.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    const state_frame* f = runner.latest();
+    const auto now = state_frame::clock::now();
+    runner.stop();
+    const double elapsed = std::chrono::duration<double>(state_frame::clock::now() - start).count();
+
+    // paced to wall time: never ahead of it, and steps plus dropped steps keep up with it
+    assert(runner.steps() <= elapsed / dt + 2);
+    assert(runner.steps() + runner.dropped() >= 0.5 * 0.25 / dt);
+    assert(f && f->count == 50);
+    const float32_t alpha = f->alpha(now);
+    assert(alpha >= 0 && alpha <= 1);
+    assert(f->alpha(f->stamp) == 0 && f->alpha(f->stamp + std::chrono::seconds(1)) == 1);
+    bool moved = false;
+    for (uint32_t i = 0; i < f->count; i++) {
+        moved |= f->ys[i] != f->pys[i]; // falling: consecutive steps differ
+    }
+    assert(moved);
+    env.stop();
+
+    std::cout<<"\n3 - ok: real time pacing ("<<runner.steps()<<" steps, "<<runner.dropped()<<" dropped in "<<elapsed<<" s)"<<std::endl;
+}
+
+
+void removal_test() {
+    simd::f32_solver solver(0.01f);
+    std::vector<uint32_t> handles;
+    for (int i = 0; i < 100; i++) {
+        simd::particle<float32_t> p(5 * (i % 10) + 30, 5 * (i / 10) + 30, 5 * (i % 10) + 30, 5 * (i / 10) + 30, 1.5);
+        handles.push_back(solver.add_particle(p));
+    }
+    simulation_runner<simd::f32_solver> runner(solver, solver.dt(), false);
+    uint32_t steps = 0;
+    runner.on_step([&](simd::f32_solver& s) { // drop one particle per step, and refill every other slot
+        if (steps < 40) {
+            assert(s.remove_particle(handles[steps]));
+            if (steps % 2 == 0) {
+                handles.push_back(s.add_particle(simd::particle<float32_t>(200, 30, 200, 30, 1.5)));
+            }
+        }
+        steps++;
+    });
+    runner.start();
+    while (runner.steps() < 60) {
+        const state_frame* f = runner.latest();
+        if (f) { // frames stay indexed by slot, removed particles have no radius
+            assert(f->count == 100 && f->rs.size() == 100);
+            for (uint32_t h = 0; h < f->count; h++) {
+                assert(f->rs[h] == 0 || f->rs[h] == 1.5f);
+            }
+        }
+    }
+    runner.stop();
+
+    const state_frame* f = runner.latest();
+    const auto& pc = solver.pc();
+    assert(pc.size() == 80 && pc.slot_count() == 100);
+    uint32_t live = 0;
+    for (uint32_t slot = 0; slot < f->count; slot++) {
+        const uint32_t idx = pc.handles().index_of_slot(slot);
+        if (idx == handle_table::invalid) {
+            assert(f->rs[slot] == 0);
+        } else {
+            assert(f->xs[slot] == pc.xs[idx] && f->ys[slot] == pc.ys[idx] && f->rs[slot] == 1.5f);
+            live++;
+        }
+    }
+    assert(live == 80);
+    solver.stop();
+
+    std::cout<<"\n4 - ok: removal while running ("<<f->count - live<<" free slots)"<<std::endl;
+}
+
+} // namespace collision_engine
+
+int main() {
+    std::cout<<"==================================================================="<<std::endl;
+    std::cout<<"Running runner_test.cpp..."<<std::endl;
+    std::cout<<"==================================================================="<<std::endl;
+
+    collision_engine::triple_buffer_test();
+    collision_engine::free_running_test();
+    collision_engine::realtime_test();
+    collision_engine::removal_test();
+
+    std::cout<<"==================================================================="<<std::endl;
+    std::cout<<"runner_test - ok."<<std::endl;
+
+    return 0;
+}
@@ -1,7 +1,7 @@
 #include "../src/physics/simd_collection.hpp"
-#include <arm_neon.h>
 #include <cassert>
 #include <iostream>
+#include <vector>
 
 namespace collision_engine::simd {
 
@@ -50,10 +50,10 @@ void single_dim_verlet_update_test() {
             particle<float32_t> p(8, 8, 8, 8, 2);
             col.add(p);
         }
-        col.single_dim_verlet_update(col.pxs.data(), col.xs.data(), col.ax_reg, 0, col.x_buffer.data(), WW);
-        col.single_dim_verlet_update(col.pxs.data(), col.xs.data(), col.ax_reg, 4, col.x_buffer.data(), WW);
-        col.single_dim_verlet_update(col.pys.data(), col.ys.data(), col.ay_reg, 0, col.y_buffer.data(), WH);
-        col.single_dim_verlet_update(col.pys.data(), col.ys.data(), col.ay_reg, 4, col.y_buffer.data(), WH);
+        col.single_dim_verlet_update(col.pxs.data(), col.xs.data(), col.ax, 0, col.x_buffer.data(), WW);
+        col.single_dim_verlet_update(col.pxs.data(), col.xs.data(), col.ax, 4, col.x_buffer.data(), WW);
+        col.single_dim_verlet_update(col.pys.data(), col.ys.data(), col.ay, 0, col.y_buffer.data(), WH);
+        col.single_dim_verlet_update(col.pys.data(), col.ys.data(), col.ay, 4, col.y_buffer.data(), WH);
         
         for (int i=0;i<8;i++) { assert(col.x_buffer[i] == 8); }
         for (int i=0;i<8;i++) { assert(8.980 <= col.y_buffer[i] && col.y_buffer[i] <= 8.982); }
@@ -117,6 +117,77 @@ void boundary_check_test() {
     std::cout<<"5 - ok: boundary checks"<<std::endl; 
 }
 
+
+void remove_particles_test() {
+    static constexpr uint32_t WW = 128;
+    static constexpr uint32_t WH = 128;
+    particle_collection<float32_t> col(WW, WH, 0.1);
+
+    std::vector<uint32_t> handles;
+    for (uint32_t i = 0; i < 10000; i++) { // each particle's x identifies it
+        handles.push_back(col.add(particle<float32_t>(i, 1, i, 1, 1)));
+    }
+    std::vector<uint32_t> order(col.size()); // scrambled, so index and slot differ
+    for (uint32_t i = 0; i < order.size(); i++) order[i] = i * 7919 % order.size();
+    col.reorder(order);
+
+    // every third particle in one batch, with a repeated and a made up handle in it
+    std::vector<uint32_t> doomed;
+    for (uint32_t i = 0; i < handles.size(); i += 3) doomed.push_back(handles[i]);
+    doomed.push_back(handles[0]);
+    doomed.push_back(handles[1] + (1u << handle_table::slot_bits));
+    assert(col.remove(doomed) == 3334);
+    assert(col.size() == 6666 && col.rs.size() == 6666 && col.slot_count() == 10000);
+    for (uint32_t i = 0; i < handles.size(); i++) { // the survivors keep their handles and data
+        const uint32_t idx = col.index_of(handles[i]);
+        assert((idx == handle_table::invalid) == (i % 3 == 0));
+        if (idx != handle_table::invalid) {
+            assert(col.xs[idx] == i && col.handle_of(idx) == handles[i]);
+        }
+    }
+    assert(col.remove(doomed) == 0); // already stale
+
+    // a reused slot comes back with the next generation, the old handle stays stale
+    const uint32_t reused = col.add(particle<float32_t>(-1, 1, -1, 1, 1));
+    assert(handle_table::slot(reused) == handle_table::slot(doomed[doomed.size() - 3]));
+    assert(handle_table::generation(reused) == 1 && !col.handles().contains(doomed[doomed.size() - 3]));
+    assert(col.xs[col.index_of(reused)] == -1 && col.slot_count() == 10000);
+
+    for (uint32_t i = 1; i < handles.size(); i += 3) doomed.push_back(handles[i]);
+    doomed.push_back(reused);
+    for (uint32_t i = 2; i < handles.size(); i += 3) doomed.push_back(handles[i]);
+    assert(col.remove(doomed) == 6667 && col.size() == 0 && col.handles().free_slots().size() == 10000);
+
+    std::cout<<"6 - ok: remove particles"<<std::endl;
+}
+
+void step_3d_test() {
+    static constexpr uint32_t WW = 128;
+    static constexpr uint32_t WH = 64;
+    static constexpr uint32_t WD = 32;
+    particle_collection<float32_t, 3> col(WW, WH, WD, 0.1);
+
+    std::vector<uint32_t> handles;
+    for (int i = 0; i < 20; i++) { // odd count, so the last register is partial
+        handles.push_back(col.add(particle<float32_t, 3>(8, 8, 8, 7.8, 7.8, 8.2, 1)));
+    }
+    handles.push_back(col.add(particle<float32_t, 3>(2, 2, 40, 3, 3, 38, 1)));
+    col.step();
+
+    for (int i = 0; i < 20; i++) { // x as in 2D, gravity along y only, z mirrors x
+        assert(col.pxs[i] == 8 && col.pys[i] == 8 && col.pzs[i] == 8);
+        assert(8.119 <= col.xs[i] && col.xs[i] <= 8.121);
+        assert(9.100 <= col.ys[i] && col.ys[i] <= 9.102);
+        assert(7.879 <= col.zs[i] && col.zs[i] <= 7.881);
+    }
+    assert(col.xs[20] == 4 && col.ys[20] == 4 && col.zs[20] == WD - 4); // clamped to every wall
+
+    assert(col.remove({handles[3]}) == 1 && col.size() == 20);
+    assert(col.zs[3] == WD - 4 && col.index_of(handles[20]) == 3);
+
+    std::cout<<"7 - ok: 3D step and boundary checks"<<std::endl;
+}
+
 } // namespace collision_engine
 
 int main() { 
@@ -129,6 +200,8 @@ int main() {
     collision_engine::simd::single_dim_verlet_update_test();
     collision_engine::simd::step_function_test();
     collision_engine::simd::boundary_check_test();
+    collision_engine::simd::remove_particles_test();
+    collision_engine::simd::step_3d_test();
 
     std::cout<<"==================================================================="<<std::endl;
     std::cout<<"simd_collection_test - ok."<<std::endl;
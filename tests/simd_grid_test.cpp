@@ -0,0 +1,332 @@
+#include "../src/physics/simd_grid.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+
+namespace collision_engine::simd {
+
+void populate_simd_grid_test() {
+    static constexpr uint32_t WW = 128;
+    static constexpr uint32_t WH = 128;
+
+    particle_collection<float32_t> col(WW, WH, 0.1);
+    grid<float32_t, binning::shift> g(WW, WH, 16, 16);
+
+    for (uint32_t i = 0; i < 16; ++i) { // place 1 particle on each of the 256 cells
+        for (uint32_t j = 0; j < 16; ++j) {
+            particle<float32_t> p(i * 8 + 4, j * 8 + 4, i * 8 + 4, j * 8 + 4, 2);
+            col.add(p);
+        }
+    }
+    for (uint32_t i = 0; i < 10; ++i) { // arbitrarily place 10 more particles on pixel (65, 13)
+        particle<float32_t> p(65, 13, 65, 13, 2);
+        col.add(p);
+    }
+
+    g.populate(col);
+
+    const uint32_t hot_cell = g.get_cell_id(65, 13);
+    assert(hot_cell == (1 + 1) * g.stride + (8 + 1)); // row from y, column from x
+
+    uint32_t total = 0;
+    for (uint32_t cell_id = 0; cell_id < g.cell_count; ++cell_id) {
+        const uint32_t row = cell_id / g.stride;
+        const uint32_t col_idx = cell_id % g.stride;
+        const bool border = row == 0 || row == 17 || col_idx == 0 || col_idx == 17;
+
+        cell<float32_t> c = g.get_cell(cell_id);
+        if (border) {
+            assert(c.size == 0 && "sentinel cells must stay empty");
+        } else if (cell_id == hot_cell) {
+            assert(c.size == 11);
+        } else {
+            assert(c.size == 1);
+        }
+        for (uint32_t k = 0; k < c.size; ++k) { // every slot holds a particle binned to this cell
+            assert(g.get_cell_id(c.xs[k], c.ys[k]) == cell_id);
+            assert(col.xs[c.ids[k]] == c.xs[k]);
+        }
+        total += c.size;
+    }
+    assert(total == col.xs.size());
+
+    g.populate(col); // rebuilding reuses storage and yields the same layout
+    assert(g.get_cell(hot_cell).size == 11);
+
+    std::cout<<"\n1 - ok: populate simd grid"<<std::endl;
+}
+
+void update_simd_grid_test() {
+    static constexpr uint32_t WW = 128;
+    static constexpr uint32_t WH = 128;
+
+    particle_collection<float32_t> col(WW, WH, 0.1);
+    grid<float32_t> incremental(WW, WH, 16, 16), reference(WW, WH, 16, 16);
+
+    for (uint32_t i = 0; i < 16; ++i) { // 4 particles in each cell
+        for (uint32_t j = 0; j < 64; ++j) {
+            particle<float32_t> p(i * 8 + 2, j * 2 + 1, i * 8 + 2, j * 2 + 1, 1);
+            col.add(p);
+        }
+    }
+    incremental.populate(col);
+    assert(incremental.migrations() == col.xs.size());
+
+    // nudge every particle within its cell, and push every 16th one into the next column
+    uint32_t moved = 0;
+    for (uint32_t idx = 0; idx < col.xs.size(); ++idx) {
+        col.ys[idx] += 0.5f;
+        if (idx % 16 == 0 && col.xs[idx] < WW - 8) {
+            col.xs[idx] += 8;
+            moved++;
+        }
+    }
+    incremental.update(col);
+    reference.populate(col);
+    assert(incremental.migrations() == moved);
+
+    for (uint32_t cell_id = 0; cell_id < incremental.cell_count; ++cell_id) { // same cells, same contents
+        cell<float32_t> c = incremental.get_cell(cell_id);
+        assert(c.size == reference.cell_size(cell_id));
+        for (uint32_t k = 0; k < c.size; ++k) {
+            assert(incremental.get_cell_id(c.xs[k], c.ys[k]) == cell_id);
+            assert(col.xs[c.ids[k]] == c.xs[k] && col.ys[c.ids[k]] == c.ys[k]);
+        }
+    }
+
+    incremental.update(col); // nothing moved since
+    assert(incremental.migrations() == 0);
+
+    for (uint32_t idx = 0; idx < col.xs.size(); ++idx) { // churn above the threshold repopulates
+        col.ys[idx] = WH - 1 - col.ys[idx];
+    }
+    incremental.update(col);
+    assert(incremental.migrations() > incremental.rebuild_fraction * col.xs.size());
+    for (uint32_t cell_id = 0; cell_id < incremental.cell_count; ++cell_id) {
+        cell<float32_t> c = incremental.get_cell(cell_id);
+        for (uint32_t k = 0; k < c.size; ++k) {
+            assert(incremental.get_cell_id(c.xs[k], c.ys[k]) == cell_id);
+        }
+    }
+
+    std::cout<<"\n2 - ok: incremental simd grid update ("<<moved<<" migrated)"<<std::endl;
+}
+
+void reciprocal_binning_test() {
+    static constexpr uint32_t WW = 1280;
+    static constexpr uint32_t WH = 720;
+    static constexpr uint32_t R  = 23;
+    static constexpr uint32_t C  = 37;
+
+    particle_collection<float32_t> col(WW, WH, 0.1);
+    grid<float32_t> g(WW, WH, R, C); // neither cell side is a whole number of pixels
+    for (uint32_t k = 0; k < 4000; ++k) {
+        const float32_t x = (k * 7919 % 12800) * 0.1f;
+        const float32_t y = (k * 104729 % 7200) * 0.1f;
+        col.add(particle<float32_t>(x, y, x, y, 1));
+    }
+    g.populate(col);
+
+    const double cell_w = double(WW) / C, cell_h = double(WH) / R;
+    uint32_t total = 0;
+    for (uint32_t cell_id = 0; cell_id < g.cell_count; ++cell_id) {
+        cell<float32_t> c = g.get_cell(cell_id);
+        const uint32_t row = cell_id / g.stride - 1;
+        const uint32_t col_idx = cell_id % g.stride - 1;
+        for (uint32_t k = 0; k < c.size; ++k) { // within the cell's bounds, up to rounding at its edges
+            assert(c.xs[k] >= col_idx * cell_w - 1e-3 && c.xs[k] < (col_idx + 1) * cell_w + 1e-3);
+            assert(c.ys[k] >= row * cell_h - 1e-3 && c.ys[k] < (row + 1) * cell_h + 1e-3);
+        }
+        total += c.size;
+    }
+    assert(total == col.xs.size());
+    assert(g.get_cell_id(-5, -5) == g.stride + 1 && g.get_cell_id(WW + 5, WH + 5) == R * g.stride + C);
+
+    g.resize(WW, WH, 8, 16); // empties the grid, update() repopulates it
+    assert(g.ids.size() == 0 && g.cell_count == 10 * 18);
+    g.update(col);
+    assert(g.ids.size() == col.xs.size());
+
+    bool thrown = false;
+    try {
+        grid<float32_t, binning::shift> shifted(WW, WH, R, C);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    std::cout<<"\n3 - ok: reciprocal binning of a "<<WW<<"x"<<WH<<" world into "<<R<<"x"<<C<<" cells"<<std::endl;
+}
+
+void hierarchical_grid_test() {
+    static constexpr uint32_t WW = 256;
+    static constexpr uint32_t WH = 256;
+
+    particle_collection<float32_t> col(WW, WH, 0.1);
+    std::vector<uint32_t> large;
+    for (uint32_t k = 0; k < 3000; ++k) { // grains, and every 50th particle up to 20px in radius
+        const float32_t x = (k * 7919 % 2560) * 0.1f;
+        const float32_t y = (k * 104729 % 2560) * 0.1f;
+        const float32_t r = k % 50 == 0 ? 4 + (k / 50 % 5) * 4 : 1.5f;
+        col.add(particle<float32_t>(x, y, x, y, r));
+        if (r > 4) large.push_back(k);
+    }
+
+    hierarchical_grid<float32_t> h(WW, WH, grid_levels::fit(16, 20));
+    assert(h.layout.count == 3 && h.levels[0].cols == 16 && h.levels[2].cols == 4); // 16, 32 and 64px cells
+    h.populate(col, &large);
+    assert(h.size() == large.size() && h.members[2].size() == large.size() / 4); // radii 20 only on the top level
+    for (uint32_t level = 0; level < h.layout.count; ++level) { // each on the level that fits it
+        for (uint32_t cell_id = 0; cell_id < h.levels[level].cell_count; ++cell_id) {
+            cell<float32_t> c = h.levels[level].get_cell(cell_id);
+            for (uint32_t k = 0; k < c.size; ++k) {
+                assert(h.layout.level_of(c.rs[k]) == level && h.levels[level].get_cell_id(c.xs[k], c.ys[k]) == cell_id);
+            }
+        }
+    }
+
+    // the rows of cells around a large particle hold every particle of the 8px grid within reach
+    grid<float32_t> fine(WW, WH, 32, 32);
+    std::vector<uint32_t> small;
+    for (uint32_t k = 0; k < col.size(); ++k) {
+        if (col.rs[k] <= 4) small.push_back(k);
+    }
+    fine.populate(col, small);
+    assert(fine.ids.size() == small.size());
+    for (uint32_t idx : large) {
+        const float32_t reach = col.rs[idx] + 4;
+        uint32_t seen = 0, near = 0;
+        fine.for_each_cell_row(col.xs[idx], col.ys[idx], reach, [&](uint32_t first, uint32_t last) {
+            for (uint32_t slot = fine.cell_begin(first); slot < fine.cell_begin(last); ++slot) {
+                seen += std::abs(fine.xs[slot] - col.xs[idx]) < reach && std::abs(fine.ys[slot] - col.ys[idx]) < reach;
+            }
+        });
+        for (uint32_t k : small) {
+            near += std::abs(col.xs[k] - col.xs[idx]) < reach && std::abs(col.ys[k] - col.ys[idx]) < reach;
+        }
+        assert(seen == near);
+    }
+
+    std::cout<<"\n4 - ok: "<<large.size()<<" large particles on "<<h.layout.count<<" coarse levels over "<<small.size()<<" grains"<<std::endl;
+}
+
+void fixed_point_grid_test() {
+    static constexpr uint32_t WW = 128;
+    static constexpr uint32_t WH = 128;
+
+    particle_collection<float32_t> col(WW, WH, 0.1);
+    grid<float32_t> fixed(WW, WH, 16, 16), reference(WW, WH, 16, 16);
+    fixed.set_precision(precision::fixed16);
+    for (uint32_t i = 0; i < 16; ++i) {
+        for (uint32_t j = 0; j < 64; ++j) {
+            const float32_t x = i * 8 + 2.3f, y = j * 2 + 1.7f;
+            col.add(particle<float32_t>(x, y, x, y, 1 + (i + j) % 3));
+        }
+    }
+    assert(col.radii.size() == 3 && col.radii_indexed());
+    assert(fixed.scale() == 512 && fixed.slot_bytes() == 5 && fixed.range() == 64); // 8px cells at 1/512px
+
+    // same layout, 16-bit positions wrapping around every 128px and radius indices instead
+    // of floats: the offset from the cell's corner is exact either way
+    auto check = [&]() {
+        assert(fixed.xs.empty() && fixed.qs.size() == col.size());
+        for (uint32_t cell_id = 0; cell_id < fixed.cell_count; ++cell_id) {
+            assert(fixed.cell_size(cell_id) == reference.cell_size(cell_id));
+            for (uint32_t slot = fixed.cell_begin(cell_id); slot < fixed.cell_begin(cell_id + 1); ++slot) {
+                const uint32_t idx = fixed.ids[slot];
+                assert(idx == reference.ids[slot]);
+                const float32_t x0 = fixed.cell_x(cell_id), y0 = fixed.cell_y(cell_id);
+                assert(std::fabs(fixed.offset(fixed.qx(fixed.qs[slot]), fixed.quantize(x0)) * fixed.inv_scale() - (col.xs[idx] - x0)) <= 0.5f * fixed.inv_scale());
+                assert(std::fabs(fixed.offset(fixed.qy(fixed.qs[slot]), fixed.quantize(y0)) * fixed.inv_scale() - (col.ys[idx] - y0)) <= 0.5f * fixed.inv_scale());
+                assert(col.radii[fixed.rids[slot]] == col.rs[idx]);
+            }
+        }
+    };
+    fixed.populate(col);
+    reference.populate(col);
+    check();
+
+    for (uint32_t idx = 0; idx < col.xs.size(); ++idx) { // the incremental merge keeps the format
+        col.ys[idx] += 0.5f;
+        if (idx % 16 == 0 && col.xs[idx] < WW - 8) col.xs[idx] += 8;
+    }
+    fixed.update(col);
+    reference.populate(col);
+    assert(fixed.migrations() > 0);
+    check();
+
+    // untouched slots leave the collection bit-exact, moved ones carry the quantized change
+    const std::vector<float32_t> xs(col.xs.begin(), col.xs.end()), ys(col.ys.begin(), col.ys.end());
+    fixed.qs[0] = fixed.pack(fixed.qx(fixed.qs[0]) + 3, fixed.qy(fixed.qs[0]));
+    fixed.store_to_collection(col, 0, fixed.ids.size());
+    for (uint32_t idx = 0; idx < col.xs.size(); ++idx) {
+        const float32_t moved = idx == fixed.ids[0] ? 3 * fixed.inv_scale() : 0;
+        assert(col.xs[idx] == xs[idx] + moved && col.ys[idx] == ys[idx]);
+    }
+
+    std::cout<<"\n5 - ok: fixed point grid ("<<fixed.slot_bytes()<<" bytes per slot, 1/"<<fixed.scale()<<"px)"<<std::endl;
+}
+
+void grid_3d_test() {
+    static constexpr uint32_t WW = 64;
+    static constexpr uint32_t WH = 32;
+    static constexpr uint32_t WD = 16;
+
+    particle_collection<float32_t, 3> col(WW, WH, WD, 0.1);
+    grid<float32_t, binning::shift, 3> g(WW, WH, WD, 4, 8, 2);
+    grid<float32_t, binning::reciprocal, 3> r(WW, WH, WD, 4, 8, 2);
+    for (uint32_t i = 0; i < 8; ++i) { // one particle per cell, two in the last one
+        for (uint32_t j = 0; j < 4; ++j) {
+            for (uint32_t k = 0; k < 2; ++k) {
+                col.add(particle<float32_t, 3>(i * 8 + 3, j * 8 + 5, k * 8 + 1, i * 8 + 3, j * 8 + 5, k * 8 + 1, 2));
+            }
+        }
+    }
+    col.add(particle<float32_t, 3>(WW + 10, WH + 10, WD + 10, 0, 0, 0, 2)); // outside, binned to the last cell
+    g.populate(col);
+    r.populate(col);
+
+    assert(g.stride == 10 && g.plane == 60 && g.cell_count == 240);
+    assert(g.get_cell_id(19, 9, 9) == 2 * g.plane + 2 * g.stride + 3); // layer from z, row from y, column from x
+    const uint32_t last = g.get_cell_id(WW - 1, WH - 1, WD - 1);
+    uint32_t total = 0;
+    for (uint32_t cell_id = 0; cell_id < g.cell_count; ++cell_id) {
+        const uint32_t col_idx = cell_id % g.stride, row = cell_id % g.plane / g.stride, layer = cell_id / g.plane;
+        const bool border = col_idx == 0 || col_idx == 9 || row == 0 || row == 5 || layer == 0 || layer == 3;
+        assert(g.cell_size(cell_id) == (border ? 0 : cell_id == last ? 2 : 1));
+        assert(g.cell_size(cell_id) == r.cell_size(cell_id) && g.cell_begin(cell_id) == r.cell_begin(cell_id));
+        for (uint32_t slot = g.cell_begin(cell_id); slot < g.cell_begin(cell_id + 1); ++slot) {
+            assert(g.get_cell_id(col.xs[g.ids[slot]], col.ys[g.ids[slot]], col.zs[g.ids[slot]]) == cell_id);
+            assert(g.zs[slot] == col.zs[g.ids[slot]] && g.ids[slot] == r.ids[slot]);
+        }
+        total += g.cell_size(cell_id);
+    }
+    assert(total == col.size());
+
+    g.zs[0] += 1; // store writes back every axis
+    g.store_to_collection(col, 0, g.ids.size());
+    assert(col.zs[g.ids[0]] == g.zs[0]);
+
+    std::cout<<"\n6 - ok: 3D grid"<<std::endl;
+}
+
+} // namespace collision_engine::simd
+
+int main() {
+    std::cout<<"==================================================================="<<std::endl;
+    std::cout<<"Running simd_grid_test.cpp..."<<std::endl;
+    std::cout<<"==================================================================="<<std::endl;
+
+    collision_engine::simd::populate_simd_grid_test();
+    collision_engine::simd::update_simd_grid_test();
+    collision_engine::simd::reciprocal_binning_test();
+    collision_engine::simd::hierarchical_grid_test();
+    collision_engine::simd::fixed_point_grid_test();
+    collision_engine::simd::grid_3d_test();
+
+    std::cout<<"==================================================================="<<std::endl;
+    std::cout<<"simd_grid_test - ok."<<std::endl;
+
+    return 0;
+}
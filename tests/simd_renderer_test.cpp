@@ -1,6 +1,12 @@
+#include "common/constants.hpp"
 #include "physics/simd_solver.hpp"
+#include "physics/recorder.hpp"
+#include "physics/runner.hpp"
+#include "physics/snapshot.hpp"
 #include "renderer/simd_renderer.hpp"
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 
 namespace collision_engine::simd {
 
@@ -9,7 +15,7 @@ void allocate_particle_before_simulation() {
     constexpr uint32_t n_particles  = 15000;
     const float dt = 1.f / static_cast<float32_t>(fps_cap);
     
-    f32_solver solver(dt); 
+    f32_solver solver(dt, WINDOW_WIDTH, WINDOW_HEIGHT); // the world fills the window
     renderer r(solver);
     r.set_frame_limit(fps_cap);
 
@@ -18,27 +24,64 @@ void allocate_particle_before_simulation() {
     float32_t start_i   = 10;
     float32_t prev_i    = 9.5;
     float32_t fps       = 0;
-    int count           = 0;
+    uint32_t count      = 0;    // touched by the physics thread only once the runner starts
+
+    // start from (and save back to) a settled scene instead of emitting it particle by particle
+    const char* snapshot_path = std::getenv("COLLISION_ENGINE_SNAPSHOT");
+    if (snapshot_path && load_snapshot(snapshot_path, solver)) {
+        count = solver.pc().size();
+    }
     r.init_frame();
-    while(r.run()) {
+
+    // positions are streamed to disk by the recorder's own thread
+    const char* record_path = std::getenv("COLLISION_ENGINE_RECORD");
+    std::unique_ptr<trajectory_recorder> recorder;
+    if (record_path) {
+        recorder = std::make_unique<trajectory_recorder>(record_path, solver.world_width(), solver.world_height(), n_particles);
+    }
+#if defined(CE_PROFILE)
+    const char* trace_path = std::getenv("COLLISION_ENGINE_TRACE"); // Chrome trace written on exit
+    profiler::instance().set_tracing(trace_path != nullptr);
+#endif
+
+    // physics runs on its own thread at dt; the window draws whatever state is latest
+    simulation_runner<f32_solver> runner(solver, dt);
+    runner.on_step([&](f32_solver& s) {
         if (count < n_particles) {
             for (int i{4};i--;) {
                 particle<float32_t> p(start_i, 50 - 5 * i, prev_i, 50 - 5 * i, radius);
-                solver.add_particle(p);
-                r.add_object_to_frame(p); 
+                s.add_particle(p);
             }
             count += 4;
         }
-        solver.step();
-        r.update_frame();
+        if (recorder) {
+            recorder->record(s);
+        }
+    });
+    runner.start();
+    while(r.run()) {
+        const state_frame* frame = runner.latest();
+        if (frame) {
+            r.update_frame(*frame, frame->alpha(state_frame::clock::now()));
+        }
 
         // calculate fps
         float32_t c_time = clock.restart().asSeconds();
         fps = 1.f / c_time;
  
-        r.update_metadata(fps, c_time, count); 
+        r.update_metadata(fps, c_time, frame ? frame->count : 0); 
         r.render_with_metadata();
+        CE_PROFILE_FRAME();
     }  
+    runner.stop();
+#if defined(CE_PROFILE)
+    if (trace_path) {
+        profiler::instance().write_chrome_trace(trace_path);
+    }
+#endif
+    if (snapshot_path) {
+        save_snapshot(snapshot_path, solver);
+    }
 }
 
 } // namespace collision engine simd
@@ -0,0 +1,151 @@
+#include "../src/physics/simd_solver3d.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+
+namespace collision_engine::simd {
+
+void half_stencil_3d_test() {
+    constexpr float32_t dt = 0.01f;
+
+    // two overlapping particles across every face, edge and corner of a cell: each pair is
+    // resolved once, equal and opposite
+    uint32_t pairs = 0;
+    for (int di = -1; di <= 1; di++) {
+        for (int dj = -1; dj <= 1; dj++) {
+            for (int dk = -1; dk <= 1; dk++) {
+                if (!di && !dj && !dk) continue;
+                f32_solver3d solver(dt, 64, 64, 64, isa::active(), 1);
+                // straddling the cell boundaries at 32 along the axes they differ on
+                const float32_t h = 1.2f / std::sqrt(float32_t(di * di + dj * dj + dk * dk));
+                auto at = [h](int d) { return d ? 32 - h * d : 28.f; };
+                const float32_t a[3] = {at(di), at(dj), at(dk)};
+                const float32_t b[3] = {a[0] + 2 * h * di, a[1] + 2 * h * dj, a[2] + 2 * h * dk};
+                solver.add_particle(particle<float32_t, 3>(a[0], a[1], a[2], a[0], a[1], a[2], 2));
+                solver.add_particle(particle<float32_t, 3>(b[0], b[1], b[2], b[0], b[1], b[2], 2));
+                assert(solver.grid().cols == 8);
+                solver.grid().populate(solver.pc());
+                assert(solver.grid().get_cell_id(a[0], a[1], a[2]) != solver.grid().get_cell_id(b[0], b[1], b[2]));
+                solver.resolve_collision();
+
+                const auto& pc = solver.pc();
+                const float32_t mx = pc.xs[0] - a[0], my = pc.ys[0] - a[1], mz = pc.zs[0] - a[2];
+                assert(std::fabs(pc.xs[1] - b[0] + mx) < 1e-4f);
+                assert(std::fabs(pc.ys[1] - b[1] + my) < 1e-4f);
+                assert(std::fabs(pc.zs[1] - b[2] + mz) < 1e-4f);
+                assert(mx * di + my * dj + mz * dk < -0.1f); // pushed apart along the offset
+                assert(std::fabs(std::sqrt(mx * mx + my * my + mz * mz) - 0.7f) < 0.01f); // half of 3.5 * 1.6 / 4, once
+                pairs++;
+            }
+        }
+    }
+    assert(pairs == 26);
+
+    std::cout<<"\n1 - ok: 3D half stencil resolves all "<<pairs<<" neighbour directions once"<<std::endl;
+}
+
+void pile_3d_test() {
+    constexpr float32_t dt = 0.01f;
+    constexpr uint32_t n = 1500;
+
+    for (isa::level level : {isa::level::scalar, isa::level::neon, isa::level::sse4, isa::level::avx2, isa::level::avx512}) {
+        if (!isa::supported(level)) continue;
+        f32_solver3d solver(dt, 96, 96, 96, level, 2);
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float32_t> pos(8, 88), rad(1.5f, 3.f);
+        for (uint32_t i = 0; i < n; i++) {
+            const float32_t x = pos(rng), y = pos(rng), z = pos(rng);
+            solver.add_particle(particle<float32_t, 3>(x, y, z, x, y, z, rad(rng)));
+        }
+        for (int i = 0; i < 300; i++) {
+            solver.step();
+        }
+
+        // settled on the floor, inside the box and barely overlapping
+        const auto& pc = solver.pc();
+        float32_t worst = 1, mean_y = 0;
+        for (uint32_t a = 0; a < n; a++) {
+            assert(pc.xs[a] >= 4 && pc.xs[a] <= 92 && pc.ys[a] >= 4 && pc.ys[a] <= 92 && pc.zs[a] >= 4 && pc.zs[a] <= 92);
+            mean_y += pc.ys[a] / n;
+            for (uint32_t b = a + 1; b < n; b++) {
+                const float32_t dx = pc.xs[a] - pc.xs[b], dy = pc.ys[a] - pc.ys[b], dz = pc.zs[a] - pc.zs[b];
+                worst = std::min(worst, std::sqrt(dx * dx + dy * dy + dz * dz) / (pc.rs[a] + pc.rs[b]));
+            }
+        }
+        assert(mean_y > 70);
+        assert(worst > 0.7f);
+        std::cout<<"   "<<isa::name(level)<<": closest pair at "<<worst<<" of contact, mean height "<<mean_y<<std::endl;
+    }
+
+    std::cout<<"\n2 - ok: 3D pile settles without overlap"<<std::endl;
+}
+
+void flat_scene_matches_2d_test() {
+    constexpr float32_t dt = 0.01f;
+
+    // a lattice in one z plane visits the 2D half stencil in the same order and goes through
+    // the same narrow phase, so both solvers correct it identically
+    for (isa::level level : {isa::level::scalar, isa::level::neon, isa::level::sse4, isa::level::avx2, isa::level::avx512}) {
+        if (!isa::supported(level)) continue;
+        f32_solver3d solver(dt, 64, 64, 64, level, 1);
+        f32_solver flat(dt, 64, 64, level, 1);
+        for (uint32_t i = 0; i < 40; i++) {
+            const float32_t x = 12 + 3.6f * (i % 8), y = 12 + 3.4f * (i / 8);
+            solver.add_particle(particle<float32_t, 3>(x, y, 32, x, y, 32, 2));
+            flat.add_particle(particle<float32_t>(x, y, x, y, 2));
+        }
+        solver.grid().populate(solver.pc());
+        solver.resolve_collision();
+        flat.grid().populate(flat.pc());
+        flat.resolve_collision();
+
+        for (uint32_t i = 0; i < 40; i++) {
+            assert(std::fabs(solver.pc().xs[i] - flat.pc().xs[i]) < 1e-5f);
+            assert(std::fabs(solver.pc().ys[i] - flat.pc().ys[i]) < 1e-5f);
+            assert(solver.pc().zs[i] == 32);
+        }
+        assert(solver.pc().xs[0] != 12); // the lattice overlaps
+    }
+
+    std::cout<<"\n3 - ok: a flat 3D scene resolves like the 2D one"<<std::endl;
+}
+
+void remove_largest_test() {
+    constexpr float32_t dt = 0.01f;
+
+    // the cells follow the largest radius down again once its particle is gone
+    f32_solver3d solver(dt, 256, 256, 256, isa::active(), 1);
+    std::vector<uint32_t> handles;
+    for (uint32_t i = 0; i < 8; i++) {
+        handles.push_back(solver.add_particle(particle<float32_t, 3>(20 + 10 * i, 40, 40, 20 + 10 * i, 40, 40, 2)));
+    }
+    const uint32_t boulder = solver.add_particle(particle<float32_t, 3>(128, 128, 128, 128, 128, 128, 32));
+    assert(solver.grid().cols == 4);
+    assert(solver.remove_particles({handles[0]}) == 1 && solver.grid().cols == 4);
+    assert(solver.remove_particles({boulder}) == 1 && solver.grid().cols == 32);
+    solver.step();
+    assert(solver.pc().size() == 7);
+    solver.stop();
+
+    std::cout<<"\n4 - ok: removing the largest particle shrinks the cells"<<std::endl;
+}
+
+} // namespace collision_engine::simd
+
+int main() {
+    std::cout<<"==================================================================="<<std::endl;
+    std::cout<<"Running simd_solver3d_test.cpp..."<<std::endl;
+    std::cout<<"==================================================================="<<std::endl;
+
+    collision_engine::simd::half_stencil_3d_test();
+    collision_engine::simd::pile_3d_test();
+    collision_engine::simd::flat_scene_matches_2d_test();
+    collision_engine::simd::remove_largest_test();
+
+    std::cout<<"==================================================================="<<std::endl;
+    std::cout<<"simd_solver3d_test - ok."<<std::endl;
+
+    return 0;
+}
@@ -1,6 +1,8 @@
 #include "../src/physics/simd_solver.hpp"
-#include <arm_neon.h>
+#include <cassert>
+#include <cmath>
 #include <iostream>
+#include <stdexcept>
 
 namespace collision_engine::simd {
 
@@ -58,6 +60,521 @@ void step_test() {
     std::cout<<"\n3 - ok: solver step test"<<std::endl; 
 }
 
+void isa_dispatch_test() {
+    constexpr float32_t dt  = 0.01f;
+    
+    // lightly overlapping lattice, so approximate rsqrt/recip only cause small deviations
+    f32_solver reference(dt, isa::level::scalar); 
+    for (int i = 0; i < 120; i++) {
+        particle<float32_t> p(3.8 * (i % 20) + 30, 3.8 * (i / 20) + 30, 3.8 * (i % 20) + 30, 3.8 * (i / 20) + 30, 2);
+        reference.add_particle(p);
+    }
+    reference.grid().populate(reference.pc());
+    reference.resolve_collision();
+
+    for (isa::level l : {isa::level::neon, isa::level::sse4, isa::level::avx2, isa::level::avx512}) {
+        if (!isa::supported(l)) continue;
+
+        f32_solver solver(dt, l); 
+        for (int i = 0; i < 120; i++) {
+            particle<float32_t> p(3.8 * (i % 20) + 30, 3.8 * (i / 20) + 30, 3.8 * (i % 20) + 30, 3.8 * (i / 20) + 30, 2);
+            solver.add_particle(p);
+        }
+        solver.grid().populate(solver.pc());
+        solver.resolve_collision();
+
+        for (int i = 0; i < 120; i++) {
+            assert(std::abs(solver.pc().xs[i] - reference.pc().xs[i]) < 1e-3);
+            assert(std::abs(solver.pc().ys[i] - reference.pc().ys[i]) < 1e-3);
+        }
+        std::cout<<"   matched scalar kernel: "<<isa::name(l)<<std::endl;
+    }
+
+    std::cout<<"\n4 - ok: isa dispatch test (active: "<<isa::name(isa::active())<<")"<<std::endl; 
+}
+
+void reorder_test() {
+    constexpr float32_t dt  = 0.01f;
+    constexpr uint32_t  n   = 600;
+
+    // lattice spawned in a scrambled order, so spatial neighbours are far apart in memory
+    auto spawn = [](f32_solver& solver) {
+        for (uint32_t k = 0; k < n; k++) {
+            const uint32_t i = (k * 7919) % n;
+            particle<float32_t> p(3.8 * (i % 40) + 30, 3.8 * (i / 40) + 30, 3.8 * (i % 40) + 30, 3.8 * (i / 40) + 30, 2);
+            solver.add_particle(p);
+        }
+    };
+    for (ordering order : {ordering::cell, ordering::morton}) {
+        f32_solver reference(dt);
+        f32_solver solver(dt);
+        spawn(reference);
+        spawn(solver);
+        solver.set_reordering(order, 1);
+
+        // one substep: the reorder keeps the in-cell order, so the result is unchanged
+        reference.grid().populate(reference.pc());
+        reference.resolve_collision();
+        reference.update_particles();
+        solver.grid().populate(solver.pc());
+        solver.reorder_particles();
+        solver.resolve_collision();
+        solver.update_particles();
+        for (uint32_t h = 0; h < n; h++) {
+            const uint32_t i = solver.pc().index_of(h);
+            assert(solver.pc().handle_of(i) == h);
+            assert(std::abs(solver.pc().xs[i] - reference.pc().xs[h]) < 1e-4);
+            assert(std::abs(solver.pc().ys[i] - reference.pc().ys[h]) < 1e-4);
+        }
+
+        // handles stay consistent over many reorders, and right after one every cell is
+        // a contiguous index range
+        for (int s = 0; s < 10; s++) {
+            solver.step();
+        }
+        solver.grid().populate(solver.pc());
+        solver.reorder_particles();
+        for (uint32_t h = 0; h < n; h++) {
+            assert(solver.pc().handle_of(solver.pc().index_of(h)) == h);
+        }
+        for (uint32_t cell_id = 0; cell_id < solver.grid().cell_count; cell_id++) {
+            const cell<float32_t> c = solver.grid().get_cell(cell_id);
+            for (uint32_t slot = 0; slot < c.size; slot++) {
+                assert(c.ids[slot] == c.ids[0] + slot);
+                assert(solver.pc().xs[c.ids[slot]] == c.xs[slot]);
+            }
+        }
+    }
+
+    // without an ordering, reordering leaves the particles where they are
+    f32_solver unordered(dt);
+    spawn(unordered);
+    unordered.grid().populate(unordered.pc());
+    unordered.reorder_particles();
+    for (uint32_t h = 0; h < n; h++) {
+        assert(unordered.pc().index_of(h) == h);
+    }
+
+    std::cout<<"\n5 - ok: reorder test"<<std::endl; 
+}
+
+void incremental_grid_test() {
+    constexpr float32_t dt  = 0.01f;
+
+    f32_solver reference(dt);
+    f32_solver solver(dt);
+    solver.set_incremental_grid(true);
+    for (int i = 0; i < 600; i++) {
+        particle<float32_t> p(3.8 * (i % 40) + 30, 3.8 * (i / 40) + 30, 3.8 * (i % 40) + 30, 3.8 * (i / 40) + 30, 2);
+        reference.add_particle(p);
+        solver.add_particle(p);
+    }
+
+    uint32_t migrations = 0;
+    for (int s = 0; s < 20; s++) {
+        reference.step();
+        solver.step();
+        for (uint32_t m : solver.migrations()) { migrations += m; }
+    }
+
+    // the incremental grid reproduces populate()'s layout, so the simulation is identical
+    for (int i = 0; i < 600; i++) {
+        assert(solver.pc().xs[i] == reference.pc().xs[i]);
+        assert(solver.pc().ys[i] == reference.pc().ys[i]);
+    }
+    assert(reference.migrations()[0] == 600);
+    assert(migrations < 600 * 4 * 20);
+
+    std::cout<<"\n6 - ok: incremental grid test ("<<migrations<<" migrations)"<<std::endl; 
+}
+
+void sleeping_test() {
+    constexpr float32_t dt  = 0.01f;
+
+    f32_solver solver(dt);
+    solver.set_sleeping(true, 0.01f, 20);
+    for (int i = 0; i < 80; i++) { // a floor row of particles that do not touch
+        particle<float32_t> p(6.f * i + 20, 508, 6.f * i + 20, 508, 2);
+        solver.add_particle(p);
+    }
+    for (int s = 0; s < 10; s++) {
+        solver.step();
+    }
+    particle_collection<float32_t>& pc = solver.pc();
+    for (uint32_t i = 0; i < 80; i++) {
+        assert(pc.asleep(i));
+    }
+
+    // a particle dropped on the left end wakes its neighbourhood only
+    std::vector<float32_t> xs(pc.xs.begin(), pc.xs.end());
+    std::vector<float32_t> ys(pc.ys.begin(), pc.ys.end());
+    particle<float32_t> p(35, 500, 35, 500, 2);
+    solver.add_particle(p);
+    for (int s = 0; s < 40; s++) {
+        solver.step();
+    }
+    uint32_t awake = 0;
+    for (uint32_t i = 0; i < 80; i++) {
+        awake += !pc.asleep(i);
+        if (pc.xs[i] > 100) { // far from the impact: untouched
+            assert(pc.asleep(i));
+            assert(pc.xs[i] == xs[i] && pc.ys[i] == ys[i]);
+        }
+    }
+    assert(awake > 0 && awake < 20);
+    assert(!pc.asleep(80));
+
+    std::cout<<"\n7 - ok: sleeping particles ("<<awake<<" woken)"<<std::endl; 
+}
+
+void world_size_test() {
+    constexpr float32_t dt  = 0.01f;
+
+    f32_solver solver(dt, 300, 200);
+    assert(solver.world_width() == 300 && solver.world_height() == 200);
+    assert(solver.grid_cols() == 37 && solver.grid_rows() == 25); // 8px cells until particles need larger
+    solver.add_particle(particle<float32_t>(150, 100, 150, 100, 3));
+    assert(solver.grid_cols() == 37);
+
+    // particles wider than the cells grow them to their diameter (radii within a factor of 2 share one level)
+    for (int i = 0; i < 150; i++) {
+        particle<float32_t> p(9.5 * (i % 25) + 20, 9.5 * (i / 25) + 60, 9.5 * (i % 25) + 20, 9.5 * (i / 25) + 60, 5);
+        solver.add_particle(p);
+    }
+    assert(solver.grid_cols() == 30 && solver.grid_rows() == 20);
+    solver.set_grid(4, 6);
+    assert(solver.grid_rows() == 4 && solver.grid_cols() == 6);
+    solver.set_grid(0, 0);
+    assert(solver.grid_cols() == 30 && solver.grid_rows() == 20);
+
+    // the pile settles on the floor of the non power of 2 world without interpenetrating
+    for (int s = 0; s < 200; s++) {
+        solver.step();
+    }
+    const particle_collection<float32_t>& pc = solver.pc();
+    float32_t worst = 1;
+    for (uint32_t i = 0; i < pc.size(); i++) {
+        assert(pc.xs[i] >= 0 && pc.xs[i] <= 300 && pc.ys[i] >= 0 && pc.ys[i] <= 200);
+        for (uint32_t j = i + 1; j < pc.size(); j++) {
+            const float32_t d = std::hypot(pc.xs[i] - pc.xs[j], pc.ys[i] - pc.ys[j]);
+            worst = std::min(worst, d / (pc.rs[i] + pc.rs[j]));
+        }
+    }
+    assert(worst > 0.8f);
+    solver.stop();
+
+    std::cout<<"\n8 - ok: 300x200 world, "<<solver.grid_rows()<<"x"<<solver.grid_cols()<<" cells (closest pair at "<<worst<<" of contact)"<<std::endl; 
+}
+
+void mixed_radii_test() {
+    constexpr float32_t dt  = 0.01f;
+
+    f32_solver solver(dt, 400, 400);
+    solver.set_reordering(ordering::morton, 8);
+    for (int i = 0; i < 1200; i++) { // a bed of grains
+        particle<float32_t> p(3.2 * (i % 100) + 40, 3.2 * (i / 100) + 340, 3.2 * (i % 100) + 40, 3.2 * (i / 100) + 340, 1.5);
+        solver.add_particle(p);
+    }
+    assert(!solver.hierarchical() && solver.grid_cols() == 50);
+    for (float32_t x : {100.f, 200.f}) { // boulders dropped on it
+        solver.add_particle(particle<float32_t>(x, 250, x, 250, 12));
+    }
+    solver.add_particle(particle<float32_t>(300, 250, 300, 250, 30));
+
+    // the grains keep their 8px cells; the boulders go to levels of 16, 32 and 64px cells
+    assert(solver.hierarchical() && solver.level_count() == 4 && solver.grid_cols() == 50);
+    const grid_levels& layout = solver.coarse_grid().layout;
+    assert(layout.base == 16 && layout.level_of(12) == 1 && layout.level_of(30) == 2);
+
+    for (int s = 0; s < 200; s++) { // until the boulders land
+        solver.step();
+    }
+    const simd::hierarchical_grid<float32_t>& coarse = solver.coarse_grid();
+    assert(coarse.members[1].size() == 2 && coarse.members[2].size() == 1);
+    assert(solver.grid().ids.size() + coarse.size() == solver.pc().size());
+
+    const particle_collection<float32_t>& pc = solver.pc();
+    float32_t worst = 1, boulder_depth = 0;
+    for (uint32_t i = 0; i < pc.size(); i++) {
+        if (pc.rs[i] < 10) continue; // grain pairs go through the single level kernel
+        for (uint32_t j = 0; j < pc.size(); j++) {
+            const float32_t d = std::hypot(pc.xs[i] - pc.xs[j], pc.ys[i] - pc.ys[j]);
+            worst = i == j ? worst : std::min(worst, d / (pc.rs[i] + pc.rs[j]));
+        }
+        boulder_depth = std::max(boulder_depth, pc.ys[i] - 250);
+    }
+    assert(worst > 0.8f);       // grains do not tunnel into the boulders, nor boulders into each other
+    assert(boulder_depth > 50); // the boulders fell and rest on the grains
+    solver.stop();
+
+    std::cout<<"\n9 - ok: mixed radii on "<<solver.level_count()<<" levels (closest pair with a boulder at "<<worst<<" of contact)"<<std::endl;
+}
+
+
+void remove_particles_test() {
+    constexpr float32_t dt  = 0.01f;
+
+    f32_solver reference(dt);
+    f32_solver solver(dt);
+    solver.set_incremental_grid(true);
+    std::vector<uint32_t> handles;
+    for (int i = 0; i < 600; i++) {
+        particle<float32_t> p(3.8 * (i % 40) + 30, 3.8 * (i / 40) + 30, 3.8 * (i % 40) + 30, 3.8 * (i / 40) + 30, 2);
+        reference.add_particle(p);
+        handles.push_back(solver.add_particle(p));
+    }
+    const uint32_t boulder = solver.add_particle(particle<float32_t>(300, 30, 300, 30, 6));
+    reference.add_particle(particle<float32_t>(300, 30, 300, 30, 6));
+    assert(solver.hierarchical());
+
+    // particles removed between steps leave the incremental grid no stale ids
+    for (int s = 0; s < 40; s++) {
+        if (s % 4 == 0) {
+            std::vector<uint32_t> doomed;
+            for (uint32_t i = s / 4; i < handles.size(); i += 25) doomed.push_back(handles[i]);
+            assert(solver.remove_particles(doomed) == doomed.size());
+            assert(reference.remove_particles(doomed) == doomed.size()); // same handles in both
+        }
+        if (s == 20) { // the only large one gone, one level fits the rest again
+            assert(solver.remove_particle(boulder) && reference.remove_particle(boulder));
+            assert(!solver.remove_particle(boulder) && !solver.hierarchical());
+        }
+        reference.step();
+        solver.step();
+        assert(solver.grid().ids.size() + solver.coarse_grid().size() == solver.pc().size());
+    }
+    assert(solver.pc().size() == 600 - 10 * 24);
+    for (uint32_t i = 0; i < solver.pc().size(); i++) {
+        assert(solver.pc().xs[i] == reference.pc().xs[i] && solver.pc().ys[i] == reference.pc().ys[i]);
+    }
+    solver.stop();
+    reference.stop();
+
+    std::cout<<"\n10 - ok: remove particles while stepping ("<<solver.pc().size()<<" left)"<<std::endl;
+}
+
+void fixed_point_precision_test() {
+    constexpr float32_t dt  = 0.01f;
+
+    // one collision pass over the same jittered lattice, positions exact in both formats,
+    // with a boulder scanning the fine grid from a coarse level
+    auto resolve_once = [](isa::level level, precision p) {
+        f32_solver solver(dt, 512, 512, level, 1);
+        solver.set_precision(p);
+        uint32_t seed = 7;
+        auto jitter = [&seed]() { seed = seed * 1664525 + 1013904223; return static_cast<float32_t>(seed >> 26) / 32; };
+        for (int i = 0; i < 6400; i++) {
+            const float32_t x = 5.5f * (i % 80) + 20 + jitter(), y = 5.5f * (i / 80) + 20 + jitter();
+            solver.add_particle(particle<float32_t>(x, y, x, y, 2 + i % 2));
+        }
+        solver.add_particle(particle<float32_t>(200, 200, 200, 200, 20));
+        assert(solver.precision() == p && solver.hierarchical());
+        solver.step();
+        return std::pair(std::vector<float32_t>(solver.pc().xs.begin(), solver.pc().xs.end()),
+                         std::vector<float32_t>(solver.pc().ys.begin(), solver.pc().ys.end()));
+    };
+    float32_t worst = 0;
+    for (isa::level level : {isa::level::scalar, isa::level::neon, isa::level::sse4, isa::level::avx2, isa::level::avx512}) {
+        if (!isa::supported(level)) continue;
+        const auto reference = resolve_once(level, precision::f32);
+        const auto fixed = resolve_once(level, precision::fixed16);
+        for (uint32_t i = 0; i < reference.first.size(); i++) {
+            worst = std::max({worst, std::fabs(reference.first[i] - fixed.first[i]), std::fabs(reference.second[i] - fixed.second[i])});
+        }
+    }
+    assert(worst < 0.1f); // a few 1/512px steps per contact, compounded over the substeps
+
+    // a pile settles just as well on 16-bit positions
+    f32_solver solver(dt);
+    solver.set_precision(precision::fixed16);
+    solver.set_incremental_grid(true);
+    for (int i = 0; i < 1500; i++) {
+        particle<float32_t> p(3.9 * (i % 100) + 40, 3.9 * (i / 100) + 200, 3.9 * (i % 100) + 40, 3.9 * (i / 100) + 200, 2);
+        solver.add_particle(p);
+    }
+    for (int s = 0; s < 200; s++) {
+        solver.step();
+    }
+    assert(solver.grid().precision() == precision::fixed16 && solver.grid().xs.empty());
+    const particle_collection<float32_t>& pc = solver.pc();
+    float32_t closest = 1;
+    for (uint32_t i = 0; i < pc.size(); i++) {
+        for (uint32_t j = i + 1; j < pc.size(); j++) {
+            closest = std::min(closest, std::hypot(pc.xs[i] - pc.xs[j], pc.ys[i] - pc.ys[j]) / (pc.rs[i] + pc.rs[j]));
+        }
+    }
+    assert(closest > 0.8f);
+
+    // the single-cell kernel needs f32 positions in the grid and leaves fixed16 scenes alone
+    const std::vector<float32_t> settled(pc.xs.begin(), pc.xs.end());
+    solver.resolve_particle_collision_simd(0, solver.grid().get_cell_id(pc.xs[0], pc.ys[0]));
+    assert(std::equal(settled.begin(), settled.end(), pc.xs.begin()));
+
+    // more distinct radii than the table holds fall back to f32
+    for (int i = 0; i < 300; i++) {
+        solver.add_particle(particle<float32_t>(20 + i, 20, 20 + i, 20, 1 + i / 300.f));
+    }
+    assert(!pc.radii_indexed() && solver.precision() == precision::f32);
+    solver.step();
+    assert(solver.grid().precision() == precision::f32);
+    solver.stop();
+
+    std::cout<<"\n11 - ok: fixed point grid within "<<worst<<"px of f32 (closest pair at "<<closest<<" of contact)"<<std::endl;
+}
+
+
+void spatial_hash_test() {
+    constexpr float32_t dt  = 0.01f;
+
+    // the same pile on both broadphases
+    auto pile = [](f32_solver& solver, float32_t x0, float32_t y0) {
+        for (int i = 0; i < 1500; i++) {
+            const float32_t x = 3.9f * (i % 60) + x0, y = 3.9f * (i / 60) + y0;
+            solver.add_particle(particle<float32_t>(x, y, x, y, 1.5f + i % 3 * 0.2f));
+        }
+    };
+    auto closest = [](const particle_collection<float32_t>& pc) {
+        float32_t worst = 1;
+        for (uint32_t i = 0; i < pc.size(); i++) {
+            for (uint32_t j = i + 1; j < pc.size(); j++) {
+                if (std::fabs(pc.xs[i] - pc.xs[j]) > 10 || std::fabs(pc.ys[i] - pc.ys[j]) > 10) continue;
+                worst = std::min(worst, std::hypot(pc.xs[i] - pc.xs[j], pc.ys[i] - pc.ys[j]) / (pc.rs[i] + pc.rs[j]));
+            }
+        }
+        return worst;
+    };
+    f32_solver grid(dt, 512, 512, isa::active(), 2);
+    f32_solver hashed(dt, 512, 512, isa::active(), 2, broadphase::spatial_hash);
+    pile(grid, 100, 300);
+    pile(hashed, 100, 300);
+    assert(hashed.active_broadphase() == broadphase::spatial_hash && hashed.hash_grid().layout.cell_size() == 8);
+    for (int s = 0; s < 200; s++) {
+        grid.step();
+        hashed.step();
+    }
+    float32_t grid_y = 0, hashed_y = 0;
+    for (uint32_t i = 0; i < grid.pc().size(); i++) {
+        grid_y += grid.pc().ys[i] / grid.pc().size();
+        hashed_y += hashed.pc().ys[i] / hashed.pc().size();
+    }
+    assert(std::fabs(grid_y - hashed_y) < 1 && closest(hashed.pc()) > 0.8f);
+    grid.stop();
+
+    // three piles far apart in a 100k px wide world: memory follows them, not the world
+    f32_solver sparse(dt, 100000, 4096, isa::active(), 2, broadphase::spatial_hash);
+    for (float32_t x : {100.f, 50000.f, 90000.f}) {
+        pile(sparse, x, 3900);
+    }
+    for (int s = 0; s < 200; s++) {
+        sparse.step();
+    }
+    const particle_collection<float32_t>& pc = sparse.pc();
+    float32_t lowest = 0;
+    for (uint32_t i = 0; i < pc.size(); i++) {
+        assert(pc.ys[i] > 3900 && pc.ys[i] < 4096);
+        lowest = std::max(lowest, pc.ys[i]);
+    }
+    assert(lowest > 4085); // landed
+    const spatial_hash& cells = sparse.hash_grid().layout;
+    assert(cells.cell_count() < pc.size() && cells.memory_bytes() < 1 << 20);
+    const float32_t worst = closest(pc);
+    assert(worst > 0.8f);
+    sparse.stop();
+    hashed.stop();
+
+    std::cout<<"\n12 - ok: spatial hash, "<<cells.cell_count()<<" cells of a 100k world in "<<cells.memory_bytes() / 1024
+             <<" KiB (closest pair at "<<worst<<" of contact)"<<std::endl;
+}
+
+
+void sweep_and_prune_test() {
+    constexpr float32_t dt  = 0.01f;
+
+    // grains and boulders on one layout, without a hierarchy of cells
+    auto scene = [](f32_solver& solver) {
+        for (int i = 0; i < 1200; i++) {
+            const float32_t x = 3.2f * (i % 100) + 40, y = 3.2f * (i / 100) + 340;
+            solver.add_particle(particle<float32_t>(x, y, x, y, 1.5f));
+        }
+        for (float32_t x : {100.f, 200.f, 300.f}) {
+            solver.add_particle(particle<float32_t>(x, 250, x, 250, x == 300 ? 30 : 12));
+        }
+    };
+    for (isa::level level : {isa::level::scalar, isa::level::neon, isa::level::sse4, isa::level::avx2, isa::level::avx512}) {
+        if (!isa::supported(level)) continue;
+        f32_solver grid(dt, 400, 400, level, 2);
+        f32_solver sap(dt, 400, 400, level, 2, broadphase::sweep_and_prune);
+        scene(grid);
+        scene(sap);
+        assert(sap.active_broadphase() == broadphase::sweep_and_prune && !sap.hierarchical());
+        uint32_t radix_sorts = 0;
+        for (int s = 0; s < 200; s++) {
+            grid.step();
+            sap.step();
+            radix_sorts += sap.sap_grid().layout.radix_sorted();
+        }
+        assert(radix_sorts <= 1); // only the first populate, then insertion sorts
+
+        const particle_collection<float32_t>& pc = sap.pc();
+        float32_t worst = 1, boulder_depth = 0, grid_depth = 0;
+        for (uint32_t i = 1200; i < pc.size(); i++) {
+            for (uint32_t j = 0; j < pc.size(); j++) {
+                worst = i == j ? worst : std::min(worst, std::hypot(pc.xs[i] - pc.xs[j], pc.ys[i] - pc.ys[j]) / (pc.rs[i] + pc.rs[j]));
+            }
+            boulder_depth = std::max(boulder_depth, pc.ys[i] - 250);
+            grid_depth = std::max(grid_depth, grid.pc().ys[i] - 250);
+        }
+        assert(worst > 0.8f && boulder_depth > 50 && std::fabs(boulder_depth - grid_depth) < 10);
+        grid.stop();
+        sap.stop();
+        std::cout<<"   "<<isa::name(level)<<": closest pair with a boulder at "<<worst<<" of contact, boulders "
+                 <<boulder_depth<<"px down ("<<grid_depth<<"px on the grid)"<<std::endl;
+    }
+
+    std::cout<<"\n13 - ok: sweep and prune matches the hierarchical grid on mixed radii"<<std::endl;
+}
+
+
+void shift_binning_test() {
+    constexpr float32_t dt  = 0.01f;
+
+    // 8px cells either way: shifting and multiplying by 1/8 bin every particle alike
+    f32_solver reference(dt);
+    f32_shift_solver shifted(dt);
+    for (int i = 0; i < 1200; i++) {
+        particle<float32_t> p(3.8 * (i % 60) + 30, 3.8 * (i / 60) + 300, 3.8 * (i % 60) + 30, 3.8 * (i / 60) + 300, 1.5f + i % 2 * 0.5f);
+        reference.add_particle(p);
+        shifted.add_particle(p);
+    }
+    assert(shifted.grid_rows() == reference.grid_rows() && shifted.grid_cols() == 64);
+    for (int s = 0; s < 60; s++) {
+        reference.step();
+        shifted.step();
+    }
+    for (uint32_t i = 0; i < reference.pc().size(); i++) {
+        assert(std::abs(reference.pc().xs[i] - shifted.pc().xs[i]) < 1e-3f && std::abs(reference.pc().ys[i] - shifted.pc().ys[i]) < 1e-3f);
+    }
+
+    reference.stop();
+    shifted.stop();
+
+    // larger particles get the next power of 2, not their diameter
+    f32_shift_solver wide(dt);
+    wide.add_particle(particle<float32_t>(400, 100, 400, 100, 5));
+    assert(wide.grid_cols() == 32 && wide.grid_rows() == 32);
+    wide.stop();
+
+    bool thrown = false;
+    try {
+        f32_shift_solver odd(dt, 300, 200);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    std::cout<<"\n14 - ok: shift binning matches reciprocal binning on power of 2 cells"<<std::endl;
+}
+
 } // namespace collision_engine
 
 int main() { 
@@ -68,6 +585,17 @@ int main() {
     collision_engine::simd::resolve_particle_collision_test();
     collision_engine::simd::resolve_collision_test();
     collision_engine::simd::step_test();
+    collision_engine::simd::isa_dispatch_test();
+    collision_engine::simd::reorder_test();
+    collision_engine::simd::incremental_grid_test();
+    collision_engine::simd::sleeping_test();
+    collision_engine::simd::world_size_test();
+    collision_engine::simd::mixed_radii_test();
+    collision_engine::simd::remove_particles_test();
+    collision_engine::simd::fixed_point_precision_test();
+    collision_engine::simd::spatial_hash_test();
+    collision_engine::simd::sweep_and_prune_test();
+    collision_engine::simd::shift_binning_test();
 
     std::cout<<"==================================================================="<<std::endl;
     std::cout<<"simd_solver_test - ok."<<std::endl;
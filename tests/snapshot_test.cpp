@@ -0,0 +1,200 @@
+#include "../src/physics/snapshot.hpp"
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace collision_engine {
+
+using W = vec2<uint32_t>;
+using VT = vec2<float32_t>;
+using PT = particle<VT>;
+
+void fill_soa(simd::f32_solver& solver, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        simd::particle<float32_t> p(3.5 * (i % 40) + 30, 3.5 * (i / 40) + 30, 3.5 * (i % 40) + 29.5, 3.5 * (i / 40) + 30, 1.5 + (i % 3) * 0.25);
+        solver.add_particle(p);
+    }
+}
+
+void soa_file_roundtrip_test() {
+    const std::string path = "snapshot_test_soa.bin";
+    simd::f32_solver solver(0.01f);
+    solver.set_reordering(simd::ordering::cell, 8); // handles no longer match indices
+    fill_soa(solver, 600);
+    for (int s = 0; s < 20; s++) {
+        solver.step();
+    }
+    assert(save_snapshot(path, solver));
+
+    simd::f32_solver restored(0.01f);
+    restored.set_reordering(simd::ordering::cell, 8);
+    assert(load_snapshot(path, restored));
+    const auto& a = solver.pc();
+    const auto& b = restored.pc();
+    assert(b.size() == 600);
+    for (uint32_t i = 0; i < 600; i++) {
+        assert(a.xs[i] == b.xs[i] && a.ys[i] == b.ys[i] && a.pxs[i] == b.pxs[i] && a.pys[i] == b.pys[i]);
+        assert(a.rs[i] == b.rs[i] && a.handle_of(i) == b.handle_of(i) && a.index_of(i) == b.index_of(i));
+    }
+
+    for (int s = 0; s < 10; s++) { // the restored state carries on exactly like the original
+        solver.step();
+        restored.step();
+    }
+    for (uint32_t i = 0; i < 600; i++) {
+        assert(a.xs[i] == b.xs[i] && a.ys[i] == b.ys[i]);
+    }
+
+    simd::f32_solver other_dt(0.02f); // integration constants differ: refused
+    assert(!load_snapshot(path, other_dt));
+    assert(other_dt.pc().size() == 0);
+    assert(!load_snapshot("snapshot_test_missing.bin", other_dt));
+    std::remove(path.c_str());
+
+    std::cout<<"\n1 - ok: soa snapshot file round trip"<<std::endl;
+}
+
+void aos_file_roundtrip_test() {
+    const std::string path = "snapshot_test_aos.bin";
+    environment<VT, W> env(W{512, 512});
+    std::vector<PT> storage(600);
+    for (uint32_t i = 0; i < storage.size(); i++) {
+        storage[i].radius = 2;
+        storage[i].position = VT(3.5f * (i % 40) + 30, 3.5f * (i / 40) + 30);
+        storage[i].prev_position = storage[i].position;
+        env.add_particle(&storage[i]);
+    }
+    for (int s = 0; s < 20; s++) {
+        env.step(0.01f);
+    }
+    assert(save_snapshot(path, env));
+
+    environment<VT, W> empty(W{512, 512});
+    assert(!load_snapshot(path, empty)); // nowhere to put the particles
+    std::vector<PT> restored_storage(600);
+    assert(load_snapshot(path, empty, restored_storage.data()));
+    assert(empty.particles().size() == 600);
+    for (uint32_t i = 0; i < 600; i++) {
+        assert(restored_storage[i].position.i() == storage[i].position.i());
+        assert(restored_storage[i].position.j() == storage[i].position.j());
+        assert(restored_storage[i].prev_position.j() == storage[i].prev_position.j());
+    }
+
+    environment<VT, W> other_world(W{1024, 1024});
+    assert(!load_snapshot(path, other_world, restored_storage.data()));
+
+    simd::f32_solver solver(0.01f); // wrong kind
+    assert(!load_snapshot(path, solver));
+    std::remove(path.c_str());
+
+    std::cout<<"\n2 - ok: aos snapshot file round trip"<<std::endl;
+}
+
+void ring_rewind_test() {
+    simd::f32_solver solver(0.01f);
+    fill_soa(solver, 400);
+    snapshot_ring ring(3);
+    std::vector<std::vector<float32_t>> history;
+    for (int s = 0; s < 5; s++) {
+        solver.step();
+        ring.push(solver);
+        history.emplace_back(solver.pc().ys.begin(), solver.pc().ys.end());
+    }
+    assert(ring.size() == 3 && ring.capacity() == 3);
+    assert(!ring.at(3).valid());
+
+    assert(ring.rewind(2, solver)); // back to the third push
+    for (uint32_t i = 0; i < 400; i++) {
+        assert(solver.pc().ys[i] == history[2][i]);
+    }
+    assert(ring.size() == 1);
+
+    solver.step();
+    ring.push(solver);
+    assert(ring.size() == 2);
+    assert(ring.rewind(1, solver));
+    for (uint32_t i = 0; i < 400; i++) {
+        assert(solver.pc().ys[i] == history[2][i]);
+    }
+
+    environment<VT, W> env(W{512, 512}); // rewinding in place
+    std::vector<PT> storage(100);
+    for (uint32_t i = 0; i < storage.size(); i++) {
+        storage[i].radius = 2;
+        storage[i].position = VT(5.f * (i % 10) + 100, 5.f * (i / 10) + 100);
+        storage[i].prev_position = storage[i].position;
+        env.add_particle(&storage[i]);
+    }
+    snapshot_ring env_ring(2);
+    env_ring.push(env);
+    const VT start = storage[42].position;
+    for (int s = 0; s < 30; s++) {
+        env.step(1.f / 60.f);
+    }
+    assert(storage[42].position.j() != start.j());
+    assert(env_ring.rewind(0, env));
+    assert(storage[42].position.i() == start.i() && storage[42].position.j() == start.j());
+
+    std::cout<<"\n3 - ok: snapshot ring rewind"<<std::endl;
+}
+
+void corrupt_image_test() {
+    simd::f32_solver solver(0.01f);
+    fill_soa(solver, 300);
+    std::vector<std::byte> image;
+    capture(solver, image);
+    assert(snapshot_view(image.data(), image.size()).valid());
+
+    // headers that do not match the image size are refused before anything is read
+    auto header_of = [](std::vector<std::byte>& img) { return reinterpret_cast<snapshot_header*>(img.data()); };
+    std::vector<std::byte> bad = image;
+    assert(!snapshot_view(bad.data(), bad.size() - 64).valid()); // truncated
+    header_of(bad)->count = 1ull << 40;
+    assert(!snapshot_view(bad.data(), bad.size()).valid());
+    bad = image;
+    header_of(bad)->count = 200; // fits in the image, but the sections are larger
+    assert(!snapshot_view(bad.data(), bad.size()).valid());
+    bad = image;
+    header_of(bad)->element_bytes = 8;
+    assert(!snapshot_view(bad.data(), bad.size()).valid());
+    bad = image;
+    header_of(bad)->slot_count = 299;
+    assert(!snapshot_view(bad.data(), bad.size()).valid());
+
+    // as are slots out of range or repeated, leaving the solver untouched
+    const uint32_t slots = snapshot_detail::soa_sections - 1;
+    for (uint32_t bogus : {300u, ~0u, 7u}) {
+        bad = image;
+        const snapshot_view view(bad.data(), bad.size());
+        uint32_t* slot_of = reinterpret_cast<uint32_t*>(const_cast<std::byte*>(view.section(slots)));
+        slot_of[3] = bogus;
+        assert(view.valid());
+        simd::f32_solver restored(0.01f);
+        assert(!restore(view, restored) && restored.pc().size() == 0);
+    }
+    simd::f32_solver restored(0.01f);
+    assert(restore(snapshot_view(image.data(), image.size()), restored) && restored.pc().size() == 300);
+
+    std::cout<<"\n4 - ok: corrupt snapshots refused"<<std::endl;
+}
+
+} // namespace collision_engine
+
+int main() {
+    std::cout<<"==================================================================="<<std::endl;
+    std::cout<<"Running snapshot_test.cpp..."<<std::endl;
+    std::cout<<"==================================================================="<<std::endl;
+
+    collision_engine::soa_file_roundtrip_test();
+    collision_engine::aos_file_roundtrip_test();
+    collision_engine::ring_rewind_test();
+    collision_engine::corrupt_image_test();
+
+    std::cout<<"==================================================================="<<std::endl;
+    std::cout<<"snapshot_test - ok."<<std::endl;
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include "../src/physics/spatial_hash.hpp"
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace collision_engine {
+
+void populate_test() {
+    // far apart, negative and huge coordinates, with two particles sharing a cell
+    const std::vector<std::pair<float32_t, float32_t>> points = {
+        {5, 5}, {-5, 5}, {5, -5}, {1e9f, 3}, {-1e9f, -1e9f}, {7, 2}, {1e5f, 1e5f}, {-3e38f, 0},
+    };
+    spatial_hash hash(10);
+    hash.populate(points.size(), [&](uint32_t idx) { return std::array{points[idx].first, points[idx].second, 1.f}; });
+
+    assert(hash.cell_count() == points.size() - 1 && hash.ids.size() == points.size());
+    assert(hash.coordinate(-5) == -1 && hash.coordinate(-3e38f) == -(1 << 30));
+    for (uint32_t c = 1; c < hash.cell_count(); c++) { // row-major order
+        assert(hash.cell_y(c - 1) < hash.cell_y(c) || (hash.cell_y(c - 1) == hash.cell_y(c) && hash.cell_x(c - 1) < hash.cell_x(c)));
+    }
+    for (uint32_t idx = 0; idx < points.size(); idx++) {
+        const uint32_t c = hash.find(hash.coordinate(points[idx].first), hash.coordinate(points[idx].second));
+        assert(c == hash.cell_of(idx));
+        bool found = false;
+        for (uint32_t slot = hash.cell_begin(c); slot < hash.cell_begin(c + 1); slot++) {
+            found |= hash.ids[slot] == idx;
+        }
+        assert(found);
+    }
+    const uint32_t shared = hash.cell_of(0);
+    assert(hash.cell_of(5) == shared && hash.ids[hash.cell_begin(shared)] == 0 && hash.ids[hash.cell_begin(shared) + 1] == 5);
+    assert(hash.find(1, 1) == spatial_hash::npos);
+    assert(hash.row_begin(0) == hash.find(-(1 << 30), 0) && hash.row_begin(1) == hash.find(10000, 10000));
+
+    std::cout<<"\n1 - ok: "<<hash.cell_count()<<" occupied cells sorted row-major over a 2e9 px plane"<<std::endl;
+}
+
+void pairs_test() {
+    // clusters of particles of radius up to 2, far apart on a 100k world
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float32_t> jitter(-60, 60);
+    std::vector<std::pair<float32_t, float32_t>> points;
+    for (float32_t cx : {-50000.f, 0.f, 12345.f, 99000.f}) {
+        for (int i = 0; i < 500; i++) {
+            points.emplace_back(cx + jitter(rng), cx / 2 + jitter(rng));
+        }
+    }
+    spatial_hash hash(4);
+    hash.populate(points.size(), [&](uint32_t idx) { return std::array{points[idx].first, points[idx].second, 1.f}; });
+
+    // every pair closer than a cell is found, and no pair twice
+    std::set<std::pair<uint32_t, uint32_t>> found;
+    uint32_t candidates = 0;
+    hash.for_each_pair(0, hash.cell_count(), [&](uint32_t a, uint32_t b) {
+        found.insert({std::min(a, b), std::max(a, b)});
+        candidates++;
+    });
+    assert(found.size() == candidates);
+    uint32_t close = 0;
+    for (uint32_t a = 0; a < points.size(); a++) {
+        for (uint32_t b = a + 1; b < points.size(); b++) {
+            if (std::hypot(points[a].first - points[b].first, points[a].second - points[b].second) < 4) {
+                assert(found.count({a, b}));
+                close++;
+            }
+        }
+    }
+    assert(close > 0);
+
+    // stripes of whole rows, each 2 rows tall at least, together covering every cell once
+    const auto stripes = hash.stripes(6);
+    assert(stripes.size() > 1 && stripes.size() <= 6 && stripes.front().first == 0 && stripes.back().second == hash.cell_count());
+    for (uint32_t s = 1; s < stripes.size(); s++) {
+        assert(stripes[s].first == stripes[s - 1].second);
+        assert(hash.cell_y(stripes[s].first) >= hash.cell_y(stripes[s - 1].first) + 2);
+        assert(hash.cell_y(stripes[s].first) != hash.cell_y(stripes[s].first - 1));
+    }
+
+    std::cout<<"\n2 - ok: "<<candidates<<" candidate pairs cover all "<<close<<" close pairs once"<<std::endl;
+}
+
+void memory_test() {
+    // a dense grid of 4px cells over 100k x 100k px would hold 625M cells
+    std::vector<std::pair<float32_t, float32_t>> points;
+    for (int i = 0; i < 20000; i++) { // 20 clusters of 40x25 particles 2px apart
+        const float32_t cx = 5000.f * (i / 1000), cy = 4000.f * (i / 1000 % 7);
+        points.emplace_back(cx + 2.f * (i % 40), cy + 2.f * (i / 40 % 25));
+    }
+    spatial_hash hash(4);
+    size_t peak = 0;
+    for (int frame = 0; frame < 3; frame++) {
+        hash.populate(points.size(), [&](uint32_t idx) { return std::array{points[idx].first, points[idx].second, 1.f}; });
+        peak = std::max(peak, hash.memory_bytes());
+    }
+    assert(hash.cell_count() == 20 * 20 * 13);
+    assert(peak < 256 * hash.cell_count()); // a few dozen bytes per occupied cell
+
+    std::cout<<"\n3 - ok: "<<hash.cell_count()<<" occupied cells in "<<peak / 1024<<" KiB"<<std::endl;
+}
+
+} // namespace collision engine
+
+int main() {
+    std::cout<<"==================================================================="<<std::endl;
+    std::cout<<"Running spatial_hash_test.cpp..."<<std::endl;
+    std::cout<<"==================================================================="<<std::endl;
+
+    collision_engine::populate_test();
+    collision_engine::pairs_test();
+    collision_engine::memory_test();
+
+    std::cout<<"==================================================================="<<std::endl;
+    std::cout<<"spatial_hash_test - ok."<<std::endl;
+
+    return 0;
+}
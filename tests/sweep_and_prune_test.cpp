@@ -0,0 +1,166 @@
+#include "../src/physics/sweep_and_prune.hpp"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace collision_engine {
+
+using circles = std::vector<std::array<float32_t, 3>>;
+
+/**
+ * @return number of pairs, after asserting the slots are sorted and the pairs are exactly
+ *         those overlapping along x, each once
+ */
+uint32_t check_pairs(const sweep_and_prune& sap, const circles& cs) {
+    for (uint32_t s = 1; s < sap.size(); s++) {
+        assert(sap.min_x(s - 1) <= sap.min_x(s));
+    }
+    std::set<std::pair<uint32_t, uint32_t>> found;
+    uint32_t candidates = 0;
+    sap.for_each_pair(0, sap.size(), [&](uint32_t a, uint32_t b) {
+        found.insert({std::min(a, b), std::max(a, b)});
+        candidates++;
+    });
+    assert(found.size() == candidates);
+    uint32_t overlapping = 0;
+    for (uint32_t a = 0; a < cs.size(); a++) {
+        for (uint32_t b = a + 1; b < cs.size(); b++) {
+            const bool overlap = cs[a][0] - cs[a][2] <= cs[b][0] + cs[b][2] && cs[b][0] - cs[b][2] <= cs[a][0] + cs[a][2];
+            assert(overlap == (found.count({a, b}) == 1));
+            overlapping += overlap;
+        }
+    }
+    return overlapping;
+}
+
+void pairs_test() {
+    // a hot spot of small particles, a scattering of large ones, negative coordinates
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float32_t> unit(0, 1);
+    circles cs;
+    for (int i = 0; i < 1500; i++) {
+        cs.push_back(i < 1000 ? std::array{40 + 20 * unit(rng), 40 + 20 * unit(rng), 0.5f + unit(rng)}
+                              : std::array{-500 + 2000 * unit(rng), 2000 * unit(rng), 1 + 15 * unit(rng)});
+    }
+    sweep_and_prune sap;
+    sap.populate(cs.size(), [&](uint32_t idx) { return cs[idx]; });
+    assert(sap.radix_sorted());
+    const uint32_t pairs = check_pairs(sap, cs);
+
+    std::cout<<"\n1 - ok: radix sorted extents give all "<<pairs<<" pairs overlapping along x once"<<std::endl;
+}
+
+void reuse_test() {
+    std::mt19937 rng(9);
+    std::uniform_real_distribution<float32_t> unit(0, 1);
+    circles cs;
+    for (int i = 0; i < 2000; i++) {
+        cs.push_back({1000 * unit(rng), 1000 * unit(rng), 2});
+    }
+    sweep_and_prune sap;
+    sap.populate(cs.size(), [&](uint32_t idx) { return cs[idx]; });
+
+    // small moves are sorted in place from the last order
+    for (int frame = 0; frame < 5; frame++) {
+        for (auto& c : cs) {
+            c[0] += unit(rng) - 0.5f;
+        }
+        sap.populate(cs.size(), [&](uint32_t idx) { return cs[idx]; });
+        assert(!sap.radix_sorted() && sap.moves() < cs.size());
+        check_pairs(sap, cs);
+    }
+    const uint32_t moves = sap.moves(), n = cs.size();
+
+    // a shuffle runs out of moves, and a new count starts over
+    std::shuffle(cs.begin(), cs.end(), rng);
+    sap.populate(cs.size(), [&](uint32_t idx) { return cs[idx]; });
+    assert(sap.radix_sorted());
+    check_pairs(sap, cs);
+    cs.resize(1500);
+    sap.populate(cs.size(), [&](uint32_t idx) { return cs[idx]; });
+    assert(sap.radix_sorted() && sap.moves() == 0);
+    check_pairs(sap, cs);
+
+    std::cout<<"\n2 - ok: insertion sort reuses the last order ("<<moves<<" moves for "<<n<<" particles)"<<std::endl;
+}
+
+void stripes_test() {
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float32_t> unit(0, 1);
+    circles cs;
+    for (int i = 0; i < 4000; i++) {
+        cs.push_back({2000 * unit(rng) * unit(rng), 100 * unit(rng), 1 + 3 * unit(rng)});
+    }
+    sweep_and_prune sap;
+    sap.populate(cs.size(), [&](uint32_t idx) { return cs[idx]; });
+
+    // the spans of a stripe end within the next one, so stripes of one colour are disjoint
+    const auto stripes = sap.stripes(8);
+    assert(stripes.size() == 8 && stripes.front().first == 0 && stripes.back().second == sap.size());
+    for (uint32_t k = 0; k < stripes.size(); k++) {
+        assert(k == 0 || stripes[k].first == stripes[k - 1].second);
+        const uint32_t limit = k + 1 < stripes.size() ? stripes[k + 1].second : sap.size();
+        for (uint32_t s = stripes[k].first; s < stripes[k].second; s++) {
+            assert(sap.span_end(s) <= limit);
+        }
+    }
+
+    std::cout<<"\n3 - ok: "<<stripes.size()<<" stripes whose spans reach at most the next one"<<std::endl;
+}
+
+void span_ends_test() {
+    // wide particles among narrow ones, so spans both grow and shrink from slot to slot
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float32_t> unit(0, 1);
+    circles cs;
+    for (int i = 0; i < 3000; i++) {
+        cs.push_back({300 * unit(rng), 300 * unit(rng), i % 50 ? 0.5f + 2 * unit(rng) : 10 + 20 * unit(rng)});
+    }
+
+    uint32_t levels = 0;
+    for (simd::isa::level level : {simd::isa::level::scalar, simd::isa::level::neon, simd::isa::level::sse4, simd::isa::level::avx2, simd::isa::level::avx512}) {
+        if (!simd::isa::supported(level)) continue;
+        sweep_and_prune sap(level);
+        circles moved = cs;
+        for (int frame = 0; frame < 3; frame++) {
+            sap.populate(moved.size(), [&](uint32_t idx) { return moved[idx]; });
+            for (uint32_t s = 0; s < sap.size(); s++) {
+                uint32_t end = s + 1;
+                while (end < sap.size() && sap.min_x(end) <= sap.max_x(s)) {
+                    end++;
+                }
+                assert(sap.span_end(s) == end);
+            }
+            for (auto& c : moved) {
+                c[0] += unit(rng) - 0.5f;
+            }
+        }
+        levels++;
+    }
+
+    std::cout<<"\n4 - ok: span ends counted on "<<levels<<" instruction sets match a scan of the extents"<<std::endl;
+}
+
+} // namespace collision engine
+
+int main() {
+    std::cout<<"==================================================================="<<std::endl;
+    std::cout<<"Running sweep_and_prune_test.cpp..."<<std::endl;
+    std::cout<<"==================================================================="<<std::endl;
+
+    collision_engine::pairs_test();
+    collision_engine::reuse_test();
+    collision_engine::stripes_test();
+    collision_engine::span_ends_test();
+
+    std::cout<<"==================================================================="<<std::endl;
+    std::cout<<"sweep_and_prune_test - ok."<<std::endl;
+
+    return 0;
+}
@@ -0,0 +1,466 @@
+#include "../src/common/task_graph.hpp"
+#include "../src/physics/solver.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace collision_engine {
+
+void dependency_order_test() {
+    thread_pool tp;
+    task_graph graph;
+
+    // diamond a -> (b, c) -> d, every task records the tick it finished at
+    std::atomic_uint32_t tick = 0;
+    std::vector<uint32_t> done(4, 0);
+    auto a = graph.add([&]() { done[0] = ++tick; });
+    auto b = graph.add([&]() { done[1] = ++tick; });
+    auto c = graph.add([&]() { done[2] = ++tick; });
+    auto d = graph.add([&]() { done[3] = ++tick; });
+    graph.precede(a, b);
+    graph.precede(a, c);
+    graph.precede(b, d);
+    graph.precede(c, d);
+
+    graph.run(tp);
+
+    assert(tick == 4);
+    assert(done[0] < done[1] && done[0] < done[2]);
+    assert(done[1] < done[3] && done[2] < done[3]);
+
+    std::cout<<"\n1 - ok: dependency order"<<std::endl; 
+}
+
+void rerun_test() {
+    thread_pool tp;
+    task_graph graph;
+
+    // 64 independent chains of 8 tasks, each chain bumps its own counter in order
+    constexpr uint32_t chains = 64;
+    constexpr uint32_t length = 8;
+    std::vector<uint32_t> counters(chains, 0);
+    std::atomic_bool in_order = true;
+    for (uint32_t c = 0; c < chains; c++) {
+        task_graph::task_id prev = 0;
+        for (uint32_t l = 0; l < length; l++) {
+            auto id = graph.add([&, c, l]() {
+                if (counters[c] % length != l) { in_order = false; }
+                counters[c]++;
+            });
+            if (l > 0) { graph.precede(prev, id); }
+            prev = id;
+        }
+    }
+
+    graph.run(tp);
+    graph.run(tp);
+
+    assert(in_order);
+    assert(graph.size() == chains * length);
+    for (uint32_t count : counters) {
+        assert(count == 2 * length);
+    }
+
+    std::cout<<"\n2 - ok: graph rerun"<<std::endl; 
+}
+
+void environment_step_test() {
+    using W = vec2<uint32_t>;
+    using VT = vec2<float32_t>;
+    using PT = particle<VT>;
+
+    constexpr uint32_t world = 512;
+    environment<VT, W> env(W{world, world});
+    std::vector<PT> storage(2000);
+    for (uint32_t i = 0; i < storage.size(); i++) {
+        PT& p = storage[i];
+        p.radius = 2;
+        p.position = VT(3.5f * (i % 100) + 20, 3.5f * (i / 100) + 20);
+        p.prev_position = p.position;
+        env.add_particle(&p);
+    }
+    assert(env.stripes().front().first == 0 && env.stripes().back().second == 128);
+
+    for (uint32_t frame = 0; frame < 60; frame++) {
+        env.step(1.f / 60.f);
+    }
+
+    uint32_t migrations = 0;
+    for (uint32_t m : env.migrations()) { migrations += m; }
+    assert(migrations < storage.size() * 4);
+
+    for (const PT& p : storage) {
+        assert(std::isfinite(p.position.i()) && std::isfinite(p.position.j()));
+        assert(p.position.i() >= 4.f && p.position.i() <= world - 4.f);
+        assert(p.position.j() >= 4.f && p.position.j() <= world - 4.f);
+    }
+
+    std::cout<<"\n3 - ok: environment step on task graph"<<std::endl; 
+}
+
+void balanced_stripes_test() {
+    using W = vec2<uint32_t>;
+    using VT = vec2<float32_t>;
+    using PT = particle<VT>;
+
+    constexpr uint32_t world = 512; // 4px cells
+    environment<VT, W> env(W{world, world});
+    std::vector<PT> storage(4000);
+    for (uint32_t i = 0; i < storage.size(); i++) { // dense band over grid rows 8..19
+        PT& p = storage[i];
+        p.radius = 2;
+        p.position = VT(32.f + 1.2f * (i % 40), 20.f + 1.2f * (i / 40));
+        p.prev_position = p.position;
+        env.add_particle(&p);
+    }
+
+    env.reset_busy_time();
+    env.step_barrier(1.f / 60.f);
+
+    // stripes tile every row, stay at least 2 rows tall and crowd around the band
+    const auto& stripes = env.stripes();
+    assert(stripes.front().first == 0 && stripes.back().second == 128);
+    uint32_t stripes_in_band = 0;
+    for (uint32_t s = 0; s < stripes.size(); s++) {
+        assert(stripes[s].second - stripes[s].first >= 2);
+        if (s > 0) { assert(stripes[s].first == stripes[s - 1].second); }
+        if (stripes[s].first >= 6 && stripes[s].second <= 22) { stripes_in_band++; }
+    }
+    assert(stripes_in_band >= std::min<size_t>(stripes.size() / 2, 4)); // the band only fits six 2-row stripes
+
+    const std::vector<uint64_t> busy = env.busy_time();
+    uint64_t total_busy = 0;
+    for (uint64_t ns : busy) { total_busy += ns; }
+    assert(total_busy > 0);
+
+    // on many threads the stripes have rows to spare: over a sparse lattice, a dense band of
+    // x 200..240 (grid rows are the x axis, so rows 50..59) gets thinner stripes than the rest
+    environment<VT, W> wide(W{world, world}, 16);
+    std::vector<PT> pile;
+    pile.reserve(62 * 62 + 1200); // the environment keeps pointers into it
+    for (uint32_t i = 0; i < 62 * 62; i++) {
+        const float32_t x = 12.f + 8.f * (i % 62), y = 12.f + 8.f * (i / 62);
+        if (x > 196.f && x < 244.f) continue;
+        pile.emplace_back().position = VT(x, y);
+    }
+    for (uint32_t i = 0; i < 1200; i++) {
+        pile.emplace_back().position = VT(202.f + 4.f * (i % 10), 14.f + 4.f * (i / 10));
+    }
+    for (PT& p : pile) {
+        p.radius = 2;
+        p.prev_position = p.position;
+        wide.add_particle(&p);
+    }
+    wide.step(1.f / 60.f);
+    const auto& wide_stripes = wide.stripes();
+    uint32_t tallest_in_band = 0, shortest_outside = 128;
+    for (const auto& [first, last] : wide_stripes) {
+        if (first >= 50 && last <= 60) { tallest_in_band = std::max(tallest_in_band, last - first); }
+        if (last <= 50 || first >= 60) { shortest_outside = std::min(shortest_outside, last - first); }
+    }
+    assert(tallest_in_band >= 2 && tallest_in_band < shortest_outside);
+    wide.stop();
+
+    std::cout<<"\n4 - ok: load-balanced stripes ("<<stripes.size()<<" stripes, "<<stripes_in_band<<" inside the band; "
+             <<tallest_in_band<<" rows inside and "<<shortest_outside<<"+ outside the dense band on 16 threads)"<<std::endl; 
+}
+
+void sleeping_test() {
+    using W = vec2<uint32_t>;
+    using VT = vec2<float32_t>;
+    using PT = particle<VT>;
+
+    constexpr uint32_t world = 512;
+    environment<VT, W> env(W{world, world});
+    std::vector<PT> storage(81);
+    for (uint32_t i = 0; i < 80; i++) { // a floor row of particles that do not touch
+        PT& p = storage[i];
+        p.radius = 2;
+        p.position = VT(6.f * i + 20, 508.f);
+        p.prev_position = p.position;
+        env.add_particle(&p);
+    }
+    env.enable_sleeping(0.01f, 20);
+    for (uint32_t frame = 0; frame < 10; frame++) {
+        env.step(1.f / 60.f);
+    }
+    for (uint32_t i = 0; i < 80; i++) {
+        assert(env.resting(i));
+    }
+
+    // a particle dropped on the left end wakes its neighbourhood only
+    std::vector<VT> rest_positions;
+    for (uint32_t i = 0; i < 80; i++) { rest_positions.push_back(storage[i].position); }
+    storage[80].radius = 2;
+    storage[80].position = VT(35.f, 500.f);
+    storage[80].prev_position = storage[80].position;
+    env.add_particle(&storage[80]);
+    for (uint32_t frame = 0; frame < 40; frame++) {
+        env.step(1.f / 60.f);
+    }
+    uint32_t moved = 0;
+    for (uint32_t i = 0; i < 80; i++) {
+        const bool same = storage[i].position.i() == rest_positions[i].i()
+            && storage[i].position.j() == rest_positions[i].j();
+        moved += !same;
+        if (storage[i].position.i() > 100) { // far from the impact: untouched
+            assert(same && env.resting(i));
+        }
+    }
+    assert(moved > 0 && moved < 20);
+    assert(storage[80].position.j() > 500.f);
+
+    std::cout<<"\n5 - ok: sleeping particles ("<<moved<<" pushed)"<<std::endl; 
+}
+
+void mixed_radii_test() {
+    using W = vec2<uint32_t>;
+    using VT = vec2<float32_t>;
+    using PT = particle<VT>;
+
+    constexpr uint32_t world = 512; // 4px cells fit the grains only
+    for (bool barrier : {false, true}) {
+        environment<VT, W> env(W{world, world});
+        std::vector<PT> storage(1203);
+        for (uint32_t i = 0; i < storage.size(); i++) { // a bed of grains, and boulders dropped on it
+            PT& p = storage[i];
+            p.radius = i < 1200 ? 1.5f : 8.f + 8.f * (i - 1200);
+            p.position = i < 1200 ? VT(4.2f * (i % 100) + 50, 4.2f * (i / 100) + 450) : VT(150.f + 100.f * (i - 1200), 380.f);
+            p.prev_position = p.position;
+            env.add_particle(&p);
+        }
+        for (uint32_t frame = 0; frame < 120; frame++) {
+            barrier ? env.step_barrier(1.f / 60.f) : env.step(1.f / 60.f);
+        }
+
+        float32_t worst = 1;
+        for (uint32_t a = 1200; a < storage.size(); a++) {
+            assert(storage[a].position.j() > 440.f); // fell into the bed
+            for (uint32_t b = 0; b < storage.size(); b++) {
+                const VT d = storage[a].position - storage[b].position;
+                const float32_t dist = std::sqrt(d.i() * d.i() + d.j() * d.j());
+                worst = a == b ? worst : std::min(worst, dist / (storage[a].radius + storage[b].radius));
+            }
+        }
+        assert(worst > 0.8f); // no grain inside a boulder, nor boulders inside each other
+        env.stop();
+
+        std::cout<<"\n"<<6 + barrier<<" - ok: mixed radii with "<<(barrier ? "step_barrier" : "the task graph")
+                 <<" (closest pair with a boulder at "<<worst<<" of contact)"<<std::endl;
+    }
+}
+
+
+void remove_particles_test() {
+    using W = vec2<uint32_t>;
+    using VT = vec2<float32_t>;
+    using PT = particle<VT>;
+
+    constexpr uint32_t world = 512;
+    for (bool barrier : {false, true}) {
+        environment<VT, W> env(W{world, world});
+        std::vector<PT> storage(1501);
+        std::vector<uint32_t> handles;
+        for (uint32_t i = 0; i < storage.size(); i++) { // a block of grains and one boulder above it
+            PT& p = storage[i];
+            p.radius = i < 1500 ? 1.5f : 12.f;
+            p.position = i < 1500 ? VT(4.2f * (i % 100) + 50, 4.2f * (i / 100) + 300) : VT(250.f, 200.f);
+            p.prev_position = p.position;
+            handles.push_back(env.add_particle(&p));
+        }
+
+        // particles removed between frames are neither binned nor integrated anymore
+        std::vector<VT> frozen(storage.size());
+        uint32_t doomed_count = 0;
+        for (uint32_t frame = 0; frame < 40; frame++) {
+            if (frame % 10 == 5) {
+                std::vector<uint32_t> doomed;
+                for (uint32_t i = frame / 10; i < 1500; i += 7) doomed.push_back(handles[i]);
+                if (frame == 25) doomed.push_back(handles[1500]);
+                assert(env.remove_particles(doomed) == doomed.size());
+                doomed_count += doomed.size();
+                for (uint32_t h : doomed) frozen[h] = storage[h].position;
+            }
+            barrier ? env.step_barrier(1.f / 60.f) : env.step(1.f / 60.f);
+        }
+
+        uint32_t removed = 0;
+        for (uint32_t i = 0; i < storage.size(); i++) {
+            const uint32_t idx = env.handles().index_of(handles[i]);
+            if (idx == handle_table::invalid) {
+                assert(storage[i].position.i() == frozen[i].i() && storage[i].position.j() == frozen[i].j());
+                removed++;
+            } else {
+                assert(env.particles()[idx] == &storage[i]);
+                assert(storage[i].position.j() >= 4.f && storage[i].position.j() <= world - 4.f);
+            }
+        }
+        assert(removed == doomed_count && env.particles().size() == storage.size() - removed);
+        assert(!env.remove_particle(handles[1500]));
+        env.stop();
+
+        std::cout<<"\n"<<8 + barrier<<" - ok: remove particles with "<<(barrier ? "step_barrier" : "the task graph")
+                 <<" ("<<env.particles().size()<<" left)"<<std::endl;
+    }
+}
+
+
+void spatial_hash_test() {
+    using W = vec2<uint32_t>;
+    using VT = vec2<float32_t>;
+    using PT = particle<VT>;
+
+    // three blocks of grains far apart in a 100k px wide world, binned on the hash only
+    for (bool barrier : {false, true}) {
+        environment<VT, W> env(W{100000, 4096}, 2, broadphase::spatial_hash);
+        std::vector<PT> storage(1800);
+        for (uint32_t i = 0; i < storage.size(); i++) {
+            PT& p = storage[i];
+            p.radius = 1.5f;
+            p.position = VT(4.2f * (i % 30) + 40000.f * (i / 600) + 100, 4.2f * (i % 600 / 30) + 3900);
+            p.prev_position = p.position;
+            env.add_particle(&p);
+        }
+        for (uint32_t frame = 0; frame < 120; frame++) {
+            barrier ? env.step_barrier(1.f / 60.f) : env.step(1.f / 60.f);
+        }
+
+        float32_t worst = 1, lowest = 0;
+        for (uint32_t a = 0; a < storage.size(); a++) {
+            lowest = std::max(lowest, storage[a].position.j());
+            for (uint32_t b = a + 1; b < storage.size(); b++) {
+                const VT d = storage[a].position - storage[b].position;
+                worst = std::min(worst, std::sqrt(d.i() * d.i() + d.j() * d.j()) / (storage[a].radius + storage[b].radius));
+            }
+        }
+        assert(lowest > 4085 && worst > 0.8f); // landed, without sinking into each other
+        assert(env.hash().cell_count() <= storage.size() && env.hash().memory_bytes() < 1 << 20);
+        env.stop();
+
+        std::cout<<"\n"<<10 + barrier<<" - ok: spatial hash with "<<(barrier ? "step_barrier" : "step")<<", "<<env.hash().cell_count()
+                 <<" cells of a 100k world (closest pair at "<<worst<<" of contact)"<<std::endl;
+    }
+}
+
+void sweep_and_prune_test() {
+    using W = vec2<uint32_t>;
+    using VT = vec2<float32_t>;
+    using PT = particle<VT>;
+
+    // the mixed radii bed again, with no cell size to fit the boulders
+    constexpr uint32_t world = 512;
+    for (bool barrier : {false, true}) {
+        environment<VT, W> env(W{world, world}, 2, broadphase::sweep_and_prune);
+        std::vector<PT> storage(1203);
+        for (uint32_t i = 0; i < storage.size(); i++) {
+            PT& p = storage[i];
+            p.radius = i < 1200 ? 1.5f : 8.f + 8.f * (i - 1200);
+            p.position = i < 1200 ? VT(4.2f * (i % 100) + 50, 4.2f * (i / 100) + 450) : VT(150.f + 100.f * (i - 1200), 380.f);
+            p.prev_position = p.position;
+            env.add_particle(&p);
+        }
+        uint32_t radix_sorts = 0;
+        for (uint32_t frame = 0; frame < 120; frame++) {
+            barrier ? env.step_barrier(1.f / 60.f) : env.step(1.f / 60.f);
+            radix_sorts += env.sap().radix_sorted();
+        }
+        assert(radix_sorts == 0); // the substeps after the first reuse the order
+
+        float32_t worst = 1;
+        for (uint32_t a = 1200; a < storage.size(); a++) {
+            assert(storage[a].position.j() > 440.f);
+            for (uint32_t b = 0; b < storage.size(); b++) {
+                const VT d = storage[a].position - storage[b].position;
+                const float32_t dist = std::sqrt(d.i() * d.i() + d.j() * d.j());
+                worst = a == b ? worst : std::min(worst, dist / (storage[a].radius + storage[b].radius));
+            }
+        }
+        assert(worst > 0.8f);
+        env.stop();
+
+        std::cout<<"\n"<<12 + barrier<<" - ok: sweep and prune with "<<(barrier ? "step_barrier" : "step")
+                 <<" (closest pair with a boulder at "<<worst<<" of contact)"<<std::endl;
+    }
+}
+
+void sleeping_boulder_test() {
+    using W = vec2<uint32_t>;
+    using VT = vec2<float32_t>;
+    using PT = particle<VT>;
+
+    constexpr uint32_t world = 512;
+    for (bool barrier : {false, true}) {
+        environment<VT, W> env(W{world, world});
+        std::vector<PT> storage(601);
+        for (uint32_t i = 0; i < 600; i++) { // a bed of grains 4 rows deep, left to fall asleep
+            PT& p = storage[i];
+            p.radius = 1.5f;
+            p.position = VT(3.f * (i % 150) + 30, 508.f - 3.f * (i / 150));
+            p.prev_position = p.position;
+            env.add_particle(&p);
+        }
+        env.enable_sleeping(0.01f, 20);
+        for (uint32_t frame = 0; frame < 30; frame++) {
+            barrier ? env.step_barrier(1.f / 60.f) : env.step(1.f / 60.f);
+        }
+        uint32_t asleep = 0;
+        for (uint32_t i = 0; i < 600; i++) { asleep += env.resting(i); }
+        assert(asleep > 500);
+
+        // a boulder rolling in from the side only meets sleepers: the cells within its reach
+        // wake up, so the grains it pushes are resolved against each other too
+        PT& boulder = storage[600];
+        boulder.radius = 12;
+        boulder.position = VT(200.f, 480.f);
+        boulder.prev_position = VT(197.f, 480.f);
+        env.add_particle(&boulder);
+        barrier ? env.step_barrier(1.f / 60.f) : env.step(1.f / 60.f);
+        const auto cell_of = [](float32_t x, float32_t y) { return static_cast<uint32_t>(x) / 4 * 128 + static_cast<uint32_t>(y) / 4; }; // 4px cells, x major
+        for (float32_t dx : {-12.f, 0.f, 12.f}) {
+            assert(!env.quiet(cell_of(boulder.position.i() + dx, boulder.position.j() + 13.f))); // the bed it is about to reach
+        }
+        float32_t worst = 1;
+        for (uint32_t frame = 0; frame < 60; frame++) {
+            barrier ? env.step_barrier(1.f / 60.f) : env.step(1.f / 60.f);
+            for (uint32_t a = 0; a < storage.size(); a++) {
+                for (uint32_t b = a + 1; b < storage.size(); b++) {
+                    const VT d = storage[a].position - storage[b].position;
+                    if (std::abs(d.i()) > 30 || std::abs(d.j()) > 30) continue;
+                    worst = std::min(worst, std::sqrt(d.i() * d.i() + d.j() * d.j()) / (storage[a].radius + storage[b].radius));
+                }
+            }
+        }
+        assert(boulder.position.i() > 210.f && worst > 0.75f);
+        env.stop();
+
+        std::cout<<"\n"<<14 + barrier<<" - ok: boulder onto sleepers with "<<(barrier ? "step_barrier" : "step")
+                 <<" (closest pair at "<<worst<<" of contact)"<<std::endl;
+    }
+}
+
+} // namespace collision engine
+
+int main() {
+    std::cout<<"==================================================================="<<std::endl;
+    std::cout<<"Running task_graph_test.cpp..."<<std::endl;
+    std::cout<<"==================================================================="<<std::endl;
+
+    collision_engine::dependency_order_test();
+    collision_engine::rerun_test();
+    collision_engine::environment_step_test();
+    collision_engine::balanced_stripes_test();
+    collision_engine::sleeping_test();
+    collision_engine::mixed_radii_test();
+    collision_engine::remove_particles_test();
+    collision_engine::spatial_hash_test();
+    collision_engine::sweep_and_prune_test();
+    collision_engine::sleeping_boulder_test();
+
+    std::cout<<"==================================================================="<<std::endl;
+    std::cout<<"task_graph_test - ok."<<std::endl;
+    
+    return 0;
+}